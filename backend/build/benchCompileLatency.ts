@@ -0,0 +1,165 @@
+/*
+ * Compile latency of typical student programs, from a plain compiler
+ * spawn to the compile cache with and without precompiled headers. Each
+ * sample compiles a new variant of the program (one extra global), so
+ * the cache misses; "hit" recompiles an unchanged one. Medians of
+ * `samples` runs, with caches in a temporary directory.
+ *
+ *   node --experimental-transform-types backend/build/benchCompileLatency.ts [samples]
+ */
+import { spawn } from 'child_process';
+import * as os from 'os';
+import * as path from 'path';
+import * as fs from 'fs/promises';
+
+const FLAGS = ['-Wall', '-Wextra'];
+
+const PROGRAMS: { name: string; file: string; source: string }[] = [
+  {
+    name: 'C hello',
+    file: 'hello.c',
+    source: '#include <stdio.h>\n\nint main(void) {\n    printf("hello\\n");\n    return 0;\n}\n',
+  },
+  {
+    name: 'C strings',
+    file: 'words.c',
+    source:
+      '#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <ctype.h>\n\n' +
+      'int main(void) {\n    char line[256];\n    int words = 0;\n' +
+      '    while (fgets(line, sizeof line, stdin)) {\n' +
+      '        for (char *t = strtok(line, " \\n"); t; t = strtok(NULL, " \\n")) {\n' +
+      '            words += isalpha((unsigned char)t[0]) != 0;\n        }\n    }\n' +
+      '    printf("%d\\n", words);\n    return EXIT_SUCCESS;\n}\n',
+  },
+  {
+    name: 'C++ iostream',
+    file: 'hello.cpp',
+    source:
+      '#include <iostream>\n\nint main() {\n' +
+      '    std::cout << "hello" << std::endl;\n    return 0;\n}\n',
+  },
+  {
+    name: 'C++ containers',
+    file: 'grades.cpp',
+    source:
+      '#include <iostream>\n#include <vector>\n#include <string>\n#include <map>\n' +
+      '#include <algorithm>\n\nint main() {\n' +
+      '    std::map<std::string, std::vector<int>> grades;\n' +
+      '    std::string name;\n    int grade;\n    while (std::cin >> name >> grade) {\n' +
+      '        grades[name].push_back(grade);\n    }\n    for (auto &[who, list] : grades) {\n' +
+      '        std::sort(list.begin(), list.end());\n' +
+      '        std::cout << who << " " << list.back() << "\\n";\n    }\n}\n',
+  },
+  {
+    name: 'C++ bits/stdc++.h',
+    file: 'contest.cpp',
+    source:
+      '#include <bits/stdc++.h>\nusing namespace std;\n\nint main() {\n    int n;\n' +
+      '    cin >> n;\n    vector<long long> a(n);\n    for (auto &x : a) cin >> x;\n' +
+      '    sort(a.begin(), a.end());\n' +
+      '    cout << accumulate(a.begin(), a.end(), 0LL) << "\\n";\n}\n',
+  },
+];
+
+async function main(): Promise<void> {
+  const samples = Number(process.argv[2]) || 5;
+  const root = await fs.mkdtemp(path.join(os.tmpdir(), 'genix-latency-'));
+  // Set before the imports: the caches pick their root when loaded
+  process.env.GENIX_COMPILE_CACHE = path.join(root, 'cache');
+  const { compileCached, warmCompileCache } = await import('./compileCache');
+  const { precompiledHeadersIdle } = await import('./precompiledHeaders');
+
+  let variant = 0;
+  const write = async (program: (typeof PROGRAMS)[number], unique: boolean): Promise<string> => {
+    const file = path.join(root, program.file);
+    const extra = unique ? `int genix_variant_${++variant};\n` : '';
+    await fs.writeFile(file, program.source + extra);
+    return file;
+  };
+  const compilerOf = (file: string): string => (file.endsWith('.c') ? 'gcc' : 'g++');
+  const output = path.join(root, 'a.out');
+  const compile = async (file: string): Promise<void> => {
+    const result = await compileCached(compilerOf(file), file, FLAGS, output);
+    if (!result.success) {
+      throw new Error(`${path.basename(file)}: ${result.stderr}`);
+    }
+  };
+  const median = async (run: () => Promise<void>): Promise<number> => {
+    const times: number[] = [];
+    for (let i = 0; i < samples; ++i) {
+      const started = performance.now();
+      await run();
+      times.push(performance.now() - started);
+    }
+    times.sort((a, b) => a - b);
+    return times[Math.floor(times.length / 2)];
+  };
+
+  const rows = new Map<string, number[]>();
+  process.env.GENIX_PCH = '0';
+  for (const program of PROGRAMS) {
+    const spawnMs = await median(async () => {
+      const file = await write(program, true);
+      await run(compilerOf(file), [path.basename(file), '-o', output, ...FLAGS], root);
+    });
+    const missMs = await median(async () => {
+      const file = await write(program, true);
+      await compile(file);
+    });
+    rows.set(program.name, [spawnMs, missMs]);
+  }
+
+  delete process.env.GENIX_PCH;
+  const warmStarted = performance.now();
+  await warmCompileCache(FLAGS);
+  const warmMs = performance.now() - warmStarted;
+  // Two sightings queue a PCH for each program's own header set
+  for (const program of PROGRAMS) {
+    for (let i = 0; i < 2; ++i) {
+      const file = await write(program, true);
+      await compile(file);
+    }
+  }
+  await precompiledHeadersIdle();
+  for (const program of PROGRAMS) {
+    const pchMs = await median(async () => {
+      const file = await write(program, true);
+      await compile(file);
+    });
+    const file = await write(program, false);
+    await compile(file);
+    const hitMs = await median(async () => {
+      await compile(file);
+    });
+    rows.get(program.name)!.push(pchMs, hitMs);
+  }
+
+  console.log(`median of ${samples} compiles (ms); precompiling common sets took ${ms(warmMs)} ms`);
+  console.log(
+    `${'program'.padEnd(20)} ${'spawn'.padStart(8)} ${'miss'.padStart(8)} ` +
+      `${'miss+pch'.padStart(8)} ${'hit'.padStart(8)}`
+  );
+  for (const [name, times] of rows) {
+    console.log(`${name.padEnd(20)} ${times.map((t) => ms(t).padStart(8)).join(' ')}`);
+  }
+  await fs.rm(root, { recursive: true, force: true });
+}
+
+function ms(value: number): string {
+  return value.toFixed(value < 10 ? 1 : 0);
+}
+
+function run(command: string, args: string[], cwd: string): Promise<void> {
+  return new Promise((resolve, reject) => {
+    const child = spawn(command, args, { cwd, stdio: 'ignore' });
+    child.on('close', (code) =>
+      code === 0 ? resolve() : reject(new Error(`${command} exited with ${code}`))
+    );
+    child.on('error', reject);
+  });
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
@@ -0,0 +1,117 @@
+/*
+ * Incremental project builds on a generated 100-unit C project: each unit
+ * includes a shared header and the header of its module (ten units per
+ * module). Timed: a full build, a no-op rebuild, a code edit to one .c
+ * file, a macro added to one module header (its units preprocess to the
+ * same text, so the compile cache answers them) and a type added to the
+ * shared header, which recompiles everything. The compile cache starts
+ * empty in a temporary directory.
+ *
+ *   node --experimental-transform-types backend/build/benchProjectBuild.ts [jobs]
+ */
+import * as os from 'os';
+import * as path from 'path';
+import * as fs from 'fs/promises';
+
+const UNITS = 100;
+const MODULES = 10;
+
+async function main(): Promise<void> {
+  const jobs = Number(process.argv[2]) || os.availableParallelism();
+  const root = await fs.mkdtemp(path.join(os.tmpdir(), 'genix-project-'));
+  // Set before the import: the cache picks its root when loaded
+  process.env.GENIX_COMPILE_CACHE = path.join(root, 'cache');
+  const { buildProject } = await import('./projectBuild');
+
+  const project = path.join(root, 'bench');
+  await generateProject(project);
+  const outputPath = path.join(root, 'bench.out');
+  const build = async (label: string): Promise<void> => {
+    const result = await buildProject(project, { outputPath, flags: ['-Wall', '-O1'], jobs });
+    if (!result.success) {
+      throw new Error(`${label}: ${result.output}`);
+    }
+    const compiled = result.units.filter((unit) => unit.status === 'compiled').length;
+    console.log(
+      `${label.padEnd(24)} ${String(result.totalMs).padStart(7)} ms  ` +
+        `${String(result.units.length).padStart(3)} rebuilt (${compiled} compiled), ` +
+        `${result.upToDate} up to date${result.linked ? ', linked' : ''}`
+    );
+  };
+
+  console.log(`${UNITS} units in ${MODULES} modules, ${jobs} jobs`);
+  await build('full build');
+  await build('no-op rebuild');
+  await touch(path.join(project, 'src', 'mod3', 'unit_37.c'), 'int unit_37_edits = 1;\n');
+  await build('edit one .c file');
+  await touch(path.join(project, 'include', 'mod5.h'), '#define MOD5_EDITED 1\n');
+  await build('edit a module header');
+  await touch(path.join(project, 'include', 'common.h'), 'typedef int CommonEdit;\n');
+  await build('edit the shared header');
+  await build('no-op rebuild');
+
+  await fs.rm(root, { recursive: true, force: true });
+}
+
+async function generateProject(project: string): Promise<void> {
+  await fs.mkdir(path.join(project, 'include'), { recursive: true });
+  await fs.writeFile(
+    path.join(project, 'include', 'common.h'),
+    '#ifndef COMMON_H\n#define COMMON_H\n#include <stdio.h>\n#include <string.h>\n' +
+      'typedef struct { int id; double weight; char name[32]; } Item;\n#endif\n'
+  );
+  for (let m = 0; m < MODULES; ++m) {
+    const declarations = [];
+    for (let u = m * (UNITS / MODULES); u < (m + 1) * (UNITS / MODULES); ++u) {
+      declarations.push(`double unit_${u}(const Item *items, int count);`);
+    }
+    await fs.writeFile(
+      path.join(project, 'include', `mod${m}.h`),
+      `#ifndef MOD${m}_H\n#define MOD${m}_H\n#include "common.h"\n` +
+        `${declarations.join('\n')}\n#endif\n`
+    );
+    await fs.mkdir(path.join(project, 'src', `mod${m}`), { recursive: true });
+  }
+  const calls = [];
+  for (let u = 0; u < UNITS; ++u) {
+    const m = Math.floor(u / (UNITS / MODULES));
+    await fs.writeFile(path.join(project, 'src', `mod${m}`, `unit_${u}.c`), unitSource(u, m));
+    calls.push(`    total += unit_${u}(items, 4);`);
+  }
+  const includes = Array.from({ length: MODULES }, (_, m) => `#include "mod${m}.h"`);
+  await fs.writeFile(
+    path.join(project, 'main.c'),
+    `${includes.join('\n')}\n\nint main(void) {\n    Item items[4] = {{0}};\n` +
+      `    double total = 0;\n${calls.join('\n')}\n    printf("%f\\n", total);\n    return 0;\n}\n`
+  );
+}
+
+// Enough code that the compiler, not process startup, dominates
+function unitSource(u: number, m: number): string {
+  const helpers = [];
+  for (let h = 0; h < 8; ++h) {
+    helpers.push(
+      `static double helper_${h}(const Item *item, int k) {\n` +
+        `    double acc = item->weight * ${h + 1};\n` +
+        `    for (int i = 0; i < k; ++i) {\n` +
+        `        acc += (double)strlen(item->name) * i / (item->id + ${u + 1});\n` +
+        `    }\n    return acc;\n}\n`
+    );
+  }
+  const uses = Array.from({ length: 8 }, (_, h) => `helper_${h}(&items[i], ${h + 2})`);
+  return (
+    `#include "mod${m}.h"\n\n${helpers.join('\n')}\n` +
+    `double unit_${u}(const Item *items, int count) {\n    double sum = 0;\n` +
+    `    for (int i = 0; i < count; ++i) {\n        sum += ${uses.join(' + ')};\n    }\n` +
+    `    return sum;\n}\n`
+  );
+}
+
+async function touch(file: string, line: string): Promise<void> {
+  await fs.appendFile(file, line);
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
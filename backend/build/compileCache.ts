@@ -0,0 +1,381 @@
+import { spawn } from 'child_process';
+import { createHash } from 'crypto';
+import { constants as fsConstants } from 'fs';
+import * as path from 'path';
+import * as fs from 'fs/promises';
+import { precompiledHeaderFlags, warmPrecompiledHeaders } from './precompiledHeaders';
+
+// Shared by every user of this backend: identical submissions share one artifact
+const CACHE_ROOT =
+  process.env.GENIX_COMPILE_CACHE || path.resolve(process.cwd(), '.genix-cache', 'compile');
+const HEADER_EXTENSIONS = new Set(['.h', '.hh', '.hpp', '.hxx']);
+
+export type CacheHit = 'direct' | 'preprocessed' | null;
+
+export interface CompileResult {
+  success: boolean;
+  stdout: string;
+  stderr: string;
+  // 'direct': the source and every header it read are unchanged since a
+  // previous compile; 'preprocessed': the preprocessor output matched one
+  cacheHit: CacheHit;
+}
+
+// What a compile produced; `artifact` is the content hash of the output
+interface StoredResult {
+  success: boolean;
+  stdout: string;
+  stderr: string;
+  artifact: string | null;
+}
+
+interface Dependency {
+  path: string;
+  size: number;
+  mtimeMs: number;
+  hash: string;
+}
+
+// Direct mode: maps a source file's bytes to the result of its last
+// compile, valid while the headers it read and the headers next to it
+// are the same
+interface Manifest {
+  dependencies: Dependency[];
+  localHeaders: string[];
+  result: string;
+}
+
+interface ProcessOutput {
+  code: number | null;
+  stdout: string;
+  stderr: string;
+}
+
+const compilerIds = new Map<string, Promise<string>>();
+// Students submitting the same code at once wait for a single compile
+const inFlight = new Map<string, Promise<StoredResult | null>>();
+
+/**
+ * Compiles `sourcePath` into `outputPath` like ccache: the result is keyed
+ * by a hash of the compiler, the flags and the preprocessed source, and
+ * the executable is stored once by the hash of its contents. The compiler
+ * runs in the source's directory on its base name, so diagnostics and
+ * hashes do not depend on where a student's home is.
+ *
+ * A hit costs a hash of the source and a stat of each header (direct
+ * mode), or one preprocessor run when a header changed, plus a copy of
+ * the executable. A miss compiles with a precompiled header for the
+ * system headers the source starts with, when one is ready; it does not
+ * change the output, so it is not part of the key. Cache failures fall
+ * back to compiling uncached.
+ */
+export async function compileCached(
+  compiler: string,
+  sourcePath: string,
+  flags: string[],
+  outputPath: string
+): Promise<CompileResult> {
+  const sourceDir = path.dirname(sourcePath);
+  const sourceName = path.basename(sourcePath);
+  try {
+    const [compilerId, source, localHeaders] = await Promise.all([
+      compilerIdentity(compiler),
+      fs.readFile(sourcePath),
+      listLocalHeaders(sourceDir),
+    ]);
+    const directKey = hashOf('direct', compilerId, flags.join('\0'), sourceName, source);
+
+    const manifest = await readJson<Manifest>(manifestPath(directKey));
+    if (
+      manifest &&
+      sameHeaders(manifest.localHeaders, localHeaders) &&
+      (await unchanged(manifest.dependencies))
+    ) {
+      const stored = await readJson<StoredResult>(resultPath(manifest.result));
+      if (stored && (await materialize(stored, outputPath))) {
+        return { ...resultOf(stored), cacheHit: 'direct' };
+      }
+    }
+
+    const preprocessed = await runProcess(compiler, ['-E', ...flags, sourceName], sourceDir);
+    if (preprocessed.code !== 0) {
+      // Missing headers and the like: let the real compile report them
+      return await compileUncached(compiler, sourcePath, flags, outputPath);
+    }
+    const key = hashOf('cpp', compilerId, flags.join('\0'), preprocessed.stdout);
+
+    let stored = await readJson<StoredResult>(resultPath(key));
+    const cacheHit: CacheHit = stored ? 'preprocessed' : null;
+    if (!stored) {
+      const pch = await precompiledHeaderFlags(compiler, compilerId, sourcePath, source, flags);
+      stored = await compileOnce(key, compiler, sourceDir, sourceName, [...flags, ...pch]);
+    }
+    if (!stored || !(await materialize(stored, outputPath))) {
+      return await compileUncached(compiler, sourcePath, flags, outputPath);
+    }
+
+    const dependencies = await describeDependencies(preprocessed.stdout, sourceDir, sourceName);
+    await writeJson(manifestPath(directKey), { dependencies, localHeaders, result: key });
+    return { ...resultOf(stored), cacheHit };
+  } catch (error) {
+    const message = error instanceof Error ? error.message : String(error);
+    console.error(`[CompileCache] ${message}; compiling uncached`);
+    return await compileUncached(compiler, sourcePath, flags, outputPath);
+  }
+}
+
+/**
+ * Gets the compilers ready before the first build: their identities, and
+ * precompiled headers for the header sets most programs start with.
+ */
+export async function warmCompileCache(flags: string[]): Promise<void> {
+  const started = performance.now();
+  await Promise.all(
+    (['gcc', 'g++'] as const).map(async (compiler) => {
+      const compilerId = await compilerIdentity(compiler);
+      const language = compiler === 'g++' ? 'c++' : 'c';
+      await warmPrecompiledHeaders(compiler, compilerId, language, flags);
+    })
+  );
+  console.log(`[CompileCache] compilers warm in ${Math.round(performance.now() - started)} ms`);
+}
+
+async function compileOnce(
+  key: string,
+  compiler: string,
+  sourceDir: string,
+  sourceName: string,
+  flags: string[]
+): Promise<StoredResult | null> {
+  let pending = inFlight.get(key);
+  if (!pending) {
+    pending = compileAndStore(key, compiler, sourceDir, sourceName, flags);
+    inFlight.set(key, pending);
+    pending.finally(() => inFlight.delete(key)).catch(() => {
+      // the caller sees the error
+    });
+  }
+  return pending;
+}
+
+async function compileAndStore(
+  key: string,
+  compiler: string,
+  sourceDir: string,
+  sourceName: string,
+  flags: string[]
+): Promise<StoredResult | null> {
+  const tempOutput = await tempPath();
+  const result = await runProcess(compiler, [sourceName, '-o', tempOutput, ...flags], sourceDir);
+  // Exit status 1 is a compile error, which is as reproducible as a
+  // success; anything else (killed, out of memory) is not cached
+  if (result.code !== 0 && result.code !== 1) {
+    await fs.rm(tempOutput, { force: true });
+    return { success: false, stdout: result.stdout, stderr: result.stderr, artifact: null };
+  }
+  const artifact = result.code === 0 ? await storeArtifact(tempOutput) : null;
+  const stored: StoredResult = {
+    success: result.code === 0,
+    stdout: result.stdout,
+    stderr: result.stderr,
+    artifact,
+  };
+  await writeJson(resultPath(key), stored);
+  return stored;
+}
+
+async function compileUncached(
+  compiler: string,
+  sourcePath: string,
+  flags: string[],
+  outputPath: string
+): Promise<CompileResult> {
+  const result = await runProcess(
+    compiler,
+    [path.basename(sourcePath), '-o', outputPath, ...flags],
+    path.dirname(sourcePath)
+  );
+  const success = result.code === 0;
+  return { success, stdout: result.stdout, stderr: result.stderr, cacheHit: null };
+}
+
+function resultOf(stored: StoredResult): Omit<CompileResult, 'cacheHit'> {
+  return { success: stored.success, stdout: stored.stdout, stderr: stored.stderr };
+}
+
+// Moves a fresh executable into the object store under its content hash
+async function storeArtifact(tempOutput: string): Promise<string> {
+  const hash = createHash('sha256').update(await fs.readFile(tempOutput)).digest('hex');
+  const objectPath = artifactPath(hash);
+  try {
+    await fs.access(objectPath);
+    await fs.rm(tempOutput, { force: true });
+  } catch {
+    await fs.mkdir(path.dirname(objectPath), { recursive: true });
+    await fs.chmod(tempOutput, 0o755);
+    await fs.rename(tempOutput, objectPath);
+  }
+  return hash;
+}
+
+// Copies (or reflinks) the artifact next to `outputPath` and renames it
+// into place, so a copy of the old executable still running is untouched
+async function materialize(stored: StoredResult, outputPath: string): Promise<boolean> {
+  if (!stored.artifact) {
+    return true;
+  }
+  const temp = `${outputPath}.${process.pid}.${Math.random().toString(36).slice(2)}.tmp`;
+  try {
+    await fs.mkdir(path.dirname(outputPath), { recursive: true });
+    await fs.copyFile(artifactPath(stored.artifact), temp, fsConstants.COPYFILE_FICLONE);
+    await fs.chmod(temp, 0o755);
+    await fs.rename(temp, outputPath);
+    return true;
+  } catch {
+    await fs.rm(temp, { force: true });
+    return false;
+  }
+}
+
+// Every file the preprocessor read, from its line markers, except the source itself
+async function describeDependencies(
+  preprocessed: string,
+  sourceDir: string,
+  sourceName: string
+): Promise<Dependency[]> {
+  const files = new Set<string>();
+  for (const match of preprocessed.matchAll(/^# \d+ "((?:[^"\\]|\\.)*)"/gm)) {
+    const name = match[1].replace(/\\(.)/g, '$1');
+    if (!name.startsWith('<') && name !== sourceName) {
+      files.add(path.resolve(sourceDir, name));
+    }
+  }
+  return Promise.all(
+    [...files].map(async (file) => {
+      const [stat, content] = await Promise.all([fs.stat(file), fs.readFile(file)]);
+      return { path: file, size: stat.size, mtimeMs: stat.mtimeMs, hash: hashOf(content) };
+    })
+  );
+}
+
+// A header whose size and mtime are as recorded is trusted; otherwise its
+// contents decide
+async function unchanged(dependencies: Dependency[]): Promise<boolean> {
+  const checks = await Promise.all(
+    dependencies.map(async (dependency) => {
+      try {
+        const stat = await fs.stat(dependency.path);
+        if (stat.size === dependency.size && stat.mtimeMs === dependency.mtimeMs) {
+          return true;
+        }
+        return (
+          stat.size === dependency.size &&
+          hashOf(await fs.readFile(dependency.path)) === dependency.hash
+        );
+      } catch {
+        return false;
+      }
+    })
+  );
+  return checks.every(Boolean);
+}
+
+// A header appearing next to the source can shadow one found elsewhere
+async function listLocalHeaders(sourceDir: string): Promise<string[]> {
+  const names = await fs.readdir(sourceDir);
+  return names.filter((name) => HEADER_EXTENSIONS.has(path.extname(name))).sort();
+}
+
+function sameHeaders(a: string[], b: string[]): boolean {
+  return a.length === b.length && a.every((name, i) => name === b[i]);
+}
+
+// The compiler's version and the binary itself, so an upgrade misses
+function compilerIdentity(compiler: string): Promise<string> {
+  let id = compilerIds.get(compiler);
+  if (!id) {
+    id = (async () => {
+      const version = await runProcess(compiler, ['--version'], process.cwd());
+      const binary = await findInPath(compiler);
+      const stat = binary ? await fs.stat(binary) : null;
+      const binaryId = stat ? `${binary}:${stat.size}:${stat.mtimeMs}` : '';
+      return hashOf(compiler, version.stdout, binaryId);
+    })();
+    compilerIds.set(compiler, id);
+  }
+  return id;
+}
+
+async function findInPath(command: string): Promise<string | null> {
+  for (const dir of (process.env.PATH || '').split(path.delimiter)) {
+    const candidate = path.join(dir, command);
+    try {
+      await fs.access(candidate, fsConstants.X_OK);
+      return await fs.realpath(candidate);
+    } catch {
+      // keep looking
+    }
+  }
+  return null;
+}
+
+function runProcess(command: string, args: string[], cwd: string): Promise<ProcessOutput> {
+  return new Promise((resolve) => {
+    const child = spawn(command, args, { cwd });
+    const stdout: Buffer[] = [];
+    const stderr: Buffer[] = [];
+    child.stdout.on('data', (data: Buffer) => stdout.push(data));
+    child.stderr.on('data', (data: Buffer) => stderr.push(data));
+    child.on('close', (code) => {
+      resolve({
+        code,
+        stdout: Buffer.concat(stdout).toString(),
+        stderr: Buffer.concat(stderr).toString(),
+      });
+    });
+    child.on('error', (error) => resolve({ code: null, stdout: '', stderr: error.message }));
+  });
+}
+
+function hashOf(...parts: (string | Buffer)[]): string {
+  const hash = createHash('sha256');
+  for (const part of parts) {
+    hash.update(part);
+    hash.update('\0');
+  }
+  return hash.digest('hex');
+}
+
+function artifactPath(hash: string): string {
+  return path.join(CACHE_ROOT, 'objects', hash.slice(0, 2), hash);
+}
+
+function resultPath(key: string): string {
+  return path.join(CACHE_ROOT, 'results', key.slice(0, 2), `${key}.json`);
+}
+
+function manifestPath(key: string): string {
+  return path.join(CACHE_ROOT, 'manifests', key.slice(0, 2), `${key}.json`);
+}
+
+async function tempPath(): Promise<string> {
+  const dir = path.join(CACHE_ROOT, 'tmp');
+  await fs.mkdir(dir, { recursive: true });
+  return path.join(dir, `${process.pid}.${Date.now()}.${Math.random().toString(36).slice(2)}`);
+}
+
+async function readJson<T>(file: string): Promise<T | null> {
+  try {
+    return JSON.parse(await fs.readFile(file, 'utf-8')) as T;
+  } catch {
+    return null;
+  }
+}
+
+// Written aside and renamed, so concurrent readers never see half a file
+async function writeJson(file: string, value: unknown): Promise<void> {
+  await fs.mkdir(path.dirname(file), { recursive: true });
+  const temp = `${file}.${process.pid}.${Math.random().toString(36).slice(2)}.tmp`;
+  await fs.writeFile(temp, JSON.stringify(value));
+  await fs.rename(temp, file);
+}
@@ -0,0 +1,298 @@
+import { spawn } from 'child_process';
+import { createHash } from 'crypto';
+import * as path from 'path';
+import * as fs from 'fs/promises';
+
+const PCH_ROOT = path.resolve(
+  process.env.GENIX_COMPILE_CACHE || path.join(process.cwd(), '.genix-cache', 'compile'),
+  'pch'
+);
+const CPP_EXTENSIONS = new Set(['.cc', '.cpp', '.cxx']);
+// A set seen this often gets its own precompiled header
+const BUILD_AFTER_USES = 2;
+// A <bits/stdc++.h> PCH is ~100 MB; beyond this many the least recently used is dropped
+const MAX_PRECOMPILED = 16;
+const INCLUDE_LINE = /^#\s*include\s*<([^>]+)>\s*(\/\/.*|\/\*.*\*\/\s*)?$/;
+
+// What students start their programs with; built when the backend starts
+const COMMON_SETS: Record<'c' | 'c++', string[][]> = {
+  c: [['stdio.h'], ['stdio.h', 'stdlib.h'], ['stdio.h', 'stdlib.h', 'string.h']],
+  'c++': [['iostream'], ['iostream', 'vector'], ['iostream', 'string'], ['bits/stdc++.h']],
+};
+
+type Language = 'c' | 'c++';
+
+interface PrecompiledHeader {
+  header: string;
+  names: string[];
+  ready: boolean;
+  building: Promise<void> | null;
+  uses: number;
+  lastUsed: number;
+}
+
+const headers = new Map<string, PrecompiledHeader>();
+
+/**
+ * Flags that make `compiler` load a precompiled header for the system
+ * headers `source` starts with, or none. Only a leading run of
+ * `#include <...>` lines (with blank lines and comments between) is
+ * considered, and a PCH is used only for an ordered prefix of it: the
+ * same headers in the same order, before anything that could change
+ * their meaning, so the program compiles exactly as it would without.
+ *
+ * Sets are precompiled in the background once seen BUILD_AFTER_USES
+ * times; until then the longest ready prefix is used, if any. `flags`
+ * must be what the compile itself uses: GCC rejects a PCH built with
+ * different language options and silently reads the plain header.
+ * GENIX_PCH=0 turns precompiled headers off.
+ */
+export async function precompiledHeaderFlags(
+  compiler: string,
+  compilerId: string,
+  sourcePath: string,
+  source: Buffer,
+  flags: string[]
+): Promise<string[]> {
+  if (process.env.GENIX_PCH === '0') {
+    return [];
+  }
+  const names = systemIncludePrefix(source.toString());
+  if (names.length === 0 || (await shadowed(names, sourcePath, flags))) {
+    return [];
+  }
+  const language = languageOf(compiler, sourcePath);
+  const headerFlags = pchFlags(flags);
+
+  const full = await lookup(compilerId, language, headerFlags, names);
+  full.uses++;
+  if (!full.ready && !full.building && full.uses >= BUILD_AFTER_USES) {
+    startBuild(full, compiler, language, headerFlags);
+  }
+  for (let count = names.length; count > 0; --count) {
+    const candidate =
+      count === names.length
+        ? full
+        : await lookup(compilerId, language, headerFlags, names.slice(0, count));
+    if (candidate.ready) {
+      candidate.lastUsed = Date.now();
+      return ['-include', candidate.header];
+    }
+  }
+  return [];
+}
+
+/**
+ * Precompiles the common header sets for `compiler`, so the first
+ * programs after a restart do not pay for them. Resolves when all are
+ * built; failures only mean those sets compile without a PCH.
+ */
+export async function warmPrecompiledHeaders(
+  compiler: string,
+  compilerId: string,
+  language: Language,
+  flags: string[]
+): Promise<void> {
+  if (process.env.GENIX_PCH === '0') {
+    return;
+  }
+  const headerFlags = pchFlags(flags);
+  await Promise.all(
+    COMMON_SETS[language].map(async (names) => {
+      const entry = await lookup(compilerId, language, headerFlags, names);
+      if (!entry.ready) {
+        await (entry.building ?? startBuild(entry, compiler, language, headerFlags));
+      }
+    })
+  );
+}
+
+// Resolves once no precompiled header is being built
+export async function precompiledHeadersIdle(): Promise<void> {
+  const building = [...headers.values()].map((entry) => entry.building).filter(Boolean);
+  await Promise.all(building);
+}
+
+// The leading `#include <...>` lines, before any other code
+function systemIncludePrefix(source: string): string[] {
+  const names: string[] = [];
+  let inComment = false;
+  for (const raw of source.split('\n')) {
+    let line = raw.trim();
+    if (inComment) {
+      const end = line.indexOf('*/');
+      if (end < 0) {
+        continue;
+      }
+      line = line.slice(end + 2).trim();
+      inComment = false;
+    }
+    if (line.startsWith('/*')) {
+      const end = line.indexOf('*/', 2);
+      if (end < 0) {
+        inComment = true;
+        continue;
+      }
+      line = line.slice(end + 2).trim();
+    }
+    if (line === '' || line.startsWith('//')) {
+      continue;
+    }
+    const match = INCLUDE_LINE.exec(line);
+    if (!match) {
+      break;
+    }
+    names.push(match[1].trim());
+  }
+  return names;
+}
+
+// An angled include that resolves to a file under one of the -I
+// directories is the project's, not the system's, and may change
+async function shadowed(names: string[], sourcePath: string, flags: string[]): Promise<boolean> {
+  const dirs: string[] = [];
+  for (let i = 0; i < flags.length; ++i) {
+    const match = /^-(I|isystem|iquote)(.*)$/.exec(flags[i]);
+    if (match) {
+      const dir = match[2] || flags[++i];
+      dirs.push(path.resolve(path.dirname(sourcePath), dir));
+    }
+  }
+  const found = await Promise.all(
+    dirs.flatMap((dir) =>
+      names.map((name) =>
+        fs.access(path.join(dir, name)).then(
+          () => true,
+          () => false
+        )
+      )
+    )
+  );
+  return found.some(Boolean);
+}
+
+// The flags a PCH depends on: everything but search paths and the compile-only switch
+function pchFlags(flags: string[]): string[] {
+  const kept: string[] = [];
+  for (let i = 0; i < flags.length; ++i) {
+    const match = /^-(I|isystem|iquote)(.*)$/.exec(flags[i]);
+    if (match) {
+      i += match[2] ? 0 : 1;
+    } else if (flags[i] !== '-c') {
+      kept.push(flags[i]);
+    }
+  }
+  return kept;
+}
+
+function languageOf(compiler: string, sourcePath: string): Language {
+  return compiler.endsWith('++') || CPP_EXTENSIONS.has(path.extname(sourcePath)) ? 'c++' : 'c';
+}
+
+// Known headers are kept in memory; the first lookup of one checks the disk
+async function lookup(
+  compilerId: string,
+  language: Language,
+  flags: string[],
+  names: string[]
+): Promise<PrecompiledHeader> {
+  const key = hashOf(compilerId, language, flags.join('\0'), names.join('\0'));
+  let entry = headers.get(key);
+  if (!entry) {
+    const header = path.join(PCH_ROOT, key.slice(0, 2), key, 'prefix.h');
+    const ready = await fs.access(`${header}.gch`).then(
+      () => true,
+      () => false
+    );
+    // Another lookup may have raced this one
+    entry = headers.get(key) ?? {
+      header,
+      names,
+      ready,
+      building: null,
+      uses: 0,
+      lastUsed: ready ? Date.now() : 0,
+    };
+    headers.set(key, entry);
+  }
+  return entry;
+}
+
+function startBuild(
+  entry: PrecompiledHeader,
+  compiler: string,
+  language: Language,
+  flags: string[]
+): Promise<void> {
+  entry.building = buildHeader(entry, compiler, language, flags)
+    .catch((error) => {
+      const message = error instanceof Error ? error.message : String(error);
+      console.error(`[PrecompiledHeaders] ${entry.names.join(', ')}: ${message}`);
+    })
+    .finally(() => {
+      entry.building = null;
+    });
+  return entry.building;
+}
+
+// The .gch is written aside and renamed next to prefix.h, where GCC looks for it
+async function buildHeader(
+  entry: PrecompiledHeader,
+  compiler: string,
+  language: Language,
+  flags: string[]
+): Promise<void> {
+  const dir = path.dirname(entry.header);
+  await fs.mkdir(dir, { recursive: true });
+  await fs.writeFile(entry.header, entry.names.map((name) => `#include <${name}>\n`).join(''));
+  const temp = `${entry.header}.${process.pid}.${Math.random().toString(36).slice(2)}.tmp`;
+  const args = ['-x', `${language}-header`, ...flags, path.basename(entry.header), '-o', temp];
+  const result = await runProcess(compiler, args, dir);
+  if (result.code !== 0) {
+    await fs.rm(temp, { force: true });
+    // Not retried: a set that does not compile on its own never will
+    entry.uses = -Infinity;
+    throw new Error(result.stderr.trim() || `exit status ${result.code}`);
+  }
+  await fs.rename(temp, `${entry.header}.gch`);
+  entry.ready = true;
+  entry.lastUsed = Date.now();
+  await evict();
+}
+
+// Only the .gch goes: a compile that already chose the header then reads it as text
+async function evict(): Promise<void> {
+  const ready = [...headers.values()].filter((entry) => entry.ready);
+  ready.sort((a, b) => a.lastUsed - b.lastUsed);
+  const excess = ready.slice(0, Math.max(0, ready.length - MAX_PRECOMPILED));
+  for (const entry of excess) {
+    entry.ready = false;
+    entry.uses = 0;
+  }
+  await Promise.all(excess.map((entry) => fs.rm(`${entry.header}.gch`, { force: true })));
+}
+
+function runProcess(
+  command: string,
+  args: string[],
+  cwd: string
+): Promise<{ code: number | null; stderr: string }> {
+  return new Promise((resolve) => {
+    const child = spawn(command, args, { cwd });
+    let stderr = '';
+    child.stderr.on('data', (data) => {
+      stderr += data.toString();
+    });
+    child.on('close', (code) => resolve({ code, stderr }));
+    child.on('error', (error) => resolve({ code: null, stderr: error.message }));
+  });
+}
+
+function hashOf(...parts: string[]): string {
+  const hash = createHash('sha256');
+  for (const part of parts) {
+    hash.update(part);
+    hash.update('\0');
+  }
+  return hash.digest('hex');
+}
@@ -0,0 +1,360 @@
+import { spawn } from 'child_process';
+import { createHash } from 'crypto';
+import * as os from 'os';
+import * as path from 'path';
+import * as fs from 'fs/promises';
+import { compileCached } from './compileCache';
+
+// Per project, next to its sources: objects and what each was built from
+const BUILD_DIR = '.genix-build';
+const STATE_VERSION = 1;
+const SOURCE_EXTENSIONS = new Set(['.c', '.cc', '.cpp', '.cxx']);
+const HEADER_EXTENSIONS = new Set(['.h', '.hh', '.hpp', '.hxx']);
+const CPP_EXTENSIONS = new Set(['.cc', '.cpp', '.cxx']);
+const INCLUDE_PATTERN = /^[ \t]*#[ \t]*include[ \t]*([<"])([^>"\n]+)[>"]/gm;
+
+export interface UnitTiming {
+  file: string;
+  ms: number;
+  status: 'compiled' | 'cached' | 'failed';
+}
+
+export interface ProjectBuildResult {
+  success: boolean;
+  output: string;
+  executable: string | null;
+  units: UnitTiming[];
+  upToDate: number;
+  linked: boolean;
+  totalMs: number;
+}
+
+export interface ProjectBuildOptions {
+  outputPath: string;
+  flags: string[];
+  // Compiles running at once; defaults to one per CPU
+  jobs?: number;
+}
+
+// A project file as last seen; the hash is only recomputed when its size or mtime moves
+interface FileRecord {
+  size: number;
+  mtimeMs: number;
+  hash: string;
+}
+
+interface BuildState {
+  version: number;
+  // Compiler and flags; a change rebuilds everything
+  toolchain: string;
+  files: Record<string, FileRecord>;
+  // Translation unit -> hash over its source and every project header it reaches
+  units: Record<string, string>;
+  // Hash over the objects linked last time
+  link: string;
+}
+
+interface ProjectFile {
+  relative: string;
+  record: FileRecord;
+  includes: string[];
+}
+
+/**
+ * Builds every translation unit under `projectDir` into one executable,
+ * recompiling only units whose inputs changed. Inputs come from a scan of
+ * the project: each file's quoted (and project-resolvable angled)
+ * `#include`s form a graph, and a unit's inputs are its source plus every
+ * project header reachable from it. System headers are covered by the
+ * compile cache's compiler identity rather than the graph.
+ *
+ * Changed units are compiled through the compile cache, `jobs` at a time,
+ * and the objects are linked once if any of them changed.
+ */
+export async function buildProject(
+  projectDir: string,
+  options: ProjectBuildOptions
+): Promise<ProjectBuildResult> {
+  const started = performance.now();
+  const buildDir = path.join(projectDir, BUILD_DIR);
+  const previous = await readState(buildDir);
+  const files = await scanProject(projectDir, previous);
+  const includeDirs = await projectIncludeDirs(projectDir);
+  const graph = new Map(files.map((file) => [file.relative, file]));
+  for (const file of files) {
+    file.includes = resolveIncludes(file, graph, includeDirs);
+  }
+
+  const sources = files.filter((file) => SOURCE_EXTENSIONS.has(path.extname(file.relative)));
+  // C units stay C; a single C++ unit makes the link need libstdc++
+  const linker = sources.some((file) => compilerFor(file) === 'g++') ? 'g++' : 'gcc';
+  const toolchain = [linker, ...options.flags].join(' ');
+  const state: BuildState = { version: STATE_VERSION, toolchain, files: {}, units: {}, link: '' };
+  for (const file of files) {
+    state.files[file.relative] = file.record;
+  }
+
+  const stale: ProjectFile[] = [];
+  let upToDate = 0;
+  for (const source of sources) {
+    const inputs = inputsHash(source, graph);
+    const fresh =
+      previous?.toolchain === toolchain &&
+      previous.units[source.relative] === inputs &&
+      (await exists(objectPath(buildDir, source.relative)));
+    if (fresh) {
+      state.units[source.relative] = inputs;
+      ++upToDate;
+    } else {
+      stale.push(source);
+    }
+  }
+  await removeStaleObjects(buildDir, previous, sources);
+
+  const lines: string[] = [];
+  const errors: string[] = [];
+  const units: UnitTiming[] = [];
+  let done = 0;
+  const jobs = Math.max(1, options.jobs ?? os.availableParallelism());
+  await runJobs(stale, jobs, async (source) => {
+    const unitStarted = performance.now();
+    const object = objectPath(buildDir, source.relative);
+    await fs.mkdir(path.dirname(object), { recursive: true });
+    const sourcePath = path.join(projectDir, source.relative);
+    const unitFlags = [
+      '-c',
+      ...options.flags,
+      ...includeDirs.map((dir) => `-I${path.relative(path.dirname(sourcePath), dir) || '.'}`),
+    ];
+    const result = await compileCached(compilerFor(source), sourcePath, unitFlags, object);
+    const ms = Math.round(performance.now() - unitStarted);
+    const status = !result.success ? 'failed' : result.cacheHit ? 'cached' : 'compiled';
+    units.push({ file: source.relative, ms, status });
+    lines.push(
+      `[${++done}/${stale.length}] ${status === 'failed' ? 'FAIL' : 'CC  '} ${source.relative}` +
+        `  ${ms} ms${status === 'cached' ? ' (cached)' : ''}`
+    );
+    if (result.success) {
+      state.units[source.relative] = inputsHash(source, graph);
+    }
+    const diagnostics = (result.stdout + result.stderr).trim();
+    if (diagnostics) {
+      errors.push(diagnostics);
+    }
+  });
+
+  const failed = units.some((unit) => unit.status === 'failed');
+  let linked = false;
+  let success = !failed && sources.length > 0;
+  if (sources.length === 0) {
+    errors.push(`No C or C++ sources under ${path.basename(projectDir)}`);
+  }
+  if (success) {
+    const objects = sources.map((source) => objectPath(buildDir, source.relative));
+    const unitHashes = sources.map((source) => state.units[source.relative]);
+    state.link = hashOf(toolchain, options.outputPath, ...unitHashes);
+    if (stale.length > 0 || previous?.link !== state.link || !(await exists(options.outputPath))) {
+      const linkStarted = performance.now();
+      const result = await runProcess(linker, [...objects, '-o', options.outputPath], projectDir);
+      const ms = Math.round(performance.now() - linkStarted);
+      lines.push(`LINK ${path.basename(options.outputPath)}  ${ms} ms`);
+      linked = true;
+      success = result.code === 0;
+      if (!success) {
+        state.link = '';
+        errors.push(result.stderr.trim());
+      }
+    }
+  }
+  await writeState(buildDir, state);
+
+  const totalMs = Math.round(performance.now() - started);
+  lines.push(
+    `${success ? 'Built' : 'Failed'} ${path.basename(options.outputPath)}: ` +
+      `${stale.length} of ${sources.length} units compiled, ${upToDate} up to date, ${totalMs} ms`
+  );
+  const output = [...errors, ...lines].filter(Boolean).join('\n') + '\n';
+  return {
+    success,
+    output,
+    executable: success ? options.outputPath : null,
+    units,
+    upToDate,
+    linked,
+    totalMs,
+  };
+}
+
+// Every source and header below the project, skipping hidden entries
+async function scanProject(
+  projectDir: string,
+  previous: BuildState | null
+): Promise<ProjectFile[]> {
+  const files: ProjectFile[] = [];
+  const visit = async (dir: string): Promise<void> => {
+    const entries = await fs.readdir(dir, { withFileTypes: true });
+    await Promise.all(
+      entries.map(async (entry) => {
+        if (entry.name.startsWith('.')) {
+          return;
+        }
+        const full = path.join(dir, entry.name);
+        if (entry.isDirectory()) {
+          await visit(full);
+          return;
+        }
+        const ext = path.extname(entry.name);
+        if (!entry.isFile() || (!SOURCE_EXTENSIONS.has(ext) && !HEADER_EXTENSIONS.has(ext))) {
+          return;
+        }
+        const relative = path.relative(projectDir, full);
+        // The includes are parsed again even when the file is unchanged;
+        // that is cheaper than storing the graph and proving it fresh
+        const [stat, content] = await Promise.all([fs.stat(full), fs.readFile(full)]);
+        const known = previous?.files[relative];
+        const record =
+          known && known.size === stat.size && known.mtimeMs === stat.mtimeMs
+            ? known
+            : { size: stat.size, mtimeMs: stat.mtimeMs, hash: hashOf(content) };
+        files.push({ relative, record, includes: [...parseIncludes(content.toString())] });
+      })
+    );
+  };
+  await visit(projectDir);
+  return files.sort((a, b) => (a.relative < b.relative ? -1 : a.relative > b.relative ? 1 : 0));
+}
+
+function* parseIncludes(text: string): Generator<string> {
+  for (const match of text.matchAll(INCLUDE_PATTERN)) {
+    yield `${match[1]}${match[2].trim()}`;
+  }
+}
+
+// The project root, plus include/ when the project has one
+async function projectIncludeDirs(projectDir: string): Promise<string[]> {
+  const include = path.join(projectDir, 'include');
+  const stat = await fs.stat(include).catch(() => null);
+  return stat?.isDirectory() ? [projectDir, include] : [projectDir];
+}
+
+// Quoted includes look next to the includer first, like the compiler;
+// anything not found in the project is a system header
+function resolveIncludes(
+  file: ProjectFile,
+  graph: Map<string, ProjectFile>,
+  includeDirs: string[]
+): string[] {
+  const projectDir = includeDirs[0];
+  const resolved: string[] = [];
+  for (const include of file.includes) {
+    const name = include.slice(1);
+    const candidates =
+      include[0] === '"' ? [path.dirname(path.join(projectDir, file.relative))] : [];
+    candidates.push(...includeDirs);
+    for (const dir of candidates) {
+      const relative = path.relative(projectDir, path.join(dir, name));
+      if (graph.has(relative)) {
+        resolved.push(relative);
+        break;
+      }
+    }
+  }
+  return resolved;
+}
+
+// A unit's inputs: its source and every project header it reaches
+function inputsHash(source: ProjectFile, graph: Map<string, ProjectFile>): string {
+  const reached = new Set<string>([source.relative]);
+  const pending = [source];
+  while (pending.length > 0) {
+    for (const include of pending.pop()!.includes) {
+      const header = graph.get(include);
+      if (header && !reached.has(include)) {
+        reached.add(include);
+        pending.push(header);
+      }
+    }
+  }
+  const parts = [...reached].sort().map((file) => `${file}:${graph.get(file)!.record.hash}`);
+  return hashOf(...parts);
+}
+
+async function removeStaleObjects(
+  buildDir: string,
+  previous: BuildState | null,
+  sources: ProjectFile[]
+): Promise<void> {
+  const current = new Set(sources.map((source) => source.relative));
+  const gone = Object.keys(previous?.units ?? {}).filter((unit) => !current.has(unit));
+  await Promise.all(gone.map((unit) => fs.rm(objectPath(buildDir, unit), { force: true })));
+}
+
+async function runJobs<T>(
+  items: T[],
+  jobs: number,
+  run: (item: T) => Promise<void>
+): Promise<void> {
+  let next = 0;
+  const worker = async (): Promise<void> => {
+    while (next < items.length) {
+      await run(items[next++]);
+    }
+  };
+  await Promise.all(Array.from({ length: Math.min(jobs, items.length) }, worker));
+}
+
+function compilerFor(source: ProjectFile): string {
+  return CPP_EXTENSIONS.has(path.extname(source.relative)) ? 'g++' : 'gcc';
+}
+
+function objectPath(buildDir: string, unit: string): string {
+  return path.join(buildDir, 'obj', `${unit}.o`);
+}
+
+async function readState(buildDir: string): Promise<BuildState | null> {
+  try {
+    const state = JSON.parse(await fs.readFile(path.join(buildDir, 'state.json'), 'utf-8'));
+    return state.version === STATE_VERSION ? (state as BuildState) : null;
+  } catch {
+    return null;
+  }
+}
+
+async function writeState(buildDir: string, state: BuildState): Promise<void> {
+  await fs.mkdir(buildDir, { recursive: true });
+  const file = path.join(buildDir, 'state.json');
+  await fs.writeFile(`${file}.tmp`, JSON.stringify(state));
+  await fs.rename(`${file}.tmp`, file);
+}
+
+async function exists(file: string): Promise<boolean> {
+  return fs.access(file).then(
+    () => true,
+    () => false
+  );
+}
+
+function runProcess(
+  command: string,
+  args: string[],
+  cwd: string
+): Promise<{ code: number | null; stderr: string }> {
+  return new Promise((resolve) => {
+    const child = spawn(command, args, { cwd });
+    let stderr = '';
+    child.stderr.on('data', (data) => {
+      stderr += data.toString();
+    });
+    child.on('close', (code) => resolve({ code, stderr }));
+    child.on('error', (error) => resolve({ code: null, stderr: error.message }));
+  });
+}
+
+function hashOf(...parts: (string | Buffer)[]): string {
+  const hash = createHash('sha256');
+  for (const part of parts) {
+    hash.update(part);
+    hash.update('\0');
+  }
+  return hash.digest('hex');
+}
@@ -0,0 +1,774 @@
+import * as net from 'net';
+import * as path from 'path';
+import * as fs from 'fs';
+import { StringDecoder } from 'string_decoder';
+import { spawn, ChildProcess } from 'child_process';
+
+const PROJECT_ROOT = path.resolve(process.cwd(), 'c-engine');
+const ENGINE_BINARY = process.env.GENIX_ENGINE_BINARY || path.join(PROJECT_ROOT, 'genix_engine');
+const ENGINE_SOCKET = process.env.GENIX_ENGINE_SOCKET || path.join(PROJECT_ROOT, 'genix_engine.sock');
+// Indexed for full-text search; keep in step with handlers/fileHandler.ts
+const GENIX_FILES_ROOT = path.resolve(process.cwd(), 'GenixFiles');
+
+const CONNECT_ATTEMPTS = 50;
+const CONNECT_RETRY_MS = 20;
+
+// Mirrors c-engine/protocol.h: u32 length | u32 request_id | u16 opcode | u16 status (little-endian)
+export const FRAME_HEADER_SIZE = 12;
+
+export enum EngineOpcode {
+  Ping = 1,
+  Exec = 2,
+  List = 3,
+  Stats = 4,
+  Eval = 5,
+  ExecStream = 6,
+  SessionOpen = 7,
+  SessionClose = 8,
+  SessionExec = 9,
+  Complete = 10,
+  History = 11,
+  Search = 12,
+  Index = 13,
+  Grep = 14,
+  Read = 15,
+  Run = 16,
+  RunTerminal = 17,
+  RunInput = 18,
+  RunResize = 19,
+  RunKill = 20,
+  StreamAck = 21,
+}
+
+export enum EngineStatus {
+  Ok = 0,
+  Error = 1,
+  NotFound = 2,
+  BadRequest = 3,
+  // An ExecStream output chunk; the frame with the final status follows
+  More = 4,
+}
+
+export interface EngineResponse {
+  status: EngineStatus;
+  output: string;
+}
+
+export interface EngineDirEntry {
+  name: string;
+  type: 'file' | 'directory' | 'other';
+  size: number;
+  mtime: number;
+}
+
+export interface EngineCompletion {
+  // Index in the line where the word being completed starts
+  start: number;
+  candidates: string[];
+}
+
+export type HistoryMatch = 'prefix' | 'substring';
+
+export interface EngineSearchHit {
+  // Relative to GenixFiles
+  path: string;
+  // Line of the snippet, from 1; 0 when no line shows a query word
+  line: number;
+  score: number;
+  snippet: string;
+}
+
+export interface EngineGrepOptions {
+  ignoreCase?: boolean;
+  // The pattern is a plain string
+  fixed?: boolean;
+  // POSIX extended rather than basic regex syntax
+  extended?: boolean;
+}
+
+export interface EngineGrepMatch {
+  // Relative to the directory searched
+  path: string;
+  line: number;
+  text: string;
+}
+
+// 0 (or absent) leaves a limit at the engine's default
+export interface EngineRunLimits {
+  wallMs?: number;
+  cpuSeconds?: number;
+  memoryMb?: number;
+  fileMb?: number;
+  processes?: number;
+}
+
+export interface EngineRunResult {
+  // -1 when a signal ended the program
+  exitCode: number;
+  signal: number;
+  timedOut: boolean;
+  // Each stream keeps its first megabyte
+  truncated: boolean;
+  wallMs: number;
+  userMs: number;
+  systemMs: number;
+  maxRssKb: number;
+  stdout: string;
+  stderr: string;
+}
+
+export interface EngineTerminalSize {
+  rows: number;
+  columns: number;
+}
+
+// A program running on an engine terminal, started by runTerminal
+export interface EngineTerminalRun {
+  // Settles once the program has exited, like run() with no output;
+  // null if the engine went away meanwhile
+  result: Promise<EngineRunResult | null>;
+  // Types into the terminal; false once the program exited or while it
+  // leaves too much input unread
+  write(input: string): Promise<boolean>;
+  resize(size: EngineTerminalSize): Promise<void>;
+  // Kills the program and everything it started
+  kill(): Promise<void>;
+}
+
+interface RawResponse {
+  status: EngineStatus;
+  payload: Buffer;
+}
+
+type ChunkHandler = (payload: Buffer) => void | Promise<void>;
+
+interface PendingRequest {
+  resolve: (response: RawResponse) => void;
+  reject: (error: Error) => void;
+  onChunk?: ChunkHandler;
+  // Settles once every chunk received so far has been handled
+  delivered: Promise<void>;
+  // Handled but not yet acknowledged to the engine
+  unacknowledged: number;
+  // A chunk handler failed; the rest of the stream is dropped unacknowledged
+  abandoned: boolean;
+}
+
+const DIR_RECORD_HEADER_SIZE = 20;
+const RUN_REQUEST_HEADER_SIZE = 20;
+const RUN_RESPONSE_HEADER_SIZE = 44;
+const RUN_TERMINAL_HEADER_SIZE = 24;
+// Mirrors GENIX_STREAM_WINDOW; acknowledging every quarter keeps the stream moving
+const STREAM_WINDOW = 256 * 1024;
+const STREAM_ACK_BYTES = STREAM_WINDOW / 4;
+const DIR_ENTRY_TYPES: EngineDirEntry['type'][] = ['file', 'directory', 'other'];
+
+export function encodeFrame(requestId: number, opcode: EngineOpcode, payload: Buffer): Buffer {
+  const frame = Buffer.allocUnsafe(FRAME_HEADER_SIZE + payload.length);
+  frame.writeUInt32LE(payload.length, 0);
+  frame.writeUInt32LE(requestId, 4);
+  frame.writeUInt16LE(opcode, 8);
+  frame.writeUInt16LE(0, 10);
+  payload.copy(frame, FRAME_HEADER_SIZE);
+  return frame;
+}
+
+// Keeps one persistent connection to the genix_engine daemon and pipelines
+// requests over it; replies are matched back to callers by request id.
+class EngineClient {
+  private socket: net.Socket | null = null;
+  private connecting: Promise<net.Socket | null> | null = null;
+  private daemon: ChildProcess | null = null;
+  private incoming: Buffer = Buffer.alloc(0);
+  private nextRequestId = 1;
+  private pending = new Map<number, PendingRequest>();
+  // Sessions live on the daemon connection and end with it
+  private sessions = new Set<number>();
+
+  // Resolves to null when the engine is unavailable so callers can fall back
+  async execute(command: string): Promise<EngineResponse | null> {
+    const response = await this.request(EngineOpcode.Exec, Buffer.from(command, 'utf-8'));
+    if (!response) {
+      return null;
+    }
+    return { status: response.status, output: response.payload.toString('utf-8') };
+  }
+
+  // Runs a command and hands its output to onChunk as the engine produces
+  // it. While a promise returned by onChunk is pending the output is not
+  // acknowledged, so the engine throttles the command instead of buffering
+  // it; other requests carry on.
+  // With a session id the command runs in that session's directory and
+  // environment. Resolves with the final status, or null when the engine
+  // (or the session) is unavailable.
+  async executeStream(
+    command: string,
+    onChunk: (text: string) => void | Promise<void>,
+    sessionId?: number
+  ): Promise<EngineResponse | null> {
+    let opcode = EngineOpcode.ExecStream;
+    let payload = Buffer.from(command, 'utf-8');
+    if (sessionId !== undefined) {
+      if (!this.sessions.has(sessionId)) {
+        return null;
+      }
+      const id = Buffer.allocUnsafe(4);
+      id.writeUInt32LE(sessionId, 0);
+      opcode = EngineOpcode.SessionExec;
+      payload = Buffer.concat([id, payload]);
+    }
+    const decoder = new StringDecoder('utf8');
+    const response = await this.request(
+      opcode,
+      payload,
+      (payload) => {
+        const text = decoder.write(payload);
+        return text ? onChunk(text) : undefined;
+      }
+    );
+    if (!response) {
+      return null;
+    }
+    return { status: response.status, output: decoder.end() + response.payload.toString('utf-8') };
+  }
+
+  // Opens a shell session with its own working directory, environment and
+  // history. Resolves to its id, or null when the engine is unavailable.
+  async openSession(): Promise<number | null> {
+    const response = await this.request(EngineOpcode.SessionOpen, Buffer.alloc(0));
+    if (!response || response.status !== EngineStatus.Ok || response.payload.length !== 4) {
+      return null;
+    }
+    const id = response.payload.readUInt32LE(0);
+    this.sessions.add(id);
+    return id;
+  }
+
+  hasSession(sessionId: number): boolean {
+    return this.sessions.has(sessionId);
+  }
+
+  async closeSession(sessionId: number): Promise<void> {
+    if (!this.sessions.delete(sessionId)) {
+      return;
+    }
+    const id = Buffer.allocUnsafe(4);
+    id.writeUInt32LE(sessionId, 0);
+    await this.request(EngineOpcode.SessionClose, id);
+  }
+
+  // Completes the last word of `line`: a command name, or a path relative to
+  // the session's directory (the project root without a session).
+  async complete(line: string, sessionId?: number): Promise<EngineCompletion | null> {
+    const id = Buffer.alloc(4);
+    if (sessionId !== undefined) {
+      if (!this.sessions.has(sessionId)) {
+        return null;
+      }
+      id.writeUInt32LE(sessionId, 0);
+    }
+    const bytes = Buffer.from(line, 'utf-8');
+    const response = await this.request(EngineOpcode.Complete, Buffer.concat([id, bytes]));
+    if (!response || response.status !== EngineStatus.Ok) {
+      return null;
+    }
+    const [offset, ...candidates] = response.payload.toString('utf-8').split('\n');
+    candidates.pop();
+    // The engine counts bytes; the editor counts UTF-16 units
+    const start = bytes.subarray(0, parseInt(offset, 10) || 0).toString('utf-8').length;
+    return { start, candidates };
+  }
+
+  // Searches the persistent history shared by all sessions, newest first
+  async searchHistory(query: string, match: HistoryMatch, limit: number): Promise<string[] | null> {
+    const header = Buffer.alloc(4);
+    header.writeUInt8(match === 'substring' ? 1 : 0, 0);
+    header.writeUInt16LE(Math.max(0, Math.min(limit, 0xffff)), 2);
+    const response = await this.request(
+      EngineOpcode.History,
+      Buffer.concat([header, Buffer.from(query, 'utf-8')])
+    );
+    if (!response || response.status !== EngineStatus.Ok) {
+      return null;
+    }
+    const lines = response.payload.toString('utf-8').split('\n');
+    lines.pop();
+    return lines;
+  }
+
+  // Full-text search over GenixFiles: files containing every word of the
+  // query, best first. Resolves to null when the engine is unavailable.
+  async search(query: string, limit: number): Promise<EngineSearchHit[] | null> {
+    const header = Buffer.alloc(2);
+    header.writeUInt16LE(Math.max(0, Math.min(limit, 0xffff)), 0);
+    const response = await this.request(
+      EngineOpcode.Search,
+      Buffer.concat([header, Buffer.from(query, 'utf-8')])
+    );
+    if (!response || response.status !== EngineStatus.Ok) {
+      return null;
+    }
+    const lines = response.payload.toString('utf-8').split('\n');
+    lines.pop();
+    return lines.map((line) => {
+      const [hitPath, lineNumber, score, ...snippet] = line.split('\t');
+      return {
+        path: hitPath,
+        line: parseInt(lineNumber, 10),
+        score: parseFloat(score),
+        snippet: snippet.join('\t'),
+      };
+    });
+  }
+
+  // Tells the engine a file under GenixFiles was written or deleted, so
+  // searches see the change
+  async indexFile(absolutePath: string): Promise<void> {
+    await this.request(EngineOpcode.Index, Buffer.from(absolutePath, 'utf-8'));
+  }
+
+  // grep -rn over an absolute directory, matches in path order. Resolves to
+  // null when the engine is unavailable; throws if the pattern does not
+  // compile or the directory cannot be read.
+  async grep(
+    pattern: string,
+    absolutePath: string,
+    options: EngineGrepOptions,
+    limit: number
+  ): Promise<EngineGrepMatch[] | null> {
+    const header = Buffer.alloc(4);
+    header.writeUInt8((options.ignoreCase ? 1 : 0) | (options.fixed ? 2 : 0) | (options.extended ? 4 : 0), 0);
+    header.writeUInt16LE(Math.max(0, Math.min(limit, 0xffff)), 2);
+    const response = await this.request(
+      EngineOpcode.Grep,
+      Buffer.concat([header, Buffer.from(`${pattern}\0${absolutePath}`, 'utf-8')])
+    );
+    if (!response) {
+      return null;
+    }
+    if (response.status === EngineStatus.NotFound) {
+      throw new Error(`ENOENT: no such directory, scandir '${absolutePath}'`);
+    }
+    if (response.status !== EngineStatus.Ok) {
+      throw new Error(response.payload.toString('utf-8') || 'Invalid grep request');
+    }
+    const matches: EngineGrepMatch[] = [];
+    for (const line of response.payload.toString('utf-8').split('\n')) {
+      const [matchPath, lineNumber, ...text] = line.split('\t');
+      // The engine cuts replies that outgrow its buffer, possibly mid-line
+      if (text.length > 0) {
+        matches.push({ path: matchPath, line: parseInt(lineNumber, 10), text: text.join('\t') });
+      }
+    }
+    return matches;
+  }
+
+  // Reads a file through the engine's page cache. Resolves to null when the
+  // engine is unavailable or the file is too large for one frame; throws
+  // if the file cannot be read.
+  async read(absolutePath: string): Promise<string | null> {
+    const response = await this.request(EngineOpcode.Read, Buffer.from(absolutePath, 'utf-8'));
+    if (!response || response.status === EngineStatus.Error) {
+      return null;
+    }
+    if (response.status !== EngineStatus.Ok) {
+      throw new Error(`ENOENT: no such file or directory, open '${absolutePath}'`);
+    }
+    return response.payload.toString('utf-8');
+  }
+
+  // Runs an executable (absolute path) in `cwd` under resource limits
+  // through the engine's zygotes. Resolves to null when the engine is
+  // unavailable; throws if the program could not be started.
+  async run(
+    executable: string,
+    cwd: string,
+    limits: EngineRunLimits = {}
+  ): Promise<EngineRunResult | null> {
+    const header = Buffer.alloc(RUN_REQUEST_HEADER_SIZE);
+    writeRunLimits(header, limits);
+    const response = await this.request(
+      EngineOpcode.Run,
+      Buffer.concat([header, Buffer.from(`${executable}\0${cwd}`, 'utf-8')])
+    );
+    return response ? decodeRunResult(response, executable) : null;
+  }
+
+  // Runs an executable like run() but on a pseudo-terminal, handing what
+  // it prints to onOutput as the engine streams it (coalesced into chunks
+  // of up to 64 KiB or 16 ms). While a promise returned by onOutput is
+  // pending the output is not acknowledged and the program stops printing.
+  // Resolves to null when the engine is unavailable.
+  async runTerminal(
+    executable: string,
+    cwd: string,
+    limits: EngineRunLimits,
+    size: EngineTerminalSize,
+    onOutput: (text: string) => void | Promise<void>
+  ): Promise<EngineTerminalRun | null> {
+    if (!(await this.connect())) {
+      return null;
+    }
+    const header = Buffer.alloc(RUN_TERMINAL_HEADER_SIZE);
+    writeRunLimits(header, limits);
+    header.writeUInt16LE(clampU16(size.rows), 20);
+    header.writeUInt16LE(clampU16(size.columns), 22);
+    const decoder = new StringDecoder('utf8');
+    let started: (requestId: number) => void = () => undefined;
+    const requestId = new Promise<number>((resolve) => {
+      started = resolve;
+    });
+    const response = this.request(
+      EngineOpcode.RunTerminal,
+      Buffer.concat([header, Buffer.from(`${executable}\0${cwd}`, 'utf-8')]),
+      (payload) => {
+        const text = decoder.write(payload);
+        return text ? onOutput(text) : undefined;
+      },
+      started
+    );
+    // Unsent when the connection dropped first; id 0 then finds no run
+    response.finally(() => started(0));
+    const control = async (opcode: EngineOpcode, data: Buffer): Promise<EngineStatus | null> => {
+      const id = Buffer.allocUnsafe(4);
+      id.writeUInt32LE(await requestId, 0);
+      const reply = await this.request(opcode, Buffer.concat([id, data]));
+      return reply ? reply.status : null;
+    };
+    return {
+      result: response.then(async (reply) => {
+        const rest = decoder.end();
+        if (rest) {
+          await onOutput(rest);
+        }
+        return reply ? decodeRunResult(reply, executable) : null;
+      }),
+      write: async (input) =>
+        (await control(EngineOpcode.RunInput, Buffer.from(input, 'utf-8'))) === EngineStatus.Ok,
+      resize: async ({ rows, columns }) => {
+        const data = Buffer.allocUnsafe(4);
+        data.writeUInt16LE(clampU16(rows), 0);
+        data.writeUInt16LE(clampU16(columns), 2);
+        await control(EngineOpcode.RunResize, data);
+      },
+      kill: async () => {
+        await control(EngineOpcode.RunKill, Buffer.alloc(0));
+      },
+    };
+  }
+
+  async ping(): Promise<boolean> {
+    return (await this.request(EngineOpcode.Ping, Buffer.alloc(0))) !== null;
+  }
+
+  // Lists an absolute directory path through the engine's directory cache.
+  // Resolves to null when the engine is unavailable; throws if the
+  // directory cannot be read.
+  async list(absolutePath: string): Promise<EngineDirEntry[] | null> {
+    const response = await this.request(EngineOpcode.List, Buffer.from(absolutePath, 'utf-8'));
+    if (!response) {
+      return null;
+    }
+    if (response.status !== EngineStatus.Ok) {
+      throw new Error(`ENOENT: no such directory, scandir '${absolutePath}'`);
+    }
+
+    const { payload } = response;
+    const entries: EngineDirEntry[] = [];
+    let offset = 0;
+    while (offset + DIR_RECORD_HEADER_SIZE <= payload.length) {
+      const nameLength = payload.readUInt16LE(offset);
+      const start = offset + DIR_RECORD_HEADER_SIZE;
+      entries.push({
+        name: payload.toString('utf-8', start, start + nameLength),
+        type: DIR_ENTRY_TYPES[payload[offset + 2]] || 'other',
+        size: Number(payload.readBigUInt64LE(offset + 4)),
+        mtime: Number(payload.readBigInt64LE(offset + 12)),
+      });
+      offset = start + nameLength;
+    }
+    return entries;
+  }
+
+  // Evaluates a calculator expression such as 'sin(x)*y+2' once per row of
+  // the given variable columns, in a single request. Resolves to null when
+  // the engine is unavailable; throws if the expression does not compile.
+  async evaluate(
+    expression: string,
+    columns: Record<string, ArrayLike<number>>
+  ): Promise<Float64Array | null> {
+    const names = Object.keys(columns);
+    const rows = names.length > 0 ? columns[names[0]].length : 1;
+    const expressionBytes = Buffer.from(expression, 'utf-8');
+    const nameBytes = names.map((name) => Buffer.from(name, 'utf-8'));
+
+    const header = Buffer.allocUnsafe(8);
+    header.writeUInt16LE(expressionBytes.length, 0);
+    header.writeUInt16LE(names.length, 2);
+    header.writeUInt32LE(rows, 4);
+    const values = Buffer.allocUnsafe(names.length * rows * 8);
+    names.forEach((name, column) => {
+      const data = columns[name];
+      if (data.length !== rows) {
+        throw new Error(`Column '${name}' has ${data.length} rows, expected ${rows}`);
+      }
+      for (let row = 0; row < rows; row++) {
+        values.writeDoubleLE(data[row], (column * rows + row) * 8);
+      }
+    });
+    const payload = Buffer.concat([
+      header,
+      expressionBytes,
+      ...nameBytes.flatMap((bytes) => [Buffer.from([bytes.length]), bytes]),
+      values,
+    ]);
+
+    const response = await this.request(EngineOpcode.Eval, payload);
+    if (!response) {
+      return null;
+    }
+    if (response.status !== EngineStatus.Ok) {
+      throw new Error(response.payload.toString('utf-8') || 'Invalid evaluation request');
+    }
+    const results = new Float64Array(rows);
+    for (let row = 0; row < rows; row++) {
+      results[row] = response.payload.readDoubleLE(row * 8);
+    }
+    return results;
+  }
+
+  async stats(): Promise<string | null> {
+    const response = await this.request(EngineOpcode.Stats, Buffer.alloc(0));
+    return response ? response.payload.toString('utf-8') : null;
+  }
+
+  // `onSent` learns the request id, which later requests may refer to
+  private async request(
+    opcode: EngineOpcode,
+    payload: Buffer,
+    onChunk?: ChunkHandler,
+    onSent?: (requestId: number) => void
+  ): Promise<RawResponse | null> {
+    const socket = await this.connect();
+    if (!socket) {
+      return null;
+    }
+
+    const requestId = this.nextRequestId;
+    this.nextRequestId = (this.nextRequestId + 1) >>> 0 || 1;
+
+    return new Promise<RawResponse | null>((resolve) => {
+      this.pending.set(requestId, {
+        resolve,
+        reject: (error) => {
+          console.warn('[Engine] Request failed:', error.message);
+          resolve(null);
+        },
+        onChunk,
+        delivered: Promise.resolve(),
+        unacknowledged: 0,
+        abandoned: false,
+      });
+      socket.write(encodeFrame(requestId, opcode, payload));
+      onSent?.(requestId);
+    });
+  }
+
+  private connect(): Promise<net.Socket | null> {
+    if (this.socket) {
+      return Promise.resolve(this.socket);
+    }
+    if (!this.connecting) {
+      this.connecting = this.establish().finally(() => {
+        this.connecting = null;
+      });
+    }
+    return this.connecting;
+  }
+
+  private async establish(): Promise<net.Socket | null> {
+    for (let attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+      const socket = await tryConnect(ENGINE_SOCKET);
+      if (socket) {
+        this.attach(socket);
+        return socket;
+      }
+      if (!this.startDaemon()) {
+        return null;
+      }
+      await new Promise((resolve) => setTimeout(resolve, CONNECT_RETRY_MS));
+    }
+    console.warn(`[Engine] Could not connect to ${ENGINE_SOCKET}`);
+    return null;
+  }
+
+  private startDaemon(): boolean {
+    if (this.daemon && this.daemon.exitCode === null) {
+      return true;
+    }
+    if (!fs.existsSync(ENGINE_BINARY)) {
+      return false;
+    }
+
+    console.log(`[Engine] Starting ${ENGINE_BINARY} on ${ENGINE_SOCKET}`);
+    const daemon = spawn(
+      ENGINE_BINARY,
+      ['--root', PROJECT_ROOT, '--index', GENIX_FILES_ROOT, '--socket', ENGINE_SOCKET],
+      { stdio: ['ignore', 'ignore', 'inherit'] }
+    );
+    daemon.on('error', (error) => {
+      console.warn('[Engine] Failed to start daemon:', error.message);
+    });
+    daemon.on('exit', () => {
+      if (this.daemon === daemon) {
+        this.daemon = null;
+      }
+    });
+    this.daemon = daemon;
+    return true;
+  }
+
+  private attach(socket: net.Socket) {
+    this.socket = socket;
+    this.incoming = Buffer.alloc(0);
+    socket.setNoDelay(true);
+    socket.on('data', (chunk: Buffer) => this.onData(chunk));
+    socket.on('error', (error) => this.detach(error));
+    socket.on('close', () => this.detach(new Error('Engine connection closed')));
+  }
+
+  private detach(error: Error) {
+    if (!this.socket) {
+      return;
+    }
+    this.socket.destroy();
+    this.socket = null;
+    this.sessions.clear();
+    const pending = this.pending;
+    this.pending = new Map();
+    pending.forEach((request) => request.reject(error));
+  }
+
+  private onData(chunk: Buffer) {
+    this.incoming = this.incoming.length === 0 ? chunk : Buffer.concat([this.incoming, chunk]);
+
+    let offset = 0;
+    while (this.incoming.length - offset >= FRAME_HEADER_SIZE) {
+      const length = this.incoming.readUInt32LE(offset);
+      if (this.incoming.length - offset < FRAME_HEADER_SIZE + length) {
+        break;
+      }
+      const requestId = this.incoming.readUInt32LE(offset + 4);
+      const status = this.incoming.readUInt16LE(offset + 10) as EngineStatus;
+      const start = offset + FRAME_HEADER_SIZE;
+      const payload = this.incoming.subarray(start, start + length);
+      offset = start + length;
+
+      const request = this.pending.get(requestId);
+      if (request && status === EngineStatus.More) {
+        this.deliverChunk(requestId, request, payload);
+      } else if (request) {
+        this.pending.delete(requestId);
+        // After the chunks before it
+        request.delivered.then(() => request.resolve({ status, payload }));
+      }
+    }
+    this.incoming = this.incoming.subarray(offset);
+  }
+
+  // Chunks of a request are handled one at a time and acknowledged once
+  // handled. A slow consumer holds back only its own stream: the engine
+  // stops it after a window of unacknowledged output, which bounds memory
+  // on both sides while the connection keeps serving everyone else.
+  private deliverChunk(requestId: number, request: PendingRequest, payload: Buffer) {
+    request.delivered = request.delivered.then(async () => {
+      if (request.abandoned) {
+        return;
+      }
+      try {
+        await request.onChunk?.(payload);
+      } catch {
+        // Left unacknowledged, the engine fails the stream after its timeout
+        request.abandoned = true;
+        return;
+      }
+      this.acknowledge(requestId, request, payload.length);
+    });
+  }
+
+  private acknowledge(requestId: number, request: PendingRequest, length: number) {
+    request.unacknowledged += length;
+    // A request that already ended, or one from a dropped connection, needs none
+    if (request.unacknowledged < STREAM_ACK_BYTES || this.pending.get(requestId) !== request) {
+      return;
+    }
+    const bytes = Buffer.allocUnsafe(4);
+    bytes.writeUInt32LE(request.unacknowledged, 0);
+    request.unacknowledged = 0;
+    this.socket?.write(encodeFrame(requestId, EngineOpcode.StreamAck, bytes));
+  }
+
+  shutdown() {
+    this.detach(new Error('Engine client shut down'));
+    if (this.daemon) {
+      this.daemon.kill('SIGTERM');
+      this.daemon = null;
+    }
+  }
+}
+
+// 0 (or absent) leaves a limit at the engine's default
+function writeRunLimits(header: Buffer, limits: EngineRunLimits) {
+  header.writeUInt32LE(limits.wallMs ?? 0, 0);
+  header.writeUInt32LE(limits.cpuSeconds ?? 0, 4);
+  header.writeUInt32LE(limits.memoryMb ?? 0, 8);
+  header.writeUInt32LE(limits.fileMb ?? 0, 12);
+  header.writeUInt32LE(limits.processes ?? 0, 16);
+}
+
+function decodeRunResult(response: RawResponse, executable: string): EngineRunResult {
+  if (response.status === EngineStatus.NotFound) {
+    throw new Error(`ENOENT: no such file or directory, spawn '${executable}'`);
+  }
+  if (response.status !== EngineStatus.Ok) {
+    throw new Error(response.payload.toString('utf-8') || 'Invalid run request');
+  }
+  const payload = response.payload;
+  const flags = payload.readUInt8(5);
+  const stdoutLength = payload.readUInt32LE(40);
+  const stdoutEnd = RUN_RESPONSE_HEADER_SIZE + stdoutLength;
+  return {
+    exitCode: payload.readInt32LE(0),
+    signal: payload.readUInt8(4),
+    timedOut: (flags & 1) !== 0,
+    truncated: (flags & 2) !== 0,
+    wallMs: Number(payload.readBigUInt64LE(8)) / 1000,
+    userMs: Number(payload.readBigUInt64LE(16)) / 1000,
+    systemMs: Number(payload.readBigUInt64LE(24)) / 1000,
+    maxRssKb: Number(payload.readBigUInt64LE(32)),
+    stdout: payload.subarray(RUN_RESPONSE_HEADER_SIZE, stdoutEnd).toString('utf-8'),
+    stderr: payload.subarray(stdoutEnd).toString('utf-8'),
+  };
+}
+
+function clampU16(value: number): number {
+  return Math.max(0, Math.min(Math.floor(value) || 0, 0xffff));
+}
+
+function tryConnect(socketPath: string): Promise<net.Socket | null> {
+  return new Promise((resolve) => {
+    const socket = net.createConnection(socketPath);
+    socket.once('connect', () => {
+      socket.removeAllListeners('error');
+      resolve(socket);
+    });
+    socket.once('error', () => {
+      socket.destroy();
+      resolve(null);
+    });
+  });
+}
+
+export const engineClient = new EngineClient();
+
+process.on('exit', () => engineClient.shutdown());
@@ -1,15 +1,54 @@
 import { spawn } from 'child_process';
+import * as os from 'os';
 import * as path from 'path';
 import * as fs from 'fs/promises';
+import { compileCached, warmCompileCache } from '../build/compileCache';
+import { buildProject } from '../build/projectBuild';
+import { engineClient, EngineRunResult, EngineTerminalRun } from '../engine/engineClient';
 
 const PROJECT_ROOT = path.resolve(process.cwd(), 'c-engine');
 const GENIX_FILES_ROOT = path.resolve(process.cwd(), 'GenixFiles');
 const SANDBOX_ROOT = path.resolve(PROJECT_ROOT, 'sandbox');
+const COMPILE_FLAGS = ['-Wall', '-Wextra'];
+// Enough for coursework; an infinite loop or a fork bomb ends here
+const RUN_LIMITS = {
+  wallMs: 10000,
+  cpuSeconds: 5,
+  memoryMb: 512,
+  fileMb: 64,
+  processes: 64,
+};
+// An interactive program mostly waits for its user; the CPU limit still applies
+const INTERACTIVE_RUN_LIMITS = { ...RUN_LIMITS, wallMs: 15 * 60 * 1000 };
 
 interface BuildMessage {
   type: 'build';
-  action: 'compile' | 'run';
+  action: 'compile' | 'run' | 'build' | 'run-input' | 'run-resize' | 'run-kill';
   file: string;
+  // 'build' only: compiles running at once
+  jobs?: number;
+  // 'run': on a terminal, streaming output and taking input
+  interactive?: boolean;
+  // 'run' (interactive) and 'run-resize'
+  rows?: number;
+  columns?: number;
+  // 'run-input': typed into the running program's terminal
+  input?: string;
+}
+
+export type RunOutputSender = (message: object) => void | Promise<void>;
+
+// Per-connection state: the program the window is running interactively
+export interface RunContext {
+  run: EngineTerminalRun | null;
+}
+
+// Precompiles common headers in the background; builds before it finishes
+// simply compile without them
+export function warmBuildTools(): void {
+  warmCompileCache(COMPILE_FLAGS).catch((error) => {
+    console.warn('[BuildHandler] Failed to warm compilers:', error);
+  });
 }
 
 // Find the file in either c-engine or GenixFiles
@@ -35,8 +74,17 @@ async function findFile(fileName: string): Promise<string | null> {
   }
 }
 
-export async function handleBuild(data: BuildMessage): Promise<any> {
-  const { action, file } = data;
+// Control messages for an interactive run resolve to null: they have no reply
+export async function handleBuild(
+  data: BuildMessage,
+  send?: RunOutputSender,
+  context?: RunContext
+): Promise<any> {
+  const { action, file, jobs } = data;
+  if (action === 'run-input' || action === 'run-resize' || action === 'run-kill') {
+    await controlRun(data, context);
+    return null;
+  }
 
   // Find the file in either location
   const fullPath = await findFile(file);
@@ -50,28 +98,18 @@ export async function handleBuild(data: BuildMessage): Promise<any> {
     return { type: 'error', message: 'Permission denied: File outside allowed directories' };
   }
 
-  // If file is in GenixFiles, copy it to c-engine to ensure we're using the latest version
-  // This ensures consistency and that the compiler uses the most recent code
-  let compilePath = fullPath;
-  if (fullPath.startsWith(GENIX_FILES_ROOT)) {
-    const targetPath = path.resolve(PROJECT_ROOT, file);
-    try {
-      const fileContent = await fs.readFile(fullPath, 'utf-8');
-      await fs.writeFile(targetPath, fileContent, 'utf-8');
-      compilePath = targetPath;
-      console.log(`[BuildHandler] Copied ${fullPath} to ${targetPath} for compilation`);
-    } catch (error) {
-      console.error(`[BuildHandler] Error copying file: ${error}`);
-      // Continue with original path if copy fails
-    }
-  }
-
+  // Compiled where it lives; copying it into c-engine/ overwrote the
+  // engine's own sources (main.c) with students' files of the same name
   try {
     switch (action) {
       case 'compile':
-        return await handleCompile(compilePath);
+        return await handleCompile(fullPath);
       case 'run':
-        return await handleRun(compilePath);
+        return data.interactive && send && context
+          ? await handleInteractiveRun(fullPath, data, send, context)
+          : await handleRun(fullPath);
+      case 'build':
+        return await handleProjectBuild(fullPath, jobs);
       default:
         return { type: 'error', message: 'Unknown build action' };
     }
@@ -88,141 +126,243 @@ async function handleCompile(filePath: string): Promise<any> {
     // ignore mkdir errors
   });
 
+  const ext = path.extname(filePath);
+  const isCpp = ext === '.cpp' || ext === '.cxx' || ext === '.cc';
+  const compiler = isCpp ? 'g++' : 'gcc';
+
+  const baseName = path.basename(filePath, ext);
+  // On Windows, gcc/g++ automatically adds .exe, but we'll be explicit
+  const outputPath = path.join(SANDBOX_ROOT, baseName + (process.platform === 'win32' ? '.exe' : ''));
+
+  const result = await compileCached(compiler, filePath, COMPILE_FLAGS, outputPath);
+  if (result.cacheHit) {
+    console.log(`[BuildHandler] ${path.basename(filePath)}: cache hit (${result.cacheHit})`);
+  }
+  if (result.success) {
+    return {
+      type: 'build',
+      action: 'compile',
+      success: true,
+      output: result.stdout,
+      executable: outputPath,
+      cached: result.cacheHit !== null,
+    };
+  }
+  return {
+    type: 'build',
+    action: 'compile',
+    success: false,
+    output: result.stderr,
+    error: true,
+    cached: result.cacheHit !== null,
+  };
+}
+
+// A project directory: every source below it, rebuilt incrementally and
+// linked into sandbox/<project>, which 'run' on the same path starts
+async function handleProjectBuild(projectDir: string, jobs?: number): Promise<any> {
+  const stat = await fs.stat(projectDir);
+  if (!stat.isDirectory()) {
+    return { type: 'error', message: `Not a project directory: ${path.basename(projectDir)}` };
+  }
+  await fs.mkdir(SANDBOX_ROOT, { recursive: true });
+
+  const outputPath = path.join(SANDBOX_ROOT, path.basename(projectDir));
+  const result = await buildProject(projectDir, { outputPath, flags: COMPILE_FLAGS, jobs });
+  console.log(
+    `[BuildHandler] ${path.basename(projectDir)}: ${result.units.length} compiled, ` +
+      `${result.upToDate} up to date in ${result.totalMs} ms`
+  );
+  return {
+    type: 'build',
+    action: 'build',
+    success: result.success,
+    output: result.output,
+    executable: result.executable,
+    units: result.units,
+    error: !result.success,
+  };
+}
+
+async function handleRun(filePath: string): Promise<any> {
+  const exePath = await findExecutable(filePath);
+  if (!exePath) {
+    return runFailure('Executable not found. Please compile first.');
+  }
+
+  // The engine's runner applies RUN_LIMITS and measures the run; without
+  // the engine (or on Windows) the program runs unconfined
+  try {
+    const result = await engineClient.run(exePath, SANDBOX_ROOT, RUN_LIMITS);
+    if (result) {
+      return runReply(result, RUN_LIMITS.wallMs);
+    }
+  } catch (error) {
+    return runFailure(error instanceof Error ? error.message : String(error));
+  }
+  return runUnconfined(exePath);
+}
+
+// Runs the program on an engine terminal: what it prints streams to the
+// window as { type: 'run-output', output } messages, and run-input,
+// run-resize and run-kill messages reach it while it runs. The usual run
+// reply follows its exit, with the output already sent. One program per
+// window; starting another kills the first.
+async function handleInteractiveRun(
+  filePath: string,
+  data: BuildMessage,
+  send: RunOutputSender,
+  context: RunContext
+): Promise<any> {
+  const exePath = await findExecutable(filePath);
+  if (!exePath) {
+    return runFailure('Executable not found. Please compile first.');
+  }
+  await context.run?.kill();
+
+  const run = await engineClient.runTerminal(
+    exePath,
+    SANDBOX_ROOT,
+    INTERACTIVE_RUN_LIMITS,
+    { rows: data.rows ?? 0, columns: data.columns ?? 0 },
+    (output) => send({ type: 'run-output', output })
+  );
+  if (!run) {
+    // Without the engine there is no terminal: run it with no input instead
+    return handleRun(filePath);
+  }
+  context.run = run;
+  try {
+    const result = await run.result;
+    return result
+      ? runReply(result, INTERACTIVE_RUN_LIMITS.wallMs)
+      : runFailure('The engine stopped while the program was running');
+  } catch (error) {
+    return runFailure(error instanceof Error ? error.message : String(error));
+  } finally {
+    if (context.run === run) {
+      context.run = null;
+    }
+  }
+}
+
+async function controlRun(data: BuildMessage, context?: RunContext): Promise<void> {
+  const run = context?.run;
+  if (!run) {
+    return;
+  }
+  if (data.action === 'run-input') {
+    await run.write(data.input ?? '');
+  } else if (data.action === 'run-resize') {
+    await run.resize({ rows: data.rows ?? 0, columns: data.columns ?? 0 });
+  } else {
+    await run.kill();
+  }
+}
+
+export async function closeRunContext(context: RunContext): Promise<void> {
+  const run = context.run;
+  context.run = null;
+  await run?.kill();
+}
+
+// sandbox/<name>, or sandbox/<name>.exe on Windows
+async function findExecutable(filePath: string): Promise<string | null> {
+  await fs.mkdir(SANDBOX_ROOT, { recursive: true }).catch(() => {
+    // ignore mkdir errors
+  });
+  const baseName = path.basename(filePath, path.extname(filePath));
+  for (const candidate of [baseName, baseName + '.exe']) {
+    const exePath = path.join(SANDBOX_ROOT, candidate);
+    try {
+      await fs.access(exePath);
+      return exePath;
+    } catch {
+      // try the next name
+    }
+  }
+  return null;
+}
+
+function runReply(result: EngineRunResult, wallMs: number): any {
+  let error = result.stderr;
+  const separator = error === '' || error.endsWith('\n') ? '' : '\n';
+  if (result.timedOut) {
+    error += `${separator}Killed: ran longer than ${wallMs / 1000} s`;
+  } else if (result.signal !== 0) {
+    error += `${separator}Killed: ${describeSignal(result.signal)}`;
+  }
+  return {
+    type: 'build',
+    action: 'run',
+    success: result.exitCode === 0,
+    output: result.stdout,
+    error,
+    exitCode: result.exitCode,
+    signal: result.signal,
+    timedOut: result.timedOut,
+    truncated: result.truncated,
+    stats: {
+      wallMs: result.wallMs,
+      userMs: result.userMs,
+      systemMs: result.systemMs,
+      maxRssKb: result.maxRssKb,
+    },
+  };
+}
+
+function runFailure(error: string): any {
+  return { type: 'build', action: 'run', success: false, output: '', error };
+}
+
+function describeSignal(signal: number): string {
+  if (signal === os.constants.signals.SIGXCPU) {
+    return `used more than ${RUN_LIMITS.cpuSeconds} s of CPU time`;
+  }
+  if (signal === os.constants.signals.SIGXFSZ) {
+    return `wrote a file larger than ${RUN_LIMITS.fileMb} MB`;
+  }
+  const name = Object.entries(os.constants.signals).find(([, number]) => number === signal);
+  return name ? name[0] : `signal ${signal}`;
+}
+
+function runUnconfined(exePath: string): Promise<any> {
   return new Promise((resolve) => {
-    const ext = path.extname(filePath);
-    const isCpp = ext === '.cpp' || ext === '.cxx' || ext === '.cc';
-    const compiler = isCpp ? 'g++' : 'gcc';
-    
-    const baseName = path.basename(filePath, ext);
-    // On Windows, gcc/g++ automatically adds .exe, but we'll be explicit
-    const outputPath = path.join(SANDBOX_ROOT, baseName + (process.platform === 'win32' ? '.exe' : ''));
-    
-    const compileProcess = spawn(compiler, [
-      filePath,
-      '-o',
-      outputPath,
-      '-Wall',
-      '-Wextra',
-    ]);
+    const runProcess = spawn(exePath, [], {
+      cwd: SANDBOX_ROOT,
+      shell: process.platform === 'win32', // Use shell on Windows
+    });
 
     let stdout = '';
     let stderr = '';
 
-    compileProcess.stdout.on('data', (data) => {
+    runProcess.stdout.on('data', (data) => {
       stdout += data.toString();
     });
 
-    compileProcess.stderr.on('data', (data) => {
+    runProcess.stderr.on('data', (data) => {
       stderr += data.toString();
     });
 
-    compileProcess.on('close', (code) => {
-      if (code === 0) {
-        resolve({
-          type: 'build',
-          action: 'compile',
-          success: true,
-          output: stdout,
-          executable: outputPath,
-        });
-      } else {
-        resolve({
-          type: 'build',
-          action: 'compile',
-          success: false,
-          output: stderr,
-          error: true,
-        });
-      }
+    runProcess.on('close', (code) => {
+      resolve({
+        type: 'build',
+        action: 'run',
+        success: code === 0,
+        output: stdout,
+        error: stderr,
+        exitCode: code,
+      });
     });
 
-    compileProcess.on('error', (error) => {
+    runProcess.on('error', (error) => {
       resolve({
         type: 'build',
-        action: 'compile',
+        action: 'run',
         success: false,
-        output: error.message,
-        error: true,
+        output: '',
+        error: error.message,
       });
     });
   });
 }
-
-async function handleRun(filePath: string): Promise<any> {
-  await fs.mkdir(SANDBOX_ROOT, { recursive: true }).catch(() => {
-    // ignore mkdir errors
-  });
-
-  return new Promise((resolve) => {
-    const ext = path.extname(filePath);
-    const baseName = path.basename(filePath, ext);
-    const executable = path.join(SANDBOX_ROOT, baseName);
-    // On Windows, executables have .exe extension
-    const executableExe = path.join(SANDBOX_ROOT, baseName + '.exe');
-
-    // Try to find executable (with or without .exe on Windows)
-    const checkExecutable = async () => {
-      try {
-        await fs.access(executable);
-        return executable;
-      } catch {
-        try {
-          await fs.access(executableExe);
-          return executableExe;
-        } catch {
-          throw new Error('Executable not found');
-        }
-      }
-    };
-
-    checkExecutable()
-      .then((exePath) => {
-        const runProcess = spawn(exePath, [], {
-          cwd: SANDBOX_ROOT,
-          shell: process.platform === 'win32', // Use shell on Windows
-        });
-
-        let stdout = '';
-        let stderr = '';
-
-        runProcess.stdout.on('data', (data) => {
-          stdout += data.toString();
-        });
-
-        runProcess.stderr.on('data', (data) => {
-          stderr += data.toString();
-        });
-
-        runProcess.on('close', (code) => {
-          resolve({
-            type: 'build',
-            action: 'run',
-            success: code === 0,
-            output: stdout,
-            error: stderr,
-            exitCode: code,
-          });
-        });
-
-        runProcess.on('error', (error) => {
-          resolve({
-            type: 'build',
-            action: 'run',
-            success: false,
-            output: '',
-            error: error.message,
-          });
-        });
-      })
-      .catch(() => {
-        resolve({
-          type: 'build',
-          action: 'run',
-          success: false,
-          output: '',
-          error: 'Executable not found. Please compile first.',
-        });
-      });
-  });
-}
-
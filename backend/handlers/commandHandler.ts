@@ -1,5 +1,6 @@
 import * as path from 'path';
 import * as fs from 'fs/promises';
+import { engineClient, EngineStatus } from '../engine/engineClient';
 
 const PROJECT_ROOT = path.resolve(process.cwd(), 'c-engine');
 
@@ -7,11 +8,60 @@ interface CommandMessage {
   type: 'command';
   action: string;
   path?: string;
+  // The full command line as typed, for pipelines and redirection
+  line?: string;
+  // history-search: what to look for, and how many matches to return
+  query?: string;
+  mode?: 'prefix' | 'substring';
+  limit?: number;
 }
 
-export async function handleCommand(data: CommandMessage): Promise<any> {
+const HISTORY_DEFAULT_LIMIT = 50;
+
+export type OutputSender = (message: object) => void | Promise<void>;
+
+// Per-connection shell state: the engine session holding the cwd,
+// environment and history of one GenixShell window
+export interface ShellContext {
+  session: Promise<number | null> | null;
+}
+
+const STREAM_STATUS: Record<number, string> = {
+  [EngineStatus.Ok]: 'ok',
+  [EngineStatus.NotFound]: 'not-found',
+};
+
+export async function handleCommand(
+  data: CommandMessage,
+  send?: OutputSender,
+  shell?: ShellContext
+): Promise<any> {
   const { action, path: cmdPath = '.' } = data;
 
+  if (action === 'complete') {
+    return await handleCompletion(data.line ?? '', shell);
+  }
+  if (action === 'history-search') {
+    return await handleHistorySearch(data);
+  }
+
+  // cd only means something inside a session
+  if (data.line && send && (action !== 'cd' || shell)) {
+    const streamed = await streamInEngine(data.line, send, shell);
+    if (streamed) {
+      return streamed;
+    }
+  }
+
+  if (action === 'calc' && data.path) {
+    return await handleCalc(data.path);
+  }
+
+  const engineResult = action !== 'cd' ? await executeInEngine(action, cmdPath) : null;
+  if (engineResult) {
+    return engineResult;
+  }
+
   switch (action) {
     case 'ls':
       return await handleLs(cmdPath);
@@ -33,16 +83,119 @@ export async function handleCommand(data: CommandMessage): Promise<any> {
   }
 }
 
+const ENGINE_FLAGS: Record<string, string> = { mkdir: '-p', rm: '-rf' };
+
+// Commands the C engine implements run there over the persistent daemon
+// connection; anything it does not know falls back to the handlers below.
+async function executeInEngine(action: string, cmdPath: string): Promise<any | null> {
+  const fullPath = path.resolve(PROJECT_ROOT, cmdPath);
+  if (!fullPath.startsWith(PROJECT_ROOT)) {
+    return null;
+  }
+  const relativePath = path.relative(PROJECT_ROOT, fullPath) || '.';
+
+  // Match the Node fallbacks: mkdir creates parents, rm removes trees
+  const flags = ENGINE_FLAGS[action] ? `${ENGINE_FLAGS[action]} ` : '';
+  const quoted = `"${relativePath.replace(/["\\]/g, '\\$&')}"`;
+  const response = await engineClient.execute(`${action} ${flags}${quoted}`);
+  if (!response || response.status === EngineStatus.NotFound) {
+    return null;
+  }
+  return { type: 'output', output: response.output };
+}
+
+export async function closeShellContext(shell: ShellContext): Promise<void> {
+  const sessionId = shell.session ? await shell.session : null;
+  shell.session = null;
+  if (sessionId !== null) {
+    await engineClient.closeSession(sessionId);
+  }
+}
+
+// Opens the session on first use, and again if the engine restarted since
+async function sessionFor(shell: ShellContext): Promise<number | null> {
+  let sessionId = shell.session ? await shell.session : null;
+  if (sessionId === null || !engineClient.hasSession(sessionId)) {
+    shell.session = engineClient.openSession();
+    sessionId = await shell.session;
+  }
+  return sessionId;
+}
+
+// Forwards output chunk by chunk as the engine produces it. `send` waits
+// while the WebSocket is backed up, which in turn throttles the engine.
+async function streamInEngine(
+  line: string,
+  send: OutputSender,
+  shell?: ShellContext
+): Promise<any | null> {
+  const sessionId = shell ? await sessionFor(shell) : null;
+  if (shell && sessionId === null) {
+    return null;
+  }
+  let streamed = false;
+  const response = await engineClient.executeStream(
+    line,
+    (chunk) => {
+      streamed = true;
+      return send({ type: 'output-chunk', output: chunk });
+    },
+    sessionId ?? undefined
+  );
+  if (!response) {
+    // Only fall back when nothing has been shown yet
+    return streamed ? { type: 'output-end', status: 'error' } : null;
+  }
+  if (response.output) {
+    await send({ type: 'output-chunk', output: response.output });
+  }
+  return { type: 'output-end', status: STREAM_STATUS[response.status] || 'error' };
+}
+
+// Completions within a session resolve paths against its directory, and
+// queue behind its commands, so they see the effect of a preceding cd
+async function handleCompletion(line: string, shell?: ShellContext): Promise<any> {
+  const sessionId = shell ? await sessionFor(shell) : null;
+  const completion = await engineClient.complete(line, sessionId ?? undefined);
+  return {
+    type: 'completion',
+    line,
+    start: completion ? completion.start : line.length,
+    candidates: completion ? completion.candidates : [],
+  };
+}
+
+async function handleHistorySearch(data: CommandMessage): Promise<any> {
+  const query = data.query ?? '';
+  const mode = data.mode === 'substring' ? 'substring' : 'prefix';
+  const matches = await engineClient.searchHistory(
+    query,
+    mode,
+    data.limit ?? HISTORY_DEFAULT_LIMIT
+  );
+  return { type: 'history', query, mode, matches: matches ?? [] };
+}
+
+// The argument is an expression, not a path, so it goes to the engine as is
+async function handleCalc(expression: string): Promise<any> {
+  const response = await engineClient.execute(`calc ${expression.replace(/\s+/g, ' ')}`);
+  if (!response) {
+    return { type: 'output', output: 'calc: engine unavailable\n' };
+  }
+  return { type: 'output', output: response.output };
+}
+
 async function handleLs(cmdPath: string): Promise<any> {
   try {
     const fullPath = path.resolve(PROJECT_ROOT, cmdPath);
     if (!fullPath.startsWith(PROJECT_ROOT)) {
       return { type: 'output', output: 'Permission denied\n' };
     }
-    const entries = await fs.readdir(fullPath, { withFileTypes: true });
-    const files = entries
-      .map((entry) => entry.name)
-      .join('\n');
+    const cached = await engineClient.list(fullPath);
+    const names = cached
+      ? cached.map((entry) => entry.name)
+      : (await fs.readdir(fullPath, { withFileTypes: true })).map((entry) => entry.name);
+    const files = names.join('\n');
     return { type: 'output', output: files + '\n' };
   } catch (error) {
     return {
@@ -1,5 +1,6 @@
 import * as path from 'path';
 import * as fs from 'fs/promises';
+import { engineClient } from '../engine/engineClient';
 
 const GENIX_ROOT = path.resolve(process.cwd(), 'GenixFiles');
 
@@ -20,11 +21,21 @@ ensureGenixStructure();
 
 interface FileMessage {
   type: 'file';
-  action: 'read' | 'write' | 'create' | 'delete' | 'list';
+  action: 'read' | 'write' | 'create' | 'delete' | 'list' | 'search' | 'grep';
   path?: string;
   content?: string;
+  // search: words to find, and how many files to return
+  // grep: the pattern, and how many lines to return; path is the directory
+  query?: string;
+  limit?: number;
+  ignoreCase?: boolean;
+  fixed?: boolean;
+  extended?: boolean;
 }
 
+const SEARCH_DEFAULT_LIMIT = 20;
+const GREP_DEFAULT_LIMIT = 200;
+
 export async function handleFile(data: FileMessage): Promise<any> {
   const { action, path: filePath, content } = data;
 
@@ -40,7 +51,7 @@ export async function handleFile(data: FileMessage): Promise<any> {
   try {
     switch (action) {
       case 'read':
-        const fileContent = await fs.readFile(fullPath, 'utf-8');
+        const fileContent = await readFile(fullPath);
         return { type: 'file', action: 'read', path: filePath, content: fileContent };
       
       case 'write':
@@ -48,6 +59,7 @@ export async function handleFile(data: FileMessage): Promise<any> {
         const writeDir = path.dirname(fullPath);
         await fs.mkdir(writeDir, { recursive: true });
         await fs.writeFile(fullPath, content || '', 'utf-8');
+        await engineClient.indexFile(fullPath);
         return { type: 'file', action: 'write', path: filePath, success: true };
       
       case 'create':
@@ -55,19 +67,22 @@ export async function handleFile(data: FileMessage): Promise<any> {
         const createDir = path.dirname(fullPath);
         await fs.mkdir(createDir, { recursive: true });
         await fs.writeFile(fullPath, content || '', 'utf-8');
+        await engineClient.indexFile(fullPath);
         return { type: 'file', action: 'create', path: filePath, success: true };
       
       case 'delete':
         await fs.unlink(fullPath);
+        await engineClient.indexFile(fullPath);
         return { type: 'file', action: 'delete', path: filePath, success: true };
       
       case 'list':
-        const entries = await fs.readdir(fullPath, { withFileTypes: true });
-        const items = entries.map((entry) => ({
-          name: entry.name,
-          type: entry.isDirectory() ? 'directory' : 'file',
-        }));
-        return { type: 'file', action: 'list', path: resolvedPath || '.', items };
+        return { type: 'file', action: 'list', path: resolvedPath || '.', items: await listDirectory(fullPath) };
+
+      case 'search':
+        return await searchFiles(data.query ?? '', data.limit ?? SEARCH_DEFAULT_LIMIT);
+
+      case 'grep':
+        return await grepFiles(data, fullPath);
       
       default:
         return { type: 'error', message: 'Unknown file action' };
@@ -80,3 +95,48 @@ export async function handleFile(data: FileMessage): Promise<any> {
   }
 }
 
+
+// Served from the engine's inotify-backed directory cache when it is running
+async function listDirectory(fullPath: string) {
+  const cached = await engineClient.list(fullPath);
+  if (cached) {
+    return cached.map((entry) => ({
+      name: entry.name,
+      type: entry.type === 'directory' ? 'directory' : 'file',
+      size: entry.size,
+      mtime: entry.mtime,
+    }));
+  }
+  const entries = await fs.readdir(fullPath, { withFileTypes: true });
+  return entries.map((entry) => ({
+    name: entry.name,
+    type: entry.isDirectory() ? 'directory' : 'file',
+  }));
+}
+
+// Served from the engine's page cache when it is running, so editors
+// reloading the same files do not go to disk each time
+async function readFile(fullPath: string): Promise<string> {
+  const cached = await engineClient.read(fullPath);
+  return cached ?? (await fs.readFile(fullPath, 'utf-8'));
+}
+
+// Ranked hits with a line snippet each, from the engine's inverted index
+async function searchFiles(query: string, limit: number) {
+  const results = await engineClient.search(query, limit);
+  if (!results) {
+    return { type: 'error', message: 'Search is unavailable: the engine is not running' };
+  }
+  return { type: 'file', action: 'search', query, results };
+}
+
+// Matching lines under a directory, narrowed down by the engine's trigram index
+async function grepFiles(data: FileMessage, fullPath: string) {
+  const query = data.query ?? '';
+  const options = { ignoreCase: data.ignoreCase, fixed: data.fixed, extended: data.extended };
+  const results = await engineClient.grep(query, fullPath, options, data.limit ?? GREP_DEFAULT_LIMIT);
+  if (!results) {
+    return { type: 'error', message: 'Grep is unavailable: the engine is not running' };
+  }
+  return { type: 'file', action: 'grep', path: data.path ?? '.', query, results };
+}
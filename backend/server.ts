@@ -2,12 +2,20 @@ import WebSocket from 'ws';
 import * as http from 'http';
 import * as path from 'path';
 import * as fs from 'fs';
-import { handleCommand } from './handlers/commandHandler';
+import { handleCommand, closeShellContext, ShellContext } from './handlers/commandHandler';
 import { handleFile } from './handlers/fileHandler';
-import { handleBuild } from './handlers/buildHandler';
+import { handleBuild, closeRunContext, RunContext, warmBuildTools } from './handlers/buildHandler';
 
 const PORT = parseInt(process.env.GENIX_BACKEND_PORT || '18080', 10);
 
+// Streamed command output pauses above the high-water mark until the
+// browser has drained the socket below the low one. A browser that stops
+// draining fails the stream it was sent; the engine then stops that command.
+const WS_HIGH_WATER = 1024 * 1024;
+const WS_LOW_WATER = 256 * 1024;
+const DRAIN_POLL_MS = 10;
+const DRAIN_TIMEOUT_MS = 30000;
+
 const server = http.createServer();
 const wss = new WebSocket.Server({ server });
 
@@ -17,10 +25,45 @@ interface WebSocketMessage {
   path?: string;
   content?: string;
   file?: string;
+  line?: string;
+  query?: string;
+  mode?: 'prefix' | 'substring';
+  limit?: number;
+  interactive?: boolean;
+  rows?: number;
+  columns?: number;
+  input?: string;
+}
+
+function sendWithBackpressure(ws: WebSocket, message: object): Promise<void> | void {
+  ws.send(JSON.stringify(message));
+  if (ws.bufferedAmount > WS_HIGH_WATER) {
+    return waitForDrain(ws);
+  }
+}
+
+function waitForDrain(ws: WebSocket): Promise<void> {
+  const deadline = Date.now() + DRAIN_TIMEOUT_MS;
+  return new Promise((resolve, reject) => {
+    const check = () => {
+      if (ws.readyState !== WebSocket.OPEN || ws.bufferedAmount <= WS_LOW_WATER) {
+        resolve();
+      } else if (Date.now() >= deadline) {
+        reject(new Error('WebSocket not drained'));
+      } else {
+        setTimeout(check, DRAIN_POLL_MS);
+      }
+    };
+    check();
+  });
 }
 
 wss.on('connection', (ws: WebSocket) => {
   console.log('Client connected');
+  // Each window gets its own engine shell session, opened on first command
+  const shell: ShellContext = { session: null };
+  // and may run one program interactively
+  const run: RunContext = { run: null };
 
   ws.on('message', async (message: string) => {
     try {
@@ -29,19 +72,30 @@ wss.on('connection', (ws: WebSocket) => {
 
       switch (data.type) {
         case 'command':
-          response = await handleCommand(data as any);
+          response = await handleCommand(
+            data as any,
+            (message) => sendWithBackpressure(ws, message),
+            shell
+          );
           break;
         case 'file':
           response = await handleFile(data as any);
           break;
         case 'build':
-          response = await handleBuild(data as any);
+          response = await handleBuild(
+            data as any,
+            (message) => sendWithBackpressure(ws, message),
+            run
+          );
           break;
         default:
           response = { type: 'error', message: 'Unknown message type' };
       }
 
-      ws.send(JSON.stringify(response));
+      // Input for a running program is not answered
+      if (response !== null) {
+        ws.send(JSON.stringify(response));
+      }
     } catch (error) {
       ws.send(
         JSON.stringify({
@@ -54,6 +108,8 @@ wss.on('connection', (ws: WebSocket) => {
 
   ws.on('close', () => {
     console.log('Client disconnected');
+    closeShellContext(shell).catch(() => undefined);
+    closeRunContext(run).catch(() => undefined);
   });
 
   ws.on('error', (error) => {
@@ -63,6 +119,7 @@ wss.on('connection', (ws: WebSocket) => {
 
 server.listen(PORT, () => {
   console.log(`WebSocket server listening on port ${PORT}`);
+  warmBuildTools();
 });
 
 const possibleGenixBotPaths = [
@@ -2,10 +2,13 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -15,6 +18,10 @@
 #define MAX_TOKENS 128
 #define MAX_STACK_SIZE 128
 #define ERROR_MESSAGE_SIZE 128
+#define CALC_CACHE_CAPACITY 64
+#define CALC_CACHE_BUCKETS 128
+#define CALC_BATCH_BLOCK 256
+#define MAX_NAME_LENGTH 7
 
 typedef enum {
     TOKEN_NUMBER,
@@ -22,20 +29,61 @@ typedef enum {
     TOKEN_LPAREN,
     TOKEN_RPAREN,
     TOKEN_FUNCTION,
+    TOKEN_VARIABLE,
     TOKEN_INVALID
 } TokenType;
 
+typedef enum {
+    FUNC_NONE,
+    FUNC_SIN,
+    FUNC_COS,
+    FUNC_TAN,
+    FUNC_LOG,
+    FUNC_SQRT,
+    FUNC_NEG
+} FunctionId;
+
 typedef struct {
     TokenType type;
     double value;
     char op;
-    char func[8];
+    FunctionId func;
+    unsigned char variable;
 } Token;
 
+typedef enum {
+    OP_PUSH,
+    OP_LOAD,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_FACT,
+    OP_SIN,
+    OP_COS,
+    OP_TAN,
+    OP_LOG,
+    OP_SQRT,
+    OP_NEG
+} Opcode;
+
+typedef struct {
+    char source[MAX_INPUT_LENGTH];
+    uint64_t hash;
+    CalcProgram program;
+    int bucket_next;
+    int lru_prev;
+    int lru_next;
+} CacheEntry;
+
 static void trim_trailing_newline(char *str);
-static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *error_message, size_t error_size);
+static int tokenize(const char *expr, const char *const *variables, size_t variable_count, Token *tokens,
+                    size_t *token_count, char *error_message, size_t error_size);
 static int to_rpn(const Token *tokens, size_t token_count, Token *output, size_t *output_count, char *error_message, size_t error_size);
-static int evaluate_rpn(const Token *tokens, size_t token_count, double *result, char *error_message, size_t error_size);
+static int compile_rpn(const Token *tokens, size_t token_count, CalcProgram *program, char *error_message, size_t error_size);
+static int apply_unary(Opcode opcode, double operand, double *result, char *error_message, size_t error_size);
+static int apply_binary(Opcode opcode, double lhs, double rhs, double *result, char *error_message, size_t error_size);
 static int precedence(char op);
 static bool is_right_associative(char op);
 static bool is_operator_token(const Token *token);
@@ -44,6 +92,15 @@ static double factorial(double n, int *error_flag);
 static double degrees_to_radians(double value);
 static void print_error(const char *message);
 
+// LRU cache of compiled programs; buckets hold entry index + 1 so zero means empty
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry cache_entries[CALC_CACHE_CAPACITY];
+static int cache_buckets[CALC_CACHE_BUCKETS];
+static size_t cache_used = 0;
+static int cache_lru_head = -1;
+static int cache_lru_tail = -1;
+static CalcCacheStats cache_counters = {0};
+
 void calculator_run(void) {
     char input[MAX_INPUT_LENGTH];
 
@@ -67,26 +124,10 @@ void calculator_run(void) {
             continue;
         }
 
-        Token tokens[MAX_TOKENS];
-        size_t token_count = 0;
-        char error_message[ERROR_MESSAGE_SIZE] = {0};
-
-        if (tokenize(input, tokens, &token_count, error_message, sizeof(error_message)) != 0) {
-            print_error(error_message);
-            continue;
-        }
-
-        Token rpn[MAX_TOKENS];
-        size_t rpn_count = 0;
-
-        if (to_rpn(tokens, token_count, rpn, &rpn_count, error_message, sizeof(error_message)) != 0) {
-            print_error(error_message);
-            continue;
-        }
-
+        CalcError error;
         double result = 0.0;
-        if (evaluate_rpn(rpn, rpn_count, &result, error_message, sizeof(error_message)) != 0) {
-            print_error(error_message);
+        if (calc_eval(input, &result, &error) != 0) {
+            print_error(error.message);
             continue;
         }
 
@@ -94,6 +135,18 @@ void calculator_run(void) {
     }
 }
 
+int calc_eval(const char *expression, double *result, CalcError *error) {
+    CalcError scratch;
+    CalcError *target = error != NULL ? error : &scratch;
+    CalcProgram program;
+    target->message[0] = '\0';
+
+    if (calc_compile_cached(expression, &program, target->message, sizeof(target->message)) != 0) {
+        return -1;
+    }
+    return calc_execute(&program, result, target->message, sizeof(target->message));
+}
+
 static void trim_trailing_newline(char *str) {
     size_t len = strlen(str);
     if (len > 0 && (str[len - 1] == '\n' || str[len - 1] == '\r')) {
@@ -101,18 +154,32 @@ static void trim_trailing_newline(char *str) {
     }
 }
 
-static bool is_function_name(const char *token, char *out_func) {
-    const char *functions[] = {"sin", "cos", "tan", "log", "sqrt", NULL};
-    for (int i = 0; functions[i] != NULL; ++i) {
-        if (strcmp(token, functions[i]) == 0) {
-            strcpy(out_func, functions[i]);
-            return true;
+static FunctionId lookup_function(const char *token) {
+    static const struct {
+        const char *name;
+        FunctionId id;
+    } functions[] = {
+        {"sin", FUNC_SIN}, {"cos", FUNC_COS}, {"tan", FUNC_TAN}, {"log", FUNC_LOG}, {"sqrt", FUNC_SQRT},
+    };
+    for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); ++i) {
+        if (strcmp(token, functions[i].name) == 0) {
+            return functions[i].id;
+        }
+    }
+    return FUNC_NONE;
+}
+
+static int lookup_variable(const char *token, const char *const *variables, size_t variable_count) {
+    for (size_t i = 0; i < variable_count; ++i) {
+        if (strcasecmp(token, variables[i]) == 0) {
+            return (int)i;
         }
     }
-    return false;
+    return -1;
 }
 
-static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *error_message, size_t error_size) {
+static int tokenize(const char *expr, const char *const *variables, size_t variable_count, Token *tokens,
+                    size_t *token_count, char *error_message, size_t error_size) {
     size_t len = strlen(expr);
     size_t idx = 0;
     TokenType last_type = TOKEN_INVALID;
@@ -139,7 +206,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
             tokens[*token_count].type = TOKEN_NUMBER;
             tokens[*token_count].value = value;
             tokens[*token_count].op = 0;
-            tokens[*token_count].func[0] = '\0';
+            tokens[*token_count].func = FUNC_NONE;
             (*token_count)++;
             idx = (size_t)(endptr - expr);
             last_type = TOKEN_NUMBER;
@@ -161,14 +228,16 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 tokens[*token_count].type = TOKEN_NUMBER;
                 tokens[*token_count].value = M_PI;
                 tokens[*token_count].op = 0;
-                tokens[*token_count].func[0] = '\0';
+                tokens[*token_count].func = FUNC_NONE;
                 (*token_count)++;
                 last_type = TOKEN_NUMBER;
                 continue;
             }
 
-            if (is_function_name(buffer, tokens[*token_count].func)) {
+            FunctionId function = lookup_function(buffer);
+            if (function != FUNC_NONE) {
                 tokens[*token_count].type = TOKEN_FUNCTION;
+                tokens[*token_count].func = function;
                 tokens[*token_count].value = 0.0;
                 tokens[*token_count].op = 0;
                 (*token_count)++;
@@ -176,6 +245,18 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 continue;
             }
 
+            int variable = lookup_variable(buffer, variables, variable_count);
+            if (variable >= 0) {
+                tokens[*token_count].type = TOKEN_VARIABLE;
+                tokens[*token_count].variable = (unsigned char)variable;
+                tokens[*token_count].value = 0.0;
+                tokens[*token_count].op = 0;
+                tokens[*token_count].func = FUNC_NONE;
+                (*token_count)++;
+                last_type = TOKEN_VARIABLE;
+                continue;
+            }
+
             snprintf(error_message, error_size, "Unknown token '%s' near position %zu.", buffer, start);
             return -1;
         }
@@ -187,7 +268,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                               last_type == TOKEN_LPAREN || last_type == TOKEN_FUNCTION);
                 if (unary && expr[idx] == '-') {
                     tokens[*token_count].type = TOKEN_FUNCTION;
-                    strcpy(tokens[*token_count].func, "neg");
+                    tokens[*token_count].func = FUNC_NEG;
                     tokens[*token_count].value = 0.0;
                     tokens[*token_count].op = 0;
                 } else if (unary && expr[idx] == '+') {
@@ -197,7 +278,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                     tokens[*token_count].type = TOKEN_OPERATOR;
                     tokens[*token_count].op = expr[idx];
                     tokens[*token_count].value = 0.0;
-                    tokens[*token_count].func[0] = '\0';
+                    tokens[*token_count].func = FUNC_NONE;
                 }
                 (*token_count)++;
                 idx++;
@@ -210,7 +291,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 tokens[*token_count].type = TOKEN_OPERATOR;
                 tokens[*token_count].op = expr[idx];
                 tokens[*token_count].value = 0.0;
-                tokens[*token_count].func[0] = '\0';
+                tokens[*token_count].func = FUNC_NONE;
                 (*token_count)++;
                 idx++;
                 last_type = TOKEN_OPERATOR;
@@ -220,7 +301,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 tokens[*token_count].type = TOKEN_OPERATOR;
                 tokens[*token_count].op = '!';
                 tokens[*token_count].value = 0.0;
-                tokens[*token_count].func[0] = '\0';
+                tokens[*token_count].func = FUNC_NONE;
                 (*token_count)++;
                 idx++;
                 last_type = TOKEN_OPERATOR;
@@ -230,7 +311,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 tokens[*token_count].type = TOKEN_LPAREN;
                 tokens[*token_count].op = 0;
                 tokens[*token_count].value = 0.0;
-                tokens[*token_count].func[0] = '\0';
+                tokens[*token_count].func = FUNC_NONE;
                 (*token_count)++;
                 idx++;
                 last_type = TOKEN_LPAREN;
@@ -239,7 +320,7 @@ static int tokenize(const char *expr, Token *tokens, size_t *token_count, char *
                 tokens[*token_count].type = TOKEN_RPAREN;
                 tokens[*token_count].op = 0;
                 tokens[*token_count].value = 0.0;
-                tokens[*token_count].func[0] = '\0';
+                tokens[*token_count].func = FUNC_NONE;
                 (*token_count)++;
                 idx++;
                 last_type = TOKEN_RPAREN;
@@ -290,7 +371,7 @@ static int to_rpn(const Token *tokens, size_t token_count, Token *output, size_t
     for (size_t i = 0; i < token_count; ++i) {
         const Token *token = &tokens[i];
 
-        if (token->type == TOKEN_NUMBER) {
+        if (token->type == TOKEN_NUMBER || token->type == TOKEN_VARIABLE) {
             if (*output_count >= MAX_TOKENS) {
                 snprintf(error_message, error_size, "Expression too complex.");
                 return -1;
@@ -407,127 +488,574 @@ static double degrees_to_radians(double value) {
     return value * (M_PI / 180.0);
 }
 
-static int evaluate_rpn(const Token *tokens, size_t token_count, double *result, char *error_message, size_t error_size) {
-    double stack[MAX_STACK_SIZE];
-    size_t stack_top = 0;
+int calc_compile(const char *expression, CalcProgram *program, char *error_message, size_t error_size) {
+    return calc_compile_vars(expression, NULL, 0, program, error_message, error_size);
+}
+
+int calc_compile_vars(const char *expression, const char *const *variables, size_t variable_count,
+                      CalcProgram *program, char *error_message, size_t error_size) {
+    if (variable_count > CALC_MAX_VARIABLES) {
+        snprintf(error_message, error_size, "Too many variables (max %d).", CALC_MAX_VARIABLES);
+        return -1;
+    }
+    for (size_t i = 0; i < variable_count; ++i) {
+        char name[MAX_NAME_LENGTH + 1] = {0};
+        size_t length = strlen(variables[i]);
+        bool valid = length > 0 && length <= MAX_NAME_LENGTH;
+        for (size_t c = 0; valid && c < length; ++c) {
+            valid = isalpha((unsigned char)variables[i][c]) != 0;
+            name[c] = (char)tolower((unsigned char)variables[i][c]);
+        }
+        if (!valid || strcmp(name, "pi") == 0 || lookup_function(name) != FUNC_NONE) {
+            snprintf(error_message, error_size, "Invalid variable name '%s'.", variables[i]);
+            return -1;
+        }
+    }
+
+    Token tokens[MAX_TOKENS];
+    size_t token_count = 0;
+    if (tokenize(expression, variables, variable_count, tokens, &token_count, error_message, error_size) != 0) {
+        return -1;
+    }
+
+    Token rpn[MAX_TOKENS];
+    size_t rpn_count = 0;
+    if (to_rpn(tokens, token_count, rpn, &rpn_count, error_message, error_size) != 0) {
+        return -1;
+    }
+
+    if (compile_rpn(rpn, rpn_count, program, error_message, error_size) != 0) {
+        return -1;
+    }
+    program->variable_count = variable_count;
+    return 0;
+}
+
+static Opcode opcode_for_token(const Token *token) {
+    if (token->type == TOKEN_FUNCTION) {
+        switch (token->func) {
+            case FUNC_SIN:
+                return OP_SIN;
+            case FUNC_COS:
+                return OP_COS;
+            case FUNC_TAN:
+                return OP_TAN;
+            case FUNC_LOG:
+                return OP_LOG;
+            case FUNC_SQRT:
+                return OP_SQRT;
+            default:
+                return OP_NEG;
+        }
+    }
+    switch (token->op) {
+        case '+':
+            return OP_ADD;
+        case '-':
+            return OP_SUB;
+        case '*':
+            return OP_MUL;
+        case '/':
+            return OP_DIV;
+        case '^':
+            return OP_POW;
+        default:
+            return OP_FACT;
+    }
+}
+
+static void emit_constant(CalcProgram *program, double value) {
+    program->constants[program->constant_count] = value;
+    program->code[program->length].opcode = OP_PUSH;
+    program->code[program->length].operand = (unsigned char)program->constant_count;
+    program->constant_count++;
+    program->length++;
+}
+
+// Stack discipline guarantees the last instruction produced the top of the
+// stack, so constant operands are always trailing PUSH instructions.
+static bool trailing_constants(const CalcProgram *program, size_t count) {
+    if (program->length < count) {
+        return false;
+    }
+    for (size_t i = program->length - count; i < program->length; ++i) {
+        if (program->code[i].opcode != OP_PUSH) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double pop_constant(CalcProgram *program) {
+    program->length--;
+    program->constant_count--;
+    return program->constants[program->constant_count];
+}
+
+static int compile_rpn(const Token *tokens, size_t token_count, CalcProgram *program, char *error_message, size_t error_size) {
+    char fold_error[ERROR_MESSAGE_SIZE];
+    size_t depth = 0;
+    program->length = 0;
+    program->constant_count = 0;
+    program->stack_depth = 0;
 
     for (size_t i = 0; i < token_count; ++i) {
         const Token *token = &tokens[i];
 
-        if (token->type == TOKEN_NUMBER) {
-            if (stack_top >= MAX_STACK_SIZE) {
+        if (token->type == TOKEN_NUMBER || token->type == TOKEN_VARIABLE) {
+            if (depth >= MAX_STACK_SIZE) {
                 snprintf(error_message, error_size, "Evaluation stack overflow.");
                 return -1;
             }
-            stack[stack_top++] = token->value;
-        } else if (is_operator_token(token)) {
-            if (token->op == '!') {
-                if (stack_top < 1) {
-                    snprintf(error_message, error_size, "Factorial requires an operand.");
-                    return -1;
-                }
-                double operand = stack[stack_top - 1];
-                int error_flag = 0;
-                double value = factorial(operand, &error_flag);
-                if (error_flag) {
-                    snprintf(error_message, error_size, "Invalid input for factorial.");
-                    return -1;
-                }
-                stack[stack_top - 1] = value;
-                continue;
+            if (token->type == TOKEN_VARIABLE) {
+                program->code[program->length].opcode = OP_LOAD;
+                program->code[program->length].operand = token->variable;
+                program->length++;
+            } else {
+                emit_constant(program, token->value);
+            }
+            if (++depth > program->stack_depth) {
+                program->stack_depth = depth;
             }
+            continue;
+        }
+
+        if (token->type != TOKEN_OPERATOR && token->type != TOKEN_FUNCTION) {
+            snprintf(error_message, error_size, "Invalid token during evaluation.");
+            return -1;
+        }
 
-            if (stack_top < 2) {
+        Opcode opcode = opcode_for_token(token);
+        bool unary = token->type == TOKEN_FUNCTION || opcode == OP_FACT;
+
+        if (unary) {
+            if (depth < 1) {
+                snprintf(error_message, error_size,
+                         opcode == OP_FACT ? "Factorial requires an operand." : "Function requires an operand.");
+                return -1;
+            }
+            if (trailing_constants(program, 1)) {
+                double operand = program->constants[program->constant_count - 1];
+                double value = 0.0;
+                // Leave failing folds to runtime so the error surfaces as before
+                if (apply_unary(opcode, operand, &value, fold_error, sizeof(fold_error)) == 0) {
+                    pop_constant(program);
+                    emit_constant(program, value);
+                    continue;
+                }
+            }
+        } else {
+            if (depth < 2) {
                 snprintf(error_message, error_size, "Operator '%c' missing operands.", token->op);
                 return -1;
             }
+            if (trailing_constants(program, 2)) {
+                double rhs = program->constants[program->constant_count - 1];
+                double lhs = program->constants[program->constant_count - 2];
+                double value = 0.0;
+                if (apply_binary(opcode, lhs, rhs, &value, fold_error, sizeof(fold_error)) == 0) {
+                    pop_constant(program);
+                    pop_constant(program);
+                    emit_constant(program, value);
+                    depth--;
+                    continue;
+                }
+            }
+            depth--;
+        }
 
-            double rhs = stack[--stack_top];
-            double lhs = stack[stack_top - 1];
-            double value = 0.0;
+        program->code[program->length].opcode = (unsigned char)opcode;
+        program->code[program->length].operand = 0;
+        program->length++;
+    }
 
-            switch (token->op) {
-                case '+':
-                    value = lhs + rhs;
-                    break;
-                case '-':
-                    value = lhs - rhs;
-                    break;
-                case '*':
-                    value = lhs * rhs;
-                    break;
-                case '/':
-                    if (fabs(rhs) < 1e-12) {
-                        snprintf(error_message, error_size, "Division by zero.");
-                        return -1;
-                    }
-                    value = lhs / rhs;
-                    break;
-                case '^':
-                    value = pow(lhs, rhs);
-                    break;
-                default:
-                    snprintf(error_message, error_size, "Unknown operator '%c'.", token->op);
-                    return -1;
+    if (depth != 1) {
+        snprintf(error_message, error_size, "Invalid expression.");
+        return -1;
+    }
+    return 0;
+}
+
+static int apply_unary(Opcode opcode, double operand, double *result, char *error_message, size_t error_size) {
+    switch (opcode) {
+        case OP_FACT: {
+            int error_flag = 0;
+            *result = factorial(operand, &error_flag);
+            if (error_flag) {
+                snprintf(error_message, error_size, "Invalid input for factorial.");
+                return -1;
+            }
+            return 0;
+        }
+        case OP_SIN:
+            *result = sin(degrees_to_radians(operand));
+            return 0;
+        case OP_COS:
+            *result = cos(degrees_to_radians(operand));
+            return 0;
+        case OP_TAN: {
+            double radians = degrees_to_radians(operand);
+            if (fabs(cos(radians)) < 1e-12) {
+                snprintf(error_message, error_size, "Undefined tangent for %.4f degrees.", operand);
+                return -1;
+            }
+            *result = tan(radians);
+            return 0;
+        }
+        case OP_LOG:
+            if (operand <= 0.0) {
+                snprintf(error_message, error_size, "Logarithm domain error.");
+                return -1;
             }
+            *result = log(operand);
+            return 0;
+        case OP_SQRT:
+            if (operand < 0.0) {
+                snprintf(error_message, error_size, "Square root of negative number.");
+                return -1;
+            }
+            *result = sqrt(operand);
+            return 0;
+        case OP_NEG:
+            *result = -operand;
+            return 0;
+        default:
+            snprintf(error_message, error_size, "Invalid token during evaluation.");
+            return -1;
+    }
+}
 
-            stack[stack_top - 1] = value;
-        } else if (is_function_token(token)) {
-            if (stack_top < 1) {
-                snprintf(error_message, error_size, "Function requires an operand.");
+static int apply_binary(Opcode opcode, double lhs, double rhs, double *result, char *error_message, size_t error_size) {
+    switch (opcode) {
+        case OP_ADD:
+            *result = lhs + rhs;
+            return 0;
+        case OP_SUB:
+            *result = lhs - rhs;
+            return 0;
+        case OP_MUL:
+            *result = lhs * rhs;
+            return 0;
+        case OP_DIV:
+            if (fabs(rhs) < 1e-12) {
+                snprintf(error_message, error_size, "Division by zero.");
                 return -1;
             }
+            *result = lhs / rhs;
+            return 0;
+        case OP_POW:
+            *result = pow(lhs, rhs);
+            return 0;
+        default:
+            snprintf(error_message, error_size, "Invalid token during evaluation.");
+            return -1;
+    }
+}
+
+int calc_execute(const CalcProgram *program, double *result, char *error_message, size_t error_size) {
+    double stack[MAX_STACK_SIZE];
+    size_t top = 0;
 
-            double operand = stack[stack_top - 1];
-            double value = 0.0;
+    if (program->variable_count > 0) {
+        snprintf(error_message, error_size, "Expression uses variables; evaluate it with calc_execute_batch.");
+        return -1;
+    }
 
-            if (strcmp(token->func, "sin") == 0) {
-                value = sin(degrees_to_radians(operand));
-            } else if (strcmp(token->func, "cos") == 0) {
-                value = cos(degrees_to_radians(operand));
-            } else if (strcmp(token->func, "tan") == 0) {
-                double radians = degrees_to_radians(operand);
-                double cosine = cos(radians);
-                if (fabs(cosine) < 1e-12) {
-                    snprintf(error_message, error_size, "Undefined tangent for %.4f degrees.", operand);
+    for (size_t i = 0; i < program->length; ++i) {
+        const CalcInstruction instruction = program->code[i];
+        switch (instruction.opcode) {
+            case OP_PUSH:
+                stack[top++] = program->constants[instruction.operand];
+                break;
+            case OP_ADD:
+                --top;
+                stack[top - 1] += stack[top];
+                break;
+            case OP_SUB:
+                --top;
+                stack[top - 1] -= stack[top];
+                break;
+            case OP_MUL:
+                --top;
+                stack[top - 1] *= stack[top];
+                break;
+            case OP_DIV:
+            case OP_POW:
+                --top;
+                if (apply_binary((Opcode)instruction.opcode, stack[top - 1], stack[top], &stack[top - 1], error_message,
+                                 error_size) != 0) {
                     return -1;
                 }
-                value = tan(radians);
-            } else if (strcmp(token->func, "log") == 0) {
-                if (operand <= 0.0) {
-                    snprintf(error_message, error_size, "Logarithm domain error.");
+                break;
+            case OP_NEG:
+                stack[top - 1] = -stack[top - 1];
+                break;
+            default:
+                if (apply_unary((Opcode)instruction.opcode, stack[top - 1], &stack[top - 1], error_message, error_size) != 0) {
                     return -1;
                 }
-                value = log(operand);
-            } else if (strcmp(token->func, "sqrt") == 0) {
-                if (operand < 0.0) {
-                    snprintf(error_message, error_size, "Square root of negative number.");
-                    return -1;
+                break;
+        }
+    }
+
+    *result = stack[0];
+    return 0;
+}
+
+// Batch kernels: one pass over a block per instruction. Operands may alias
+// the output, which is safe because every loop is strictly element-wise.
+static void fill_block(double *out, double value, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = value;
+    }
+}
+
+static void binary_block(Opcode opcode, double *out, const double *lhs, const double *rhs, size_t n) {
+    switch (opcode) {
+        case OP_ADD:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = lhs[i] + rhs[i];
+            }
+            break;
+        case OP_SUB:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = lhs[i] - rhs[i];
+            }
+            break;
+        case OP_MUL:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = lhs[i] * rhs[i];
+            }
+            break;
+        case OP_DIV:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = fabs(rhs[i]) < 1e-12 ? NAN : lhs[i] / rhs[i];
+            }
+            break;
+        default:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = pow(lhs[i], rhs[i]);
+            }
+            break;
+    }
+}
+
+static void unary_block(Opcode opcode, double *out, const double *in, size_t n) {
+    const double scale = M_PI / 180.0;
+    switch (opcode) {
+        case OP_NEG:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = -in[i];
+            }
+            break;
+        case OP_SIN:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = sin(in[i] * scale);
+            }
+            break;
+        case OP_COS:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = cos(in[i] * scale);
+            }
+            break;
+        case OP_TAN:
+            for (size_t i = 0; i < n; ++i) {
+                double radians = in[i] * scale;
+                out[i] = fabs(cos(radians)) < 1e-12 ? NAN : tan(radians);
+            }
+            break;
+        case OP_LOG:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = in[i] <= 0.0 ? NAN : log(in[i]);
+            }
+            break;
+        case OP_SQRT:
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = in[i] < 0.0 ? NAN : sqrt(in[i]);
+            }
+            break;
+        default:
+            for (size_t i = 0; i < n; ++i) {
+                int error_flag = 0;
+                double value = factorial(in[i], &error_flag);
+                out[i] = error_flag ? NAN : value;
+            }
+            break;
+    }
+}
+
+int calc_execute_batch(const CalcProgram *program, const double *const *columns, size_t rows, double *results,
+                       char *error_message, size_t error_size) {
+    // Slot k of the evaluation stack is a block of rows. Loads point straight
+    // into the caller's column instead of copying it.
+    const double *slots[MAX_STACK_SIZE];
+    double *scratch = (double *)malloc(program->stack_depth * CALC_BATCH_BLOCK * sizeof(double));
+    if (scratch == NULL) {
+        snprintf(error_message, error_size, "Out of memory.");
+        return -1;
+    }
+
+    for (size_t start = 0; start < rows; start += CALC_BATCH_BLOCK) {
+        size_t n = rows - start < CALC_BATCH_BLOCK ? rows - start : CALC_BATCH_BLOCK;
+        size_t top = 0;
+
+        for (size_t i = 0; i < program->length; ++i) {
+            const CalcInstruction instruction = program->code[i];
+            switch (instruction.opcode) {
+                case OP_PUSH: {
+                    double *out = scratch + top * CALC_BATCH_BLOCK;
+                    fill_block(out, program->constants[instruction.operand], n);
+                    slots[top++] = out;
+                    break;
+                }
+                case OP_LOAD:
+                    slots[top++] = columns[instruction.operand] + start;
+                    break;
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV:
+                case OP_POW: {
+                    --top;
+                    double *out = scratch + (top - 1) * CALC_BATCH_BLOCK;
+                    binary_block((Opcode)instruction.opcode, out, slots[top - 1], slots[top], n);
+                    slots[top - 1] = out;
+                    break;
+                }
+                default: {
+                    double *out = scratch + (top - 1) * CALC_BATCH_BLOCK;
+                    unary_block((Opcode)instruction.opcode, out, slots[top - 1], n);
+                    slots[top - 1] = out;
+                    break;
                 }
-                value = sqrt(operand);
-            } else if (strcmp(token->func, "neg") == 0) {
-                value = -operand;
-            } else {
-                snprintf(error_message, error_size, "Unknown function '%s'.", token->func);
-                return -1;
             }
+        }
 
-            stack[stack_top - 1] = value;
-        } else {
-            snprintf(error_message, error_size, "Invalid token during evaluation.");
-            return -1;
+        memcpy(results + start, slots[0], n * sizeof(double));
+    }
+
+    free(scratch);
+    return 0;
+}
+
+static uint64_t hash_source(const char *text) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void cache_unlink_lru(int index) {
+    CacheEntry *entry = &cache_entries[index];
+    if (entry->lru_prev >= 0) {
+        cache_entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        cache_lru_head = entry->lru_next;
+    }
+    if (entry->lru_next >= 0) {
+        cache_entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        cache_lru_tail = entry->lru_prev;
+    }
+}
+
+static void cache_push_front(int index) {
+    CacheEntry *entry = &cache_entries[index];
+    entry->lru_prev = -1;
+    entry->lru_next = cache_lru_head;
+    if (cache_lru_head >= 0) {
+        cache_entries[cache_lru_head].lru_prev = index;
+    }
+    cache_lru_head = index;
+    if (cache_lru_tail < 0) {
+        cache_lru_tail = index;
+    }
+}
+
+static int cache_find(const char *source, uint64_t hash) {
+    int index = cache_buckets[hash % CALC_CACHE_BUCKETS] - 1;
+    while (index >= 0) {
+        const CacheEntry *entry = &cache_entries[index];
+        if (entry->hash == hash && strcmp(entry->source, source) == 0) {
+            return index;
         }
+        index = entry->bucket_next;
     }
+    return -1;
+}
 
-    if (stack_top != 1) {
-        snprintf(error_message, error_size, "Invalid expression.");
+static void cache_remove_from_bucket(int index) {
+    size_t bucket = cache_entries[index].hash % CALC_CACHE_BUCKETS;
+    int current = cache_buckets[bucket] - 1;
+    if (current == index) {
+        cache_buckets[bucket] = cache_entries[index].bucket_next + 1;
+        return;
+    }
+    while (current >= 0) {
+        if (cache_entries[current].bucket_next == index) {
+            cache_entries[current].bucket_next = cache_entries[index].bucket_next;
+            return;
+        }
+        current = cache_entries[current].bucket_next;
+    }
+}
+
+int calc_compile_cached(const char *expression, CalcProgram *program, char *error_message, size_t error_size) {
+    size_t length = strlen(expression);
+    if (length >= MAX_INPUT_LENGTH) {
+        return calc_compile(expression, program, error_message, error_size);
+    }
+    uint64_t hash = hash_source(expression);
+
+    pthread_mutex_lock(&cache_mutex);
+    int index = cache_find(expression, hash);
+    if (index >= 0) {
+        *program = cache_entries[index].program;
+        cache_unlink_lru(index);
+        cache_push_front(index);
+        cache_counters.hits++;
+        pthread_mutex_unlock(&cache_mutex);
+        return 0;
+    }
+    cache_counters.misses++;
+    pthread_mutex_unlock(&cache_mutex);
+
+    // Compile outside the lock; failed compiles are not cached
+    if (calc_compile(expression, program, error_message, error_size) != 0) {
         return -1;
     }
 
-    *result = stack[0];
+    pthread_mutex_lock(&cache_mutex);
+    if (cache_find(expression, hash) < 0) {
+        if (cache_used < CALC_CACHE_CAPACITY) {
+            index = (int)cache_used++;
+        } else {
+            index = cache_lru_tail;
+            cache_unlink_lru(index);
+            cache_remove_from_bucket(index);
+            cache_counters.evictions++;
+        }
+        CacheEntry *entry = &cache_entries[index];
+        memcpy(entry->source, expression, length + 1);
+        entry->hash = hash;
+        entry->program = *program;
+        entry->bucket_next = cache_buckets[hash % CALC_CACHE_BUCKETS] - 1;
+        cache_buckets[hash % CALC_CACHE_BUCKETS] = index + 1;
+        cache_push_front(index);
+    }
+    pthread_mutex_unlock(&cache_mutex);
     return 0;
 }
 
+void calc_cache_stats(CalcCacheStats *stats) {
+    pthread_mutex_lock(&cache_mutex);
+    *stats = cache_counters;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
 static void print_error(const char *message) {
     fprintf(stderr, "Error: %s\n", message);
 }
@@ -1,11 +1,90 @@
 #ifndef APPS_CALCULATOR_CALCULATOR_H
 #define APPS_CALCULATOR_CALCULATOR_H
 
+#include <stddef.h>
+
+#define CALC_MAX_PROGRAM 128
+#define CALC_MAX_VARIABLES 8
+#define CALC_ERROR_SIZE 128
+
+/**
+ * Compiled expression: a compact stack-machine program produced once by
+ * calc_compile() and executed any number of times by calc_execute().
+ * Constant subexpressions are folded at compile time.
+ */
+typedef struct {
+    unsigned char opcode;
+    unsigned char operand;
+} CalcInstruction;
+
+typedef struct {
+    CalcInstruction code[CALC_MAX_PROGRAM];
+    double constants[CALC_MAX_PROGRAM];
+    size_t length;
+    size_t constant_count;
+    size_t stack_depth;
+    size_t variable_count;
+} CalcProgram;
+
+typedef struct {
+    char message[CALC_ERROR_SIZE];
+} CalcError;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} CalcCacheStats;
+
 /**
  * Scientific calculator application entry point.
  * Provides a CLI loop for evaluating arithmetic and scientific expressions.
  */
 void calculator_run(void);
 
-#endif /* APPS_CALCULATOR_CALCULATOR_H */
+/**
+ * Evaluates one expression, e.g. "2+3*4" or "sqrt(16)^2". Returns 0 and
+ * stores the value in `result`, or -1 with a message in `error` (which may
+ * be NULL). Reentrant and allocation-free: all working state lives on the
+ * caller's stack plus the shared, mutex-guarded compile cache, so it is safe
+ * to call from many threads at once.
+ */
+int calc_eval(const char *expression, double *result, CalcError *error);
 
+/**
+ * Compiles `expression` into `program`. Returns 0 on success, or -1 with a
+ * message in `error_message`.
+ */
+int calc_compile(const char *expression, CalcProgram *program, char *error_message, size_t error_size);
+
+/**
+ * Like calc_compile(), but consults an LRU cache of compiled programs keyed
+ * by source text first, so repeated expressions skip parsing entirely.
+ * Safe to call from multiple threads.
+ */
+int calc_compile_cached(const char *expression, CalcProgram *program, char *error_message, size_t error_size);
+
+int calc_execute(const CalcProgram *program, double *result, char *error_message, size_t error_size);
+void calc_cache_stats(CalcCacheStats *stats);
+
+/**
+ * Compiles an expression over named variables, e.g. "sin(x)*y+2" with
+ * variables {"x", "y"}. Names are matched case-insensitively and must not
+ * collide with function names; a variable's index in `variables` is the
+ * column it reads in calc_execute_batch().
+ */
+int calc_compile_vars(const char *expression, const char *const *variables, size_t variable_count,
+                      CalcProgram *program, char *error_message, size_t error_size);
+
+/**
+ * Evaluates `program` for `rows` rows in one call. `columns[i]` holds the
+ * values of variable i (struct-of-arrays); results go to `results[row]`.
+ * Rows are processed in fixed-size blocks, one tight loop per instruction,
+ * so arithmetic vectorizes. Domain errors (division by zero, log of a
+ * non-positive number, ...) yield NaN for that row instead of failing the
+ * batch. Returns 0, or -1 only if scratch memory cannot be allocated.
+ */
+int calc_execute_batch(const CalcProgram *program, const double *const *columns, size_t rows, double *results,
+                       char *error_message, size_t error_size);
+
+#endif /* APPS_CALCULATOR_CALCULATOR_H */
@@ -3,6 +3,7 @@
 #include "../../vfs.h"
 
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,53 +11,66 @@
 #include <time.h>
 
 #define EVENTS_STORAGE_PATH "home/user/events.txt"
-#define MAX_DESCRIPTION_LENGTH 128
+#define EVENTS_JOURNAL_PATH "home/user/events.journal"
+#define GENERATION_PREFIX "#generation "
+#define JOURNAL_RECORD_SIZE (CALENDAR_DESCRIPTION_LENGTH + 64)
+#define JOURNAL_COMPACT_MIN 256
 #define INPUT_BUFFER_SIZE 256
 #define INITIAL_EVENT_CAPACITY 16
-#define SAVE_BUFFER_SIZE 8192
+#define MAX_DAY_MATCHES 16
+#define MONTH_GRID_SIZE 512
 
 typedef struct {
-    int year;
-    int month;
-    int day;
-    char description[MAX_DESCRIPTION_LENGTH];
-} CalendarEvent;
-
+    long key;
+    size_t index;
+} EventSortKey;
+
+/**
+ * Changes since the last snapshot are appended to the journal as one line
+ * each ("+date|text" add, "~date#n|text" edit, "-date#n|" delete, where n
+ * is the event's position among that day's events). Snapshot and journal
+ * both start with a generation line; a journal only applies to the snapshot
+ * of the same generation, so a crash mid-compaction never replays twice.
+ */
 typedef struct {
-    CalendarEvent *items;
-    size_t count;
-    size_t capacity;
-} EventList;
-
-#if defined(_WIN32) || defined(_WIN64)
-#define STRTOK(buffer, delimiters, context) strtok_s((buffer), (delimiters), (context))
-#else
-#define STRTOK(buffer, delimiters, context) strtok_r((buffer), (delimiters), (context))
-#endif
-
-static void event_list_init(EventList *list);
-static void event_list_free(EventList *list);
-static bool event_list_reserve(EventList *list, size_t desired_capacity);
-static bool event_list_append(EventList *list, const CalendarEvent *event);
-static void load_events(EventList *list);
-static void save_events(const EventList *list);
-static void display_calendar(int year, int month, const EventList *list);
+    unsigned long generation;
+    size_t records;
+} EventJournal;
+
+static bool event_list_reserve(CalendarEventList *list, size_t desired_capacity);
+static bool event_list_append(CalendarEventList *list, const CalendarEvent *event);
+static void event_list_sort(CalendarEventList *list);
+static long event_key(int year, int month, int day);
+static size_t event_lower_bound(const CalendarEventList *list, long key);
+static void event_list_remove(CalendarEventList *list, size_t index);
+static void load_events(CalendarEventList *list, EventJournal *journal);
+static bool save_events(const CalendarEventList *list, unsigned long generation);
+static bool parse_event_field(const char **cursor, const char *end, char terminator, int *value);
+static bool parse_event_line(const char *line, size_t length, CalendarEvent *event);
+static bool valid_event_date(int year, int month, int day);
+static void set_description(CalendarEvent *event, const char *text, size_t length);
+static bool parse_generation_line(const char *line, size_t length, unsigned long *generation);
+static void replay_journal(CalendarEventList *list, const EventJournal *journal, size_t *records);
+static void journal_record(CalendarEventList *list, EventJournal *journal, const char *format, ...);
+static void compact_events(const CalendarEventList *list, EventJournal *journal);
+static void display_calendar(int year, int month, const CalendarEventList *list);
 static int days_in_month(int year, int month);
 static bool is_leap_year(int year);
-static const CalendarEvent *find_event_for_day(const EventList *list, int year, int month, int day, size_t *indices, size_t *match_count);
-static void list_events_for_month(const EventList *list, int year, int month);
-static void add_event(EventList *list, int default_year, int default_month);
-static void edit_event(EventList *list);
-static void delete_event(EventList *list);
+static const CalendarEvent *find_event_for_day(const CalendarEventList *list, int year, int month, int day, size_t *indices, size_t *match_count);
+static void list_events_for_month(const CalendarEventList *list, int year, int month);
+static void add_event(CalendarEventList *list, EventJournal *journal, int default_year, int default_month);
+static void edit_event(CalendarEventList *list, EventJournal *journal);
+static void delete_event(CalendarEventList *list, EventJournal *journal);
 static bool parse_date(const char *input, int *year, int *month, int *day);
 static void to_lowercase(char *str);
 static int parse_month_token(const char *token);
-static void view_events(const EventList *list, int year, int month, const char *arg);
+static void view_events(const CalendarEventList *list, int year, int month, const char *arg);
 
 void calendar_run(void) {
-    EventList events;
-    event_list_init(&events);
-    load_events(&events);
+    CalendarEventList events;
+    EventJournal journal;
+    calendar_events_init(&events);
+    load_events(&events, &journal);
 
     time_t now = time(NULL);
     struct tm local_time;
@@ -139,18 +153,15 @@ void calendar_run(void) {
             display_calendar(current_year, current_month, &events);
             list_events_for_month(&events, current_year, current_month);
         } else if (strcmp(token, "add") == 0) {
-            add_event(&events, current_year, current_month);
-            save_events(&events);
+            add_event(&events, &journal, current_year, current_month);
             display_calendar(current_year, current_month, &events);
             list_events_for_month(&events, current_year, current_month);
         } else if (strcmp(token, "edit") == 0) {
-            edit_event(&events);
-            save_events(&events);
+            edit_event(&events, &journal);
             display_calendar(current_year, current_month, &events);
             list_events_for_month(&events, current_year, current_month);
         } else if (strcmp(token, "delete") == 0) {
-            delete_event(&events);
-            save_events(&events);
+            delete_event(&events, &journal);
             display_calendar(current_year, current_month, &events);
             list_events_for_month(&events, current_year, current_month);
         } else if (strcmp(token, "view") == 0) {
@@ -161,23 +172,23 @@ void calendar_run(void) {
         }
     }
 
-    event_list_free(&events);
+    calendar_events_free(&events);
 }
 
-static void event_list_init(EventList *list) {
+void calendar_events_init(CalendarEventList *list) {
     list->items = NULL;
     list->count = 0;
     list->capacity = 0;
 }
 
-static void event_list_free(EventList *list) {
+void calendar_events_free(CalendarEventList *list) {
     free(list->items);
     list->items = NULL;
     list->count = 0;
     list->capacity = 0;
 }
 
-static bool event_list_reserve(EventList *list, size_t desired_capacity) {
+static bool event_list_reserve(CalendarEventList *list, size_t desired_capacity) {
     if (desired_capacity <= list->capacity) {
         return true;
     }
@@ -195,7 +206,7 @@ static bool event_list_reserve(EventList *list, size_t desired_capacity) {
     return true;
 }
 
-static bool event_list_append(EventList *list, const CalendarEvent *event) {
+static bool event_list_append(CalendarEventList *list, const CalendarEvent *event) {
     if (!event_list_reserve(list, list->count + 1)) {
         return false;
     }
@@ -203,58 +214,324 @@ static bool event_list_append(EventList *list, const CalendarEvent *event) {
     return true;
 }
 
-static void load_events(EventList *list) {
-    char buffer[SAVE_BUFFER_SIZE];
-    if (vfs_read(EVENTS_STORAGE_PATH, buffer, sizeof(buffer)) != 0) {
+static void event_list_remove(CalendarEventList *list, size_t index) {
+    memmove(&list->items[index], &list->items[index + 1], (list->count - index - 1) * sizeof(CalendarEvent));
+    list->count--;
+}
+
+bool calendar_events_insert(CalendarEventList *list, const CalendarEvent *event) {
+    if (!event_list_reserve(list, list->count + 1)) {
+        return false;
+    }
+    // Insert after any events already on that day to keep their order
+    size_t position = event_lower_bound(list, event_key(event->year, event->month, event->day) + 1);
+    memmove(&list->items[position + 1], &list->items[position], (list->count - position) * sizeof(CalendarEvent));
+    list->items[position] = *event;
+    list->count++;
+    return true;
+}
+
+size_t calendar_events_range(const CalendarEventList *list, int year, int month, int day, size_t *first) {
+    long key = event_key(year, month, day);
+    size_t begin = event_lower_bound(list, key);
+    // Days run 1..31, so day 0 and day 32 bracket the whole month
+    size_t end = event_lower_bound(list, day == 0 ? event_key(year, month, 32) : key + 1);
+    *first = begin;
+    return end - begin;
+}
+
+static long event_key(int year, int month, int day) {
+    return ((long)year * 16 + month) * 64 + day;
+}
+
+static size_t event_lower_bound(const CalendarEventList *list, long key) {
+    size_t low = 0;
+    size_t high = list->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const CalendarEvent *event = &list->items[mid];
+        if (event_key(event->year, event->month, event->day) < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int compare_sort_keys(const void *lhs, const void *rhs) {
+    const EventSortKey *a = (const EventSortKey *)lhs;
+    const EventSortKey *b = (const EventSortKey *)rhs;
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+    return a->index < b->index ? -1 : (a->index > b->index ? 1 : 0);
+}
+
+// Stable sort by date; ties keep file order
+static void event_list_sort(CalendarEventList *list) {
+    EventSortKey *keys = (EventSortKey *)malloc(list->count * sizeof(EventSortKey));
+    CalendarEvent *sorted = (CalendarEvent *)malloc(list->capacity * sizeof(CalendarEvent));
+    if (keys == NULL || sorted == NULL) {
+        free(keys);
+        free(sorted);
+        return;
+    }
+    for (size_t i = 0; i < list->count; ++i) {
+        const CalendarEvent *event = &list->items[i];
+        keys[i].key = event_key(event->year, event->month, event->day);
+        keys[i].index = i;
+    }
+    qsort(keys, list->count, sizeof(EventSortKey), compare_sort_keys);
+    for (size_t i = 0; i < list->count; ++i) {
+        sorted[i] = list->items[keys[i].index];
+    }
+    free(keys);
+    free(list->items);
+    list->items = sorted;
+}
+
+static void load_events(CalendarEventList *list, EventJournal *journal) {
+    journal->generation = 0;
+    journal->records = 0;
+
+    VfsView view;
+    if (vfs_map(EVENTS_STORAGE_PATH, &view) != 0) {
+        // No snapshot yet: the journal applies to an empty generation 0
+        replay_journal(list, journal, &journal->records);
         return;
     }
 
-    char *context = NULL;
-    char *line = STRTOK(buffer, "\n", &context);
-    while (line != NULL) {
-        if (line[0] != '\0') {
-            CalendarEvent event;
-            char description[MAX_DESCRIPTION_LENGTH] = {0};
-            if (sscanf(line, "%d-%d-%d|%127[^\n]", &event.year, &event.month, &event.day, description) == 4) {
-                strncpy(event.description, description, sizeof(event.description) - 1);
-                event.description[sizeof(event.description) - 1] = '\0';
-                event_list_append(list, &event);
-            }
+    const char *cursor = view.data;
+    const char *end = view.data + view.size;
+    long previous_key = 0;
+    bool sorted = true;
+    while (cursor < end) {
+        const char *newline = (const char *)memchr(cursor, '\n', (size_t)(end - cursor));
+        const char *line_end = newline != NULL ? newline : end;
+        CalendarEvent event;
+        if (cursor == view.data) {
+            parse_generation_line(cursor, (size_t)(line_end - cursor), &journal->generation);
+        }
+        if (parse_event_line(cursor, (size_t)(line_end - cursor), &event) && event_list_append(list, &event)) {
+            long key = event_key(event.year, event.month, event.day);
+            sorted = sorted && key >= previous_key;
+            previous_key = key;
         }
-        line = STRTOK(NULL, "\n", &context);
+        cursor = line_end + 1;
+    }
+
+    vfs_release(&view);
+
+    // Saved files are already in date order; only hand-edited ones need sorting
+    if (!sorted) {
+        event_list_sort(list);
+    }
+
+    replay_journal(list, journal, &journal->records);
+}
+
+static bool parse_generation_line(const char *line, size_t length, unsigned long *generation) {
+    size_t prefix_length = strlen(GENERATION_PREFIX);
+    if (length <= prefix_length || memcmp(line, GENERATION_PREFIX, prefix_length) != 0) {
+        return false;
     }
+    unsigned long value = 0;
+    for (size_t i = prefix_length; i < length && isdigit((unsigned char)line[i]); ++i) {
+        value = value * 10 + (unsigned long)(line[i] - '0');
+    }
+    *generation = value;
+    return true;
 }
 
-static void save_events(const EventList *list) {
-    size_t buffer_capacity = SAVE_BUFFER_SIZE;
-    if (list->count * (MAX_DESCRIPTION_LENGTH + 16) > buffer_capacity) {
-        buffer_capacity = list->count * (MAX_DESCRIPTION_LENGTH + 16);
+static void replay_journal(CalendarEventList *list, const EventJournal *journal, size_t *records) {
+    VfsView view;
+    if (vfs_map(EVENTS_JOURNAL_PATH, &view) != 0) {
+        return;
     }
 
-    char *buffer = (char *)calloc(buffer_capacity, sizeof(char));
-    if (buffer == NULL) {
-        printf("Failed to allocate memory while saving events.\n");
+    const char *cursor = view.data;
+    const char *end = view.data + view.size;
+    const char *newline = (const char *)memchr(cursor, '\n', view.size);
+    unsigned long generation = 0;
+    if (newline == NULL || !parse_generation_line(cursor, (size_t)(newline - cursor), &generation) ||
+        generation != journal->generation) {
+        // Left over from before the last compaction; the snapshot already has it
+        vfs_release(&view);
         return;
     }
+    cursor = newline + 1;
+
+    // A record without its newline was torn by a crash and never acknowledged
+    while (cursor < end && (newline = (const char *)memchr(cursor, '\n', (size_t)(end - cursor))) != NULL) {
+        char op = *cursor;
+        const char *body = cursor + 1;
+        const char *body_end = newline;
+        cursor = newline + 1;
+
+        CalendarEvent event;
+        if (op == '+') {
+            if (parse_event_line(body, (size_t)(body_end - body), &event)) {
+                calendar_events_insert(list, &event);
+                (*records)++;
+            }
+            continue;
+        }
+
+        int ordinal = 0;
+        if ((op != '~' && op != '-') || !parse_event_field(&body, body_end, '-', &event.year) ||
+            !parse_event_field(&body, body_end, '-', &event.month) ||
+            !parse_event_field(&body, body_end, '#', &event.day) ||
+            !parse_event_field(&body, body_end, '|', &ordinal) ||
+            !valid_event_date(event.year, event.month, event.day)) {
+            continue;
+        }
+        size_t first = 0;
+        size_t count = calendar_events_range(list, event.year, event.month, event.day, &first);
+        if (ordinal < 0 || (size_t)ordinal >= count) {
+            continue;
+        }
+        if (op == '-') {
+            event_list_remove(list, first + (size_t)ordinal);
+        } else {
+            set_description(&list->items[first + (size_t)ordinal], body, (size_t)(body_end - body));
+        }
+        (*records)++;
+    }
 
-    size_t offset = 0;
+    vfs_release(&view);
+}
+
+static bool parse_event_field(const char **cursor, const char *end, char terminator, int *value) {
+    const char *p = *cursor;
+    int result = 0;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    const char *digits = p;
+    while (p < end && isdigit((unsigned char)*p) && p - digits < 9) {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    if (p == digits || p >= end || *p != terminator) {
+        return false;
+    }
+    *value = negative ? -result : result;
+    *cursor = p + 1;
+    return true;
+}
+
+// Parses "YYYY-MM-DD|description" straight out of the mapped file
+static bool parse_event_line(const char *line, size_t length, CalendarEvent *event) {
+    const char *cursor = line;
+    const char *end = line + length;
+    if (end > line && end[-1] == '\r') {
+        --end;
+    }
+    if (!parse_event_field(&cursor, end, '-', &event->year) ||
+        !parse_event_field(&cursor, end, '-', &event->month) ||
+        !parse_event_field(&cursor, end, '|', &event->day) || cursor >= end ||
+        !valid_event_date(event->year, event->month, event->day)) {
+        return false;
+    }
+
+    set_description(event, cursor, (size_t)(end - cursor));
+    return true;
+}
+
+// Longer descriptions are cut to fit
+static void set_description(CalendarEvent *event, const char *text, size_t length) {
+    if (length > sizeof(event->description) - 1) {
+        length = sizeof(event->description) - 1;
+    }
+    memcpy(event->description, text, length);
+    event->description[length] = '\0';
+}
+
+// Event keys pack the day into 6 bits, so an out-of-range day would land in another month
+static bool valid_event_date(int year, int month, int day) {
+    return month >= 1 && month <= 12 && day >= 1 && day <= days_in_month(year, month);
+}
+
+static bool save_events(const CalendarEventList *list, unsigned long generation) {
+    VfsWriter writer;
+    if (vfs_writer_open(&writer, EVENTS_STORAGE_PATH) != 0) {
+        printf("Failed to write events to %s\n", EVENTS_STORAGE_PATH);
+        return false;
+    }
+
+    vfs_writer_printf(&writer, GENERATION_PREFIX "%lu\n", generation);
     for (size_t i = 0; i < list->count; ++i) {
         const CalendarEvent *event = &list->items[i];
-        int written = snprintf(buffer + offset, buffer_capacity - offset, "%04d-%02d-%02d|%s\n",
-                               event->year, event->month, event->day, event->description);
-        if (written < 0 || (size_t)written >= buffer_capacity - offset) {
-            free(buffer);
-            printf("Failed to serialize events (buffer overflow).\n");
-            return;
-        }
-        offset += (size_t)written;
+        vfs_writer_printf(&writer, "%04d-%02d-%02d|%s\n", event->year, event->month, event->day, event->description);
     }
 
-    if (vfs_write(EVENTS_STORAGE_PATH, buffer) != 0) {
+    if (vfs_writer_close(&writer) != 0) {
         printf("Failed to write events to %s\n", EVENTS_STORAGE_PATH);
+        return false;
+    }
+    return true;
+}
+
+// Persists one change as a journal append instead of rewriting every event
+static void journal_record(CalendarEventList *list, EventJournal *journal, const char *format, ...) {
+    char record[JOURNAL_RECORD_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record, sizeof(record), format, args);
+    va_end(args);
+
+    bool appended = false;
+    if (length > 0 && (size_t)length < sizeof(record)) {
+        if (journal->records == 0) {
+            // First change of this generation: (re)create the journal, replacing
+            // any stale one, with its header
+            VfsWriter writer;
+            if (vfs_writer_open(&writer, EVENTS_JOURNAL_PATH) == 0) {
+                vfs_writer_printf(&writer, GENERATION_PREFIX "%lu\n", journal->generation);
+                vfs_writer_write(&writer, record, (size_t)length);
+                appended = vfs_writer_close(&writer) == 0;
+            }
+        } else {
+            appended = vfs_append(EVENTS_JOURNAL_PATH, record, (size_t)length) == 0;
+        }
+    }
+
+    if (!appended) {
+        compact_events(list, journal);
+        return;
+    }
+    journal->records++;
+
+    // Compact once replaying would cost about as much as a quarter rewrite
+    if (journal->records >= JOURNAL_COMPACT_MIN && journal->records * 4 >= list->count) {
+        compact_events(list, journal);
+    }
+}
+
+// Writes a full snapshot under the next generation, retiring the journal
+static void compact_events(const CalendarEventList *list, EventJournal *journal) {
+    if (save_events(list, journal->generation + 1)) {
+        journal->generation++;
+        journal->records = 0;
     }
+}
 
-    free(buffer);
+static size_t grid_append(char *output, size_t output_size, size_t length, const char *format, ...) {
+    if (length + 1 >= output_size) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(output + length, output_size - length, format, args);
+    va_end(args);
+    if (written < 0) {
+        return 0;
+    }
+    // On truncation only count what actually landed in the buffer
+    return (size_t)written < output_size - length ? (size_t)written : output_size - length - 1;
 }
 
 static const char *month_name(int month) {
@@ -267,7 +544,13 @@ static const char *month_name(int month) {
     return names[month - 1];
 }
 
-static void display_calendar(int year, int month, const EventList *list) {
+static void display_calendar(int year, int month, const CalendarEventList *list) {
+    char grid[MONTH_GRID_SIZE];
+    calendar_format_month(list, year, month, grid, sizeof(grid));
+    fputs(grid, stdout);
+}
+
+size_t calendar_format_month(const CalendarEventList *list, int year, int month, char *output, size_t output_size) {
     struct tm first_day = {0};
     first_day.tm_year = year - 1900;
     first_day.tm_mon = month - 1;
@@ -277,36 +560,32 @@ static void display_calendar(int year, int month, const EventList *list) {
     int first_weekday = (first_day.tm_wday + 6) % 7; // convert to Monday=0
     int total_days = days_in_month(year, month);
 
-    printf("\n%s %d\n", month_name(month), year);
-    printf("Mo Tu We Th Fr Sa Su\n");
+    // One pass over the month's slice of the sorted list marks every busy day
+    bool has_event[32] = {false};
+    size_t first = 0;
+    size_t count = calendar_events_range(list, year, month, 0, &first);
+    for (size_t i = first; i < first + count; ++i) {
+        int day = list->items[i].day;
+        if (day >= 1 && day <= total_days) {
+            has_event[day] = true;
+        }
+    }
 
-    int day_counter = 1;
+    size_t length = 0;
+    length += grid_append(output, output_size, length, "\n%s %d\n", month_name(month), year);
+    length += grid_append(output, output_size, length, "Mo Tu We Th Fr Sa Su\n");
 
     for (int i = 0; i < first_weekday; ++i) {
-        printf("   ");
+        length += grid_append(output, output_size, length, "   ");
     }
 
-    while (day_counter <= total_days) {
+    for (int day_counter = 1; day_counter <= total_days; ++day_counter) {
         int weekday = (first_weekday + day_counter - 1) % 7;
-        bool has_event = false;
-        for (size_t i = 0; i < list->count; ++i) {
-            const CalendarEvent *event = &list->items[i];
-            if (event->year == year && event->month == month && event->day == day_counter) {
-                has_event = true;
-                break;
-            }
-        }
-        printf("%2d%c", day_counter, has_event ? '*' : ' ');
-
-        if (weekday == 6 || day_counter == total_days) {
-            printf("\n");
-        } else {
-            printf(" ");
-        }
-
-        day_counter++;
+        length += grid_append(output, output_size, length, "%2d%c%s", day_counter, has_event[day_counter] ? '*' : ' ',
+                              (weekday == 6 || day_counter == total_days) ? "\n" : " ");
     }
-    printf("\n");
+    length += grid_append(output, output_size, length, "\n");
+    return length;
 }
 
 static int days_in_month(int year, int month) {
@@ -324,39 +603,32 @@ static bool is_leap_year(int year) {
     return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
 }
 
-static const CalendarEvent *find_event_for_day(const EventList *list, int year, int month, int day, size_t *indices, size_t *match_count) {
-    *match_count = 0;
-    for (size_t i = 0; i < list->count; ++i) {
-        const CalendarEvent *event = &list->items[i];
-        if (event->year == year && event->month == month && event->day == day) {
-            if (indices != NULL) {
-                indices[*match_count] = i;
-            }
-            (*match_count)++;
+static const CalendarEvent *find_event_for_day(const CalendarEventList *list, int year, int month, int day, size_t *indices, size_t *match_count) {
+    size_t first = 0;
+    size_t count = calendar_events_range(list, year, month, day, &first);
+    // Callers hold MAX_DAY_MATCHES slots; large files can exceed that
+    *match_count = count < MAX_DAY_MATCHES ? count : MAX_DAY_MATCHES;
+    if (indices != NULL) {
+        for (size_t i = 0; i < *match_count; ++i) {
+            indices[i] = first + i;
         }
     }
-    if (*match_count > 0 && indices != NULL) {
-        return &list->items[indices[0]];
-    }
-    return NULL;
+    return count > 0 ? &list->items[first] : NULL;
 }
 
-static void list_events_for_month(const EventList *list, int year, int month) {
+static void list_events_for_month(const CalendarEventList *list, int year, int month) {
     printf("Events for %s %d:\n", month_name(month), year);
-    bool any = false;
-    for (size_t i = 0; i < list->count; ++i) {
-        const CalendarEvent *event = &list->items[i];
-        if (event->year == year && event->month == month) {
-            printf("  %02d: %s\n", event->day, event->description);
-            any = true;
-        }
+    size_t first = 0;
+    size_t count = calendar_events_range(list, year, month, 0, &first);
+    for (size_t i = first; i < first + count; ++i) {
+        printf("  %02d: %s\n", list->items[i].day, list->items[i].description);
     }
-    if (!any) {
+    if (count == 0) {
         printf("  (no events)\n");
     }
 }
 
-static void add_event(EventList *list, int default_year, int default_month) {
+static void add_event(CalendarEventList *list, EventJournal *journal, int default_year, int default_month) {
     char buffer[INPUT_BUFFER_SIZE];
     printf("Enter date (YYYY-MM-DD) [default %04d-%02d-<day>]: ", default_year, default_month);
     if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
@@ -401,15 +673,15 @@ static void add_event(EventList *list, int default_year, int default_month) {
     }
 
     CalendarEvent event = {.year = year, .month = month, .day = day};
-    strncpy(event.description, buffer, sizeof(event.description) - 1);
-    event.description[sizeof(event.description) - 1] = '\0';
+    set_description(&event, buffer, strlen(buffer));
 
-    if (event_list_append(list, &event)) {
+    if (calendar_events_insert(list, &event)) {
+        journal_record(list, journal, "+%04d-%02d-%02d|%s\n", year, month, day, event.description);
         printf("Event added for %04d-%02d-%02d.\n", year, month, day);
     }
 }
 
-static void edit_event(EventList *list) {
+static void edit_event(CalendarEventList *list, EventJournal *journal) {
     if (list->count == 0) {
         printf("No events to edit.\n");
         return;
@@ -429,7 +701,7 @@ static void edit_event(EventList *list) {
         return;
     }
 
-    size_t indices[16];
+    size_t indices[MAX_DAY_MATCHES];
     size_t matches = 0;
     find_event_for_day(list, year, month, day, indices, &matches);
     if (matches == 0) {
@@ -468,12 +740,12 @@ static void edit_event(EventList *list) {
         printf("Description cannot be empty.\n");
         return;
     }
-    strncpy(event->description, buffer, sizeof(event->description) - 1);
-    event->description[sizeof(event->description) - 1] = '\0';
+    set_description(event, buffer, strlen(buffer));
+    journal_record(list, journal, "~%04d-%02d-%02d#%zu|%s\n", year, month, day, selected, event->description);
     printf("Event updated.\n");
 }
 
-static void delete_event(EventList *list) {
+static void delete_event(CalendarEventList *list, EventJournal *journal) {
     if (list->count == 0) {
         printf("No events to delete.\n");
         return;
@@ -493,7 +765,7 @@ static void delete_event(EventList *list) {
         return;
     }
 
-    size_t indices[16];
+    size_t indices[MAX_DAY_MATCHES];
     size_t matches = 0;
     find_event_for_day(list, year, month, day, indices, &matches);
     if (matches == 0) {
@@ -520,11 +792,8 @@ static void delete_event(EventList *list) {
         selected--;
     }
 
-    size_t remove_index = indices[selected];
-    for (size_t i = remove_index; i + 1 < list->count; ++i) {
-        list->items[i] = list->items[i + 1];
-    }
-    list->count--;
+    event_list_remove(list, indices[selected]);
+    journal_record(list, journal, "-%04d-%02d-%02d#%zu|\n", year, month, day, selected);
     printf("Event removed.\n");
 }
 
@@ -569,7 +838,7 @@ static int parse_month_token(const char *token) {
     return -1;
 }
 
-static void view_events(const EventList *list, int year, int month, const char *arg) {
+static void view_events(const CalendarEventList *list, int year, int month, const char *arg) {
     if (arg == NULL) {
         list_events_for_month(list, year, month);
         return;
@@ -581,7 +850,7 @@ static void view_events(const EventList *list, int year, int month, const char *
             printf("Invalid day for the current month.\n");
             return;
         }
-        size_t indices[16];
+        size_t indices[MAX_DAY_MATCHES];
         size_t matches = 0;
         find_event_for_day(list, year, month, day, indices, &matches);
         if (matches == 0) {
@@ -597,7 +866,7 @@ static void view_events(const EventList *list, int year, int month, const char *
 
     int year_val = 0, month_val = 0, day_val = 0;
     if (parse_date(arg, &year_val, &month_val, &day_val)) {
-        size_t indices[16];
+        size_t indices[MAX_DAY_MATCHES];
         size_t matches = 0;
         find_event_for_day(list, year_val, month_val, day_val, indices, &matches);
         if (matches == 0) {
@@ -1,11 +1,48 @@
 #ifndef APPS_CALENDAR_CALENDAR_H
 #define APPS_CALENDAR_CALENDAR_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CALENDAR_DESCRIPTION_LENGTH 128
+
+typedef struct {
+    int year;
+    int month;
+    int day;
+    char description[CALENDAR_DESCRIPTION_LENGTH];
+} CalendarEvent;
+
+/**
+ * Events kept sorted by (year, month, day); events on the same day stay in
+ * insertion order. Month and day lookups are binary searches over `items`.
+ */
+typedef struct {
+    CalendarEvent *items;
+    size_t count;
+    size_t capacity;
+} CalendarEventList;
+
 /**
  * Calendar application entry point.
  * Provides month navigation and event management backed by the virtual file system.
  */
 void calendar_run(void);
 
-#endif /* APPS_CALENDAR_CALENDAR_H */
+void calendar_events_init(CalendarEventList *list);
+void calendar_events_free(CalendarEventList *list);
+bool calendar_events_insert(CalendarEventList *list, const CalendarEvent *event);
 
+/**
+ * Finds the events on one day, or in the whole month when `day` is 0.
+ * Returns how many there are; they occupy items[*first] onwards.
+ */
+size_t calendar_events_range(const CalendarEventList *list, int year, int month, int day, size_t *first);
+
+/**
+ * Renders the month grid (days with events marked '*') into `output`.
+ * Returns the length written, truncating to fit.
+ */
+size_t calendar_format_month(const CalendarEventList *list, int year, int month, char *output, size_t output_size);
+
+#endif /* APPS_CALENDAR_CALENDAR_H */
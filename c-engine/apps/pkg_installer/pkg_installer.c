@@ -4,26 +4,54 @@
 
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #define REGISTRY_PATH "system/lib_registry.txt"
 #define INPUT_BUFFER_SIZE 256
 #define INITIAL_LIBRARY_CAPACITY 16
+#define INITIAL_ARENA_CAPACITY 1024
+#define INDEX_EMPTY 0u
+#define INDEX_TOMBSTONE UINT32_MAX
+
+/**
+ * Names live back to back in one arena as "name\n", in install order, so
+ * the arena is the registry file image. `entries` records where each name
+ * sits; removal only marks an entry dead. `index` is an open-addressing
+ * table over case-folded names holding entry index + 1.
+ */
+typedef struct {
+    size_t offset;
+    size_t length;
+    uint64_t hash;
+    bool live;
+} LibraryEntry;
 
 typedef struct {
-    char **items;
+    char *arena;
+    size_t arena_length;
+    size_t arena_capacity;
+    LibraryEntry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    uint32_t *index;
+    size_t index_capacity;
+    size_t index_used;
     size_t count;
-    size_t capacity;
     bool dirty;
 } LibraryList;
 
 static void library_list_init(LibraryList *list);
 static void library_list_free(LibraryList *list);
-static bool library_list_reserve(LibraryList *list, size_t desired_capacity);
+static bool library_list_reserve(LibraryList *list, size_t length);
+static bool library_list_rehash(LibraryList *list, size_t capacity);
+static size_t library_list_find(const LibraryList *list, const char *name, size_t length, uint64_t hash);
 static bool library_list_contains(const LibraryList *list, const char *name);
 static bool library_list_append(LibraryList *list, const char *name);
+static bool library_list_append_range(LibraryList *list, const char *name, size_t length);
 static bool library_list_remove(LibraryList *list, const char *name);
 static void load_registry(LibraryList *list);
 static void save_registry(const LibraryList *list);
@@ -32,6 +60,7 @@ static void execute_command(LibraryList *list, const char *command_line, bool in
 static char *trim_whitespace(char *str);
 static void to_lowercase_copy(const char *source, char *destination, size_t max_length);
 static int string_case_compare(const char *a, const char *b);
+static uint64_t hash_name(const char *name, size_t length);
 
 void pkg_installer_run(const char *arguments) {
     LibraryList libraries;
@@ -61,43 +90,112 @@ void pkg_installer_run(const char *arguments) {
 }
 
 static void library_list_init(LibraryList *list) {
-    list->items = NULL;
-    list->count = 0;
-    list->capacity = 0;
-    list->dirty = false;
+    memset(list, 0, sizeof(*list));
 }
 
 static void library_list_free(LibraryList *list) {
-    if (list->items != NULL) {
-        for (size_t i = 0; i < list->count; ++i) {
-            free(list->items[i]);
+    free(list->arena);
+    free(list->entries);
+    free(list->index);
+    library_list_init(list);
+}
+
+// Makes room for one more name of `length` bytes and keeps the index at
+// most half full, counting tombstones.
+static bool library_list_reserve(LibraryList *list, size_t length) {
+    if (list->arena_length + length + 1 > list->arena_capacity) {
+        size_t new_capacity = list->arena_capacity == 0 ? INITIAL_ARENA_CAPACITY : list->arena_capacity;
+        while (new_capacity < list->arena_length + length + 1) {
+            new_capacity *= 2;
+        }
+        char *new_arena = (char *)realloc(list->arena, new_capacity);
+        if (new_arena == NULL) {
+            printf("Failed to allocate memory for library registry.\n");
+            return false;
         }
+        list->arena = new_arena;
+        list->arena_capacity = new_capacity;
     }
-    free(list->items);
-    list->items = NULL;
-    list->count = 0;
-    list->capacity = 0;
-    list->dirty = false;
-}
 
-static bool library_list_reserve(LibraryList *list, size_t desired_capacity) {
-    if (desired_capacity <= list->capacity) {
-        return true;
+    if (list->entry_count + 1 > list->entry_capacity) {
+        size_t new_capacity = list->entry_capacity == 0 ? INITIAL_LIBRARY_CAPACITY : list->entry_capacity * 2;
+        LibraryEntry *new_entries = (LibraryEntry *)realloc(list->entries, new_capacity * sizeof(LibraryEntry));
+        if (new_entries == NULL) {
+            printf("Failed to allocate memory for library registry.\n");
+            return false;
+        }
+        list->entries = new_entries;
+        list->entry_capacity = new_capacity;
     }
-    size_t new_capacity = list->capacity == 0 ? INITIAL_LIBRARY_CAPACITY : list->capacity;
-    while (new_capacity < desired_capacity) {
-        new_capacity *= 2;
+
+    if ((list->index_used + 1) * 2 > list->index_capacity) {
+        size_t new_capacity = list->index_capacity == 0 ? INITIAL_LIBRARY_CAPACITY * 2 : list->index_capacity;
+        while ((list->count + 1) * 2 > new_capacity) {
+            new_capacity *= 2;
+        }
+        // Same size when tombstones filled the table: rebuilding clears them
+        if (!library_list_rehash(list, new_capacity)) {
+            printf("Failed to allocate memory for library registry.\n");
+            return false;
+        }
     }
-    char **new_items = (char **)realloc(list->items, new_capacity * sizeof(char *));
-    if (new_items == NULL) {
-        printf("Failed to allocate memory for library registry.\n");
+    return true;
+}
+
+static bool library_list_rehash(LibraryList *list, size_t capacity) {
+    uint32_t *index = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+    if (index == NULL) {
         return false;
     }
-    list->items = new_items;
-    list->capacity = new_capacity;
+    for (size_t i = 0; i < list->entry_count; ++i) {
+        if (!list->entries[i].live) {
+            continue;
+        }
+        size_t slot = (size_t)list->entries[i].hash & (capacity - 1);
+        while (index[slot] != INDEX_EMPTY) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index[slot] = (uint32_t)(i + 1);
+    }
+    free(list->index);
+    list->index = index;
+    list->index_capacity = capacity;
+    list->index_used = list->count;
     return true;
 }
 
+// Returns the index slot holding `name`, or index_capacity if absent
+static size_t library_list_find(const LibraryList *list, const char *name, size_t length, uint64_t hash) {
+    if (list->index_capacity == 0) {
+        return 0;
+    }
+    size_t mask = list->index_capacity - 1;
+    for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t value = list->index[slot];
+        if (value == INDEX_EMPTY) {
+            return list->index_capacity;
+        }
+        if (value == INDEX_TOMBSTONE) {
+            continue;
+        }
+        const LibraryEntry *entry = &list->entries[value - 1];
+        if (entry->hash == hash && entry->length == length &&
+            strncasecmp(list->arena + entry->offset, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+static uint64_t hash_name(const char *name, size_t length) {
+    // FNV-1a over the case-folded name
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)tolower((unsigned char)name[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 static int string_case_compare(const char *a, const char *b) {
     while (*a && *b) {
         char ca = (char)tolower((unsigned char)*a);
@@ -112,88 +210,108 @@ static int string_case_compare(const char *a, const char *b) {
 }
 
 static bool library_list_contains(const LibraryList *list, const char *name) {
-    for (size_t i = 0; i < list->count; ++i) {
-        if (string_case_compare(list->items[i], name) == 0) {
-            return true;
-        }
-    }
-    return false;
+    size_t length = strlen(name);
+    return library_list_find(list, name, length, hash_name(name, length)) < list->index_capacity;
 }
 
 static bool library_list_append(LibraryList *list, const char *name) {
-    if (library_list_contains(list, name)) {
+    return library_list_append_range(list, name, strlen(name));
+}
+
+static bool library_list_append_range(LibraryList *list, const char *name, size_t length) {
+    uint64_t hash = hash_name(name, length);
+    if (library_list_find(list, name, length, hash) < list->index_capacity ||
+        !library_list_reserve(list, length)) {
         return false;
     }
-    if (!library_list_reserve(list, list->count + 1)) {
-        return false;
+
+    LibraryEntry *entry = &list->entries[list->entry_count];
+    entry->offset = list->arena_length;
+    entry->length = length;
+    entry->hash = hash;
+    entry->live = true;
+    memcpy(list->arena + list->arena_length, name, length);
+    list->arena[list->arena_length + length] = '\n';
+    list->arena_length += length + 1;
+
+    size_t mask = list->index_capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (list->index[slot] != INDEX_EMPTY && list->index[slot] != INDEX_TOMBSTONE) {
+        slot = (slot + 1) & mask;
     }
-    size_t length = strlen(name);
-    char *stored = (char *)malloc(length + 1);
-    if (stored == NULL) {
-        printf("Unable to store library name.\n");
-        return false;
+    if (list->index[slot] == INDEX_EMPTY) {
+        list->index_used++;
     }
-    memcpy(stored, name, length + 1);
-    list->items[list->count++] = stored;
+    list->index[slot] = (uint32_t)(++list->entry_count);
+    list->count++;
     list->dirty = true;
     return true;
 }
 
 static bool library_list_remove(LibraryList *list, const char *name) {
-    for (size_t i = 0; i < list->count; ++i) {
-        if (string_case_compare(list->items[i], name) == 0) {
-            free(list->items[i]);
-            for (size_t j = i; j + 1 < list->count; ++j) {
-                list->items[j] = list->items[j + 1];
-            }
-            list->count--;
-            list->dirty = true;
-            return true;
-        }
+    size_t length = strlen(name);
+    size_t slot = library_list_find(list, name, length, hash_name(name, length));
+    if (slot >= list->index_capacity) {
+        return false;
     }
-    return false;
+    list->entries[list->index[slot] - 1].live = false;
+    list->index[slot] = INDEX_TOMBSTONE;
+    list->count--;
+    list->dirty = true;
+    return true;
 }
 
 static void load_registry(LibraryList *list) {
-    char buffer[INPUT_BUFFER_SIZE * 8];
-    if (vfs_read(REGISTRY_PATH, buffer, sizeof(buffer)) != 0) {
+    VfsView view;
+    if (vfs_map(REGISTRY_PATH, &view) != 0) {
         return;
     }
 
-    char *context = NULL;
-    char *line = strtok(buffer, "\n");
-    while (line != NULL) {
-        char *trimmed = trim_whitespace(line);
-        if (trimmed[0] != '\0') {
-            library_list_append(list, trimmed);
+    const char *cursor = view.data;
+    const char *end = view.data + view.size;
+    while (cursor < end) {
+        const char *newline = (const char *)memchr(cursor, '\n', (size_t)(end - cursor));
+        const char *line_end = newline != NULL ? newline : end;
+        const char *name_start = cursor;
+        const char *name_end = line_end;
+        while (name_start < name_end && isspace((unsigned char)*name_start)) {
+            ++name_start;
+        }
+        while (name_end > name_start && isspace((unsigned char)*(name_end - 1))) {
+            --name_end;
+        }
+        if (name_end > name_start) {
+            library_list_append_range(list, name_start, (size_t)(name_end - name_start));
             list->dirty = false; // loading shouldn't mark as dirty
         }
-        line = strtok(NULL, "\n");
+        cursor = line_end + 1;
     }
+
+    vfs_release(&view);
 }
 
 static void save_registry(const LibraryList *list) {
-    size_t estimated_size = 1;
-    for (size_t i = 0; i < list->count; ++i) {
-        estimated_size += strlen(list->items[i]) + 1;
-    }
-    char *buffer = (char *)malloc(estimated_size);
-    if (buffer == NULL) {
-        printf("Failed to allocate memory while saving registry.\n");
+    VfsWriter writer;
+    if (vfs_writer_open(&writer, REGISTRY_PATH) != 0) {
+        printf("Failed to update registry at %s\n", REGISTRY_PATH);
         return;
     }
 
-    buffer[0] = '\0';
-    for (size_t i = 0; i < list->count; ++i) {
-        strcat(buffer, list->items[i]);
-        strcat(buffer, "\n");
+    if (list->count == list->entry_count) {
+        // Nothing removed: the arena already is the file
+        vfs_writer_write(&writer, list->arena, list->arena_length);
+    } else {
+        for (size_t i = 0; i < list->entry_count; ++i) {
+            const LibraryEntry *entry = &list->entries[i];
+            if (entry->live) {
+                vfs_writer_write(&writer, list->arena + entry->offset, entry->length + 1);
+            }
+        }
     }
 
-    if (vfs_write(REGISTRY_PATH, buffer) != 0) {
+    if (vfs_writer_close(&writer) != 0) {
         printf("Failed to update registry at %s\n", REGISTRY_PATH);
     }
-
-    free(buffer);
 }
 
 static char *trim_whitespace(char *str) {
@@ -225,8 +343,11 @@ static void print_library_list(const LibraryList *list) {
         return;
     }
     printf("Installed libraries:\n");
-    for (size_t i = 0; i < list->count; ++i) {
-        printf("  - %s\n", list->items[i]);
+    for (size_t i = 0; i < list->entry_count; ++i) {
+        const LibraryEntry *entry = &list->entries[i];
+        if (entry->live) {
+            printf("  - %.*s\n", (int)entry->length, list->arena + entry->offset);
+        }
     }
 }
 
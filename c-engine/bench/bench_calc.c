@@ -0,0 +1,134 @@
+/*
+ * Measures calculator evaluations per second for a fixed set of expressions:
+ *   parse     - tokenize, convert and compile on every evaluation (the cost
+ *               of the old interpreter path, which re-parsed each input)
+ *   cached    - calc_compile_cached() + calc_execute(), as the REPL does
+ *   bytecode  - calc_execute() on programs compiled once up front
+ *
+ * and, for a table of (x, y) points, per-point evaluation (substituting the
+ * values into the text, as callers had to before variables existed) against
+ * one calc_execute_batch() call over the columns.
+ *
+ *   make bench && ./bench/bench_calc [iterations] [rows]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apps/calculator/calculator.h"
+#include "bench_util.h"
+
+static const char *expressions[] = {
+    "2+3*4",
+    "sin(30)+cos(60)",
+    "sqrt(16)^2/4",
+    "log(10)*(3+4)-5!",
+    "(1+2)*(3+4)*(5+6)/7",
+    "tan(45)+2^10-sqrt(2)",
+};
+
+#define EXPRESSION_COUNT (sizeof(expressions) / sizeof(expressions[0]))
+
+static void report(const char *label, long evaluations, double elapsed, double checksum) {
+    printf("%-10s %10ld evals  %8.3f s  %12.0f evals/s  (checksum %.4f)\n", label, evaluations, elapsed,
+           (double)evaluations / elapsed, checksum);
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    size_t rows = argc > 2 ? (size_t)atol(argv[2]) : 100000;
+    long evaluations = iterations * (long)EXPRESSION_COUNT;
+    char error[128];
+    double result = 0.0;
+    double checksum = 0.0;
+
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        for (size_t e = 0; e < EXPRESSION_COUNT; ++e) {
+            CalcProgram program;
+            if (calc_compile(expressions[e], &program, error, sizeof(error)) == 0 &&
+                calc_execute(&program, &result, error, sizeof(error)) == 0) {
+                checksum += result;
+            }
+        }
+    }
+    report("parse", evaluations, now_seconds() - start, checksum);
+
+    checksum = 0.0;
+    start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        for (size_t e = 0; e < EXPRESSION_COUNT; ++e) {
+            CalcProgram program;
+            if (calc_compile_cached(expressions[e], &program, error, sizeof(error)) == 0 &&
+                calc_execute(&program, &result, error, sizeof(error)) == 0) {
+                checksum += result;
+            }
+        }
+    }
+    report("cached", evaluations, now_seconds() - start, checksum);
+
+    CalcProgram programs[EXPRESSION_COUNT];
+    for (size_t e = 0; e < EXPRESSION_COUNT; ++e) {
+        if (calc_compile(expressions[e], &programs[e], error, sizeof(error)) != 0) {
+            fprintf(stderr, "%s: %s\n", expressions[e], error);
+            return 1;
+        }
+    }
+    checksum = 0.0;
+    start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        for (size_t e = 0; e < EXPRESSION_COUNT; ++e) {
+            if (calc_execute(&programs[e], &result, error, sizeof(error)) == 0) {
+                checksum += result;
+            }
+        }
+    }
+    report("bytecode", evaluations, now_seconds() - start, checksum);
+
+    double *x = (double *)malloc(rows * sizeof(double));
+    double *y = (double *)malloc(rows * sizeof(double));
+    double *out = (double *)malloc(rows * sizeof(double));
+    if (x == NULL || y == NULL || out == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        x[i] = (double)(i % 360);
+        y[i] = (double)(i % 17) * 0.5;
+    }
+
+    checksum = 0.0;
+    start = now_seconds();
+    for (size_t i = 0; i < rows; ++i) {
+        char text[128];
+        CalcProgram program;
+        snprintf(text, sizeof(text), "sin(%.17g)*%.17g+2", x[i], y[i]);
+        if (calc_compile(text, &program, error, sizeof(error)) == 0 &&
+            calc_execute(&program, &result, error, sizeof(error)) == 0) {
+            checksum += result;
+        }
+    }
+    report("per-point", (long)rows, now_seconds() - start, checksum);
+
+    const char *variables[] = {"x", "y"};
+    const double *columns[] = {x, y};
+    CalcProgram batch;
+    if (calc_compile_vars("sin(x)*y+2", variables, 2, &batch, error, sizeof(error)) != 0) {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+    start = now_seconds();
+    calc_execute_batch(&batch, columns, rows, out, error, sizeof(error));
+    double elapsed = now_seconds() - start;
+    checksum = 0.0;
+    for (size_t i = 0; i < rows; ++i) {
+        checksum += out[i];
+    }
+    report("batch", (long)rows, elapsed, checksum);
+    free(x);
+    free(y);
+    free(out);
+
+    CalcCacheStats stats;
+    calc_cache_stats(&stats);
+    printf("cache: %lu hits, %lu misses, %lu evictions\n", stats.hits, stats.misses, stats.evictions);
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Measures month rendering and day lookups over a large event store.
+ *   linear   - the previous algorithm: scan every event for every day of
+ *              the month (reimplemented here for comparison)
+ *   indexed  - calendar_format_month() / calendar_events_range() over the
+ *              date-sorted store
+ *
+ *   make bench && ./bench/bench_calendar [events] [renders]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "apps/calendar/calendar.h"
+#include "bench_util.h"
+
+#define FIRST_YEAR 2000
+#define YEARS 25
+
+static int linear_render(const CalendarEventList *list, int year, int month) {
+    int busy_days = 0;
+    for (int day = 1; day <= 31; ++day) {
+        for (size_t i = 0; i < list->count; ++i) {
+            const CalendarEvent *event = &list->items[i];
+            if (event->year == year && event->month == month && event->day == day) {
+                busy_days++;
+                break;
+            }
+        }
+    }
+    return busy_days;
+}
+
+static size_t linear_day(const CalendarEventList *list, int year, int month, int day) {
+    size_t matches = 0;
+    for (size_t i = 0; i < list->count; ++i) {
+        const CalendarEvent *event = &list->items[i];
+        if (event->year == year && event->month == month && event->day == day) {
+            matches++;
+        }
+    }
+    return matches;
+}
+
+static void report(const char *label, long operations, double elapsed) {
+    printf("%-16s %8ld ops  %10.2f us/op\n", label, operations, elapsed * 1e6 / (double)operations);
+}
+
+int main(int argc, char **argv) {
+    long event_count = argc > 1 ? atol(argv[1]) : 100000;
+    long renders = argc > 2 ? atol(argv[2]) : 2000;
+
+    CalendarEventList list;
+    calendar_events_init(&list);
+    // Insert in date order, as a saved file loads; events cluster on a few days
+    long total_days = YEARS * 12L * 28L;
+    for (long i = 0; i < event_count; ++i) {
+        long slot = i * total_days / event_count;
+        CalendarEvent event = {
+            .year = FIRST_YEAR + (int)(slot / (12 * 28)),
+            .month = (int)(slot / 28 % 12) + 1,
+            .day = (int)(slot % 28) + 1,
+        };
+        snprintf(event.description, sizeof(event.description), "event %ld", i);
+        if (!calendar_events_insert(&list, &event)) {
+            return 1;
+        }
+    }
+    printf("%zu events over %d years\n", list.count, YEARS);
+
+    char grid[512];
+    long checksum = 0;
+    double start = now_seconds();
+    long linear_renders = renders / 20 > 0 ? renders / 20 : 1;
+    for (long i = 0; i < linear_renders; ++i) {
+        checksum += linear_render(&list, FIRST_YEAR + (int)(i % YEARS), (int)(i % 12) + 1);
+    }
+    report("render linear", linear_renders, now_seconds() - start);
+
+    start = now_seconds();
+    for (long i = 0; i < renders; ++i) {
+        checksum += (long)calendar_format_month(&list, FIRST_YEAR + (int)(i % YEARS), (int)(i % 12) + 1, grid,
+                                                sizeof(grid));
+    }
+    report("render indexed", renders, now_seconds() - start);
+
+    start = now_seconds();
+    for (long i = 0; i < linear_renders; ++i) {
+        checksum += (long)linear_day(&list, FIRST_YEAR + (int)(i % YEARS), (int)(i % 12) + 1, (int)(i % 28) + 1);
+    }
+    report("day linear", linear_renders, now_seconds() - start);
+
+    long queries = renders * 100;
+    start = now_seconds();
+    for (long i = 0; i < queries; ++i) {
+        size_t first = 0;
+        checksum += (long)calendar_events_range(&list, FIRST_YEAR + (int)(i % YEARS), (int)(i % 12) + 1,
+                                                (int)(i % 28) + 1, &first);
+    }
+    report("day indexed", queries, now_seconds() - start);
+
+    printf("(checksum %ld)\n", checksum);
+    calendar_events_free(&list);
+    return 0;
+}
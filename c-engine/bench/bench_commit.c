@@ -0,0 +1,101 @@
+/*
+ * Measures atomic VFS commits per second with group commit off and on.
+ * Each thread repeatedly rewrites its own small file, like concurrent
+ * calendar and pkg saves.
+ *
+ *   make bench && ./bench/bench_commit [threads] [commits-per-thread] [window-us] [dir]
+ *
+ * Point [dir] at a real disk; on tmpfs fsync is nearly free and both modes
+ * measure the same.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "vfs.h"
+#include "bench_util.h"
+
+typedef struct {
+    int index;
+    int commits;
+    int failures;
+} WorkerArgs;
+
+static void *worker(void *arg) {
+    WorkerArgs *args = (WorkerArgs *)arg;
+    char path[64];
+    snprintf(path, sizeof(path), "file-%d.txt", args->index);
+    for (int i = 0; i < args->commits; ++i) {
+        VfsWriter writer;
+        if (vfs_writer_open(&writer, path) != 0) {
+            args->failures++;
+            continue;
+        }
+        vfs_writer_printf(&writer, "2025-01-%02d|commit %d from worker %d\n", i % 28 + 1, i, args->index);
+        if (vfs_writer_close(&writer) != 0) {
+            args->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void run(const char *label, int threads, int commits) {
+    pthread_t *ids = (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+    WorkerArgs *args = (WorkerArgs *)calloc((size_t)threads, sizeof(WorkerArgs));
+    if (ids == NULL || args == NULL) {
+        free(ids);
+        free(args);
+        return;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < threads; ++i) {
+        args[i].index = i;
+        args[i].commits = commits;
+        pthread_create(&ids[i], NULL, worker, &args[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(ids[i], NULL);
+        failures += args[i].failures;
+    }
+    double elapsed = now_seconds() - start;
+
+    int total = threads * commits;
+    printf("%-26s %10.0f commits/s %10.1f us/commit  (%d failed)\n", label, total / elapsed,
+           elapsed * 1e6 / total, failures);
+    free(ids);
+    free(args);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 16;
+    int commits = argc > 2 ? atoi(argv[2]) : 100;
+    unsigned int window_us = argc > 3 ? (unsigned int)atoi(argv[3]) : 500;
+
+    char root[256];
+    snprintf(root, sizeof(root), "%s/genix-commit-XXXXXX", argc > 4 ? argv[4] : "/tmp");
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[300];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+
+    printf("%d threads x %d commits, group window %u us\n", threads, commits, window_us);
+    vfs_set_group_commit(0, 0);
+    run("fsync per commit", threads, commits);
+    vfs_set_group_commit(1, window_us);
+    run("group commit", threads, commits);
+
+    for (int i = 0; i < threads; ++i) {
+        char path[320];
+        snprintf(path, sizeof(path), "%s/file-%d.txt", root, i);
+        unlink(path);
+    }
+    rmdir(sandbox);
+    rmdir(root);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Times tab completion and history search on a large project: a tree of
+ * DIRECTORY_COUNT directories holding FILES_PER_DIRECTORY files each, and
+ * a history file of HISTORY_LINES commands. Completion is timed cold, on
+ * the first lookup in each directory, and warm; history search by prefix,
+ * by substring and for a query that matches nothing, which scans it all.
+ *
+ *   make bench && ./bench/bench_complete [iterations]
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "complete.h"
+#include "history.h"
+#include "shell.h"
+#include "vfs.h"
+#include "bench_util.h"
+
+#define DIRECTORY_COUNT 100
+#define FILES_PER_DIRECTORY 1000
+#define HISTORY_LINES 100000
+
+static char output[65536];
+
+static int create_tree(const char *root) {
+    char path[512];
+    for (int d = 0; d < DIRECTORY_COUNT; ++d) {
+        snprintf(path, sizeof(path), "%s/dir_%03d", root, d);
+        if (mkdir(path, 0755) != 0) {
+            return -1;
+        }
+        for (int f = 0; f < FILES_PER_DIRECTORY; ++f) {
+            snprintf(path, sizeof(path), "%s/dir_%03d/file_%04d.c", root, d, f);
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                return -1;
+            }
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+static size_t complete(ShellSession *session, const char *line) {
+    ShellOutput out = {.data = output, .size = sizeof(output)};
+    return complete_line(session, line, &out);
+}
+
+static double time_search(const char *query, HistoryMatch match, size_t limit, long iterations, size_t *found) {
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        ShellOutput out = {.data = output, .size = sizeof(output)};
+        *found = history_search(query, match, limit, &out);
+    }
+    return (now_seconds() - start) / (double)iterations;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+
+    char root[] = "/tmp/genix-complete-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[300];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+    shell_init();
+    if (create_tree(root) != 0) {
+        perror("create tree");
+        return 1;
+    }
+    ShellSession *session = shell_session_create();
+
+    printf("%d files in %d directories\n", DIRECTORY_COUNT * FILES_PER_DIRECTORY, DIRECTORY_COUNT);
+    char line[128];
+    double start = now_seconds();
+    for (int d = 0; d < DIRECTORY_COUNT; ++d) {
+        snprintf(line, sizeof(line), "cat dir_%03d/file_05", d);
+        complete(session, line);
+    }
+    printf("%-36s %12.1f us\n", "cold, first lookup in a directory", (now_seconds() - start) / DIRECTORY_COUNT * 1e6);
+
+    static const char *const lines[] = {"gr", "ls dir_04", "cat dir_042/file_09", "cat dir_042/file_0999",
+                                        "cat dir_042/", "cd dir_04"};
+    printf("%-36s %12s %10s\n", "warm line", "us", "matches");
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        size_t matches = 0;
+        start = now_seconds();
+        for (long j = 0; j < iterations; ++j) {
+            matches = complete(session, lines[i]);
+        }
+        printf("%-36s %12.2f %10zu\n", lines[i], (now_seconds() - start) / (double)iterations * 1e6, matches);
+    }
+
+    char history_path[320];
+    snprintf(history_path, sizeof(history_path), "%s/history", root);
+    if (history_open(history_path) != 0) {
+        perror(history_path);
+        return 1;
+    }
+    for (int i = 0; i < HISTORY_LINES; ++i) {
+        snprintf(line, sizeof(line), "make target_%d && ./run --case %d", i % 5000, i);
+        history_append(line);
+    }
+    static const struct {
+        const char *query;
+        HistoryMatch match;
+    } searches[] = {
+        {"make target_42", HISTORY_PREFIX},
+        {"case 4242", HISTORY_SUBSTRING},
+        {"no such command", HISTORY_SUBSTRING},
+        {"cat", HISTORY_PREFIX},
+    };
+    printf("\n%d history lines\n%-36s %12s %10s\n", HISTORY_LINES, "query", "us", "matches");
+    for (size_t i = 0; i < sizeof(searches) / sizeof(searches[0]); ++i) {
+        size_t found = 0;
+        double seconds = time_search(searches[i].query, searches[i].match, 20, iterations / 10 + 1, &found);
+        printf("%-9s %-26s %12.2f %10zu\n", searches[i].match == HISTORY_PREFIX ? "prefix" : "substring",
+               searches[i].query, seconds * 1e6, found);
+    }
+
+    history_close();
+    shell_session_destroy(session);
+    char command[320];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * Compares command throughput of the per-request spawn path against the
+ * persistent daemon speaking the framed protocol.
+ *
+ *   make bench && ./bench/bench_daemon [iterations] [command]
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "bench_util.h"
+
+#define ENGINE_BINARY "./genix_engine"
+#define PIPELINE_WINDOW 64
+
+static int send_request(int fd, uint32_t request_id, uint16_t opcode, const char *command) {
+    size_t length = command != NULL ? strlen(command) : 0;
+    unsigned char header_bytes[GENIX_FRAME_HEADER_SIZE];
+    GenixFrameHeader header = {.length = (uint32_t)length, .request_id = request_id, .opcode = opcode};
+    genix_frame_encode_header(&header, header_bytes);
+    if (write_all(fd, header_bytes, sizeof(header_bytes)) != 0) {
+        return -1;
+    }
+    return length == 0 ? 0 : write_all(fd, command, length);
+}
+
+static int receive_response(int fd) {
+    static unsigned char payload[GENIX_FRAME_MAX_PAYLOAD];
+    unsigned char header_bytes[GENIX_FRAME_HEADER_SIZE];
+    GenixFrameHeader header;
+    if (read_all(fd, header_bytes, sizeof(header_bytes)) != 0) {
+        return -1;
+    }
+    genix_frame_decode_header(header_bytes, &header);
+    return read_all(fd, payload, header.length);
+}
+
+static double bench_spawn(const char *root, const char *command, int iterations) {
+    char sink[4096];
+    double start = now_seconds();
+    for (int i = 0; i < iterations; ++i) {
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0) {
+            return -1.0;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(pipe_fds[1], STDOUT_FILENO);
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            execl(ENGINE_BINARY, ENGINE_BINARY, "--root", root, "-c", command, (char *)NULL);
+            _exit(127);
+        }
+        close(pipe_fds[1]);
+        while (read(pipe_fds[0], sink, sizeof(sink)) > 0) {
+        }
+        close(pipe_fds[0]);
+        waitpid(pid, NULL, 0);
+    }
+    return now_seconds() - start;
+}
+
+static double bench_daemon(int fd, uint16_t opcode, const char *command, int iterations, int window) {
+    double start = now_seconds();
+    int sent = 0;
+    int received = 0;
+    while (received < iterations) {
+        while (sent < iterations && sent - received < window) {
+            if (send_request(fd, (uint32_t)sent, opcode, command) != 0) {
+                return -1.0;
+            }
+            sent++;
+        }
+        if (receive_response(fd) != 0) {
+            return -1.0;
+        }
+        received++;
+    }
+    return now_seconds() - start;
+}
+
+static void report(const char *label, int iterations, double elapsed) {
+    if (elapsed < 0.0) {
+        printf("%-28s failed\n", label);
+        return;
+    }
+    printf("%-28s %10.0f req/s %12.2f us/req\n", label, iterations / elapsed, elapsed * 1e6 / iterations);
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    const char *command = argc > 2 ? argv[2] : "ls";
+    int spawn_iterations = iterations / 20 > 0 ? iterations / 20 : 1;
+
+    char root[] = "/tmp/genix-bench-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char socket_path[256];
+    snprintf(socket_path, sizeof(socket_path), "%s/engine.sock", root);
+
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        execl(ENGINE_BINARY, ENGINE_BINARY, "--root", root, "--socket", socket_path, (char *)NULL);
+        _exit(127);
+    }
+
+    int fd = connect_engine(socket_path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not connect to %s (run from c-engine/ after make)\n", socket_path);
+        kill(daemon, SIGTERM);
+        return 1;
+    }
+
+    printf("command: \"%s\", %d daemon requests, %d spawns\n", command, iterations, spawn_iterations);
+    report("spawn per request", spawn_iterations, bench_spawn(root, command, spawn_iterations));
+    report("daemon exec (sequential)", iterations, bench_daemon(fd, GENIX_OP_EXEC, command, iterations, 1));
+    report("daemon exec (pipelined)", iterations,
+           bench_daemon(fd, GENIX_OP_EXEC, command, iterations, PIPELINE_WINDOW));
+    report("daemon ping (pipelined)", iterations,
+           bench_daemon(fd, GENIX_OP_PING, NULL, iterations, PIPELINE_WINDOW));
+
+    close(fd);
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+
+    char sandbox_path[300];
+    snprintf(sandbox_path, sizeof(sandbox_path), "%s/sandbox", root);
+    rmdir(sandbox_path);
+    rmdir(root);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * grep -r over a tree of generated source files: the first search, which
+ * builds the trigram index, then searches for rare and common literals,
+ * regexes and -i patterns, and a search right after a file changed,
+ * against GNU grep -r scanning every file.
+ *
+ *   make bench && ./bench/bench_grep [files] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "dircache.h"
+#include "grep.h"
+#include "bench_util.h"
+
+#define LINES_PER_FILE 80
+#define FILES_PER_DIRECTORY 250
+
+typedef struct {
+    const char *pattern;
+    const char *grep_flags;
+    GrepOptions options;
+} BenchQuery;
+
+static const char *const identifiers[] = {
+    "count", "index", "buffer", "length", "node", "value", "result", "total", "left", "right",
+    "parent", "child", "queue", "stack", "item", "key", "size", "capacity", "cursor", "offset",
+};
+
+static const char *pick(unsigned int *seed) {
+    return identifiers[(size_t)rand_r(seed) % (sizeof(identifiers) / sizeof(identifiers[0]))];
+}
+
+static int write_file(const char *path, unsigned int *seed, const char *extra) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "#include <stdio.h>\n\nstruct %s_%u {\n    int %s;\n};\n\n", pick(seed), rand_r(seed) % 5000,
+            pick(seed));
+    for (int i = 0; i < LINES_PER_FILE; ++i) {
+        switch (rand_r(seed) % 4) {
+            case 0:
+                fprintf(file, "    int %s_%u = %s + %u;\n", pick(seed), rand_r(seed) % 100, pick(seed),
+                        rand_r(seed) % 1000);
+                break;
+            case 1:
+                fprintf(file, "    for (int i = 0; i < %s; ++i) { %s[i] = %s; }\n", pick(seed), pick(seed), pick(seed));
+                break;
+            case 2:
+                fprintf(file, "    if (%s > %s) return %s;\n", pick(seed), pick(seed), pick(seed));
+                break;
+            default:
+                fprintf(file, "    printf(\"%%d\\n\", %s->%s);\n", pick(seed), pick(seed));
+                break;
+        }
+    }
+    fprintf(file, "%s\n", extra);
+    return fclose(file);
+}
+
+// Counts the lines of output and drops them
+static int discard_output(void *context, const char *data, size_t length) {
+    size_t *lines = (size_t *)context;
+    for (const char *cursor = data; (cursor = memchr(cursor, '\n', length - (size_t)(cursor - data))) != NULL;
+         ++cursor) {
+        ++*lines;
+    }
+    return 0;
+}
+
+static double time_engine(const char *root, const BenchQuery *query, long iterations, size_t *lines) {
+    static char buffer[SHELL_CHUNK_SIZE];
+    GrepPattern pattern;
+    char error[256];
+    if (grep_compile(&pattern, query->pattern, &query->options, error, sizeof(error)) != 0) {
+        fprintf(stderr, "%s: %s\n", query->pattern, error);
+        return 0.0;
+    }
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        *lines = 0;
+        ShellOutput out = {.data = buffer, .size = sizeof(buffer), .sink = discard_output, .sink_context = lines};
+        grep_tree(&pattern, root, NULL, &out);
+        discard_output(lines, out.data, out.length);  // what is left below a full chunk
+    }
+    double seconds = (now_seconds() - start) / (double)iterations;
+    grep_free(&pattern);
+    return seconds;
+}
+
+static double time_grep(const char *root, const BenchQuery *query) {
+    char command[512];
+    char line[4096];
+    snprintf(command, sizeof(command), "grep -r %s '%s' %s", query->grep_flags, query->pattern, root);
+    double start = now_seconds();
+    FILE *fp = popen(command, "r");
+    if (fp == NULL) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+    }
+    pclose(fp);
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv) {
+    int file_count = argc > 1 ? atoi(argv[1]) : 10000;
+    long iterations = argc > 2 ? atol(argv[2]) : 20;
+
+    char root[] = "/tmp/genix-grep-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    unsigned int seed = 42;
+    char path[512];
+    for (int i = 0; i < file_count; ++i) {
+        if (i % FILES_PER_DIRECTORY == 0) {
+            snprintf(path, sizeof(path), "%s/student%03d", root, i / FILES_PER_DIRECTORY);
+            mkdir(path, 0755);
+        }
+        snprintf(path, sizeof(path), "%s/student%03d/lab_%d.c", root, i / FILES_PER_DIRECTORY, i);
+        if (write_file(path, &seed, i % 1000 == 0 ? "// TODO: balance the binary_search_tree" : "") != 0) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    static const BenchQuery queries[] = {
+        {"binary_search_tree", "-n", {.line_numbers = true, .separator = ':'}},
+        {"struct node_4[0-9]+ ", "-nE", {.line_numbers = true, .separator = ':', .extended = true}},
+        {"todo: balance", "-ni", {.line_numbers = true, .separator = ':', .ignore_case = true}},
+        {"quokka|zebra_[0-9]", "-nE", {.line_numbers = true, .separator = ':', .extended = true}},
+        {"return capacity", "-n", {.line_numbers = true, .separator = ':'}},
+    };
+
+    size_t lines = 0;
+    printf("%d files, %d lines each: first grep -rn (builds the index) %.1f ms\n", file_count, LINES_PER_FILE,
+           time_engine(root, &queries[0], 1, &lines) * 1e3);
+
+    printf("%-24s %12s %8s %14s\n", "pattern", "engine ms", "lines", "grep -r ms");
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i) {
+        double seconds = time_engine(root, &queries[i], iterations, &lines);
+        printf("%-24s %12.2f %8zu %14.1f\n", queries[i].pattern, seconds * 1e3, lines,
+               time_grep(root, &queries[i]) * 1e3);
+    }
+
+    // Another process rewrites a file; the next search re-reads just that one
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        snprintf(path, sizeof(path), "%s/student000/lab_%ld.c", root, i % FILES_PER_DIRECTORY + 1);
+        write_file(path, &seed, "// binary_search_tree rebalanced");
+        usleep(10000);  // inotify delivers the change asynchronously
+        dircache_process_events();
+        start += 0.01;
+        time_engine(root, &queries[0], 1, &lines);
+    }
+    printf("grep -rn after another process rewrote a file: %.2f ms (%zu lines)\n",
+           (now_seconds() - start) / (double)iterations * 1e3, lines);
+
+    char command[320];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
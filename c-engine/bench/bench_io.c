@@ -0,0 +1,169 @@
+/*
+ * Batched file I/O through the VFS: FILE_COUNT files of FILE_SIZE bytes
+ * read whole, written durably, and a whole-tree snapshot (cp -r). Each is
+ * timed the stdio way (one file after another: fopen/fread, or a
+ * VfsWriter per file), through the batch API on synchronous calls, and
+ * through the batch API on io_uring. Reads hit the kernel page cache;
+ * writes pay a real fsync each.
+ *
+ *   make bench && ./bench/bench_io [files]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "vfs.h"
+#include "bench_util.h"
+
+#define FILE_SIZE (8 * 1024)
+#define SUBDIRECTORIES 16
+
+static void report(const char *label, long files, double seconds) {
+    printf("%-34s %10.1f %12.0f\n", label, seconds / (double)files * 1e6, (double)files / seconds);
+}
+
+static void sum_read(void *context, size_t index, const char *data, size_t size, const struct stat *st, int error) {
+    (void)index;
+    (void)st;
+    unsigned long *checksum = (unsigned long *)context;
+    for (size_t i = 0; error == 0 && i < size; i += 64) {
+        *checksum += (unsigned char)data[i];
+    }
+}
+
+static double read_stdio(char **paths, long files, char *buffer, unsigned long *checksum) {
+    double start = now_seconds();
+    for (long i = 0; i < files; ++i) {
+        FILE *file = fopen(paths[i], "rb");
+        if (file == NULL) {
+            continue;
+        }
+        size_t size = fread(buffer, 1, FILE_SIZE, file);
+        fclose(file);
+        sum_read(checksum, (size_t)i, buffer, size, NULL, 0);
+    }
+    return now_seconds() - start;
+}
+
+static double read_batched(char **paths, long files, unsigned long *checksum) {
+    double start = now_seconds();
+    vfs_read_batch((const char *const *)paths, (size_t)files, FILE_SIZE, sum_read, checksum);
+    return now_seconds() - start;
+}
+
+static double write_one_by_one(VfsBatchWrite *writes, long files) {
+    double start = now_seconds();
+    for (long i = 0; i < files; ++i) {
+        VfsWriter writer;
+        if (vfs_writer_open(&writer, writes[i].path) == 0) {
+            vfs_writer_write(&writer, writes[i].data, writes[i].size);
+            vfs_writer_close(&writer);
+        }
+    }
+    return now_seconds() - start;
+}
+
+static double write_batched(VfsBatchWrite *writes, long files) {
+    double start = now_seconds();
+    size_t failed = vfs_write_batch(writes, (size_t)files);
+    if (failed > 0) {
+        fprintf(stderr, "%zu writes failed\n", failed);
+    }
+    return now_seconds() - start;
+}
+
+static double snapshot(const char *target) {
+    double start = now_seconds();
+    size_t failed = 0;
+    if (vfs_copy_tree("files", target, &failed) < 0 || failed > 0) {
+        fprintf(stderr, "snapshot to %s failed\n", target);
+    }
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv) {
+    long files = argc > 1 ? atol(argv[1]) : 2048;
+    if (files < 2) {
+        files = 2;
+    }
+
+    char root[] = "/tmp/genix-io-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[320];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+    char command[320];
+    snprintf(command, sizeof(command), "mkdir -p %s/files/d00", root);
+    if (system(command) != 0) {
+        return 1;
+    }
+    for (int d = 1; d < SUBDIRECTORIES; ++d) {
+        snprintf(command, sizeof(command), "mkdir -p %s/files/d%02d", root, d);
+        if (system(command) != 0) {
+            return 1;
+        }
+    }
+
+    char *content = (char *)malloc(FILE_SIZE);
+    char *buffer = (char *)malloc(FILE_SIZE);
+    char **relative = (char **)calloc((size_t)files, sizeof(char *));
+    char **full = (char **)calloc((size_t)files, sizeof(char *));
+    VfsBatchWrite *writes = (VfsBatchWrite *)calloc((size_t)files, sizeof(VfsBatchWrite));
+    if (content == NULL || buffer == NULL || relative == NULL || full == NULL || writes == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < FILE_SIZE; ++i) {
+        content[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+    }
+    for (long i = 0; i < files; ++i) {
+        relative[i] = (char *)malloc(64);
+        full[i] = (char *)malloc(384);
+        if (relative[i] == NULL || full[i] == NULL) {
+            return 1;
+        }
+        snprintf(relative[i], 64, "files/d%02ld/file_%05ld.txt", i % SUBDIRECTORIES, i);
+        snprintf(full[i], 384, "%s/%s", root, relative[i]);
+        writes[i] = (VfsBatchWrite){relative[i], content, FILE_SIZE, 0};
+    }
+
+    const char *backend = vfs_set_io_backend(VFS_IO_URING) == VFS_IO_URING ? "io_uring" : "unavailable, sync";
+    printf("%ld files of %d KiB in %d directories; io_uring backend: %s\n", files, FILE_SIZE / 1024, SUBDIRECTORIES,
+           backend);
+    printf("%-34s %10s %12s\n", "", "us/file", "files/s");
+
+    vfs_set_io_backend(VFS_IO_SYNC);
+    write_batched(writes, files);  // creates the files
+
+    unsigned long checksum = 0;
+    report("read: stdio fopen/fread", files, read_stdio(full, files, buffer, &checksum));
+    report("read: batch, sync", files, read_batched(full, files, &checksum));
+    vfs_set_io_backend(VFS_IO_URING);
+    report("read: batch, io_uring", files, read_batched(full, files, &checksum));
+
+    vfs_set_io_backend(VFS_IO_SYNC);
+    report("write+fsync: VfsWriter per file", files, write_one_by_one(writes, files));
+    report("write+fsync: batch, sync", files, write_batched(writes, files));
+    vfs_set_io_backend(VFS_IO_URING);
+    report("write+fsync: batch, io_uring", files, write_batched(writes, files));
+
+    vfs_set_io_backend(VFS_IO_SYNC);
+    report("snapshot (cp -r): sync", files, snapshot("snapshot_sync"));
+    vfs_set_io_backend(VFS_IO_URING);
+    report("snapshot (cp -r): io_uring", files, snapshot("snapshot_uring"));
+
+    printf("checksum %lu\n", checksum);
+    for (long i = 0; i < files; ++i) {
+        free(relative[i]);
+        free(full[i]);
+    }
+    free(relative);
+    free(full);
+    free(writes);
+    free(content);
+    free(buffer);
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
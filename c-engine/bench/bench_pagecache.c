@@ -0,0 +1,124 @@
+/*
+ * Reads the way editors reload files: FILE_COUNT files of FILE_SIZE bytes
+ * each, read whole in random order through vfs_map. Timed with the page
+ * cache disabled (open, fstat and mmap per read), with everything cached,
+ * and with a budget holding a quarter of the files so LRU eviction runs;
+ * then a write-through vfs_write followed by reads of what it wrote.
+ *
+ *   make bench && ./bench/bench_pagecache [reads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pagecache.h"
+#include "vfs.h"
+#include "bench_util.h"
+
+#define FILE_COUNT 256
+#define FILE_SIZE (16 * 1024)
+#define HOT_FILES 16
+
+// Touches every byte, as a reader would
+static unsigned long read_file(int index) {
+    char path[64];
+    snprintf(path, sizeof(path), "files/file_%03d.txt", index);
+    VfsView view;
+    if (vfs_map(path, &view) != 0) {
+        return 0;
+    }
+    unsigned long sum = 0;
+    for (size_t i = 0; i < view.size; i += 64) {
+        sum += (unsigned char)view.data[i];
+    }
+    vfs_release(&view);
+    return sum;
+}
+
+static void run(const char *label, long reads, int spread, unsigned long *checksum) {
+    PageCacheStats before;
+    PageCacheStats after;
+    pagecache_stats(&before);
+    unsigned int seed = 7;
+    double start = now_seconds();
+    for (long i = 0; i < reads; ++i) {
+        *checksum += read_file(rand_r(&seed) % spread);
+    }
+    double seconds = now_seconds() - start;
+    pagecache_stats(&after);
+    printf("%-28s %10.2f %10lu %10lu %10lu\n", label, seconds / (double)reads * 1e6, after.hits - before.hits,
+           after.misses - before.misses, after.evictions - before.evictions);
+}
+
+int main(int argc, char **argv) {
+    long reads = argc > 1 ? atol(argv[1]) : 200000;
+
+    char root[] = "/tmp/genix-pagecache-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[320];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+
+    char *content = (char *)malloc(FILE_SIZE + 1);
+    if (content == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < FILE_SIZE; ++i) {
+        content[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+    }
+    content[FILE_SIZE] = '\0';
+    char path[64];
+    char command[320];
+    snprintf(command, sizeof(command), "mkdir -p %s/files", root);
+    if (system(command) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < FILE_COUNT; ++i) {
+        snprintf(path, sizeof(path), "files/file_%03d.txt", i);
+        if (vfs_write(path, content) != 0) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    unsigned long checksum = 0;
+    printf("%d files of %d KiB, %ld random whole-file reads\n", FILE_COUNT, FILE_SIZE / 1024, reads);
+    printf("%-28s %10s %10s %10s %10s\n", "", "us/read", "hits", "misses", "evictions");
+
+    pagecache_set_budget(0);
+    run("no cache", reads, FILE_COUNT, &checksum);
+
+    pagecache_set_budget(PAGECACHE_DEFAULT_BUDGET);
+    run("all files cached", reads, FILE_COUNT, &checksum);
+    run("hot set cached", reads, HOT_FILES, &checksum);
+
+    // Room for a quarter of the files: most reads miss and evict
+    pagecache_set_budget(FILE_COUNT / 4 * FILE_SIZE);
+    run("budget of a quarter", reads, FILE_COUNT, &checksum);
+    run("hot set within budget", reads, HOT_FILES, &checksum);
+
+    // Write-through: reads right after a write hit without reading the file
+    pagecache_set_budget(PAGECACHE_DEFAULT_BUDGET);
+    PageCacheStats before;
+    pagecache_stats(&before);
+    long writes = reads / 1000 > 0 ? reads / 1000 : 1;
+    double start = now_seconds();
+    for (long i = 0; i < writes; ++i) {
+        snprintf(path, sizeof(path), "files/file_%03ld.txt", i % FILE_COUNT);
+        content[0] = (char)('a' + i % 26);
+        vfs_write(path, content);
+        checksum += read_file((int)(i % FILE_COUNT));
+    }
+    PageCacheStats after;
+    pagecache_stats(&after);
+    printf("vfs_write then read: %.1f us per pair, %lu of %ld reads hit\n",
+           (now_seconds() - start) / (double)writes * 1e6, after.hits - before.hits, writes);
+
+    printf("checksum %lu\n", checksum);
+    free(content);
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
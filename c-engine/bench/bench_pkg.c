@@ -0,0 +1,89 @@
+/*
+ * Measures package registry load + save through the pkg installer at
+ * growing registry sizes. Each "install" loads the whole registry, inserts
+ * one name and writes it back; "remove" does the same for a deletion.
+ * Time per operation should grow linearly with the registry size.
+ *
+ *   make bench && ./bench/bench_pkg [max-entries]
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "vfs.h"
+#include "apps/pkg_installer/pkg_installer.h"
+#include "bench_util.h"
+
+#define REPEATS 5
+
+static int write_registry(long entries) {
+    VfsWriter writer;
+    if (vfs_writer_open(&writer, "system/lib_registry.txt") != 0) {
+        return -1;
+    }
+    for (long i = 0; i < entries; ++i) {
+        vfs_writer_printf(&writer, "Library_%ld\n", i);
+    }
+    return vfs_writer_close(&writer);
+}
+
+// The installer reports to stdout; keep it out of the results
+static double timed_run(const char *arguments) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    double start = now_seconds();
+    pkg_installer_run(arguments);
+    fflush(stdout);
+    double elapsed = now_seconds() - start;
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    long max_entries = argc > 1 ? atol(argv[1]) : 100000;
+
+    char root[] = "/tmp/genix-pkg-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char path[320];
+    snprintf(path, sizeof(path), "%s/system", root);
+    mkdir(path, 0755);
+    char sandbox[300];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+
+    printf("%10s %14s %14s\n", "entries", "install ms", "remove ms");
+    for (long entries = 1000; entries <= max_entries; entries *= 10) {
+        if (write_registry(entries) != 0) {
+            fprintf(stderr, "failed to write registry\n");
+            return 1;
+        }
+        double install = 0.0;
+        double remove = 0.0;
+        for (int i = 0; i < REPEATS; ++i) {
+            install += timed_run("install NewLibrary");
+            remove += timed_run("remove library_0");
+            timed_run("install Library_0");
+            timed_run("remove newlibrary");
+        }
+        printf("%10ld %14.2f %14.2f\n", entries, install * 1e3 / REPEATS, remove * 1e3 / REPEATS);
+    }
+
+    snprintf(path, sizeof(path), "%s/system/lib_registry.txt", root);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/system", root);
+    rmdir(path);
+    rmdir(sandbox);
+    rmdir(root);
+    return 0;
+}
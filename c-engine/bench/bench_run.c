@@ -0,0 +1,137 @@
+/*
+ * Cost of starting a program, as handleRun pays it once per click: RUNS
+ * runs of /bin/true from a process holding HEAP_MB of touched heap (the
+ * backend's or the daemon's size), started with fork plus exec, with
+ * posix_spawn, and through runner_run's zygotes, which also apply the
+ * resource limits and collect rusage. Then RUNS runs from THREADS threads
+ * at once, as in a lab session, through the zygotes.
+ *
+ *   make bench && ./bench/bench_run [runs]
+ */
+#include <pthread.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "runner.h"
+#include "bench_util.h"
+
+#define HEAP_MB 512
+#define THREADS 8
+#define PROGRAM "/bin/true"
+
+extern char **environ;
+
+typedef struct {
+    long runs;
+    long failures;
+} Worker;
+
+static void run_forked(void) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        char *argv[] = {PROGRAM, NULL};
+        execve(PROGRAM, argv, environ);
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+static void run_spawned(void) {
+    char *argv[] = {PROGRAM, NULL};
+    pid_t pid;
+    if (posix_spawn(&pid, PROGRAM, NULL, NULL, argv, environ) == 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+static bool run_zygote(void) {
+    RunLimits limits = {0};
+    RunResult result;
+    if (runner_run(PROGRAM, "/", &limits, &result) != 0) {
+        return false;
+    }
+    runner_result_free(&result);
+    return result.exit_code == 0;
+}
+
+static void *run_many(void *argument) {
+    Worker *worker = (Worker *)argument;
+    for (long i = 0; i < worker->runs; ++i) {
+        worker->failures += !run_zygote();
+    }
+    return NULL;
+}
+
+static void report(const char *label, long runs, double seconds) {
+    printf("%-32s %9.1f us/run %9.0f runs/s\n", label, seconds / (double)runs * 1e6, (double)runs / seconds);
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--zygote") == 0) {
+        return runner_zygote_main(atoi(argv[2]));
+    }
+    long runs = argc > 1 ? atol(argv[1]) : 2000;
+
+    size_t heap_size = (size_t)HEAP_MB * 1024 * 1024;
+    char *heap = (char *)malloc(heap_size);
+    if (heap == NULL) {
+        return 1;
+    }
+    memset(heap, 1, heap_size);
+    if (runner_init(THREADS) != 0) {
+        perror("runner_init");
+        return 1;
+    }
+    printf("%ld runs of %s from a process with %d MB of heap\n", runs, PROGRAM, HEAP_MB);
+
+    double start = now_seconds();
+    for (long i = 0; i < runs; ++i) {
+        run_forked();
+    }
+    report("fork + exec", runs, now_seconds() - start);
+
+    start = now_seconds();
+    for (long i = 0; i < runs; ++i) {
+        run_spawned();
+    }
+    report("posix_spawn", runs, now_seconds() - start);
+
+    long failures = 0;
+    start = now_seconds();
+    for (long i = 0; i < runs; ++i) {
+        failures += !run_zygote();
+    }
+    report("zygote (limits + rusage)", runs, now_seconds() - start);
+
+    Worker workers[THREADS];
+    pthread_t threads[THREADS];
+    start = now_seconds();
+    for (int i = 0; i < THREADS; ++i) {
+        workers[i] = (Worker){.runs = runs / THREADS, .failures = 0};
+        pthread_create(&threads[i], NULL, run_many, &workers[i]);
+    }
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        failures += workers[i].failures;
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "zygote, %d threads", THREADS);
+    report(label, runs / THREADS * THREADS, now_seconds() - start);
+
+    // One measured run, to show what a reply carries
+    RunLimits limits = {0};
+    RunResult result;
+    if (runner_run(PROGRAM, "/", &limits, &result) == 0) {
+        printf("last run: exit %d, wall %llu us, cpu %llu+%llu us, max rss %llu KB\n", result.exit_code,
+               (unsigned long long)result.wall_us, (unsigned long long)result.user_us,
+               (unsigned long long)result.system_us, (unsigned long long)result.max_rss_kb);
+        runner_result_free(&result);
+    }
+    printf("failures %ld, heap checksum %d\n", failures, heap[heap_size / 2]);
+    runner_shutdown();
+    free(heap);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Full-text search over a tree of generated student files: time to build
+ * the index, query latency for rare, common and multi-word queries, and
+ * the cost of re-indexing a file after a write, against scanning every
+ * file with grep the way finding something used to work.
+ *
+ *   make bench && ./bench/bench_search [files] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "bench_util.h"
+
+#define VOCABULARY_SIZE 20000
+#define WORDS_PER_FILE 300
+#define FILES_PER_DIRECTORY 500
+
+// Zipf-like: low word numbers are far more common than high ones
+static unsigned int pick_word(unsigned int *seed) {
+    double u = (double)rand_r(seed) / ((double)RAND_MAX + 1.0);
+    return (unsigned int)(VOCABULARY_SIZE * u * u * u);
+}
+
+static int write_file(const char *path, unsigned int *seed, const char *extra) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < WORDS_PER_FILE; ++i) {
+        fprintf(file, "w%u%c", pick_word(seed), i % 12 == 11 ? '\n' : ' ');
+    }
+    fprintf(file, "%s\n", extra);
+    return fclose(file);
+}
+
+static double time_query(const char *query, long iterations, size_t *found) {
+    static SearchHit hits[10];
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        *found = search_query(query, hits, 10);
+    }
+    return (now_seconds() - start) / (double)iterations;
+}
+
+static double time_grep(const char *root, const char *word) {
+    char command[512];
+    char line[512];
+    snprintf(command, sizeof(command), "grep -rliw %s %s", word, root);
+    double start = now_seconds();
+    FILE *fp = popen(command, "r");
+    if (fp == NULL) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+    }
+    pclose(fp);
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv) {
+    int file_count = argc > 1 ? atoi(argv[1]) : 20000;
+    long iterations = argc > 2 ? atol(argv[2]) : 200;
+
+    char root[] = "/tmp/genix-search-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    unsigned int seed = 42;
+    char path[512];
+    for (int i = 0; i < file_count; ++i) {
+        if (i % FILES_PER_DIRECTORY == 0) {
+            snprintf(path, sizeof(path), "%s/student%03d", root, i / FILES_PER_DIRECTORY);
+            mkdir(path, 0755);
+        }
+        snprintf(path, sizeof(path), "%s/student%03d/notes_%d.txt", root, i / FILES_PER_DIRECTORY, i);
+        if (write_file(path, &seed, i % 1000 == 0 ? "Homework about binary search trees" : "") != 0) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    double start = now_seconds();
+    if (search_index_open(root) != 0) {
+        perror(root);
+        return 1;
+    }
+    search_index_wait();
+    printf("%d files, %d words each: indexed in %.1f ms\n", file_count, WORDS_PER_FILE, (now_seconds() - start) * 1e3);
+
+    static const char *const queries[] = {"trees", "w1", "binary search trees", "w3 w7", "nosuchword"};
+    printf("%-24s %12s %8s %14s\n", "query", "search us", "hits", "grep -rl ms");
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i) {
+        size_t found = 0;
+        double seconds = time_query(queries[i], iterations, &found);
+        const char *space = strchr(queries[i], ' ');
+        char first_word[64];
+        snprintf(first_word, sizeof(first_word), "%.*s", (int)(space != NULL ? space - queries[i] : 63), queries[i]);
+        printf("%-24s %12.1f %8zu %14.1f\n", queries[i], seconds * 1e6, found, time_grep(root, first_word) * 1e3);
+    }
+
+    // Rewrite files the way the file handler does, then let the index catch up
+    start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        snprintf(path, sizeof(path), "%s/student000/notes_%ld.txt", root, i % FILES_PER_DIRECTORY);
+        write_file(path, &seed, "");
+        search_index_update(path);
+    }
+    printf("rewrite and re-index one file: %.1f us\n", (now_seconds() - start) / (double)iterations * 1e6);
+
+    search_index_close();
+    char command[320];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
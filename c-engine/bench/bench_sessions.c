@@ -0,0 +1,250 @@
+/*
+ * Load test for concurrent shell sessions on the daemon. Each simulated
+ * user opens its own connection and session, changes into its own
+ * directory and runs a mix of commands one after another, the way a
+ * GenixShell window does. Reports per-command latency percentiles by
+ * session count, alone and next to one session hammering the engine with
+ * slow commands.
+ *
+ *   make bench && ./bench/bench_sessions [commands-per-session] [workers]
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "bench_util.h"
+
+#define ENGINE_BINARY "./genix_engine"
+#define SLOW_FILE_LINES 400000
+
+typedef struct {
+    const char *socket_path;
+    int user;
+    int commands;
+    double *latencies;
+    pthread_barrier_t *start;
+    bool failed;
+} UserRun;
+
+typedef struct {
+    const char *socket_path;
+    volatile bool stop;
+    long completed;
+} SlowRun;
+
+static const char *const user_commands[] = {
+    "ls -l",
+    "echo \"$USER was here\" >> notes.txt",
+    "cat notes.txt | wc -l",
+    "pwd",
+    "grep -c here notes.txt",
+};
+
+static int send_frame(int fd, uint16_t opcode, const void *prefix, size_t prefix_length, const char *text) {
+    size_t text_length = text != NULL ? strlen(text) : 0;
+    unsigned char header_bytes[GENIX_FRAME_HEADER_SIZE];
+    GenixFrameHeader header = {.length = (uint32_t)(prefix_length + text_length), .request_id = 1, .opcode = opcode};
+    genix_frame_encode_header(&header, header_bytes);
+    if (write_all(fd, header_bytes, sizeof(header_bytes)) != 0 ||
+        (prefix_length > 0 && write_all(fd, prefix, prefix_length) != 0)) {
+        return -1;
+    }
+    return text_length == 0 ? 0 : write_all(fd, text, text_length);
+}
+
+// Reads frames up to the final one of the request and returns its status,
+// or -1; the final payload (at most `size` bytes) is left in `payload`.
+// Output is acknowledged as it is read, as the backend does.
+static int receive_final(int fd, unsigned char *payload, size_t size) {
+    unsigned char discard[4096];
+    for (;;) {
+        unsigned char header_bytes[GENIX_FRAME_HEADER_SIZE];
+        GenixFrameHeader header;
+        if (read_all(fd, header_bytes, sizeof(header_bytes)) != 0) {
+            return -1;
+        }
+        genix_frame_decode_header(header_bytes, &header);
+        size_t remaining = header.length;
+        if (header.status != GENIX_STATUS_MORE && remaining <= size) {
+            return read_all(fd, payload, remaining) == 0 ? header.status : -1;
+        }
+        while (remaining > 0) {
+            size_t chunk = remaining < sizeof(discard) ? remaining : sizeof(discard);
+            if (read_all(fd, discard, chunk) != 0) {
+                return -1;
+            }
+            remaining -= chunk;
+        }
+        if (header.status != GENIX_STATUS_MORE) {
+            return header.status;
+        }
+        unsigned char consumed[4];
+        genix_put_u32(consumed, header.length);
+        if (send_frame(fd, GENIX_OP_STREAM_ACK, consumed, sizeof(consumed), NULL) != 0) {
+            return -1;
+        }
+    }
+}
+
+static int open_session(int fd, unsigned char id[4]) {
+    if (send_frame(fd, GENIX_OP_SESSION_OPEN, NULL, 0, NULL) != 0) {
+        return -1;
+    }
+    return receive_final(fd, id, 4) == GENIX_STATUS_OK ? 0 : -1;
+}
+
+static int session_exec(int fd, const unsigned char id[4], const char *command) {
+    unsigned char payload[4];
+    if (send_frame(fd, GENIX_OP_SESSION_EXEC, id, 4, command) != 0) {
+        return -1;
+    }
+    return receive_final(fd, payload, 0);
+}
+
+static void *run_user(void *argument) {
+    UserRun *run = (UserRun *)argument;
+    int fd = connect_engine(run->socket_path);
+    unsigned char id[4];
+    char setup[128];
+    snprintf(setup, sizeof(setup), "mkdir -p user%d && cd user%d && export USER=user%d", run->user, run->user,
+             run->user);
+    run->failed = fd < 0 || open_session(fd, id) != 0 || session_exec(fd, id, setup) != GENIX_STATUS_OK;
+
+    pthread_barrier_wait(run->start);
+    for (int i = 0; i < run->commands && !run->failed; ++i) {
+        double start = now_seconds();
+        int status = session_exec(fd, id, user_commands[i % (sizeof(user_commands) / sizeof(user_commands[0]))]);
+        run->latencies[i] = now_seconds() - start;
+        run->failed = status != GENIX_STATUS_OK;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Keeps a full-file regex scan running for as long as the users are busy
+static void *run_slow(void *argument) {
+    SlowRun *run = (SlowRun *)argument;
+    int fd = connect_engine(run->socket_path);
+    unsigned char id[4];
+    if (fd < 0 || open_session(fd, id) != 0) {
+        return NULL;
+    }
+    while (!run->stop && session_exec(fd, id, "grep -c 'a.*b.*c.*d.*q' slow.txt") >= 0) {
+        ++run->completed;
+    }
+    close(fd);
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_users(const char *socket_path, int users, int commands, bool slow_neighbour) {
+    UserRun *runs = calloc((size_t)users, sizeof(UserRun));
+    pthread_t *threads = calloc((size_t)users, sizeof(pthread_t));
+    double *latencies = calloc((size_t)users * (size_t)commands, sizeof(double));
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)users + 1);
+
+    SlowRun slow = {socket_path, false, 0};
+    pthread_t slow_thread;
+    if (slow_neighbour) {
+        pthread_create(&slow_thread, NULL, run_slow, &slow);
+    }
+    for (int i = 0; i < users; ++i) {
+        runs[i] = (UserRun){socket_path, i, commands, latencies + (size_t)i * (size_t)commands, &start, false};
+        pthread_create(&threads[i], NULL, run_user, &runs[i]);
+    }
+    pthread_barrier_wait(&start);
+    double began = now_seconds();
+    int failures = 0;
+    for (int i = 0; i < users; ++i) {
+        pthread_join(threads[i], NULL);
+        failures += runs[i].failed ? 1 : 0;
+    }
+    double elapsed = now_seconds() - began;
+    if (slow_neighbour) {
+        slow.stop = true;
+        pthread_join(slow_thread, NULL);
+    }
+
+    size_t count = (size_t)users * (size_t)commands;
+    qsort(latencies, count, sizeof(double), compare_double);
+    printf("%8d %-6s %10.0f %10.1f %10.1f %10.1f", users, slow_neighbour ? "yes" : "no", (double)count / elapsed,
+           latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6, latencies[count - 1] * 1e6);
+    if (slow_neighbour) {
+        printf("  (%ld slow scans)", slow.completed);
+    }
+    printf(failures > 0 ? "  %d sessions failed\n" : "\n", failures);
+
+    pthread_barrier_destroy(&start);
+    free(latencies);
+    free(threads);
+    free(runs);
+}
+
+int main(int argc, char **argv) {
+    int commands = argc > 1 ? atoi(argv[1]) : 200;
+    const char *workers = argc > 2 ? argv[2] : NULL;
+
+    char root[] = "/tmp/genix-sessions-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char path[300];
+    snprintf(path, sizeof(path), "%s/slow.txt", root);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    for (int i = 0; i < SLOW_FILE_LINES; ++i) {
+        fprintf(file, "line %d with a bit of text before the end\n", i);
+    }
+    fclose(file);
+
+    char socket_path[256];
+    snprintf(socket_path, sizeof(socket_path), "%s/engine.sock", root);
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        if (workers != NULL) {
+            execl(ENGINE_BINARY, ENGINE_BINARY, "--root", root, "--socket", socket_path, "--workers", workers,
+                  (char *)NULL);
+        } else {
+            execl(ENGINE_BINARY, ENGINE_BINARY, "--root", root, "--socket", socket_path, (char *)NULL);
+        }
+        _exit(127);
+    }
+    int probe = connect_engine(socket_path);
+    if (probe < 0) {
+        fprintf(stderr, "Could not connect to %s (run from c-engine/ after make)\n", socket_path);
+        kill(daemon, SIGTERM);
+        return 1;
+    }
+    close(probe);
+
+    static const int user_counts[] = {1, 10, 100, 200};
+    printf("%d commands per session, workers: %s\n", commands, workers != NULL ? workers : "default");
+    printf("%8s %-6s %10s %10s %10s %10s\n", "sessions", "slow", "cmd/s", "p50 us", "p99 us", "max us");
+    for (size_t i = 0; i < sizeof(user_counts) / sizeof(user_counts[0]); ++i) {
+        bench_users(socket_path, user_counts[i], commands, false);
+        bench_users(socket_path, user_counts[i], commands, true);
+    }
+
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    char command[320];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
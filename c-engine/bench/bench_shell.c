@@ -0,0 +1,83 @@
+/*
+ * Compares in-process shell builtins against forking the equivalent
+ * coreutils command through popen, which is what "ls" used to do. Each
+ * command runs against the same small project tree.
+ *
+ *   make bench && ./bench/bench_shell [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "shell.h"
+#include "vfs.h"
+#include "bench_util.h"
+
+#define FILE_COUNT 64
+
+static double run_native(const char *command, long iterations) {
+    static char output[65536];
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        shell_execute_command(command, output, sizeof(output));
+    }
+    return (now_seconds() - start) / (double)iterations;
+}
+
+static double run_popen(const char *root, const char *command, long iterations) {
+    char line[512];
+    char full_command[512];
+    snprintf(full_command, sizeof(full_command), "cd %s && %s", root, command);
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        FILE *fp = popen(full_command, "r");
+        if (fp == NULL) {
+            return 0.0;
+        }
+        while (fgets(line, sizeof(line), fp) != NULL) {
+        }
+        pclose(fp);
+    }
+    return (now_seconds() - start) / (double)iterations;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 500;
+
+    char root[] = "/tmp/genix-shell-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[300];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+
+    for (int i = 0; i < FILE_COUNT; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "file_%02d.txt", i);
+        VfsWriter writer;
+        if (vfs_writer_open(&writer, name) != 0) {
+            fprintf(stderr, "failed to create %s\n", name);
+            return 1;
+        }
+        for (int line = 0; line < 100; ++line) {
+            vfs_writer_printf(&writer, "line %d of file %d\n", line, i);
+        }
+        vfs_writer_close(&writer);
+    }
+
+    static const char *const commands[] = {"ls", "ls -l", "cat file_00.txt", "wc file_00.txt", "tail -n 5 file_00.txt",
+                                           "cat file_00.txt | grep 7 | wc -l"};
+    printf("%-34s %12s %12s %10s\n", "command", "native us", "popen us", "speedup");
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+        double native = run_native(commands[i], iterations * 20);
+        double forked = run_popen(root, commands[i], iterations);
+        printf("%-34s %12.2f %12.2f %9.0fx\n", commands[i], native * 1e6, forked * 1e6, forked / native);
+    }
+
+    char command[320];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
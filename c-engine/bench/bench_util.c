@@ -0,0 +1,73 @@
+#include "bench_util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONNECT_ATTEMPTS 200
+#define CONNECT_RETRY_US 10000
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int write_all(int fd, const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+int read_all(int fd, void *data, size_t length) {
+    unsigned char *bytes = (unsigned char *)data;
+    while (length > 0) {
+        ssize_t received = read(fd, bytes, length);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += received;
+        length -= (size_t)received;
+    }
+    return 0;
+}
+
+int connect_engine(const char *socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    size_t path_length = strlen(socket_path);
+    if (path_length >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memcpy(address.sun_path, socket_path, path_length + 1);
+
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; ++attempt) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(CONNECT_RETRY_US);
+    }
+    return -1;
+}
@@ -0,0 +1,21 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>
+
+/**
+ * Scaffolding shared by the benchmarks: timing, and talking to a daemon
+ * started on a Unix socket.
+ */
+
+// Monotonic clock in seconds
+double now_seconds(void);
+
+// Both return 0 once all `length` bytes moved, -1 on error or end of file
+int write_all(int fd, const void *data, size_t length);
+int read_all(int fd, void *data, size_t length);
+
+// Retries for about two seconds while the daemon starts; -1 if it never listens
+int connect_engine(const char *socket_path);
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,159 @@
+/*
+ * The per-user storage report: HOMES home directories, each with
+ * SUBDIRECTORIES subdirectories of FILES_PER_DIRECTORY files, summed per
+ * home. Timed as a sequential walk that stats every entry by full path
+ * (opendir plus lstat, as the engine's recursive helpers did), then
+ * through walk_tree with one thread and with the default pool, and
+ * finally as `du -d 1` through the shell. The tree is in the kernel's
+ * dentry cache after the first pass, so this measures CPU cost.
+ *
+ *   make bench && ./bench/bench_walk [homes]
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "shell.h"
+#include "vfs.h"
+#include "walk.h"
+#include "bench_util.h"
+
+#define SUBDIRECTORIES 8
+#define FILES_PER_DIRECTORY 25
+#define ROUNDS 3
+
+static unsigned long long sequential_blocks(char *path, size_t length, unsigned long *entries) {
+    unsigned long long blocks = 0;
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        size_t name_length = strlen(entry->d_name);
+        path[length] = '/';
+        memcpy(path + length + 1, entry->d_name, name_length + 1);
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            ++*entries;
+            blocks += (unsigned long long)st.st_blocks;
+            if (S_ISDIR(st.st_mode)) {
+                blocks += sequential_blocks(path, length + 1 + name_length, entries);
+            }
+        }
+    }
+    path[length] = '\0';
+    closedir(dir);
+    return blocks;
+}
+
+static unsigned long count_entries(const WalkEntry *entry) {
+    unsigned long count = 1;
+    for (size_t i = 0; i < entry->child_count; ++i) {
+        count += count_entries(entry->children[i]);
+    }
+    return count;
+}
+
+static bool directories_only(const WalkEntry *entry, void *context) {
+    (void)context;
+    return S_ISDIR(entry->mode);
+}
+
+static void run_walk(const char *label, const char *homes, int threads) {
+    WalkOptions options = {.max_depth = -1, .hidden = true, .threads = threads, .keep = directories_only};
+    double best = 1e9;
+    unsigned long long blocks = 0;
+    unsigned long kept = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        double start = now_seconds();
+        WalkEntry *root = walk_tree(homes, &options);
+        double seconds = now_seconds() - start;
+        best = seconds < best ? seconds : best;
+        blocks = root != NULL ? root->total_blocks : 0;
+        kept = root != NULL ? count_entries(root) : 0;
+        walk_free(root);
+    }
+    printf("%-30s %10.1f %14llu  (%lu directories kept)\n", label, best * 1e3, blocks, kept);
+}
+
+static int discard_output(void *context, const char *data, size_t length) {
+    (void)data;
+    *(size_t *)context += length;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int homes = argc > 1 ? atoi(argv[1]) : 500;
+
+    char root[] = "/tmp/genix-walk-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char sandbox[320];
+    snprintf(sandbox, sizeof(sandbox), "%s/sandbox", root);
+    vfs_init(root, sandbox);
+    shell_init();
+
+    char path[PATH_MAX];
+    for (int h = 0; h < homes; ++h) {
+        for (int d = 0; d < SUBDIRECTORIES; ++d) {
+            snprintf(path, sizeof(path), "%s/home/student%03d/dir%d", root, h, d);
+            char command[PATH_MAX + 16];
+            snprintf(command, sizeof(command), "mkdir -p %s", path);
+            if (system(command) != 0) {
+                return 1;
+            }
+            size_t length = strlen(path);
+            for (int f = 0; f < FILES_PER_DIRECTORY; ++f) {
+                snprintf(path + length, sizeof(path) - length, "/file%02d.txt", f);
+                FILE *file = fopen(path, "w");
+                if (file == NULL) {
+                    perror(path);
+                    return 1;
+                }
+                fprintf(file, "%*d\n", (h * 131 + f * 17) % 4000, f);
+                fclose(file);
+            }
+        }
+    }
+
+    char homes_path[PATH_MAX];
+    snprintf(homes_path, sizeof(homes_path), "%s/home", root);
+    printf("%d homes, %d files\n", homes, homes * SUBDIRECTORIES * FILES_PER_DIRECTORY);
+    printf("%-30s %10s %14s\n", "", "ms", "512B blocks");
+
+    double best = 1e9;
+    unsigned long long blocks = 0;
+    unsigned long entries = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        entries = 0;
+        snprintf(path, sizeof(path), "%s", homes_path);
+        double start = now_seconds();
+        blocks = sequential_blocks(path, strlen(path), &entries);
+        double seconds = now_seconds() - start;
+        best = seconds < best ? seconds : best;
+    }
+    printf("%-30s %10.1f %14llu  (%lu entries)\n", "sequential, lstat by path", best * 1e3, blocks, entries);
+
+    run_walk("walk_tree, 1 thread", homes_path, 1);
+    run_walk("walk_tree, default pool", homes_path, 0);
+
+    ShellSession *session = shell_session_create();
+    size_t output = 0;
+    double start = now_seconds();
+    shell_session_execute(session, "du -d 1 home", discard_output, &output);
+    printf("%-30s %10.1f  (%zu bytes of report)\n", "du -d 1 home", (now_seconds() - start) * 1e3, output);
+    shell_session_destroy(session);
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    return system(command) == 0 ? 0 : 1;
+}
@@ -0,0 +1,1310 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "builtins.h"
+#include "dircache.h"
+#include "grep.h"
+#include "search.h"
+#include "vfs.h"
+#include "walk.h"
+
+#define BUILTIN_PATH_SIZE 512
+#define DEFAULT_LINE_COUNT 10
+#define FIND_MAX_TESTS 32
+#define TREE_PREFIX_SIZE 4096
+
+typedef unsigned long long OptionSet;
+
+typedef struct {
+    size_t lines;
+    size_t words;
+    size_t bytes;
+} WordCount;
+
+typedef struct {
+    bool all;  // -a: files too
+    bool apparent;  // -b: bytes of content rather than disk usage
+    bool human;  // -h
+    int max_depth;  // -d N, 0 for -s, -1 for every level
+} DuOptions;
+
+typedef struct {
+    const DuOptions *options;
+    ShellOutput *out;
+    int result;
+    char path[PATH_MAX];
+} DuRun;
+
+typedef struct {
+    ShellOutput *out;
+    bool directories_only;  // -d
+    size_t directories;
+    size_t files;
+    char prefix[TREE_PREFIX_SIZE];  // the branches drawn left of the current level
+    size_t prefix_length;
+} TreeRun;
+
+typedef enum {
+    FIND_NAME,
+    FIND_INAME,
+    FIND_TYPE,
+    FIND_SIZE,
+    FIND_MTIME,
+    FIND_MMIN
+} FindKind;
+
+typedef struct {
+    FindKind kind;
+    bool negate;
+    const char *pattern;
+    mode_t type;
+    int compare;  // -1 for -N, 1 for +N, 0 for exactly N
+    long long value;
+    long long unit;  // -size: bytes per unit, rounded up like find(1)
+} FindTest;
+
+// The tests are ANDed; they run on the walker's threads
+typedef struct {
+    FindTest tests[FIND_MAX_TESTS];
+    size_t count;
+    int min_depth;
+    int max_depth;
+    time_t now;
+    const char *root_name;  // what -name sees for the operand itself
+} FindQuery;
+
+typedef struct {
+    ShellOutput *out;
+    int result;
+    char path[PATH_MAX];
+} FindRun;
+
+static int parse_options(const ShellArgs *args, const char *allowed, OptionSet *options, ShellOutput *out);
+static bool has_option(OptionSet options, char option);
+static OptionSet option_bit(char option);
+static int parse_line_count(const ShellArgs *args, long *count, int *first_operand, ShellOutput *out);
+static bool resolve_operand(const ShellArgs *args, const char *operand, char *relative, char *full_path,
+                            ShellOutput *out);
+static int map_operand(const ShellArgs *args, const char *operand, VfsView *view);
+static void format_time(long long seconds, char *buffer, size_t size);
+static void list_directory(const char *path, OptionSet options, ShellOutput *out);
+static int remove_tree(char *path, size_t capacity);
+static const char *base_name(const char *path);
+static void write_head(const VfsView *view, long count, ShellOutput *out);
+static void write_tail(const VfsView *view, long count, ShellOutput *out);
+static bool input_view(const ShellArgs *args, VfsView *view);
+static void count_words(const VfsView *view, WordCount *counts);
+static void write_counts(const WordCount *counts, OptionSet options, const char *name, ShellOutput *out);
+static int grep_operand(const ShellArgs *args, const GrepPattern *pattern, const char *operand, const char *label,
+                        bool recursive, size_t *matches, ShellOutput *out);
+static bool parse_depth(const ShellArgs *args, const char *value, int *depth, ShellOutput *out);
+static WalkEntry *walk_operand(const ShellArgs *args, const char *operand, const WalkOptions *options,
+                               ShellOutput *out);
+static size_t join_path(char *path, size_t length, size_t size, const char *name);
+static bool du_keep(const WalkEntry *entry, void *context);
+static void du_entry(DuRun *run, const WalkEntry *entry, size_t length);
+static void format_human(unsigned long long bytes, char *buffer, size_t size);
+static bool tree_keep(const WalkEntry *entry, void *context);
+static void tree_children(TreeRun *run, const WalkEntry *directory);
+static bool starts_expression(const char *arg);
+static bool parse_find_tests(const ShellArgs *args, int first, FindQuery *query, ShellOutput *out);
+static bool parse_find_number(const char *value, FindTest *test);
+static bool find_keep(const WalkEntry *entry, void *context);
+static bool find_test(const FindQuery *query, const FindTest *test, const WalkEntry *entry);
+static void find_entry(FindRun *run, const WalkEntry *entry, size_t length);
+
+int builtin_ls(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "al1", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+
+    const char *default_target[] = {"."};
+    const char *const *targets = first < args->argc ? (const char *const *)&args->argv[first] : default_target;
+    int target_count = first < args->argc ? args->argc - first : 1;
+    int result = SHELL_OK;
+
+    for (int i = 0; i < target_count; ++i) {
+        char relative[BUILTIN_PATH_SIZE];
+        char full_path[BUILTIN_PATH_SIZE];
+        struct stat st;
+        if (!resolve_operand(args, targets[i], relative, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (stat(full_path, &st) != 0) {
+            shell_output_error(out, "ls: cannot access '%s': No such file or directory\n", targets[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            if (has_option(options, 'l')) {
+                char when[32];
+                format_time((long long)st.st_mtime, when, sizeof(when));
+                shell_output_printf(out, "- %10lld %s %s\n", (long long)st.st_size, when, targets[i]);
+            } else {
+                shell_output_printf(out, "%s\n", targets[i]);
+            }
+            continue;
+        }
+        if (target_count > 1) {
+            shell_output_printf(out, "%s%s:\n", i > 0 ? "\n" : "", targets[i]);
+        }
+        list_directory(relative, options, out);
+    }
+    return result;
+}
+
+int builtin_cat(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc < 2) {
+        if (args->input == NULL) {
+            shell_output_error(out, "cat: missing file operand\n");
+            return SHELL_ERROR;
+        }
+        shell_output_write(out, args->input, args->input_size);
+        return SHELL_OK;
+    }
+
+    int result = SHELL_OK;
+    for (int i = 1; i < args->argc; ++i) {
+        char relative[BUILTIN_PATH_SIZE];
+        char full_path[BUILTIN_PATH_SIZE];
+        struct stat st;
+        if (!resolve_operand(args, args->argv[i], relative, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            shell_output_error(out, "cat: %s: Is a directory\n", args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        VfsView view;
+        if (vfs_map(relative, &view) != 0) {
+            shell_output_error(out, "cat: %s: No such file or directory\n", args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        shell_output_write(out, view.data, view.size);
+        vfs_release(&view);
+    }
+    return result;
+}
+
+int builtin_echo(const ShellArgs *args, ShellOutput *out) {
+    int first = 1;
+    bool newline = true;
+    if (args->argc > 1 && strcmp(args->argv[1], "-n") == 0) {
+        newline = false;
+        first = 2;
+    }
+    for (int i = first; i < args->argc; ++i) {
+        shell_output_printf(out, "%s%s", i > first ? " " : "", args->argv[i]);
+    }
+    if (newline) {
+        shell_output_write(out, "\n", 1);
+    }
+    return SHELL_OK;
+}
+
+int builtin_grep(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "icnvlrREF", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+    if (first >= args->argc) {
+        shell_output_error(out, "grep: missing pattern\n");
+        return SHELL_ERROR;
+    }
+
+    GrepOptions grep_options = {
+        .ignore_case = has_option(options, 'i'),
+        .invert = has_option(options, 'v'),
+        .count_only = has_option(options, 'c'),
+        .files_only = has_option(options, 'l'),
+        .line_numbers = has_option(options, 'n'),
+        .fixed = has_option(options, 'F'),
+        .extended = has_option(options, 'E'),
+        .separator = ':',
+    };
+    GrepPattern pattern;
+    char message[128];
+    if (grep_compile(&pattern, args->argv[first], &grep_options, message, sizeof(message)) != 0) {
+        shell_output_error(out, "grep: %s\n", message);
+        return SHELL_ERROR;
+    }
+    ++first;
+
+    bool recursive = has_option(options, 'r') || has_option(options, 'R');
+    size_t matches = 0;
+    int result = SHELL_OK;
+    VfsView view;
+    if (first >= args->argc && recursive) {
+        // Like grep(1), -r without files searches the working directory
+        result = grep_operand(args, &pattern, ".", NULL, true, &matches, out);
+    } else if (first >= args->argc) {
+        if (input_view(args, &view)) {
+            matches = grep_buffer(&pattern, view.data, view.size, NULL, out);
+        } else {
+            shell_output_error(out, "grep: missing file operand\n");
+            result = SHELL_ERROR;
+        }
+    }
+    bool label = args->argc - first > 1 || recursive || grep_options.files_only;
+    for (int i = first; i < args->argc; ++i) {
+        const char *operand = args->argv[i];
+        if (grep_operand(args, &pattern, operand, label ? operand : NULL, recursive, &matches, out) != SHELL_OK) {
+            result = SHELL_ERROR;
+        }
+    }
+    grep_free(&pattern);
+
+    // Like grep(1), finding nothing is a failure so `grep x f && ...` works
+    return result == SHELL_OK && matches == 0 ? SHELL_ERROR : result;
+}
+
+int builtin_mkdir(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "p", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+    if (first >= args->argc) {
+        shell_output_error(out, "mkdir: missing operand\n");
+        return SHELL_ERROR;
+    }
+
+    int result = SHELL_OK;
+    for (int i = first; i < args->argc; ++i) {
+        char full_path[BUILTIN_PATH_SIZE];
+        if (!resolve_operand(args, args->argv[i], NULL, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+
+        if (has_option(options, 'p')) {
+            // Create each missing ancestor below the project root in turn
+            char root[BUILTIN_PATH_SIZE];
+            size_t root_length = vfs_resolve(".", root, sizeof(root)) == 0 ? strlen(root) : 0;
+            // The root itself (`mkdir -p .`) has no ancestors left to create
+            char *slash = full_path[root_length] == '/' ? strchr(full_path + root_length + 1, '/') : NULL;
+            for (; slash != NULL; slash = strchr(slash + 1, '/')) {
+                *slash = '\0';
+                if (mkdir(full_path, 0755) == 0) {
+                    dircache_invalidate_parent(full_path);
+                }
+                *slash = '/';
+            }
+        }
+        if (mkdir(full_path, 0755) != 0) {
+            if (errno == EEXIST && has_option(options, 'p')) {
+                continue;
+            }
+            shell_output_error(out, "mkdir: cannot create directory '%s': %s\n", args->argv[i], strerror(errno));
+            result = SHELL_ERROR;
+            continue;
+        }
+        dircache_invalidate_parent(full_path);
+    }
+    return result;
+}
+
+int builtin_rm(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "rRf", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+    bool recursive = has_option(options, 'r') || has_option(options, 'R');
+    bool force = has_option(options, 'f');
+    if (first >= args->argc && !force) {
+        shell_output_error(out, "rm: missing operand\n");
+        return SHELL_ERROR;
+    }
+
+    int result = SHELL_OK;
+    for (int i = first; i < args->argc; ++i) {
+        char relative[BUILTIN_PATH_SIZE];
+        char full_path[BUILTIN_PATH_SIZE];
+        struct stat st;
+        if (!resolve_operand(args, args->argv[i], relative, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (strcmp(relative, ".") == 0) {
+            shell_output_error(out, "rm: refusing to remove '%s'\n", args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (lstat(full_path, &st) != 0) {
+            if (!force) {
+                shell_output_error(out, "rm: cannot remove '%s': No such file or directory\n", args->argv[i]);
+                result = SHELL_ERROR;
+            }
+            continue;
+        }
+
+        int status;
+        if (S_ISDIR(st.st_mode)) {
+            if (!recursive) {
+                shell_output_error(out, "rm: cannot remove '%s': Is a directory\n", args->argv[i]);
+                result = SHELL_ERROR;
+                continue;
+            }
+            status = remove_tree(full_path, sizeof(full_path));
+        } else {
+            status = unlink(full_path);
+        }
+        if (status != 0) {
+            shell_output_error(out, "rm: cannot remove '%s': %s\n", args->argv[i], strerror(errno));
+            result = SHELL_ERROR;
+        }
+        dircache_invalidate_parent(full_path);
+        search_index_update(full_path);
+    }
+    return result;
+}
+
+int builtin_touch(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc < 2) {
+        shell_output_error(out, "touch: missing file operand\n");
+        return SHELL_ERROR;
+    }
+
+    int result = SHELL_OK;
+    for (int i = 1; i < args->argc; ++i) {
+        char full_path[BUILTIN_PATH_SIZE];
+        if (!resolve_operand(args, args->argv[i], NULL, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        int fd = open(full_path, O_WRONLY | O_CREAT | O_NONBLOCK, 0644);
+        if (fd < 0 || futimens(fd, NULL) != 0) {
+            shell_output_error(out, "touch: cannot touch '%s': %s\n", args->argv[i], strerror(errno));
+            result = SHELL_ERROR;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        dircache_invalidate_parent(full_path);
+        search_index_update(full_path);
+    }
+    return result;
+}
+
+int builtin_cp(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "rR", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+    if (args->argc - first != 2) {
+        shell_output_error(out, "cp: usage: cp [-r] SOURCE DEST\n");
+        return SHELL_ERROR;
+    }
+    bool recursive = has_option(options, 'r') || has_option(options, 'R');
+    const char *source = args->argv[first];
+    char source_relative[BUILTIN_PATH_SIZE];
+    char source_path[BUILTIN_PATH_SIZE];
+    char target_relative[BUILTIN_PATH_SIZE];
+    char target_path[BUILTIN_PATH_SIZE];
+    if (!resolve_operand(args, source, source_relative, source_path, out) ||
+        !resolve_operand(args, args->argv[first + 1], target_relative, target_path, out)) {
+        return SHELL_ERROR;
+    }
+
+    struct stat st;
+    if (stat(source_path, &st) != 0) {
+        shell_output_error(out, "cp: cannot stat '%s': No such file or directory\n", source);
+        return SHELL_ERROR;
+    }
+    if (S_ISDIR(st.st_mode) && !recursive) {
+        shell_output_error(out, "cp: -r not specified; omitting directory '%s'\n", source);
+        return SHELL_ERROR;
+    }
+
+    // Copying onto a directory puts the source inside it
+    char target[BUILTIN_PATH_SIZE];
+    struct stat target_st;
+    if (stat(target_path, &target_st) == 0 && S_ISDIR(target_st.st_mode)) {
+        int length = snprintf(target, sizeof(target), "%s/%s", target_relative, base_name(source_relative));
+        if (length < 0 || (size_t)length >= sizeof(target)) {
+            shell_output_error(out, "cp: cannot create regular file '%s': Path too long\n", args->argv[first + 1]);
+            return SHELL_ERROR;
+        }
+    } else {
+        snprintf(target, sizeof(target), "%s", target_relative);
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        size_t failed = 0;
+        if (vfs_copy_tree(source_relative, target, &failed) < 0) {
+            shell_output_error(out, "cp: cannot copy '%s': %s\n", source, strerror(errno));
+            return SHELL_ERROR;
+        }
+        if (failed > 0) {
+            shell_output_error(out, "cp: %zu file%s under '%s' could not be copied\n", failed, failed == 1 ? "" : "s",
+                               source);
+            return SHELL_ERROR;
+        }
+        return SHELL_OK;
+    }
+
+    VfsView view;
+    if (vfs_map(source_relative, &view) != 0) {
+        shell_output_error(out, "cp: cannot open '%s' for reading\n", source);
+        return SHELL_ERROR;
+    }
+    VfsWriter writer;
+    int status = vfs_writer_open(&writer, target);
+    if (status == 0) {
+        vfs_writer_write(&writer, view.data, view.size);
+        status = vfs_writer_close(&writer);
+    }
+    vfs_release(&view);
+    if (status != 0) {
+        shell_output_error(out, "cp: cannot create regular file '%s'\n", args->argv[first + 1]);
+        return SHELL_ERROR;
+    }
+    return SHELL_OK;
+}
+
+int builtin_mv(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc != 3) {
+        shell_output_error(out, "mv: usage: mv SOURCE DEST\n");
+        return SHELL_ERROR;
+    }
+    char source_path[BUILTIN_PATH_SIZE];
+    char target_path[BUILTIN_PATH_SIZE];
+    if (!resolve_operand(args, args->argv[1], NULL, source_path, out) ||
+        !resolve_operand(args, args->argv[2], NULL, target_path, out)) {
+        return SHELL_ERROR;
+    }
+
+    struct stat st;
+    if (stat(target_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        size_t length = strlen(target_path);
+        if (snprintf(target_path + length, sizeof(target_path) - length, "/%s", base_name(args->argv[1])) >=
+            (int)(sizeof(target_path) - length)) {
+            shell_output_error(out, "mv: cannot move '%s': Path too long\n", args->argv[1]);
+            return SHELL_ERROR;
+        }
+    }
+    if (rename(source_path, target_path) != 0) {
+        shell_output_error(out, "mv: cannot move '%s' to '%s': %s\n", args->argv[1], args->argv[2], strerror(errno));
+        return SHELL_ERROR;
+    }
+    dircache_invalidate(source_path);
+    dircache_invalidate_parent(source_path);
+    dircache_invalidate_parent(target_path);
+    search_index_update(source_path);
+    search_index_update(target_path);
+    return SHELL_OK;
+}
+
+int builtin_wc(const ShellArgs *args, ShellOutput *out) {
+    OptionSet options = 0;
+    int first = parse_options(args, "lwc", &options, out);
+    if (first < 0) {
+        return SHELL_ERROR;
+    }
+    if (options == 0) {
+        options = ~0ULL;
+    }
+
+    VfsView view;
+    if (first >= args->argc) {
+        if (!input_view(args, &view)) {
+            shell_output_error(out, "wc: missing file operand\n");
+            return SHELL_ERROR;
+        }
+        WordCount counts = {0, 0, 0};
+        count_words(&view, &counts);
+        write_counts(&counts, options, NULL, out);
+        return SHELL_OK;
+    }
+
+    WordCount total = {0, 0, 0};
+    int result = SHELL_OK;
+    for (int i = first; i < args->argc; ++i) {
+        if (map_operand(args, args->argv[i], &view) != 0) {
+            shell_output_error(out, "wc: %s: No such file or directory\n", args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        WordCount counts = {0, 0, 0};
+        count_words(&view, &counts);
+        vfs_release(&view);
+
+        write_counts(&counts, options, args->argv[i], out);
+        total.lines += counts.lines;
+        total.words += counts.words;
+        total.bytes += counts.bytes;
+    }
+    if (args->argc - first > 1) {
+        write_counts(&total, options, "total", out);
+    }
+    return result;
+}
+
+static int head_or_tail(const ShellArgs *args, ShellOutput *out, bool tail) {
+    const char *command = args->argv[0];
+    long count = DEFAULT_LINE_COUNT;
+    int first = 1;
+    if (parse_line_count(args, &count, &first, out) != 0) {
+        return SHELL_ERROR;
+    }
+
+    VfsView view;
+    if (first >= args->argc) {
+        if (!input_view(args, &view)) {
+            shell_output_error(out, "%s: missing file operand\n", command);
+            return SHELL_ERROR;
+        }
+        if (tail) {
+            write_tail(&view, count, out);
+        } else {
+            write_head(&view, count, out);
+        }
+        return SHELL_OK;
+    }
+
+    int result = SHELL_OK;
+    for (int i = first; i < args->argc; ++i) {
+        if (map_operand(args, args->argv[i], &view) != 0) {
+            shell_output_error(out, "%s: cannot open '%s' for reading: No such file or directory\n", command,
+                               args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (args->argc - first > 1) {
+            shell_output_printf(out, "%s==> %s <==\n", i > first ? "\n" : "", args->argv[i]);
+        }
+        if (tail) {
+            write_tail(&view, count, out);
+        } else {
+            write_head(&view, count, out);
+        }
+        vfs_release(&view);
+    }
+    return result;
+}
+
+int builtin_head(const ShellArgs *args, ShellOutput *out) {
+    return head_or_tail(args, out, false);
+}
+
+int builtin_tail(const ShellArgs *args, ShellOutput *out) {
+    return head_or_tail(args, out, true);
+}
+
+int builtin_stat(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc < 2) {
+        shell_output_error(out, "stat: missing operand\n");
+        return SHELL_ERROR;
+    }
+
+    int result = SHELL_OK;
+    for (int i = 1; i < args->argc; ++i) {
+        char full_path[BUILTIN_PATH_SIZE];
+        struct stat st;
+        if (!resolve_operand(args, args->argv[i], NULL, full_path, out)) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        if (lstat(full_path, &st) != 0) {
+            shell_output_error(out, "stat: cannot statx '%s': No such file or directory\n", args->argv[i]);
+            result = SHELL_ERROR;
+            continue;
+        }
+        const char *type = S_ISDIR(st.st_mode)   ? "directory"
+                           : S_ISREG(st.st_mode) ? (st.st_size == 0 ? "regular empty file" : "regular file")
+                           : S_ISLNK(st.st_mode) ? "symbolic link"
+                                                 : "other";
+        char modified[32];
+        char accessed[32];
+        format_time((long long)st.st_mtime, modified, sizeof(modified));
+        format_time((long long)st.st_atime, accessed, sizeof(accessed));
+        shell_output_printf(out,
+                            "  File: %s\n"
+                            "  Size: %lld\tBlocks: %lld\t%s\n"
+                            "Access: (%04o)\tLinks: %lu\n"
+                            "Access: %s\n"
+                            "Modify: %s\n",
+                            args->argv[i], (long long)st.st_size, (long long)st.st_blocks, type,
+                            (unsigned int)(st.st_mode & 07777), (unsigned long)st.st_nlink, accessed, modified);
+    }
+    return result;
+}
+
+int builtin_du(const ShellArgs *args, ShellOutput *out) {
+    DuOptions options = {.max_depth = -1};
+    int first = 1;
+    for (; first < args->argc && args->argv[first][0] == '-' && args->argv[first][1] != '\0'; ++first) {
+        const char *arg = args->argv[first];
+        if (strcmp(arg, "--") == 0) {
+            ++first;
+            break;
+        }
+        for (const char *flag = arg + 1; *flag != '\0'; ++flag) {
+            if (*flag == 'd') {
+                const char *value = flag[1] != '\0' ? flag + 1 : first + 1 < args->argc ? args->argv[++first] : "";
+                if (!parse_depth(args, value, &options.max_depth, out)) {
+                    return SHELL_ERROR;
+                }
+                break;
+            }
+            if (strchr("absh", *flag) == NULL) {
+                shell_output_error(out, "du: invalid option -- '%c'\n", *flag);
+                return SHELL_ERROR;
+            }
+            options.all |= *flag == 'a';
+            options.apparent |= *flag == 'b';
+            options.human |= *flag == 'h';
+            options.max_depth = *flag == 's' ? 0 : options.max_depth;
+        }
+    }
+
+    const char *default_target[] = {"."};
+    const char *const *targets = first < args->argc ? (const char *const *)&args->argv[first] : default_target;
+    int target_count = first < args->argc ? args->argc - first : 1;
+    WalkOptions walk = {.max_depth = -1, .hidden = true, .keep = du_keep, .context = &options};
+    DuRun run = {.options = &options, .out = out, .result = SHELL_OK};
+    for (int i = 0; i < target_count; ++i) {
+        WalkEntry *root = walk_operand(args, targets[i], &walk, out);
+        if (root == NULL) {
+            run.result = SHELL_ERROR;
+            continue;
+        }
+        size_t length = (size_t)snprintf(run.path, sizeof(run.path), "%s", targets[i]);
+        du_entry(&run, root, length < sizeof(run.path) ? length : sizeof(run.path) - 1);
+        walk_free(root);
+    }
+    return run.result;
+}
+
+int builtin_tree(const ShellArgs *args, ShellOutput *out) {
+    TreeRun run = {.out = out};
+    WalkOptions walk = {.max_depth = -1, .keep = tree_keep, .context = &run};
+    int first = 1;
+    for (; first < args->argc && args->argv[first][0] == '-' && args->argv[first][1] != '\0'; ++first) {
+        const char *arg = args->argv[first];
+        if (strcmp(arg, "--") == 0) {
+            ++first;
+            break;
+        }
+        if (strcmp(arg, "-L") == 0) {
+            if (!parse_depth(args, first + 1 < args->argc ? args->argv[++first] : "", &walk.max_depth, out)) {
+                return SHELL_ERROR;
+            }
+        } else if (strcmp(arg, "-a") == 0) {
+            walk.hidden = true;
+        } else if (strcmp(arg, "-d") == 0) {
+            run.directories_only = true;
+        } else {
+            shell_output_error(out, "tree: invalid option '%s'\n", arg);
+            return SHELL_ERROR;
+        }
+    }
+
+    const char *default_target[] = {"."};
+    const char *const *targets = first < args->argc ? (const char *const *)&args->argv[first] : default_target;
+    int target_count = first < args->argc ? args->argc - first : 1;
+    int result = SHELL_OK;
+    for (int i = 0; i < target_count; ++i) {
+        WalkEntry *root = walk_operand(args, targets[i], &walk, out);
+        if (root == NULL) {
+            result = SHELL_ERROR;
+            continue;
+        }
+        shell_output_printf(out, "%s\n", targets[i]);
+        run.prefix_length = 0;
+        run.prefix[0] = '\0';
+        tree_children(&run, root);
+        walk_free(root);
+    }
+    shell_output_printf(out, "\n%zu director%s", run.directories, run.directories == 1 ? "y" : "ies");
+    if (!run.directories_only) {
+        shell_output_printf(out, ", %zu file%s", run.files, run.files == 1 ? "" : "s");
+    }
+    shell_output_write(out, "\n", 1);
+    return result;
+}
+
+int builtin_find(const ShellArgs *args, ShellOutput *out) {
+    FindQuery query = {.max_depth = -1, .now = time(NULL)};
+    int first_test = 1;
+    while (first_test < args->argc && !starts_expression(args->argv[first_test])) {
+        ++first_test;
+    }
+    if (!parse_find_tests(args, first_test, &query, out)) {
+        return SHELL_ERROR;
+    }
+
+    const char *default_target[] = {"."};
+    const char *const *targets = first_test > 1 ? (const char *const *)&args->argv[1] : default_target;
+    int target_count = first_test > 1 ? first_test - 1 : 1;
+    WalkOptions walk = {.max_depth = query.max_depth, .hidden = true, .keep = find_keep, .context = &query};
+    FindRun run = {.out = out, .result = SHELL_OK};
+    for (int i = 0; i < target_count; ++i) {
+        query.root_name = base_name(targets[i]);
+        WalkEntry *root = walk_operand(args, targets[i], &walk, out);
+        if (root == NULL) {
+            run.result = SHELL_ERROR;
+            continue;
+        }
+        size_t length = (size_t)snprintf(run.path, sizeof(run.path), "%s", targets[i]);
+        find_entry(&run, root, length < sizeof(run.path) ? length : sizeof(run.path) - 1);
+        walk_free(root);
+    }
+    return run.result;
+}
+
+// Collects leading "-xyz" flags; returns the index of the first operand
+static int parse_options(const ShellArgs *args, const char *allowed, OptionSet *options, ShellOutput *out) {
+    int i = 1;
+    for (; i < args->argc; ++i) {
+        const char *arg = args->argv[i];
+        if (strcmp(arg, "--") == 0) {
+            return i + 1;
+        }
+        if (arg[0] != '-' || arg[1] == '\0') {
+            break;
+        }
+        for (const char *flag = arg + 1; *flag != '\0'; ++flag) {
+            if (strchr(allowed, *flag) == NULL || !isalnum((unsigned char)*flag)) {
+                shell_output_error(out, "%s: invalid option -- '%c'\n", args->argv[0], *flag);
+                return -1;
+            }
+            *options |= option_bit(*flag);
+        }
+    }
+    return i;
+}
+
+static bool has_option(OptionSet options, char option) {
+    return (options & option_bit(option)) != 0;
+}
+
+// Digits, upper and lower case letters each get their own bit
+static OptionSet option_bit(char option) {
+    if (isdigit((unsigned char)option)) {
+        return 1ULL << (option - '0');
+    }
+    if (isupper((unsigned char)option)) {
+        return 1ULL << (10 + option - 'A');
+    }
+    return 1ULL << (36 + option - 'a');
+}
+
+// Accepts "-n N", "-nN" and "-N" before the file operands
+static int parse_line_count(const ShellArgs *args, long *count, int *first_operand, ShellOutput *out) {
+    int i = 1;
+    while (i < args->argc && args->argv[i][0] == '-' && args->argv[i][1] != '\0') {
+        const char *arg = args->argv[i];
+        const char *value = NULL;
+        if (strcmp(arg, "-n") == 0) {
+            if (i + 1 >= args->argc) {
+                shell_output_error(out, "%s: option requires an argument -- 'n'\n", args->argv[0]);
+                return -1;
+            }
+            value = args->argv[++i];
+        } else if (arg[1] == 'n') {
+            value = arg + 2;
+        } else {
+            value = arg + 1;
+        }
+        char *end = NULL;
+        long parsed = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || parsed < 0) {
+            shell_output_error(out, "%s: invalid number of lines: '%s'\n", args->argv[0], value);
+            return -1;
+        }
+        *count = parsed;
+        ++i;
+    }
+    *first_operand = i;
+    return 0;
+}
+
+// Resolves an operand against the working directory; `relative` (may be
+// NULL) receives the root-relative path, `full_path` the filesystem one
+static bool resolve_operand(const ShellArgs *args, const char *operand, char *relative, char *full_path,
+                            ShellOutput *out) {
+    char buffer[BUILTIN_PATH_SIZE];
+    relative = relative != NULL ? relative : buffer;
+    if (!shell_resolve_path(args, operand, relative, BUILTIN_PATH_SIZE) ||
+        vfs_resolve(relative, full_path, BUILTIN_PATH_SIZE) != 0) {
+        shell_output_error(out, "%s: cannot access '%s': Invalid path\n", args->argv[0], operand);
+        return false;
+    }
+    return true;
+}
+
+static int map_operand(const ShellArgs *args, const char *operand, VfsView *view) {
+    char relative[BUILTIN_PATH_SIZE];
+    if (!shell_resolve_path(args, operand, relative, sizeof(relative))) {
+        return -1;
+    }
+    return vfs_map(relative, view);
+}
+
+static void format_time(long long seconds, char *buffer, size_t size) {
+    time_t value = (time_t)seconds;
+    struct tm local;
+    localtime_r(&value, &local);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &local);
+}
+
+static void list_directory(const char *path, OptionSet options, ShellOutput *out) {
+    const DirListing *listing = vfs_list_acquire(path);
+    if (listing == NULL) {
+        shell_output_error(out, "ls: cannot open directory '%s'\n", path);
+        return;
+    }
+    for (size_t i = 0; i < listing->count; ++i) {
+        const DirCacheEntry *entry = &listing->entries[i];
+        if (entry->name[0] == '.' && !has_option(options, 'a')) {
+            continue;
+        }
+        if (has_option(options, 'l')) {
+            char when[32];
+            format_time(entry->mtime_ms / 1000, when, sizeof(when));
+            char type = entry->type == DIRCACHE_ENTRY_DIRECTORY ? 'd' : entry->type == DIRCACHE_ENTRY_FILE ? '-' : '?';
+            shell_output_printf(out, "%c %10lld %s %s\n", type, entry->size, when, entry->name);
+        } else {
+            shell_output_printf(out, "%s\n", entry->name);
+        }
+    }
+    vfs_list_release(listing);
+}
+
+// Depth-first removal; `path` is extended in place and restored on return
+static int remove_tree(char *path, size_t capacity) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+    size_t length = strlen(path);
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(path + length, capacity - length, "/%s", entry->d_name) >= (int)(capacity - length)) {
+            errno = ENAMETOOLONG;
+            result = -1;
+            continue;
+        }
+        struct stat st;
+        if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            if (remove_tree(path, capacity) != 0) {
+                result = -1;
+            }
+        } else if (unlink(path) != 0) {
+            result = -1;
+        }
+    }
+    closedir(dir);
+    path[length] = '\0';
+
+    dircache_invalidate(path);
+    if (result == 0 && rmdir(path) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+static const char *base_name(const char *path) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') {
+        --length;
+    }
+    const char *name = path + length;
+    while (name > path && name[-1] != '/') {
+        --name;
+    }
+    return name;
+}
+
+static void write_head(const VfsView *view, long count, ShellOutput *out) {
+    size_t end = 0;
+    for (long lines = 0; end < view->size && lines < count; ++lines) {
+        const char *newline = (const char *)memchr(view->data + end, '\n', view->size - end);
+        end = newline != NULL ? (size_t)(newline - view->data) + 1 : view->size;
+    }
+    shell_output_write(out, view->data, end);
+}
+
+static void write_tail(const VfsView *view, long count, ShellOutput *out) {
+    size_t start = view->size;
+    // A trailing newline ends the last line rather than starting a new one
+    size_t scan = start > 0 && view->data[start - 1] == '\n' ? start - 1 : start;
+    long lines = 0;
+    while (scan > 0 && count > 0) {
+        if (view->data[scan - 1] == '\n' && ++lines == count) {
+            break;
+        }
+        --scan;
+    }
+    start = count > 0 ? scan : view->size;
+    shell_output_write(out, view->data + start, view->size - start);
+}
+
+// Standard input is only available inside a pipeline or after `<`
+static bool input_view(const ShellArgs *args, VfsView *view) {
+    if (args->input == NULL) {
+        return false;
+    }
+    view->data = args->input;
+    view->size = args->input_size;
+    view->mapping = NULL;
+    view->page = NULL;
+    return true;
+}
+
+static void count_words(const VfsView *view, WordCount *counts) {
+    bool in_word = false;
+    for (size_t i = 0; i < view->size; ++i) {
+        unsigned char c = (unsigned char)view->data[i];
+        counts->lines += c == '\n';
+        if (isspace(c)) {
+            in_word = false;
+        } else if (!in_word) {
+            in_word = true;
+            counts->words++;
+        }
+    }
+    counts->bytes = view->size;
+}
+
+static void write_counts(const WordCount *counts, OptionSet options, const char *name, ShellOutput *out) {
+    const size_t values[] = {counts->lines, counts->words, counts->bytes};
+    const char flags[] = {'l', 'w', 'c'};
+    const char *separator = "";
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        if (has_option(options, flags[i])) {
+            shell_output_printf(out, "%s%7zu", separator, values[i]);
+            separator = " ";
+        }
+    }
+    // Standard input has no name to print
+    if (name != NULL) {
+        shell_output_printf(out, " %s", name);
+    }
+    shell_output_write(out, "\n", 1);
+}
+
+// Directories are searched through the trigram index with -r; labels
+// keep the operand as written, so `grep -r x src` prints "src/a.c"
+static int grep_operand(const ShellArgs *args, const GrepPattern *pattern, const char *operand, const char *label,
+                        bool recursive, size_t *matches, ShellOutput *out) {
+    char relative[BUILTIN_PATH_SIZE];
+    char full_path[BUILTIN_PATH_SIZE];
+    struct stat st;
+    if (!resolve_operand(args, operand, relative, full_path, out)) {
+        return SHELL_ERROR;
+    }
+    if (stat(full_path, &st) != 0) {
+        shell_output_error(out, "grep: %s: No such file or directory\n", operand);
+        return SHELL_ERROR;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        if (!recursive) {
+            shell_output_error(out, "grep: %s: Is a directory\n", operand);
+            return SHELL_ERROR;
+        }
+        long found = grep_tree(pattern, full_path, label, out);
+        if (found < 0) {
+            shell_output_error(out, "grep: %s: Cannot read directory\n", operand);
+            return SHELL_ERROR;
+        }
+        *matches += (size_t)found;
+        return SHELL_OK;
+    }
+    VfsView view;
+    if (vfs_map(relative, &view) != 0) {
+        shell_output_error(out, "grep: %s: No such file or directory\n", operand);
+        return SHELL_ERROR;
+    }
+    *matches += grep_buffer(pattern, view.data, view.size, label, out);
+    vfs_release(&view);
+    return SHELL_OK;
+}
+
+static bool parse_depth(const ShellArgs *args, const char *value, int *depth, ShellOutput *out) {
+    char *end = NULL;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < 0 || parsed > INT_MAX) {
+        shell_output_error(out, "%s: invalid depth '%s'\n", args->argv[0], value);
+        return false;
+    }
+    *depth = (int)parsed;
+    return true;
+}
+
+static WalkEntry *walk_operand(const ShellArgs *args, const char *operand, const WalkOptions *options,
+                               ShellOutput *out) {
+    char full_path[BUILTIN_PATH_SIZE];
+    if (!resolve_operand(args, operand, NULL, full_path, out)) {
+        return NULL;
+    }
+    WalkEntry *root = walk_tree(full_path, options);
+    if (root == NULL) {
+        shell_output_error(out, "%s: cannot access '%s': %s\n", args->argv[0], operand, strerror(errno));
+    }
+    return root;
+}
+
+// Appends "/name" to the `length` bytes in `path`; returns the new length,
+// or 0 if it does not fit
+static size_t join_path(char *path, size_t length, size_t size, const char *name) {
+    size_t separator = length > 0 && path[length - 1] != '/';
+    size_t name_length = strlen(name);
+    if (length + separator + name_length >= size) {
+        return 0;
+    }
+    path[length] = '/';
+    memcpy(path + length + separator, name, name_length + 1);
+    return length + separator + name_length;
+}
+
+static bool du_keep(const WalkEntry *entry, void *context) {
+    const DuOptions *options = (const DuOptions *)context;
+    return S_ISDIR(entry->mode) || (options->all && (options->max_depth < 0 || entry->depth <= options->max_depth));
+}
+
+// Children before their directory, like du(1); `run->path` holds `length`
+// bytes naming `entry` and is extended in place
+static void du_entry(DuRun *run, const WalkEntry *entry, size_t length) {
+    if (entry->error != 0) {
+        shell_output_error(run->out, "du: cannot read directory '%s': %s\n", run->path, strerror(entry->error));
+        run->result = SHELL_ERROR;
+    }
+    for (size_t i = 0; i < entry->child_count; ++i) {
+        size_t child_length = join_path(run->path, length, sizeof(run->path), entry->children[i]->name);
+        if (child_length > 0) {
+            du_entry(run, entry->children[i], child_length);
+        }
+    }
+    run->path[length] = '\0';
+
+    const DuOptions *options = run->options;
+    if ((options->max_depth >= 0 && entry->depth > options->max_depth) ||
+        (!S_ISDIR(entry->mode) && entry->depth > 0 && !options->all)) {
+        return;
+    }
+    unsigned long long bytes = options->apparent ? entry->total_size : entry->total_blocks * 512;
+    char size[32];
+    if (options->human) {
+        format_human(bytes, size, sizeof(size));
+    } else {
+        snprintf(size, sizeof(size), "%llu", options->apparent ? bytes : (bytes + 1023) / 1024);
+    }
+    shell_output_printf(run->out, "%s\t%s\n", size, run->path);
+}
+
+// du -h: one decimal below 10, rounded up like du(1)
+static void format_human(unsigned long long bytes, char *buffer, size_t size) {
+    static const char units[] = "KMGTPE";
+    if (bytes < 1024) {
+        snprintf(buffer, size, "%llu", bytes);
+        return;
+    }
+    double value = (double)bytes / 1024.0;
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) - 1) {
+        value /= 1024.0;
+        ++unit;
+    }
+    double tenths = ceil(value * 10.0) / 10.0;
+    if (tenths < 10.0) {
+        snprintf(buffer, size, "%.1f%c", tenths, units[unit]);
+    } else {
+        snprintf(buffer, size, "%.0f%c", ceil(value), units[unit]);
+    }
+}
+
+static bool tree_keep(const WalkEntry *entry, void *context) {
+    return !((const TreeRun *)context)->directories_only || S_ISDIR(entry->mode);
+}
+
+static void tree_children(TreeRun *run, const WalkEntry *directory) {
+    for (size_t i = 0; i < directory->child_count; ++i) {
+        const WalkEntry *child = directory->children[i];
+        bool last = i + 1 == directory->child_count;
+        shell_output_printf(run->out, "%s%s%s%s\n", run->prefix, last ? "└── " : "├── ", child->name,
+                            child->error != 0 ? "  [error opening dir]" : "");
+        if (!S_ISDIR(child->mode)) {
+            ++run->files;
+            continue;
+        }
+        ++run->directories;
+        const char *branch = last ? "    " : "│   ";
+        size_t saved = run->prefix_length;
+        size_t branch_length = strlen(branch);
+        if (child->child_count > 0 && saved + branch_length < sizeof(run->prefix)) {
+            memcpy(run->prefix + saved, branch, branch_length + 1);
+            run->prefix_length += branch_length;
+            tree_children(run, child);
+            run->prefix_length = saved;
+            run->prefix[saved] = '\0';
+        }
+    }
+}
+
+static bool starts_expression(const char *arg) {
+    return (arg[0] == '-' && arg[1] != '\0') || strcmp(arg, "!") == 0 || strcmp(arg, "(") == 0;
+}
+
+static bool parse_find_tests(const ShellArgs *args, int first, FindQuery *query, ShellOutput *out) {
+    bool negate = false;
+    for (int i = first; i < args->argc; ++i) {
+        const char *arg = args->argv[i];
+        if (strcmp(arg, "!") == 0 || strcmp(arg, "-not") == 0) {
+            negate = !negate;
+            continue;
+        }
+        if (strcmp(arg, "-print") == 0 || strcmp(arg, "-a") == 0 || strcmp(arg, "-and") == 0) {
+            continue;
+        }
+        static const char *const names[] = {"-name", "-iname", "-type", "-size", "-mtime", "-mmin"};
+        size_t kind = 0;
+        while (kind < sizeof(names) / sizeof(names[0]) && strcmp(arg, names[kind]) != 0) {
+            ++kind;
+        }
+        bool depth = strcmp(arg, "-maxdepth") == 0 || strcmp(arg, "-mindepth") == 0;
+        if (kind == sizeof(names) / sizeof(names[0]) && !depth) {
+            shell_output_error(out, "find: unknown predicate '%s'\n", arg);
+            return false;
+        }
+        if (i + 1 >= args->argc) {
+            shell_output_error(out, "find: missing argument to '%s'\n", arg);
+            return false;
+        }
+        const char *value = args->argv[++i];
+        if (depth) {
+            if (!parse_depth(args, value, arg[2] == 'a' ? &query->max_depth : &query->min_depth, out)) {
+                return false;
+            }
+            continue;
+        }
+        if (query->count == FIND_MAX_TESTS) {
+            shell_output_error(out, "find: too many tests\n");
+            return false;
+        }
+
+        FindTest *test = &query->tests[query->count];
+        *test = (FindTest){.kind = (FindKind)kind, .negate = negate, .pattern = value};
+        negate = false;
+        bool valid = true;
+        if (test->kind == FIND_TYPE) {
+            test->type = strcmp(value, "f") == 0 ? S_IFREG : strcmp(value, "d") == 0 ? S_IFDIR : S_IFLNK;
+            valid = strcmp(value, "f") == 0 || strcmp(value, "d") == 0 || strcmp(value, "l") == 0;
+        } else if (test->kind != FIND_NAME && test->kind != FIND_INAME) {
+            valid = parse_find_number(value, test);
+        }
+        if (!valid) {
+            shell_output_error(out, "find: invalid argument '%s' to '%s'\n", value, arg);
+            return false;
+        }
+        ++query->count;
+    }
+    if (negate) {
+        shell_output_error(out, "find: expected an expression after '!'\n");
+        return false;
+    }
+    return true;
+}
+
+// [+-]N, with a unit suffix (c w b k M G) for -size
+static bool parse_find_number(const char *value, FindTest *test) {
+    test->compare = value[0] == '+' ? 1 : value[0] == '-' ? -1 : 0;
+    const char *digits = value + (test->compare != 0);
+    if (!isdigit((unsigned char)digits[0])) {
+        return false;
+    }
+    char *end = NULL;
+    test->value = strtoll(digits, &end, 10);
+    test->unit = 512;
+    if (test->kind == FIND_SIZE && *end != '\0') {
+        static const char units[] = "cwbkMG";
+        static const long long unit_bytes[] = {1, 2, 512, 1024, 1024 * 1024, 1024 * 1024 * 1024};
+        const char *unit = strchr(units, *end);
+        if (unit == NULL) {
+            return false;
+        }
+        test->unit = unit_bytes[unit - units];
+        ++end;
+    }
+    return *end == '\0';
+}
+
+static bool find_keep(const WalkEntry *entry, void *context) {
+    const FindQuery *query = (const FindQuery *)context;
+    if (entry->depth < query->min_depth) {
+        return false;
+    }
+    for (size_t i = 0; i < query->count; ++i) {
+        if (find_test(query, &query->tests[i], entry) == query->tests[i].negate) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool find_test(const FindQuery *query, const FindTest *test, const WalkEntry *entry) {
+    const char *name = entry->depth == 0 ? query->root_name : entry->name;
+    long long measured;
+    switch (test->kind) {
+        case FIND_NAME:
+            return fnmatch(test->pattern, name, 0) == 0;
+        case FIND_INAME:
+            return fnmatch(test->pattern, name, FNM_CASEFOLD) == 0;
+        case FIND_TYPE:
+            return (entry->mode & S_IFMT) == test->type;
+        case FIND_SIZE:
+            measured = ((long long)entry->size + test->unit - 1) / test->unit;
+            break;
+        case FIND_MTIME:
+            measured = (long long)(query->now - entry->mtime) / 86400;
+            break;
+        default:
+            measured = (long long)(query->now - entry->mtime) / 60;
+            break;
+    }
+    return test->compare < 0 ? measured < test->value : test->compare > 0 ? measured > test->value
+                                                                          : measured == test->value;
+}
+
+// Directories before their contents, like find(1)
+static void find_entry(FindRun *run, const WalkEntry *entry, size_t length) {
+    if (entry->matched) {
+        shell_output_write(run->out, run->path, length);
+        shell_output_write(run->out, "\n", 1);
+    }
+    if (entry->error != 0) {
+        shell_output_error(run->out, "find: '%s': %s\n", run->path, strerror(entry->error));
+        run->result = SHELL_ERROR;
+    }
+    for (size_t i = 0; i < entry->child_count; ++i) {
+        size_t child_length = join_path(run->path, length, sizeof(run->path), entry->children[i]->name);
+        if (child_length > 0) {
+            find_entry(run, entry->children[i], child_length);
+        }
+    }
+    run->path[length] = '\0';
+}
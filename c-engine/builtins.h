@@ -0,0 +1,30 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "shell.h"
+
+/**
+ * File commands implemented in-process on the VFS, so the shell never
+ * forks for them. Paths are relative to the project root and may not
+ * contain ".." components. Commands that take files read `args->input`
+ * instead when given none. Each returns SHELL_OK or SHELL_ERROR and writes
+ * coreutils-style diagnostics with shell_output_error().
+ */
+int builtin_cat(const ShellArgs *args, ShellOutput *out);
+int builtin_cp(const ShellArgs *args, ShellOutput *out);
+int builtin_du(const ShellArgs *args, ShellOutput *out);
+int builtin_echo(const ShellArgs *args, ShellOutput *out);
+int builtin_find(const ShellArgs *args, ShellOutput *out);
+int builtin_grep(const ShellArgs *args, ShellOutput *out);
+int builtin_head(const ShellArgs *args, ShellOutput *out);
+int builtin_ls(const ShellArgs *args, ShellOutput *out);
+int builtin_mkdir(const ShellArgs *args, ShellOutput *out);
+int builtin_mv(const ShellArgs *args, ShellOutput *out);
+int builtin_rm(const ShellArgs *args, ShellOutput *out);
+int builtin_stat(const ShellArgs *args, ShellOutput *out);
+int builtin_tail(const ShellArgs *args, ShellOutput *out);
+int builtin_touch(const ShellArgs *args, ShellOutput *out);
+int builtin_tree(const ShellArgs *args, ShellOutput *out);
+int builtin_wc(const ShellArgs *args, ShellOutput *out);
+
+#endif // BUILTINS_H
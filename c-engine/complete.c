@@ -0,0 +1,166 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+#include "complete.h"
+#include "vfs.h"
+
+#define COMPLETE_WORD_SIZE 512
+
+static bool last_word(const char *line, size_t *start, bool *command_position, char *word, size_t size);
+static size_t complete_command(const char *prefix, ShellOutput *out);
+static size_t complete_path(ShellSession *session, const char *word, ShellOutput *out);
+static size_t lower_bound(const DirListing *listing, const char *name);
+static void write_escaped(ShellOutput *out, const char *text, size_t length);
+
+size_t complete_line(ShellSession *session, const char *line, ShellOutput *out) {
+    size_t start;
+    bool command_position;
+    char word[COMPLETE_WORD_SIZE];
+    if (!last_word(line, &start, &command_position, word, sizeof(word))) {
+        shell_output_printf(out, "%zu\n", strlen(line));
+        return 0;
+    }
+    shell_output_printf(out, "%zu\n", start);
+    if (command_position && strchr(word, '/') == NULL) {
+        return complete_command(word, out);
+    }
+    return complete_path(session, word, out);
+}
+
+// Finds the word the line ends in, unquoted, with the lexer's quoting rules.
+// A command is expected at the start and after |, & and ;.
+static bool last_word(const char *line, size_t *start, bool *command_position, char *word, size_t size) {
+    bool command = true;
+    bool in_word = false;
+    char quote = '\0';
+    size_t length = 0;
+    *start = strlen(line);
+
+    for (size_t i = 0; line[i] != '\0'; ++i) {
+        char c = line[i];
+        if (quote == '\0' && (isspace((unsigned char)c) || strchr("|&;<>", c) != NULL)) {
+            if (in_word) {
+                command = false;
+                in_word = false;
+            }
+            if (strchr("|&;", c) != NULL) {
+                command = true;
+            } else if (c == '<' || c == '>') {
+                command = false;
+            }
+            continue;
+        }
+        if (!in_word) {
+            in_word = true;
+            *start = i;
+            length = 0;
+        }
+        if (quote == '\0' && (c == '\'' || c == '"')) {
+            quote = c;
+            continue;
+        }
+        if (quote != '\0' && c == quote) {
+            quote = '\0';
+            continue;
+        }
+        if (quote != '\'' && c == '\\' && line[i + 1] != '\0') {
+            c = line[++i];
+        }
+        if (length + 1 >= size) {
+            return false;
+        }
+        word[length++] = c;
+    }
+    if (!in_word) {
+        *start = strlen(line);
+        length = 0;
+    }
+    word[length] = '\0';
+    *command_position = command;
+    return true;
+}
+
+static size_t complete_command(const char *prefix, ShellOutput *out) {
+    size_t length = strlen(prefix);
+    size_t count = 0;
+    const char *name;
+    for (size_t i = 0; (name = shell_command_name(i)) != NULL; ++i) {
+        if (strncmp(name, prefix, length) == 0) {
+            shell_output_printf(out, "%s\n", name);
+            ++count;
+        }
+    }
+    return count;
+}
+
+static size_t complete_path(ShellSession *session, const char *word, ShellOutput *out) {
+    const char *slash = strrchr(word, '/');
+    const char *name = slash != NULL ? slash + 1 : word;
+    size_t directory_length = (size_t)(name - word);
+    char directory[COMPLETE_WORD_SIZE];
+    if (slash == NULL) {
+        strcpy(directory, ".");
+    } else if (slash == word) {
+        strcpy(directory, "/");
+    } else {
+        memcpy(directory, word, directory_length - 1);
+        directory[directory_length - 1] = '\0';
+    }
+
+    ShellArgs args = {.session = session};
+    char relative[SHELL_PATH_SIZE];
+    if (!shell_resolve_path(&args, directory, relative, sizeof(relative))) {
+        return 0;
+    }
+    const DirListing *listing = vfs_list_acquire(relative);
+    if (listing == NULL) {
+        return 0;
+    }
+
+    size_t name_length = strlen(name);
+    size_t count = 0;
+    for (size_t i = lower_bound(listing, name); i < listing->count && count < COMPLETE_MAX_CANDIDATES; ++i) {
+        const DirCacheEntry *entry = &listing->entries[i];
+        if (strncmp(entry->name, name, name_length) != 0) {
+            break;
+        }
+        // Hidden entries only when asked for, as in ls
+        if (entry->name[0] == '.' && name[0] != '.') {
+            continue;
+        }
+        write_escaped(out, word, directory_length);
+        write_escaped(out, entry->name, strlen(entry->name));
+        shell_output_write(out, entry->type == DIRCACHE_ENTRY_DIRECTORY ? "/\n" : "\n",
+                           entry->type == DIRCACHE_ENTRY_DIRECTORY ? 2 : 1);
+        ++count;
+    }
+    vfs_list_release(listing);
+    return count;
+}
+
+// Index of the first entry not sorting before `name`; listings are in strcmp order
+static size_t lower_bound(const DirListing *listing, const char *name) {
+    size_t low = 0;
+    size_t high = listing->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(listing->entries[middle].name, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void write_escaped(ShellOutput *out, const char *text, size_t length) {
+    size_t plain = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (isspace((unsigned char)text[i]) || strchr("\\'\"|&;<>$", text[i]) != NULL) {
+            shell_output_write(out, text + plain, i - plain);
+            shell_output_write(out, "\\", 1);
+            plain = i;
+        }
+    }
+    shell_output_write(out, text + plain, length - plain);
+}
@@ -0,0 +1,25 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <stddef.h>
+#include "shell.h"
+
+#define COMPLETE_MAX_CANDIDATES 256
+
+/**
+ * Tab completion for the last word of a command line. Where a command is
+ * expected the word completes to a builtin name; anywhere else, or when it
+ * contains a '/', to a path resolved in the session's directory (NULL
+ * means the project root). Paths are looked up in the directory cache,
+ * whose per-directory sorted listings, kept current by inotify, act as the
+ * levels of a path trie: a lookup is one binary search in one directory,
+ * however large the tree.
+ *
+ * Writes the byte offset in `line` where the word starts on the first line,
+ * then one candidate per line: the whole replacement word, escaped for the
+ * shell, with directories ending in '/'. Returns the number of candidates,
+ * at most COMPLETE_MAX_CANDIDATES.
+ */
+size_t complete_line(ShellSession *session, const char *line, ShellOutput *out);
+
+#endif // COMPLETE_H
@@ -0,0 +1,452 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dircache.h"
+
+#define DIRCACHE_SLOTS 8192
+#define DIRCACHE_MAX_DIRECTORIES (DIRCACHE_SLOTS / 2)
+#define DIRCACHE_PATH_SIZE 512
+#define INITIAL_ENTRY_CAPACITY 32
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | \
+                    IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+typedef struct {
+    char *path;
+    uint64_t hash;
+    int wd;
+    int next_same_wd;
+    unsigned long generation;
+    DirListing *listing;
+} CacheSlot;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CacheSlot slots[DIRCACHE_SLOTS];
+static size_t slot_count = 0;
+static int *wd_slots = NULL;
+static size_t wd_capacity = 0;
+static int inotify_fd = -2;
+static DirCacheStats counters = {0};
+
+static void normalize_path(const char *path, char *out, size_t out_size);
+static uint64_t hash_path(const char *path);
+static int find_slot(const char *path, uint64_t hash);
+static int insert_slot(const char *path, uint64_t hash);
+static void ensure_inotify(void);
+static void watch_slot(int index);
+static void invalidate_slot(int index);
+static void invalidate_wd(int wd, bool watch_removed);
+static void reset_cache(void);
+static void listing_unref(DirListing *listing);
+static DirListing *build_listing(const char *full_path);
+static int compare_entries(const void *a, const void *b);
+
+const DirListing *dircache_acquire(const char *full_path) {
+    char path[DIRCACHE_PATH_SIZE];
+    normalize_path(full_path, path, sizeof(path));
+    uint64_t hash = hash_path(path);
+
+    pthread_mutex_lock(&cache_mutex);
+    ensure_inotify();
+
+    int index = find_slot(path, hash);
+    if (index >= 0 && slots[index].path != NULL && slots[index].listing != NULL) {
+        DirListing *listing = slots[index].listing;
+        listing->refs++;
+        counters.hits++;
+        pthread_mutex_unlock(&cache_mutex);
+        return listing;
+    }
+
+    counters.misses++;
+    if (index < 0 || slots[index].path == NULL) {
+        if (slot_count >= DIRCACHE_MAX_DIRECTORIES) {
+            reset_cache();
+        }
+        index = insert_slot(path, hash);
+    }
+
+    // Watch before reading so changes made during the scan are not lost
+    unsigned long generation = 0;
+    bool cacheable = false;
+    if (index >= 0) {
+        watch_slot(index);
+        generation = slots[index].generation;
+        cacheable = slots[index].wd >= 0;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+
+    DirListing *listing = build_listing(path);
+    if (listing == NULL || !cacheable) {
+        return listing;
+    }
+
+    pthread_mutex_lock(&cache_mutex);
+    index = find_slot(path, hash);
+    if (index >= 0 && slots[index].path != NULL && slots[index].generation == generation &&
+        slots[index].listing == NULL) {
+        listing->refs++;
+        slots[index].listing = listing;
+        counters.directories++;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return listing;
+}
+
+void dircache_release(const DirListing *listing) {
+    if (listing == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    listing_unref((DirListing *)listing);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void dircache_invalidate(const char *full_path) {
+    char path[DIRCACHE_PATH_SIZE];
+    normalize_path(full_path, path, sizeof(path));
+
+    pthread_mutex_lock(&cache_mutex);
+    int index = find_slot(path, hash_path(path));
+    if (index >= 0 && slots[index].path != NULL) {
+        if (slots[index].wd >= 0) {
+            invalidate_wd(slots[index].wd, false);
+        } else {
+            invalidate_slot(index);
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void dircache_invalidate_parent(const char *full_path) {
+    char parent[DIRCACHE_PATH_SIZE];
+    normalize_path(full_path, parent, sizeof(parent));
+    char *slash = strrchr(parent, '/');
+    if (slash == NULL) {
+        return;
+    }
+    if (slash == parent) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    dircache_invalidate(parent);
+}
+
+int dircache_watch_fd(void) {
+    pthread_mutex_lock(&cache_mutex);
+    ensure_inotify();
+    int fd = inotify_fd;
+    pthread_mutex_unlock(&cache_mutex);
+    return fd;
+}
+
+void dircache_process_events(void) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    pthread_mutex_lock(&cache_mutex);
+    if (inotify_fd < 0) {
+        pthread_mutex_unlock(&cache_mutex);
+        return;
+    }
+
+    while (true) {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (char *cursor = buffer; cursor < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *)cursor;
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (int i = 0; i < DIRCACHE_SLOTS; ++i) {
+                    invalidate_slot(i);
+                }
+            } else if (event->wd >= 0) {
+                invalidate_wd(event->wd, (event->mask & IN_IGNORED) != 0);
+            }
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void dircache_stats(DirCacheStats *stats) {
+    pthread_mutex_lock(&cache_mutex);
+    *stats = counters;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+static void normalize_path(const char *path, char *out, size_t out_size) {
+    snprintf(out, out_size, "%s", path);
+    size_t length = strlen(out);
+    while (length > 1) {
+        if (out[length - 1] == '/') {
+            out[--length] = '\0';
+        } else if (length > 2 && out[length - 1] == '.' && out[length - 2] == '/') {
+            length -= 2;
+            out[length] = '\0';
+        } else {
+            break;
+        }
+    }
+    if (length == 0) {
+        snprintf(out, out_size, "/");
+    }
+}
+
+static uint64_t hash_path(const char *path) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)path; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Returns the slot holding `path`, or the empty slot where it would go
+static int find_slot(const char *path, uint64_t hash) {
+    size_t mask = DIRCACHE_SLOTS - 1;
+    for (size_t probe = 0; probe < DIRCACHE_SLOTS; ++probe) {
+        size_t index = (size_t)(hash + probe) & mask;
+        CacheSlot *slot = &slots[index];
+        if (slot->path == NULL) {
+            return (int)index;
+        }
+        if (slot->hash == hash && strcmp(slot->path, path) == 0) {
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+static int insert_slot(const char *path, uint64_t hash) {
+    int index = find_slot(path, hash);
+    if (index < 0) {
+        return -1;
+    }
+    CacheSlot *slot = &slots[index];
+    if (slot->path == NULL) {
+        slot->path = strdup(path);
+        if (slot->path == NULL) {
+            return -1;
+        }
+        slot->hash = hash;
+        slot->wd = -1;
+        slot->next_same_wd = -1;
+        slot->listing = NULL;
+        slot_count++;
+    }
+    return index;
+}
+
+static void ensure_inotify(void) {
+    if (inotify_fd == -2) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+}
+
+static void watch_slot(int index) {
+    CacheSlot *slot = &slots[index];
+    if (slot->wd >= 0 || inotify_fd < 0) {
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd, slot->path, WATCH_MASK);
+    if (wd < 0) {
+        return;
+    }
+    if ((size_t)wd >= wd_capacity) {
+        size_t new_capacity = wd_capacity == 0 ? 64 : wd_capacity;
+        while (new_capacity <= (size_t)wd) {
+            new_capacity *= 2;
+        }
+        int *new_slots = (int *)realloc(wd_slots, new_capacity * sizeof(int));
+        if (new_slots == NULL) {
+            return;
+        }
+        for (size_t i = wd_capacity; i < new_capacity; ++i) {
+            new_slots[i] = -1;
+        }
+        wd_slots = new_slots;
+        wd_capacity = new_capacity;
+    }
+    // The same directory reached through different paths shares one wd
+    slot->wd = wd;
+    slot->next_same_wd = wd_slots[wd];
+    wd_slots[wd] = index;
+}
+
+static void invalidate_slot(int index) {
+    CacheSlot *slot = &slots[index];
+    slot->generation++;
+    if (slot->listing != NULL) {
+        listing_unref(slot->listing);
+        slot->listing = NULL;
+        counters.invalidations++;
+        counters.directories--;
+    }
+}
+
+static void invalidate_wd(int wd, bool watch_removed) {
+    if ((size_t)wd >= wd_capacity) {
+        return;
+    }
+    int index = wd_slots[wd];
+    while (index >= 0) {
+        int next = slots[index].next_same_wd;
+        invalidate_slot(index);
+        if (watch_removed) {
+            slots[index].wd = -1;
+            slots[index].next_same_wd = -1;
+        }
+        index = next;
+    }
+    if (watch_removed) {
+        wd_slots[wd] = -1;
+    }
+}
+
+static void reset_cache(void) {
+    for (int i = 0; i < DIRCACHE_SLOTS; ++i) {
+        CacheSlot *slot = &slots[i];
+        if (slot->path == NULL) {
+            continue;
+        }
+        invalidate_slot(i);
+        if (slot->wd >= 0 && inotify_fd >= 0) {
+            inotify_rm_watch(inotify_fd, slot->wd);
+        }
+        free(slot->path);
+        memset(slot, 0, sizeof(*slot));
+    }
+    for (size_t i = 0; i < wd_capacity; ++i) {
+        wd_slots[i] = -1;
+    }
+    slot_count = 0;
+}
+
+static void listing_unref(DirListing *listing) {
+    if (--listing->refs > 0) {
+        return;
+    }
+    free(listing->entries);
+    free(listing->text);
+    free(listing);
+}
+
+static DirListing *build_listing(const char *full_path) {
+    DIR *dir = opendir(full_path);
+    if (dir == NULL) {
+        return NULL;
+    }
+    int dir_fd = dirfd(dir);
+
+    DirCacheEntry *entries = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    char *names = NULL;
+    size_t names_length = 0;
+    size_t names_capacity = 0;
+    bool failed = false;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        size_t name_length = strlen(entry->d_name);
+        if (count == capacity) {
+            capacity = capacity == 0 ? INITIAL_ENTRY_CAPACITY : capacity * 2;
+            DirCacheEntry *new_entries = (DirCacheEntry *)realloc(entries, capacity * sizeof(DirCacheEntry));
+            if (new_entries == NULL) {
+                failed = true;
+                break;
+            }
+            entries = new_entries;
+        }
+        if (names_length + name_length + 1 > names_capacity) {
+            size_t new_capacity = names_capacity == 0 ? 1024 : names_capacity;
+            while (new_capacity < names_length + name_length + 1) {
+                new_capacity *= 2;
+            }
+            char *new_names = (char *)realloc(names, new_capacity);
+            if (new_names == NULL) {
+                failed = true;
+                break;
+            }
+            names = new_names;
+            names_capacity = new_capacity;
+        }
+
+        DirCacheEntry *item = &entries[count++];
+        // Offsets for now; names may still move while the pool grows
+        item->name = (const char *)(uintptr_t)names_length;
+        memcpy(names + names_length, entry->d_name, name_length + 1);
+        names_length += name_length + 1;
+
+        struct stat st;
+        if (fstatat(dir_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            item->type = S_ISDIR(st.st_mode) ? DIRCACHE_ENTRY_DIRECTORY
+                         : S_ISREG(st.st_mode) ? DIRCACHE_ENTRY_FILE
+                                               : DIRCACHE_ENTRY_OTHER;
+            item->size = (long long)st.st_size;
+            item->mtime_ms = (long long)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000;
+        } else {
+            item->type = DIRCACHE_ENTRY_OTHER;
+            item->size = 0;
+            item->mtime_ms = 0;
+        }
+    }
+    closedir(dir);
+
+    DirListing *listing = failed ? NULL : (DirListing *)calloc(1, sizeof(DirListing));
+    // One block: the '\n'-separated text followed by the NUL-separated names
+    char *text = listing == NULL ? NULL : (char *)malloc(2 * names_length + 2);
+    if (text == NULL) {
+        free(entries);
+        free(names);
+        free(listing);
+        return NULL;
+    }
+
+    char *name_pool = text + names_length + 1;
+    if (names_length > 0) {
+        memcpy(name_pool, names, names_length);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        entries[i].name = name_pool + (uintptr_t)entries[i].name;
+    }
+    free(names);
+    qsort(entries, count, sizeof(DirCacheEntry), compare_entries);
+
+    size_t text_length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t name_length = strlen(entries[i].name);
+        memcpy(text + text_length, entries[i].name, name_length);
+        text_length += name_length;
+        text[text_length++] = '\n';
+    }
+    text[text_length] = '\0';
+
+    listing->entries = entries;
+    listing->count = count;
+    listing->text = text;
+    listing->text_length = text_length;
+    listing->refs = 1;
+    return listing;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const DirCacheEntry *)a)->name, ((const DirCacheEntry *)b)->name);
+}
@@ -0,0 +1,53 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stddef.h>
+
+typedef enum {
+    DIRCACHE_ENTRY_FILE = 0,
+    DIRCACHE_ENTRY_DIRECTORY = 1,
+    DIRCACHE_ENTRY_OTHER = 2
+} DirCacheEntryType;
+
+typedef struct {
+    const char *name;
+    DirCacheEntryType type;
+    long long size;
+    long long mtime_ms;
+} DirCacheEntry;
+
+/**
+ * Immutable snapshot of one directory. `text` is the newline-separated
+ * name listing used by vfs_list. Snapshots are reference counted, so a
+ * holder keeps a consistent view even if the directory is invalidated.
+ */
+typedef struct {
+    DirCacheEntry *entries;
+    size_t count;
+    char *text;
+    size_t text_length;
+    int refs;
+} DirListing;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long invalidations;
+    size_t directories;
+} DirCacheStats;
+
+/**
+ * Directory metadata cache keyed by full path and kept coherent with
+ * inotify. Engine writes invalidate synchronously; changes made by other
+ * processes are picked up by dircache_process_events(), which event loops
+ * call once per wakeup so lookups themselves stay a single hash probe.
+ */
+const DirListing *dircache_acquire(const char *full_path);
+void dircache_release(const DirListing *listing);
+void dircache_invalidate(const char *full_path);
+void dircache_invalidate_parent(const char *full_path);
+int dircache_watch_fd(void);
+void dircache_process_events(void);
+void dircache_stats(DirCacheStats *stats);
+
+#endif // DIRCACHE_H
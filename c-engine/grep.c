@@ -0,0 +1,525 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "grep.h"
+
+#define RUN_SIZE 256
+#define BINARY_PROBE_SIZE 4096
+#define MAX_SCAN_THREADS 16
+#define FILES_PER_THREAD 16
+#define SCAN_READ_LIMIT (256 * 1024)
+
+// One grep_tree() call; workers claim files in order through `next`
+typedef struct {
+    const GrepPattern *pattern;
+    const TrigramFile *files;
+    size_t count;
+    size_t directory_length;
+    const char *label;
+    size_t label_length;
+    ShellOutput *outputs;  // per file, written back in order at the end
+    size_t *matches;
+    atomic_size_t next;
+    atomic_size_t found;
+} TreeScan;
+
+// Pattern text being split into the literal runs every match contains
+typedef struct {
+    GrepPattern *pattern;
+    char run[RUN_SIZE];
+    size_t run_length;
+    size_t runs;
+    bool plain;  // nothing but ordinary characters so far
+    bool alternatives;
+} PatternScan;
+
+static void analyse_pattern(GrepPattern *pattern, const char *text);
+static void end_run(PatternScan *scan);
+static const char *skip_group(const char *p, bool extended);
+static const char *skip_bracket(const char *p);
+static size_t quantifier_length(const char *p, bool extended, bool *optional);
+static bool set_literal(GrepPattern *pattern, const char *text, size_t length);
+static const char *find_literal(const GrepPattern *pattern, const char *begin, const char *end);
+static size_t count_lines(const char *begin, const char *end);
+static void *scan_files(void *argument);
+static void scan_file(TreeScan *scan, size_t index, char *buffer);
+static int scan_thread_count(size_t files);
+
+int grep_compile(GrepPattern *pattern, const char *text, const GrepOptions *options, char *error, size_t error_size) {
+    memset(pattern, 0, sizeof(*pattern));
+    pattern->options = *options;
+    if (options->fixed) {
+        pattern->literal_only = true;
+        trigram_query_init(&pattern->query);
+        trigram_query_literal(&pattern->query, text, strlen(text));
+        if (!set_literal(pattern, text, strlen(text))) {
+            snprintf(error, error_size, "out of memory");
+            return -1;
+        }
+    } else {
+        int flags = REG_NOSUB | (options->extended ? REG_EXTENDED : 0) | (options->ignore_case ? REG_ICASE : 0);
+        int code = regcomp(&pattern->regex, text, flags);
+        if (code != 0) {
+            regerror(code, &pattern->regex, error, error_size);
+            return -1;
+        }
+        pattern->compiled = true;
+        analyse_pattern(pattern, text);
+    }
+    // Counts and inverted matches need every file, matching or not
+    pattern->query.match_all |= options->count_only || options->invert;
+    return 0;
+}
+
+void grep_free(GrepPattern *pattern) {
+    if (pattern->compiled) {
+        regfree(&pattern->regex);
+        pattern->compiled = false;
+    }
+    free(pattern->literal);
+    pattern->literal = NULL;
+}
+
+// Lines without the literal cannot match, so unless matches are inverted
+// the scan jumps from one occurrence to the next, and only the lines
+// holding one reach regexec
+size_t grep_buffer(const GrepPattern *pattern, const char *data, size_t size, const char *label, ShellOutput *out) {
+    const GrepOptions *options = &pattern->options;
+    bool seek = pattern->literal != NULL && !options->invert;
+    const char *end = data + size;
+    const char *line = data;
+    size_t number = 1;
+    size_t matches = 0;
+    while (line < end) {
+        const char *found = NULL;
+        if (seek) {
+            found = find_literal(pattern, line, end);
+            if (found == NULL) {
+                break;
+            }
+            const char *newline = memrchr(line, '\n', (size_t)(found - line));
+            const char *start = newline != NULL ? newline + 1 : line;
+            if (options->line_numbers) {
+                number += count_lines(line, start);
+            }
+            line = start;
+        }
+        const char *from = found != NULL ? found : line;
+        const char *newline = memchr(from, '\n', (size_t)(end - from));
+        const char *line_end = newline != NULL ? newline : end;
+
+        if (pattern->literal != NULL && found == NULL) {
+            found = find_literal(pattern, line, line_end);
+        }
+        bool hit;
+        if (pattern->literal != NULL && found == NULL) {
+            hit = false;
+        } else if (pattern->literal_only) {
+            hit = true;
+        } else {
+            regmatch_t span = {.rm_so = 0, .rm_eo = (regoff_t)(line_end - line)};
+            hit = regexec(&pattern->regex, line, 1, &span, REG_STARTEND) == 0;
+        }
+        if (hit != options->invert) {
+            ++matches;
+            if (options->files_only) {
+                shell_output_printf(out, "%s\n", label);
+                return matches;
+            }
+            if (!options->count_only) {
+                if (label != NULL) {
+                    shell_output_write(out, label, strlen(label));
+                    shell_output_write(out, &options->separator, 1);
+                }
+                if (options->line_numbers) {
+                    shell_output_printf(out, "%zu%c", number, options->separator);
+                }
+                shell_output_write(out, line, (size_t)(line_end - line));
+                shell_output_write(out, "\n", 1);
+            }
+            if (options->limit > 0 && matches >= options->limit) {
+                break;
+            }
+        }
+        if (newline == NULL) {
+            break;
+        }
+        line = newline + 1;
+        ++number;
+    }
+    if (options->count_only) {
+        if (label != NULL) {
+            shell_output_printf(out, "%s%c", label, options->separator);
+        }
+        shell_output_printf(out, "%zu\n", matches);
+    }
+    return matches;
+}
+
+long grep_tree(const GrepPattern *pattern, const char *directory, const char *label, ShellOutput *out) {
+    TrigramFile *files = NULL;
+    size_t count = 0;
+    if (trigram_select(directory, &pattern->query, &files, &count) != 0) {
+        return -1;
+    }
+    TreeScan scan = {.pattern = pattern, .files = files, .count = count, .label = label};
+    scan.directory_length = strlen(directory);
+    while (scan.directory_length > 1 && directory[scan.directory_length - 1] == '/') {
+        --scan.directory_length;
+    }
+    scan.label_length = label != NULL ? strlen(label) : 0;
+    while (scan.label_length > 1 && label[scan.label_length - 1] == '/') {
+        --scan.label_length;
+    }
+    scan.outputs = (ShellOutput *)calloc(count > 0 ? count : 1, sizeof(ShellOutput));
+    scan.matches = (size_t *)calloc(count > 0 ? count : 1, sizeof(size_t));
+    if (scan.outputs == NULL || scan.matches == NULL) {
+        free(scan.outputs);
+        free(scan.matches);
+        trigram_files_free(files, count);
+        return -1;
+    }
+    atomic_init(&scan.next, 0);
+    atomic_init(&scan.found, 0);
+
+    pthread_t threads[MAX_SCAN_THREADS];
+    int started = 0;
+    for (int i = 1; i < scan_thread_count(count); ++i) {
+        if (pthread_create(&threads[started], NULL, scan_files, &scan) == 0) {
+            ++started;
+        }
+    }
+    scan_files(&scan);
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Files were claimed in order, so everything before the last one
+    // claimed was scanned and the first `limit` matches are all here
+    size_t limit = pattern->options.limit;
+    bool lines = !pattern->options.count_only && !pattern->options.files_only;
+    size_t reported = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ShellOutput *file_output = &scan.outputs[i];
+        size_t length = file_output->length;
+        if (limit > 0 && reported + scan.matches[i] > limit) {
+            size_t keep = reported < limit ? limit - reported : 0;
+            scan.matches[i] = keep;
+            if (lines) {
+                const char *cut = file_output->data;
+                for (size_t k = 0; k < keep && cut != NULL; ++k) {
+                    cut = memchr(cut, '\n', (size_t)(file_output->data + file_output->length - cut));
+                    cut = cut != NULL ? cut + 1 : NULL;
+                }
+                length = keep == 0 ? 0 : cut != NULL ? (size_t)(cut - file_output->data) : length;
+            }
+        }
+        if (length > 0) {
+            shell_output_write(out, file_output->data, length);
+        }
+        reported += scan.matches[i];
+        free(file_output->data);
+    }
+    free(scan.outputs);
+    free(scan.matches);
+    trigram_files_free(files, count);
+    return (long)reported;
+}
+
+// Collects the strings every match must contain: runs of ordinary
+// characters outside groups and brackets that no quantifier makes
+// optional, per top-level alternative. Anything unusual just ends the
+// current run, which can only let more files through.
+static void analyse_pattern(GrepPattern *pattern, const char *text) {
+    bool extended = pattern->options.extended;
+    PatternScan scan = {.pattern = pattern, .plain = true};
+    trigram_query_init(&pattern->query);
+
+    const char *p = text;
+    while (*p != '\0') {
+        int literal = -1;
+        const char *next = p + 1;
+        if (*p == '\\' && p[1] != '\0') {
+            char c = p[1];
+            next = p + 2;
+            if (!extended && c == '(') {
+                next = skip_group(next, extended);
+            } else if (!extended && c == '|') {
+                end_run(&scan);
+                trigram_query_branch(&pattern->query);
+                scan.alternatives = true;
+                p = next;
+                continue;
+            } else if (!isalnum((unsigned char)c) && strchr("<>`'{}?+)", c) == NULL) {
+                literal = (unsigned char)c;
+            }
+        } else if (extended && *p == '(') {
+            next = skip_group(next, extended);
+        } else if (extended && *p == '|') {
+            end_run(&scan);
+            trigram_query_branch(&pattern->query);
+            scan.alternatives = true;
+            p = next;
+            continue;
+        } else if (*p == '[') {
+            next = skip_bracket(next);
+        } else if (strchr(".^$*\\", *p) == NULL && (!extended || strchr("?+{})", *p) == NULL)) {
+            literal = (unsigned char)*p;
+        }
+
+        bool optional = false;
+        size_t quantifier = quantifier_length(next, extended, &optional);
+        if (literal < 0 || quantifier > 0) {
+            scan.plain = false;
+        }
+        if (literal >= 0 && !optional) {
+            if (scan.run_length == sizeof(scan.run)) {
+                scan.plain = false;
+                end_run(&scan);
+            }
+            scan.run[scan.run_length++] = (char)literal;
+        }
+        // "ab+c" needs "ab" and "bc", but not "abc"
+        if (literal < 0 || quantifier > 0) {
+            end_run(&scan);
+        }
+        p = next + quantifier;
+    }
+    end_run(&scan);
+
+    // A plain pattern is its own literal, and finding it is a match
+    if (scan.plain && !scan.alternatives && scan.runs == 1) {
+        pattern->literal_only = true;
+    }
+    if (scan.alternatives || pattern->literal == NULL) {
+        free(pattern->literal);
+        pattern->literal = NULL;
+        pattern->literal_length = 0;
+        pattern->literal_only = false;
+    }
+}
+
+// Adds the run to the query and keeps it if it is the longest so far
+static void end_run(PatternScan *scan) {
+    if (scan->run_length == 0) {
+        return;
+    }
+    GrepPattern *pattern = scan->pattern;
+    trigram_query_literal(&pattern->query, scan->run, scan->run_length);
+    ++scan->runs;
+    if (!scan->alternatives && scan->run_length > pattern->literal_length) {
+        set_literal(pattern, scan->run, scan->run_length);
+    }
+    scan->run_length = 0;
+}
+
+// Skips to just past the group closing the one opened before `p`
+static const char *skip_group(const char *p, bool extended) {
+    int depth = 1;
+    while (*p != '\0') {
+        if (*p == '[') {
+            p = skip_bracket(p + 1);
+            continue;
+        }
+        if (*p == '\\' && p[1] != '\0') {
+            if (!extended && (p[1] == '(' || p[1] == ')')) {
+                depth += p[1] == '(' ? 1 : -1;
+            }
+            p += 2;
+        } else {
+            if (extended && (*p == '(' || *p == ')')) {
+                depth += *p == '(' ? 1 : -1;
+            }
+            ++p;
+        }
+        if (depth == 0) {
+            break;
+        }
+    }
+    return p;
+}
+
+// Skips to just past the bracket expression opened before `p`
+static const char *skip_bracket(const char *p) {
+    if (*p == '^') {
+        ++p;
+    }
+    // A leading ']' is a member, not the end
+    if (*p == ']') {
+        ++p;
+    }
+    while (*p != '\0' && *p != ']') {
+        if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+            const char *close = strchr(p + 2, p[1]);
+            p = close != NULL && close[1] == ']' ? close + 2 : p + 1;
+        } else {
+            ++p;
+        }
+    }
+    return *p == ']' ? p + 1 : p;
+}
+
+// The length of the repetition operators at `p`; `optional` tells whether
+// they allow zero repeats
+static size_t quantifier_length(const char *p, bool extended, bool *optional) {
+    const char *start = p;
+    *optional = false;
+    for (;;) {
+        if (*p == '*' || (extended && *p == '?') || (!extended && p[0] == '\\' && p[1] == '?')) {
+            *optional = true;
+            p += *p == '\\' ? 2 : 1;
+        } else if ((extended && *p == '+') || (!extended && p[0] == '\\' && p[1] == '+')) {
+            p += *p == '\\' ? 2 : 1;
+        } else if ((extended && *p == '{') || (!extended && p[0] == '\\' && p[1] == '{')) {
+            p += *p == '\\' ? 2 : 1;
+            *optional |= !isdigit((unsigned char)*p) || atoi(p) == 0;
+            const char *close = strchr(p, '}');
+            p = close != NULL ? close + 1 : p + strlen(p);
+        } else {
+            return (size_t)(p - start);
+        }
+    }
+}
+
+static bool set_literal(GrepPattern *pattern, const char *text, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    char *literal = (char *)malloc(length + 1);
+    if (literal == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        literal[i] = pattern->options.ignore_case ? (char)tolower((unsigned char)text[i]) : text[i];
+    }
+    literal[length] = '\0';
+    free(pattern->literal);
+    pattern->literal = literal;
+    pattern->literal_length = length;
+    return true;
+}
+
+// The C library's memchr and memmem are vectorised; -i looks for both
+// cases of the first byte with memchr and compares the rest by hand
+static const char *find_literal(const GrepPattern *pattern, const char *begin, const char *end) {
+    size_t length = pattern->literal_length;
+    if ((size_t)(end - begin) < length) {
+        return NULL;
+    }
+    if (!pattern->options.ignore_case) {
+        return memmem(begin, (size_t)(end - begin), pattern->literal, length);
+    }
+    unsigned char lower = (unsigned char)pattern->literal[0];
+    unsigned char upper = (unsigned char)toupper(lower);
+    const char *last = end - length + 1;
+    for (const char *cursor = begin; cursor < last;) {
+        const char *hit = memchr(cursor, lower, (size_t)(last - cursor));
+        if (upper != lower) {
+            const char *other = memchr(cursor, upper, (size_t)((hit != NULL ? hit : last) - cursor));
+            hit = other != NULL ? other : hit;
+        }
+        if (hit == NULL) {
+            return NULL;
+        }
+        size_t k = 1;
+        while (k < length && tolower((unsigned char)hit[k]) == (unsigned char)pattern->literal[k]) {
+            ++k;
+        }
+        if (k == length) {
+            return hit;
+        }
+        cursor = hit + 1;
+    }
+    return NULL;
+}
+
+static size_t count_lines(const char *begin, const char *end) {
+    size_t count = 0;
+    while ((begin = memchr(begin, '\n', (size_t)(end - begin))) != NULL) {
+        ++count;
+        ++begin;
+    }
+    return count;
+}
+
+// Once the limit is reached no more files are claimed
+static void *scan_files(void *argument) {
+    TreeScan *scan = (TreeScan *)argument;
+    size_t limit = scan->pattern->options.limit;
+    char *buffer = (char *)malloc(SCAN_READ_LIMIT);
+    while (limit == 0 || atomic_load(&scan->found) < limit) {
+        size_t index = atomic_fetch_add(&scan->next, 1);
+        if (index >= scan->count) {
+            break;
+        }
+        scan_file(scan, index, buffer);
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Reads a file once: stale ones are indexed from the same copy. Small
+// files are read into the worker's buffer, which is cheaper than mapping
+// and unmapping them; larger ones are mapped.
+static void scan_file(TreeScan *scan, size_t index, char *buffer) {
+    const TrigramFile *file = &scan->files[index];
+    int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    size_t size = (size_t)st.st_size;
+    void *mapping = NULL;
+    const char *data = "";
+    if (buffer != NULL && size <= SCAN_READ_LIMIT) {
+        ssize_t got = read(fd, buffer, size);
+        size = got > 0 ? (size_t)got : 0;
+        data = buffer;
+    } else if (size > 0) {
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = (const char *)mapping;
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+    bool binary = memchr(data, '\0', size < BINARY_PROBE_SIZE ? size : BINARY_PROBE_SIZE) != NULL;
+    if (file->stale) {
+        trigram_index_file(file, data, size);
+    }
+    if (!binary) {
+        char label[PATH_MAX];
+        const char *relative = file->path + scan->directory_length + 1;
+        if (scan->label != NULL) {
+            snprintf(label, sizeof(label), "%.*s/%s", (int)scan->label_length, scan->label, relative);
+        } else {
+            snprintf(label, sizeof(label), "%s", relative);
+        }
+        scan->outputs[index] = (ShellOutput){.growable = true};
+        scan->matches[index] = grep_buffer(scan->pattern, data, size, label, &scan->outputs[index]);
+        atomic_fetch_add(&scan->found, scan->matches[index]);
+    }
+    if (mapping != NULL) {
+        munmap(mapping, size);
+    }
+}
+
+static int scan_thread_count(size_t files) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t wanted = (files + FILES_PER_THREAD - 1) / FILES_PER_THREAD;
+    size_t threads = cpus > 0 ? (size_t)cpus : 1;
+    threads = threads < wanted ? threads : wanted;
+    threads = threads < MAX_SCAN_THREADS ? threads : MAX_SCAN_THREADS;
+    return threads > 0 ? (int)threads : 1;
+}
@@ -0,0 +1,58 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "shell.h"
+#include "trigram.h"
+
+typedef struct {
+    bool ignore_case;  // -i
+    bool invert;  // -v
+    bool count_only;  // -c
+    bool files_only;  // -l
+    bool line_numbers;  // -n
+    bool fixed;  // -F: the pattern is a plain string
+    bool extended;  // -E
+    char separator;  // after the file name and line number; ':' like grep(1)
+    size_t limit;  // matching lines to report, 0 for all
+} GrepOptions;
+
+/**
+ * A compiled grep pattern. Besides the regex it keeps the longest string
+ * every match must contain, so scans can jump between occurrences of it
+ * with memmem (or paired memchr for -i) and only run the regex on lines
+ * that have it, and the trigram query that picks the files to scan.
+ */
+typedef struct {
+    GrepOptions options;
+    regex_t regex;
+    bool compiled;
+    char *literal;  // case-folded for -i; NULL when there is none
+    size_t literal_length;
+    bool literal_only;  // finding the literal is finding a match
+    TrigramQuery query;
+} GrepPattern;
+
+// Returns 0, or -1 with regcomp's message in `error`
+int grep_compile(GrepPattern *pattern, const char *text, const GrepOptions *options, char *error, size_t error_size);
+void grep_free(GrepPattern *pattern);
+
+/**
+ * Writes the matching lines of `data` in grep(1) format, prefixed with
+ * `label` unless it is NULL. Returns the number of matching lines.
+ */
+size_t grep_buffer(const GrepPattern *pattern, const char *data, size_t size, const char *label, ShellOutput *out);
+
+/**
+ * grep -r over the full path `directory`: the trigram index narrows the
+ * files down, then they are scanned in parallel across the CPUs and their
+ * output written in path order. Files are labelled `label`/relative path,
+ * or just the relative path when `label` is NULL. Hidden entries and
+ * binary files are skipped. Returns the number of matching lines, or -1
+ * if the directory cannot be read.
+ */
+long grep_tree(const GrepPattern *pattern, const char *directory, const char *label, ShellOutput *out);
+
+#endif // GREP_H
@@ -0,0 +1,273 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+#define HISTORY_FILE_LIMIT (4 * 1024 * 1024)
+#define HISTORY_SCAN_BLOCK 65536
+#define HISTORY_BLOCK_MATCHES 1024
+#define HISTORY_PATH_SIZE 512
+
+typedef struct {
+    const char *text;
+    size_t length;
+} HistoryLine;
+
+static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char history_path[HISTORY_PATH_SIZE] = {0};
+static int history_fd = -1;
+static const char *mapping = NULL;
+static size_t mapped_size = 0;
+
+static bool refresh_mapping(void);
+static void unmap_history(void);
+static void trim_history(void);
+static bool emit_line(const char *text, size_t length, HistoryLine *emitted, size_t *count, ShellOutput *out);
+static size_t scan_substring(const char *begin, const char *end, const char *query, size_t query_length,
+                             const char **starts);
+static size_t scan_prefix(const char *begin, const char *end, const char *needle, size_t needle_length,
+                          const char **starts);
+
+int history_open(const char *path) {
+    if (strlen(path) >= sizeof(history_path)) {
+        return -1;
+    }
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&history_mutex);
+    unmap_history();
+    if (history_fd >= 0) {
+        close(history_fd);
+    }
+    history_fd = fd;
+    strcpy(history_path, path);
+    refresh_mapping();
+    pthread_mutex_unlock(&history_mutex);
+    return 0;
+}
+
+void history_close(void) {
+    pthread_mutex_lock(&history_mutex);
+    unmap_history();
+    if (history_fd >= 0) {
+        close(history_fd);
+        history_fd = -1;
+    }
+    pthread_mutex_unlock(&history_mutex);
+}
+
+void history_append(const char *line) {
+    size_t length = strlen(line);
+    if (length == 0) {
+        return;
+    }
+    // One write per command keeps lines whole when several engines share the file
+    char stack_buffer[1024];
+    char *record = length + 1 <= sizeof(stack_buffer) ? stack_buffer : malloc(length + 1);
+    if (record == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        record[i] = line[i] == '\n' || line[i] == '\r' ? ' ' : line[i];
+    }
+    record[length] = '\n';
+
+    pthread_mutex_lock(&history_mutex);
+    if (history_fd >= 0 && write(history_fd, record, length + 1) == (ssize_t)(length + 1)) {
+        struct stat st;
+        if (fstat(history_fd, &st) == 0 && st.st_size > HISTORY_FILE_LIMIT) {
+            trim_history();
+        }
+    }
+    pthread_mutex_unlock(&history_mutex);
+    if (record != stack_buffer) {
+        free(record);
+    }
+}
+
+size_t history_search(const char *query, HistoryMatch match, size_t limit, ShellOutput *out) {
+    size_t query_length = strlen(query);
+    if (memchr(query, '\n', query_length) != NULL) {
+        return 0;
+    }
+    limit = limit < HISTORY_SEARCH_LIMIT ? limit : HISTORY_SEARCH_LIMIT;
+    HistoryLine emitted[HISTORY_SEARCH_LIMIT];
+    size_t count = 0;
+    const char *starts[HISTORY_BLOCK_MATCHES];
+
+    // A prefix search looks for "\n" + query, so every hit is a match
+    char stack_needle[256];
+    char *needle = stack_needle;
+    if (match == HISTORY_PREFIX) {
+        needle = query_length + 1 <= sizeof(stack_needle) ? stack_needle : malloc(query_length + 1);
+        if (needle == NULL) {
+            return 0;
+        }
+        needle[0] = '\n';
+        memcpy(needle + 1, query, query_length);
+    }
+
+    pthread_mutex_lock(&history_mutex);
+    if (!refresh_mapping()) {
+        pthread_mutex_unlock(&history_mutex);
+        if (needle != stack_needle) {
+            free(needle);
+        }
+        return 0;
+    }
+
+    // Walk back a block at a time, each cut at a line start; matches within
+    // a block are found front to back and emitted back to front
+    const char *end = mapping + mapped_size;
+    while (end > mapping && count < limit) {
+        const char *begin = end - mapping > HISTORY_SCAN_BLOCK ? end - HISTORY_SCAN_BLOCK : mapping;
+        if (begin > mapping) {
+            const char *newline = memrchr(mapping, '\n', (size_t)(begin - mapping));
+            begin = newline != NULL ? newline + 1 : mapping;
+        }
+        size_t found = match == HISTORY_PREFIX ? scan_prefix(begin, end, needle, query_length + 1, starts)
+                                               : scan_substring(begin, end, query, query_length, starts);
+        size_t oldest = found > HISTORY_BLOCK_MATCHES ? found - HISTORY_BLOCK_MATCHES : 0;
+        for (size_t i = found; i > oldest && count < limit; --i) {
+            const char *start = starts[(i - 1) % HISTORY_BLOCK_MATCHES];
+            const char *line_end = memchr(start, '\n', (size_t)(end - start));
+            emit_line(start, (size_t)((line_end != NULL ? line_end : end) - start), emitted, &count, out);
+        }
+        // Matches that fell out of the window are picked up by rescanning
+        end = oldest > 0 ? starts[oldest % HISTORY_BLOCK_MATCHES] : begin;
+    }
+    pthread_mutex_unlock(&history_mutex);
+    if (needle != stack_needle) {
+        free(needle);
+    }
+    return count;
+}
+
+// Keeps the mapping in step with the file, which other writers may have grown
+static bool refresh_mapping(void) {
+    struct stat st;
+    if (history_fd < 0 || fstat(history_fd, &st) != 0) {
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == mapped_size && mapping != NULL) {
+        return true;
+    }
+    unmap_history();
+    if (size == 0) {
+        return false;
+    }
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, history_fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapping = data;
+    mapped_size = size;
+    return true;
+}
+
+static void unmap_history(void) {
+    if (mapping != NULL) {
+        munmap((void *)mapping, mapped_size);
+        mapping = NULL;
+        mapped_size = 0;
+    }
+}
+
+// Rewrites the file with its newest half and swaps it in atomically
+static void trim_history(void) {
+    if (!refresh_mapping()) {
+        return;
+    }
+    const char *keep = mapping + mapped_size / 2;
+    const char *newline = memchr(keep, '\n', (size_t)(mapping + mapped_size - keep));
+    keep = newline != NULL ? newline + 1 : mapping + mapped_size;
+
+    char temp_path[HISTORY_PATH_SIZE + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", history_path);
+    int fd = open(temp_path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return;
+    }
+    size_t length = (size_t)(mapping + mapped_size - keep);
+    if (write(fd, keep, length) != (ssize_t)length || rename(temp_path, history_path) != 0) {
+        close(fd);
+        unlink(temp_path);
+        return;
+    }
+    unmap_history();
+    close(history_fd);
+    history_fd = fd;
+}
+
+// Skips commands already written, so repeated commands show up once
+static bool emit_line(const char *text, size_t length, HistoryLine *emitted, size_t *count, ShellOutput *out) {
+    for (size_t i = 0; i < *count; ++i) {
+        if (emitted[i].length == length && memcmp(emitted[i].text, text, length) == 0) {
+            return false;
+        }
+    }
+    emitted[(*count)++] = (HistoryLine){text, length};
+    shell_output_write(out, text, length);
+    shell_output_write(out, "\n", 1);
+    return true;
+}
+
+// Counts the lines in [begin, end) containing `query`, keeping the starts
+// of the newest HISTORY_BLOCK_MATCHES in `starts` as a ring indexed by match
+// number. memmem skips through non-matching text far faster than a
+// line-by-line walk.
+static size_t scan_substring(const char *begin, const char *end, const char *query, size_t query_length,
+                             const char **starts) {
+    size_t found = 0;
+    const char *cursor = begin;
+    while (cursor < end) {
+        const char *hit = query_length > 0 ? memmem(cursor, (size_t)(end - cursor), query, query_length) : cursor;
+        if (hit == NULL) {
+            break;
+        }
+        const char *line_start = hit;
+        while (line_start > begin && line_start[-1] != '\n') {
+            --line_start;
+        }
+        const char *line_end = memchr(hit, '\n', (size_t)(end - hit));
+        line_end = line_end != NULL ? line_end : end;
+        if (line_end > line_start) {
+            starts[found++ % HISTORY_BLOCK_MATCHES] = line_start;
+        }
+        cursor = line_end + 1;
+    }
+    return found;
+}
+
+// Like scan_substring() for lines starting with the query; `needle` is the
+// query behind a newline, and `begin` is a line start checked on its own
+static size_t scan_prefix(const char *begin, const char *end, const char *needle, size_t needle_length,
+                          const char **starts) {
+    size_t found = 0;
+    size_t prefix_length = needle_length - 1;
+    if (begin < end && *begin != '\n' && (size_t)(end - begin) >= prefix_length &&
+        memcmp(begin, needle + 1, prefix_length) == 0) {
+        starts[found++ % HISTORY_BLOCK_MATCHES] = begin;
+    }
+    const char *cursor = begin;
+    while (cursor < end) {
+        const char *hit = memmem(cursor, (size_t)(end - cursor), needle, needle_length);
+        if (hit == NULL) {
+            break;
+        }
+        cursor = hit + 1;
+        if (cursor < end && *cursor != '\n') {
+            starts[found++ % HISTORY_BLOCK_MATCHES] = cursor;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,33 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include "shell.h"
+
+typedef enum {
+    HISTORY_PREFIX = 0,
+    HISTORY_SUBSTRING = 1
+} HistoryMatch;
+
+#define HISTORY_SEARCH_LIMIT 256
+
+/**
+ * Persistent command history shared by every session: one command per line
+ * in an append-only file. Searches read a shared memory mapping of the
+ * file in place, newest line first, so a query costs a scan of the lines
+ * it passes over and nothing else. The file is trimmed to its newest half
+ * when it outgrows its size limit. All functions are thread-safe; without
+ * history_open() appends and searches do nothing.
+ */
+int history_open(const char *path);
+void history_close(void);
+void history_append(const char *line);
+
+/**
+ * Writes up to `limit` (at most HISTORY_SEARCH_LIMIT) distinct commands
+ * that start with or contain `query`, newest first, one per line. Returns
+ * the number written.
+ */
+size_t history_search(const char *query, HistoryMatch match, size_t limit, ShellOutput *out);
+
+#endif // HISTORY_H
@@ -1,9 +1,208 @@
-// Welcome to GenixCode
-// Start coding in C or C++
-
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "history.h"
+#include "pagecache.h"
+#include "runner.h"
+#include "search.h"
+#include "shell.h"
+#include "server.h"
+#include "vfs.h"
+
+#define COMMAND_BUFFER_SIZE 256
+#define MAX_WORKERS 64
+#define HISTORY_PATH_SIZE 512
+#define MAX_PAGE_CACHE_MB 65536
+#define MAX_ZYGOTES 64
+
+static void print_usage(const char *program);
+static int run_interactive(void);
+static int run_single(const char *command);
+static void detach_stdin(void);
+static int write_stdout(void *context, const char *data, size_t length);
+static int default_worker_count(void);
+static void open_history(const char *path);
+
+int main(int argc, char **argv) {
+    // The runner re-executes this binary to start its zygotes
+    if (argc == 3 && strcmp(argv[1], "--zygote") == 0) {
+        return runner_zygote_main(atoi(argv[2]));
+    }
+
+    const char *root = ".";
+    const char *sandbox = NULL;
+    const char *socket_path = NULL;
+    const char *command = NULL;
+    const char *history_path = NULL;
+    const char *index_root = NULL;
+    int worker_count = default_worker_count();
+    int zygote_count = RUNNER_DEFAULT_ZYGOTES;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+            root = argv[++i];
+        } else if (strcmp(argv[i], "--sandbox") == 0 && i + 1 < argc) {
+            sandbox = argv[++i];
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            worker_count = atoi(argv[++i]);
+            if (worker_count < 1 || worker_count > MAX_WORKERS) {
+                fprintf(stderr, "%s: --workers must be between 1 and %d\n", argv[0], MAX_WORKERS);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--zygotes") == 0 && i + 1 < argc) {
+            zygote_count = atoi(argv[++i]);
+            if (zygote_count < 0 || zygote_count > MAX_ZYGOTES) {
+                fprintf(stderr, "%s: --zygotes must be between 0 and %d\n", argv[0], MAX_ZYGOTES);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--page-cache") == 0 && i + 1 < argc) {
+            int megabytes = atoi(argv[++i]);
+            if (megabytes < 0 || megabytes > MAX_PAGE_CACHE_MB) {
+                fprintf(stderr, "%s: --page-cache must be between 0 and %d MB\n", argv[0], MAX_PAGE_CACHE_MB);
+                return 2;
+            }
+            pagecache_set_budget((size_t)megabytes * 1024 * 1024);
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            const char *backend = argv[++i];
+            if (strcmp(backend, "sync") == 0) {
+                vfs_set_io_backend(VFS_IO_SYNC);
+            } else if (strcmp(backend, "uring") == 0) {
+                if (vfs_set_io_backend(VFS_IO_URING) != VFS_IO_URING) {
+                    fprintf(stderr, "%s: io_uring is unavailable; using synchronous I/O\n", argv[0]);
+                }
+            } else if (strcmp(backend, "auto") != 0) {
+                fprintf(stderr, "%s: --io must be auto, sync or uring\n", argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_root = argv[++i];
+        } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            history_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            command = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // Indexed in the background from here on, relative to where we started
+    if (index_root != NULL && search_index_open(index_root) != 0) {
+        perror(index_root);
+    }
+
+    // Shell commands such as ls resolve relative to the project root
+    if (chdir(root) != 0) {
+        perror(root);
+        return 1;
+    }
+
+    vfs_init(".", sandbox != NULL ? sandbox : "sandbox");
+    shell_init();
+    // Only a daemon's stdin is not the user's terminal
+    shell_set_interactive(socket_path == NULL);
 
-int main() {
-    printf("hello");
+    if (command != NULL) {
+        // A single command may be a search; give it the whole tree
+        search_index_wait();
+        return run_single(command);
+    }
+    // Scripted -c runs stay out of the history users search
+    open_history(history_path);
+    if (socket_path != NULL) {
+        // The interactive apps read stdin; a daemon must never block on it
+        detach_stdin();
+        if (zygote_count > 0 && runner_init(zygote_count) != 0) {
+            perror("runner: cannot start zygotes");
+        }
+        int status = server_run(socket_path, worker_count) == 0 ? 0 : 1;
+        runner_shutdown();
+        return status;
+    }
+    return run_interactive();
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--root DIR] [--sandbox DIR] [--index DIR] [--history FILE]\n"
+            "          [--page-cache MB] [--io auto|sync|uring]\n"
+            "          [--socket PATH [--workers N] [--zygotes N] | -c COMMAND]\n"
+            "  --index DIR    keep a full-text index of DIR for the search command\n"
+            "  --history FILE persistent command history (default: ~/.genix_history)\n"
+            "  --page-cache MB memory for cached file contents (default: 64, 0 disables)\n"
+            "  --io BACKEND   batched file I/O for indexing and cp -r (default: auto, io_uring if available)\n"
+            "  --socket PATH  run as a daemon serving framed requests on a Unix socket\n"
+            "  --workers N    daemon threads running commands (default: one per CPU, 2-16)\n"
+            "  --zygotes N    pre-started processes running programs for RUN (default: 4, 0 disables)\n"
+            "  -c COMMAND     execute one command and exit\n"
+            "  (no mode)      read commands from stdin\n",
+            program);
+}
+
+static int run_single(const char *command) {
+    ShellSession *session = shell_session_create();
+    int result = shell_session_execute(session, command, write_stdout, NULL);
+    shell_session_destroy(session);
+    fflush(stdout);
+    return result == SHELL_OK ? 0 : (result == SHELL_NOT_FOUND ? 127 : 1);
+}
+
+static int run_interactive(void) {
+    char command[COMMAND_BUFFER_SIZE];
+    ShellSession *session = shell_session_create();
+
+    while (true) {
+        printf("genix> ");
+        fflush(stdout);
+        if (fgets(command, sizeof(command), stdin) == NULL) {
+            printf("\n");
+            break;
+        }
+        command[strcspn(command, "\r\n")] = '\0';
+        if (strcmp(command, "exit") == 0) {
+            break;
+        }
+        dircache_process_events();
+        shell_session_execute(session, command, write_stdout, NULL);
+    }
+    shell_session_destroy(session);
     return 0;
-}
\ No newline at end of file
+}
+
+static void detach_stdin(void) {
+    int fd = open("/dev/null", O_RDONLY);
+    if (fd >= 0) {
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+}
+
+// Output streams straight to the terminal, so nothing is ever truncated
+static int write_stdout(void *context, const char *data, size_t length) {
+    (void)context;
+    return fwrite(data, 1, length, stdout) == length ? 0 : -1;
+}
+
+static int default_worker_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 2 ? 2 : cpus > 16 ? 16 : (int)cpus;
+}
+
+// Kept out of the project tree: every append would invalidate the cached
+// listing of the directory holding it
+static void open_history(const char *path) {
+    char default_path[HISTORY_PATH_SIZE];
+    const char *home = getenv("HOME");
+    if (path == NULL && home != NULL && home[0] != '\0') {
+        int written = snprintf(default_path, sizeof(default_path), "%s/.genix_history", home);
+        path = written > 0 && (size_t)written < sizeof(default_path) ? default_path : NULL;
+    }
+    if (path != NULL && history_open(path) != 0) {
+        perror(path);
+    }
+}
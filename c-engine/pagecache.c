@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pagecache.h"
+#include "dircache.h"
+
+#define PAGECACHE_BUCKETS 4096
+#define PAGECACHE_PATH_SIZE 512
+// Largest cacheable file, as a fraction of the budget
+#define FILE_SHARE_OF_BUDGET 8
+
+// What a stat must still report for a cached copy to be current
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+} FileIdentity;
+
+typedef struct CacheEntry {
+    PageCacheFile file;  // first, so pinned files convert back to their entry
+    char *path;
+    uint64_t hash;
+    struct CacheEntry *next_in_bucket;
+    struct CacheEntry *newer;
+    struct CacheEntry *older;
+    const DirListing *listing;  // parent listing the entry was checked against; NULL to stat first
+    FileIdentity identity;
+    size_t charge;
+    int refs;  // one for the table while cached, one per pinned view
+    char *buffer;
+} CacheEntry;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry *buckets[PAGECACHE_BUCKETS];
+static CacheEntry *newest = NULL;
+static CacheEntry *oldest = NULL;
+static size_t budget = PAGECACHE_DEFAULT_BUDGET;
+static PageCacheStats counters = {0};
+
+static uint64_t hash_path(const char *path);
+static void parent_path(const char *path, char *parent, size_t parent_size);
+static CacheEntry *find_entry(const char *path, uint64_t hash);
+static CacheEntry *insert_entry(const char *path, uint64_t hash, char *buffer, size_t size,
+                                const FileIdentity *identity, const DirListing *listing);
+static void remove_entry(CacheEntry *entry);
+static void touch_entry(CacheEntry *entry);
+static void unlink_lru(CacheEntry *entry);
+static void entry_unref(CacheEntry *entry);
+static void evict_until(size_t limit);
+static size_t charge_for(size_t size);
+static FileIdentity identity_of(const struct stat *st);
+static bool same_identity(const FileIdentity *a, const FileIdentity *b);
+static char *read_file(const char *path, size_t max_size, FileIdentity *identity, size_t *size);
+
+const PageCacheFile *pagecache_acquire(const char *full_path) {
+    char parent[PAGECACHE_PATH_SIZE];
+    parent_path(full_path, parent, sizeof(parent));
+    // Taken before the file is looked at, so later changes invalidate it
+    const DirListing *listing = dircache_acquire(parent);
+    uint64_t hash = hash_path(full_path);
+
+    pthread_mutex_lock(&cache_mutex);
+    CacheEntry *entry = find_entry(full_path, hash);
+    if (entry != NULL && listing != NULL && entry->listing == listing) {
+        entry->refs++;
+        touch_entry(entry);
+        counters.hits++;
+        counters.bytes_served += entry->file.size;
+        pthread_mutex_unlock(&cache_mutex);
+        dircache_release(listing);
+        return &entry->file;
+    }
+    bool known = entry != NULL;
+    size_t max_size = budget / FILE_SHARE_OF_BUDGET;
+    pthread_mutex_unlock(&cache_mutex);
+
+    // Something in the directory changed since the entry was checked
+    struct stat st;
+    if (known && stat(full_path, &st) == 0) {
+        FileIdentity identity = identity_of(&st);
+        pthread_mutex_lock(&cache_mutex);
+        entry = find_entry(full_path, hash);
+        if (entry != NULL && same_identity(&entry->identity, &identity)) {
+            if (entry->listing != NULL) {
+                dircache_release(entry->listing);
+            }
+            entry->listing = listing;
+            entry->refs++;
+            touch_entry(entry);
+            counters.hits++;
+            counters.revalidations++;
+            counters.bytes_served += entry->file.size;
+            pthread_mutex_unlock(&cache_mutex);
+            return &entry->file;
+        }
+        pthread_mutex_unlock(&cache_mutex);
+    }
+
+    FileIdentity identity;
+    size_t size = 0;
+    char *buffer = max_size > 0 ? read_file(full_path, max_size, &identity, &size) : NULL;
+
+    pthread_mutex_lock(&cache_mutex);
+    counters.misses++;
+    entry = find_entry(full_path, hash);
+    if (entry != NULL) {
+        remove_entry(entry);
+    }
+    entry = buffer != NULL ? insert_entry(full_path, hash, buffer, size, &identity, listing) : NULL;
+    if (entry != NULL) {
+        listing = NULL;  // the entry holds it now
+        entry->refs++;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    if (listing != NULL) {
+        dircache_release(listing);
+    }
+    if (entry == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    return &entry->file;
+}
+
+void pagecache_release(const PageCacheFile *file) {
+    if (file == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    entry_unref((CacheEntry *)file);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void pagecache_store(const char *full_path, const void *data, size_t size) {
+    struct stat st;
+    pthread_mutex_lock(&cache_mutex);
+    bool cacheable = size <= budget / FILE_SHARE_OF_BUDGET;
+    pthread_mutex_unlock(&cache_mutex);
+    char *buffer = cacheable && stat(full_path, &st) == 0 && (size_t)st.st_size == size ? (char *)malloc(size + 1)
+                                                                                          : NULL;
+    if (buffer != NULL) {
+        memcpy(buffer, data, size);
+    }
+
+    uint64_t hash = hash_path(full_path);
+    pthread_mutex_lock(&cache_mutex);
+    CacheEntry *entry = find_entry(full_path, hash);
+    if (entry != NULL) {
+        remove_entry(entry);
+    }
+    if (buffer != NULL) {
+        // No listing: the write just invalidated the directory's, so the
+        // next read stats the file once before trusting the listing again
+        FileIdentity identity = identity_of(&st);
+        if (insert_entry(full_path, hash, buffer, size, &identity, NULL) == NULL) {
+            free(buffer);
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void pagecache_invalidate(const char *full_path) {
+    uint64_t hash = hash_path(full_path);
+    pthread_mutex_lock(&cache_mutex);
+    CacheEntry *entry = find_entry(full_path, hash);
+    if (entry != NULL) {
+        remove_entry(entry);
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void pagecache_set_budget(size_t bytes) {
+    pthread_mutex_lock(&cache_mutex);
+    budget = bytes;
+    evict_until(budget);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void pagecache_stats(PageCacheStats *stats) {
+    pthread_mutex_lock(&cache_mutex);
+    *stats = counters;
+    stats->budget = budget;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+static uint64_t hash_path(const char *path) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)path; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void parent_path(const char *path, char *parent, size_t parent_size) {
+    snprintf(parent, parent_size, "%s", path);
+    char *slash = strrchr(parent, '/');
+    if (slash == NULL) {
+        snprintf(parent, parent_size, ".");
+    } else if (slash == parent) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+}
+
+static CacheEntry *find_entry(const char *path, uint64_t hash) {
+    for (CacheEntry *entry = buckets[hash % PAGECACHE_BUCKETS]; entry != NULL; entry = entry->next_in_bucket) {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Takes ownership of `buffer` and `listing` on success
+static CacheEntry *insert_entry(const char *path, uint64_t hash, char *buffer, size_t size,
+                                const FileIdentity *identity, const DirListing *listing) {
+    size_t charge = charge_for(size);
+    if (size > budget / FILE_SHARE_OF_BUDGET || charge > budget) {
+        return NULL;
+    }
+    CacheEntry *entry = (CacheEntry *)calloc(1, sizeof(CacheEntry));
+    if (entry == NULL || (entry->path = strdup(path)) == NULL) {
+        free(entry);
+        return NULL;
+    }
+    evict_until(budget - charge);
+
+    entry->file.data = buffer;
+    entry->file.size = size;
+    entry->buffer = buffer;
+    entry->hash = hash;
+    entry->identity = *identity;
+    entry->listing = listing;
+    entry->charge = charge;
+    entry->refs = 1;
+    CacheEntry **bucket = &buckets[hash % PAGECACHE_BUCKETS];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    touch_entry(entry);
+    counters.bytes_cached += charge;
+    counters.files++;
+    return entry;
+}
+
+// Drops the table's reference; pinned views keep the contents alive
+static void remove_entry(CacheEntry *entry) {
+    CacheEntry **link = &buckets[entry->hash % PAGECACHE_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+    unlink_lru(entry);
+    counters.bytes_cached -= entry->charge;
+    counters.files--;
+    if (entry->listing != NULL) {
+        dircache_release(entry->listing);
+        entry->listing = NULL;
+    }
+    entry_unref(entry);
+}
+
+static void touch_entry(CacheEntry *entry) {
+    if (newest == entry) {
+        return;
+    }
+    if (entry->newer != NULL || entry->older != NULL || oldest == entry) {
+        unlink_lru(entry);
+    }
+    entry->older = newest;
+    entry->newer = NULL;
+    if (newest != NULL) {
+        newest->newer = entry;
+    }
+    newest = entry;
+    if (oldest == NULL) {
+        oldest = entry;
+    }
+}
+
+static void unlink_lru(CacheEntry *entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void entry_unref(CacheEntry *entry) {
+    if (--entry->refs > 0) {
+        return;
+    }
+    free(entry->buffer);
+    free(entry->path);
+    free(entry);
+}
+
+static void evict_until(size_t limit) {
+    while (oldest != NULL && counters.bytes_cached > limit) {
+        remove_entry(oldest);
+        counters.evictions++;
+    }
+}
+
+static size_t charge_for(size_t size) {
+    size_t pages = (size + PAGECACHE_PAGE_SIZE - 1) / PAGECACHE_PAGE_SIZE;
+    return (pages > 0 ? pages : 1) * PAGECACHE_PAGE_SIZE;
+}
+
+static FileIdentity identity_of(const struct stat *st) {
+    return (FileIdentity){
+        .device = st->st_dev,
+        .inode = st->st_ino,
+        .size = st->st_size,
+        .mtime = st->st_mtim,
+        .ctime = st->st_ctim,
+    };
+}
+
+static bool same_identity(const FileIdentity *a, const FileIdentity *b) {
+    return a->device == b->device && a->inode == b->inode && a->size == b->size &&
+           a->mtime.tv_sec == b->mtime.tv_sec && a->mtime.tv_nsec == b->mtime.tv_nsec &&
+           a->ctime.tv_sec == b->ctime.tv_sec && a->ctime.tv_nsec == b->ctime.tv_nsec;
+}
+
+// Returns NULL for anything but a regular file of at most `max_size` bytes
+static char *read_file(const char *path, size_t max_size, FileIdentity *identity, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size > max_size) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)st.st_size;
+    char *buffer = (char *)malloc(length + 1);
+    size_t got = 0;
+    while (buffer != NULL && got < length) {
+        ssize_t n = read(fd, buffer + got, length - got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    close(fd);
+    // A file that shrank while being read is left to the caller
+    if (buffer == NULL || got != length) {
+        free(buffer);
+        return NULL;
+    }
+    *identity = identity_of(&st);
+    *size = length;
+    return buffer;
+}
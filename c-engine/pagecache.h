@@ -0,0 +1,56 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stddef.h>
+
+#define PAGECACHE_PAGE_SIZE 4096
+#define PAGECACHE_DEFAULT_BUDGET (64u * 1024u * 1024u)
+
+/**
+ * Contents of one cached file. `data` is NOT NUL-terminated. Pinned
+ * files stay valid until pagecache_release(), even if they are evicted or
+ * the file changes in the meantime.
+ */
+typedef struct {
+    const char *data;
+    size_t size;
+} PageCacheFile;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long revalidations;  // hits that needed a stat after their directory changed
+    unsigned long evictions;
+    unsigned long long bytes_served;
+    size_t bytes_cached;  // charged in whole pages
+    size_t files;
+    size_t budget;
+} PageCacheStats;
+
+/**
+ * Whole-file read cache keyed by full path, within a memory budget
+ * charged in PAGECACHE_PAGE_SIZE pages and evicting the least recently
+ * used files first. Files over an eighth of the budget are not cached.
+ *
+ * Coherence rides on the directory cache: an entry remembers the listing
+ * of its parent it was checked against, and while dircache_acquire()
+ * still returns that listing nothing in the directory has changed, so a
+ * hit costs two hash probes and no system calls. Once the directory
+ * changes, the next hit stats the file and keeps the entry only if its
+ * inode, size, mtime and ctime are unchanged.
+ *
+ * Returns NULL when the file is missing, not a regular file, too large
+ * or the cache is disabled; callers then read it themselves.
+ */
+const PageCacheFile *pagecache_acquire(const char *full_path);
+void pagecache_release(const PageCacheFile *file);
+
+// Write-through: caches what the engine just wrote to `full_path`
+void pagecache_store(const char *full_path, const void *data, size_t size);
+void pagecache_invalidate(const char *full_path);
+
+// Evicts down to the new budget; 0 disables the cache
+void pagecache_set_budget(size_t bytes);
+void pagecache_stats(PageCacheStats *stats);
+
+#endif // PAGECACHE_H
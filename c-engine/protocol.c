@@ -0,0 +1,44 @@
+#include "protocol.h"
+
+void genix_put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)((value >> 8) & 0xFF);
+    out[2] = (unsigned char)((value >> 16) & 0xFF);
+    out[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+void genix_put_u16(unsigned char *out, uint16_t value) {
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+void genix_put_u64(unsigned char *out, uint64_t value) {
+    genix_put_u32(out, (uint32_t)(value & 0xFFFFFFFFu));
+    genix_put_u32(out + 4, (uint32_t)(value >> 32));
+}
+
+uint32_t genix_get_u32(const unsigned char *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+uint16_t genix_get_u16(const unsigned char *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint64_t genix_get_u64(const unsigned char *in) {
+    return (uint64_t)genix_get_u32(in) | ((uint64_t)genix_get_u32(in + 4) << 32);
+}
+
+void genix_frame_encode_header(const GenixFrameHeader *header, unsigned char *out) {
+    genix_put_u32(out, header->length);
+    genix_put_u32(out + 4, header->request_id);
+    genix_put_u16(out + 8, header->opcode);
+    genix_put_u16(out + 10, header->status);
+}
+
+void genix_frame_decode_header(const unsigned char *in, GenixFrameHeader *header) {
+    header->length = genix_get_u32(in);
+    header->request_id = genix_get_u32(in + 4);
+    header->opcode = genix_get_u16(in + 8);
+    header->status = genix_get_u16(in + 10);
+}
@@ -0,0 +1,196 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Framed request/response protocol spoken by the engine daemon.
+ *
+ * Every frame is a fixed 12-byte little-endian header followed by `length`
+ * payload bytes:
+ *
+ *   u32 length | u32 request_id | u16 opcode | u16 status
+ *
+ * Requests carry status 0. Responses echo the request_id and opcode so a
+ * client can pipeline many requests over one connection and match replies.
+ *
+ * LIST takes an absolute directory path and answers with one record per
+ * entry, sorted by name:
+ *
+ *   u16 name_length | u8 type | u8 reserved | u64 size | u64 mtime_ms | name
+ *
+ * STATS answers with "name value" text lines.
+ *
+ * EVAL evaluates one calculator expression over columns of variable values
+ * (see calc_execute_batch):
+ *
+ *   u16 expression_length | u16 variable_count | u32 rows | expression |
+ *   variable_count x (u8 name_length | name) |
+ *   variable_count x rows f64 values, one column after another
+ *
+ * and answers with `rows` f64 results, or an error message on failure.
+ *
+ * EXEC_STREAM runs a command like EXEC but streams its output: any number
+ * of MORE frames carrying successive output chunks, then one frame with
+ * the final status. Each streaming request has its own window: once
+ * GENIX_STREAM_WINDOW bytes of MORE payload are unacknowledged the command
+ * waits, so a slow reader throttles only its own command, and the daemon's
+ * buffers stay bounded without the client having to stop reading the
+ * connection. The client acknowledges payload it has consumed with
+ *
+ *   STREAM_ACK  u32 bytes
+ *
+ * sent with the streaming request's own request_id; it is not answered.
+ * A stream left without acknowledgements for 30 s fails alone: its
+ * command is stopped and its final frame is ERROR.
+ *
+ * SESSION_OPEN creates a shell session with its own working directory,
+ * environment and history and answers with its u32 id. SESSION_EXEC takes
+ *
+ *   u32 session_id | command
+ *
+ * and streams like EXEC_STREAM; a session runs its commands one at a time,
+ * in the order they arrived. SESSION_CLOSE takes the u32 id. Sessions
+ * belong to the connection that opened them and close with it.
+ *
+ * COMPLETE takes
+ *
+ *   u32 session_id | line
+ *
+ * with session 0 for none, and answers with the byte offset in `line` where
+ * its last word starts, then the completions of that word, one per line.
+ * Within a session it runs after the commands sent before it.
+ *
+ * HISTORY searches the persistent command history:
+ *
+ *   u8 mode (0 prefix, 1 substring) | u8 reserved | u16 limit | query
+ *
+ * and answers with the distinct matching commands, newest first, one per
+ * line.
+ *
+ * SEARCH queries the full-text index of the --index directory:
+ *
+ *   u16 limit | query
+ *
+ * and answers with the files containing every word of the query, best
+ * first, one per line as "path\tline\tscore\tsnippet" (line 0 and an empty
+ * snippet when no line shows a query word), or NOT_FOUND without an index.
+ * INDEX takes an absolute path written by someone other than the engine
+ * and brings the index up to date with it, dropping any cached copy.
+ *
+ * GREP runs grep -rn over an absolute directory:
+ *
+ *   u8 flags (1 ignore case, 2 fixed string, 4 extended regex) | u8 reserved |
+ *   u16 limit | pattern \0 directory
+ *
+ * and answers with up to `limit` matching lines (0 for the daemon's maximum)
+ * in path order, one per line as "path\tline\ttext" with the path relative
+ * to the directory, BAD_REQUEST with the regex error, or NOT_FOUND if the
+ * directory cannot be read.
+ *
+ * READ takes an absolute file path and answers with its contents, served
+ * from the page cache when they are there, NOT_FOUND if it cannot be read,
+ * or ERROR if it does not fit in one frame.
+ *
+ * RUN runs a program through the runner's zygotes (see runner.h):
+ *
+ *   u32 wall_ms | u32 cpu_seconds | u32 memory_mb | u32 file_mb |
+ *   u32 processes | path \0 working_directory
+ *
+ * with absolute paths and 0 for a default limit, and answers once it has
+ * exited with
+ *
+ *   i32 exit_code | u8 signal | u8 flags (1 timed out, 2 output truncated) |
+ *   u16 reserved | u64 wall_us | u64 user_us | u64 system_us |
+ *   u64 max_rss_kb | u32 stdout_length | stdout | stderr
+ *
+ * exit_code is -1 when a signal ended it. NOT_FOUND means the program
+ * does not exist; ERROR carries the reason it could not be started.
+ *
+ * RUN_TERMINAL runs a program the same way but on a pseudo-terminal, for
+ * programs that read input:
+ *
+ *   u32 wall_ms | u32 cpu_seconds | u32 memory_mb | u32 file_mb |
+ *   u32 processes | u16 rows | u16 columns | path \0 working_directory
+ *
+ * What the program writes to the terminal streams back in MORE frames of
+ * up to 64 KiB, each sent when full or 16 ms after its first byte, and a
+ * final frame answers like RUN with no output. As with EXEC_STREAM, a
+ * client that stops acknowledging stops the program. While it runs, these take
+ * the u32 request_id of the RUN_TERMINAL:
+ *
+ *   RUN_INPUT   u32 request_id | bytes typed into the terminal
+ *   RUN_RESIZE  u32 request_id | u16 rows | u16 columns
+ *   RUN_KILL    u32 request_id
+ *
+ * and answer OK, or NOT_FOUND when no such run is in progress. RUN_INPUT
+ * answers ERROR when the program leaves more than 64 KiB of input unread.
+ * Ctrl+C typed as input interrupts the program; RUN_KILL kills it and
+ * everything it started.
+ */
+
+#define GENIX_FRAME_HEADER_SIZE 12
+#define GENIX_FRAME_MAX_PAYLOAD (16u * 1024u * 1024u)
+#define GENIX_DIR_RECORD_HEADER_SIZE 20
+
+#define GENIX_GREP_IGNORE_CASE 1
+#define GENIX_GREP_FIXED 2
+#define GENIX_GREP_EXTENDED 4
+
+#define GENIX_RUN_REQUEST_HEADER_SIZE 20
+#define GENIX_RUN_RESPONSE_HEADER_SIZE 44
+#define GENIX_RUN_TIMED_OUT 1
+#define GENIX_RUN_TRUNCATED 2
+#define GENIX_RUN_TERMINAL_HEADER_SIZE 24
+#define GENIX_STREAM_WINDOW (256 * 1024)
+
+typedef enum {
+    GENIX_OP_PING = 1,
+    GENIX_OP_EXEC = 2,
+    GENIX_OP_LIST = 3,
+    GENIX_OP_STATS = 4,
+    GENIX_OP_EVAL = 5,
+    GENIX_OP_EXEC_STREAM = 6,
+    GENIX_OP_SESSION_OPEN = 7,
+    GENIX_OP_SESSION_CLOSE = 8,
+    GENIX_OP_SESSION_EXEC = 9,
+    GENIX_OP_COMPLETE = 10,
+    GENIX_OP_HISTORY = 11,
+    GENIX_OP_SEARCH = 12,
+    GENIX_OP_INDEX = 13,
+    GENIX_OP_GREP = 14,
+    GENIX_OP_READ = 15,
+    GENIX_OP_RUN = 16,
+    GENIX_OP_RUN_TERMINAL = 17,
+    GENIX_OP_RUN_INPUT = 18,
+    GENIX_OP_RUN_RESIZE = 19,
+    GENIX_OP_RUN_KILL = 20,
+    GENIX_OP_STREAM_ACK = 21
+} GenixOpcode;
+
+typedef enum {
+    GENIX_STATUS_OK = 0,
+    GENIX_STATUS_ERROR = 1,
+    GENIX_STATUS_NOT_FOUND = 2,
+    GENIX_STATUS_BAD_REQUEST = 3,
+    GENIX_STATUS_MORE = 4
+} GenixStatus;
+
+typedef struct {
+    uint32_t length;
+    uint32_t request_id;
+    uint16_t opcode;
+    uint16_t status;
+} GenixFrameHeader;
+
+void genix_frame_encode_header(const GenixFrameHeader *header, unsigned char *out);
+void genix_frame_decode_header(const unsigned char *in, GenixFrameHeader *header);
+void genix_put_u16(unsigned char *out, uint16_t value);
+void genix_put_u32(unsigned char *out, uint32_t value);
+void genix_put_u64(unsigned char *out, uint64_t value);
+uint16_t genix_get_u16(const unsigned char *in);
+uint32_t genix_get_u32(const unsigned char *in);
+uint64_t genix_get_u64(const unsigned char *in);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,1054 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "runner.h"
+
+#define MAX_ZYGOTES 64
+// Where a zygote finds its socket
+#define ZYGOTE_FD 3
+#define RUNNER_PATH_SIZE 4096
+// Still the running binary after it was rebuilt or deleted on disk
+#define SELF_PATH "/proc/self/exe"
+#define RUNNER_READ_CHUNK 65536
+#define RUNNER_INITIAL_CAPTURE 4096
+// Output may still arrive after the exit from processes that left the group
+#define RUNNER_DRAIN_MS 100
+#define RUNNER_DEFAULT_ROWS 24
+#define RUNNER_DEFAULT_COLUMNS 80
+#define CGROUP_ROOT "/sys/fs/cgroup"
+// Rounds of killing what is left in a run's cgroup, which may still be forking
+#define CGROUP_KILL_ROUNDS 8
+
+extern char **environ;
+
+// Followed by the path and the working directory, each NUL-terminated
+typedef struct {
+    RunLimits limits;
+    uint32_t terminal;  // the three descriptors are one terminal, to become the controlling one
+    uint32_t path_length;
+    uint32_t cwd_length;
+} ZygoteRequest;
+
+// Sent ahead of the reply for a terminal run once the program started, so
+// the engine can kill it
+typedef struct {
+    int32_t pid;
+} ZygoteStarted;
+
+typedef struct {
+    int32_t wait_status;
+    int32_t exec_errno;  // nonzero when the program never started
+    uint32_t timed_out;
+    uint64_t wall_us;
+    uint64_t user_us;
+    uint64_t system_us;
+    uint64_t max_rss_kb;
+} ZygoteReply;
+
+typedef struct {
+    int fd;  // -1 when the zygote has to be started
+    pid_t pid;
+    bool busy;
+} Zygote;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool truncated;
+} Capture;
+
+struct RunTerminal {
+    int master;
+    int slave;  // handed to the program, then closed
+    int wake_fd;  // input was queued while the terminal was full
+    pthread_mutex_t lock;
+    pid_t pid;  // the program's, while it runs
+    bool exited;
+    bool kill_requested;
+    size_t input_length;
+    char input[RUNNER_TERMINAL_INPUT_LIMIT];
+    char frame[RUNNER_TERMINAL_FRAME_SIZE];
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static Zygote zygotes[MAX_ZYGOTES];
+static int zygote_count = 0;
+
+// In a zygote: its own pids cgroup, which each program joins; empty without one
+static char cgroup_path[RUNNER_PATH_SIZE + 64];
+static int cgroup_procs_fd = -1;
+static int cgroup_max_fd = -1;
+
+static int start_zygote(Zygote *zygote);
+static void stop_zygote(Zygote *zygote);
+static Zygote *acquire_zygote(bool grow);
+static void release_zygote(Zygote *zygote, bool healthy);
+static int send_request(int fd, const char *path, const char *cwd, const RunLimits *limits, bool terminal,
+                        const int fds[3]);
+static int collect(int zygote_fd, int out_fd, int err_fd, ZygoteReply *reply, Capture *out, Capture *err);
+static bool capture_read(int fd, Capture *capture);
+static void fill_result(const ZygoteReply *reply, RunResult *result);
+static int relay(RunTerminal *terminal, int zygote_fd, RunOutputFn output, void *context, ZygoteReply *reply);
+static bool relay_read(RunTerminal *terminal, size_t *frame_length);
+static void flush_input(RunTerminal *terminal);
+static void close_fd(int *fd);
+static uint64_t monotonic_us(void);
+static void close_inherited_fds(void);
+static void open_cgroup(void);
+static void close_cgroup(void);
+static int open_in_cgroup(const char *name, int flags);
+static void kill_cgroup(void);
+static void serve_run(int fd, const unsigned char *message, size_t length, const int fds[3]);
+static void run_program(int fd, const ZygoteRequest *request, const char *path, const char *cwd, const int fds[3],
+                        ZygoteReply *reply);
+static void exec_child(const RunLimits *limits, bool terminal, const char *path, const char *cwd, const int fds[3],
+                       int status_fd);
+static int apply_limit(int resource, uint64_t value, uint64_t hard_extra);
+static bool wait_with_deadline(pid_t pid, uint64_t deadline_us, int *status, struct rusage *usage);
+
+int runner_init(int count) {
+    count = count < MAX_ZYGOTES ? count : MAX_ZYGOTES;
+
+    int started = 0;
+    pthread_mutex_lock(&pool_mutex);
+    for (int i = 0; i < count; ++i) {
+        zygotes[i] = (Zygote){.fd = -1, .pid = -1, .busy = false};
+        started += start_zygote(&zygotes[i]) == 0;
+    }
+    zygote_count = started > 0 ? count : 0;
+    pthread_mutex_unlock(&pool_mutex);
+    return started > 0 ? 0 : -1;
+}
+
+void runner_shutdown(void) {
+    pthread_mutex_lock(&pool_mutex);
+    while (true) {
+        bool busy = false;
+        for (int i = 0; i < zygote_count; ++i) {
+            busy |= zygotes[i].busy;
+        }
+        if (!busy) {
+            break;
+        }
+        pthread_cond_wait(&pool_idle, &pool_mutex);
+    }
+    for (int i = 0; i < zygote_count; ++i) {
+        stop_zygote(&zygotes[i]);
+    }
+    zygote_count = 0;
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+bool runner_available(void) {
+    pthread_mutex_lock(&pool_mutex);
+    bool available = zygote_count > 0;
+    pthread_mutex_unlock(&pool_mutex);
+    return available;
+}
+
+int runner_run(const char *path, const char *cwd, const RunLimits *limits, RunResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (path[0] != '/' || strlen(path) >= RUNNER_PATH_SIZE || strlen(cwd) >= RUNNER_PATH_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    Zygote *zygote = acquire_zygote(false);
+    if (zygote == NULL) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int out_pipe[2] = {-1, -1};
+    int err_pipe[2] = {-1, -1};
+    ZygoteReply reply;
+    Capture out = {0};
+    Capture err = {0};
+    int status = -1;
+    bool healthy = true;
+    if (null_fd >= 0 && pipe2(out_pipe, O_CLOEXEC) == 0 && pipe2(err_pipe, O_CLOEXEC) == 0) {
+        int fds[3] = {null_fd, out_pipe[1], err_pipe[1]};
+        healthy = send_request(zygote->fd, path, cwd, limits, false, fds) == 0;
+        // The program holds the write ends now; ours would keep the pipes from reaching EOF
+        close_fd(&null_fd);
+        close_fd(&out_pipe[1]);
+        close_fd(&err_pipe[1]);
+        healthy = healthy && collect(zygote->fd, out_pipe[0], err_pipe[0], &reply, &out, &err) == 0;
+        if (!healthy) {
+            errno = EIO;
+        } else if (reply.exec_errno != 0) {
+            errno = reply.exec_errno;
+        } else {
+            status = 0;
+        }
+    }
+    int saved_errno = errno;
+    close_fd(&null_fd);
+    close_fd(&out_pipe[0]);
+    close_fd(&out_pipe[1]);
+    close_fd(&err_pipe[0]);
+    close_fd(&err_pipe[1]);
+    release_zygote(zygote, healthy);
+
+    if (status != 0) {
+        free(out.data);
+        free(err.data);
+        errno = saved_errno;
+        return -1;
+    }
+    fill_result(&reply, result);
+    result->truncated = out.truncated || err.truncated;
+    result->out = out.data;
+    result->out_length = out.length;
+    result->err = err.data;
+    result->err_length = err.length;
+    return 0;
+}
+
+void runner_result_free(RunResult *result) {
+    free(result->out);
+    free(result->err);
+    result->out = NULL;
+    result->err = NULL;
+}
+
+RunTerminal *runner_terminal_create(uint16_t rows, uint16_t columns) {
+    RunTerminal *terminal = (RunTerminal *)calloc(1, sizeof(RunTerminal));
+    if (terminal == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&terminal->lock, NULL);
+    terminal->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC | O_NONBLOCK);
+    terminal->slave = -1;
+    terminal->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    char name[64];
+    bool opened = terminal->master >= 0 && terminal->wake_fd >= 0 && grantpt(terminal->master) == 0 &&
+                  unlockpt(terminal->master) == 0 && ptsname_r(terminal->master, name, sizeof(name)) == 0 &&
+                  (terminal->slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC)) >= 0 &&
+                  runner_terminal_resize(terminal, rows, columns) == 0;
+    if (!opened) {
+        int saved_errno = errno;
+        runner_terminal_destroy(terminal);
+        errno = saved_errno;
+        return NULL;
+    }
+    return terminal;
+}
+
+int runner_terminal_run(RunTerminal *terminal, const char *path, const char *cwd, const RunLimits *limits,
+                        RunOutputFn output, void *context, RunResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (path[0] != '/' || strlen(path) >= RUNNER_PATH_SIZE || strlen(cwd) >= RUNNER_PATH_SIZE ||
+        terminal->slave < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    Zygote *zygote = acquire_zygote(true);
+    if (zygote == NULL) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    int fds[3] = {terminal->slave, terminal->slave, terminal->slave};
+    bool healthy = send_request(zygote->fd, path, cwd, limits, true, fds) == 0;
+    // Ours would keep the master from seeing the program's side close
+    close_fd(&terminal->slave);
+    ZygoteReply reply;
+    healthy = healthy && relay(terminal, zygote->fd, output, context, &reply) == 0;
+
+    pthread_mutex_lock(&terminal->lock);
+    if (!healthy && terminal->pid > 0) {
+        // Its zygote is going away and would not reap it
+        kill(-terminal->pid, SIGKILL);
+    }
+    terminal->pid = 0;
+    terminal->exited = true;
+    pthread_mutex_unlock(&terminal->lock);
+    release_zygote(zygote, healthy);
+
+    if (!healthy) {
+        errno = EIO;
+        return -1;
+    }
+    if (reply.exec_errno != 0) {
+        errno = reply.exec_errno;
+        return -1;
+    }
+    fill_result(&reply, result);
+    return 0;
+}
+
+int runner_terminal_write(RunTerminal *terminal, const char *data, size_t length) {
+    int status = 0;
+    pthread_mutex_lock(&terminal->lock);
+    if (terminal->exited) {
+        errno = EPIPE;
+        status = -1;
+    } else if (length > RUNNER_TERMINAL_INPUT_LIMIT - terminal->input_length) {
+        errno = ENOBUFS;
+        status = -1;
+    } else {
+        memcpy(terminal->input + terminal->input_length, data, length);
+        terminal->input_length += length;
+        flush_input(terminal);
+        if (terminal->input_length > 0) {
+            // The run loop writes the rest as the program reads
+            uint64_t one = 1;
+            ssize_t ignored = write(terminal->wake_fd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+    pthread_mutex_unlock(&terminal->lock);
+    return status;
+}
+
+// The kernel sends the program SIGWINCH
+int runner_terminal_resize(RunTerminal *terminal, uint16_t rows, uint16_t columns) {
+    struct winsize size = {
+        .ws_row = rows > 0 ? rows : RUNNER_DEFAULT_ROWS,
+        .ws_col = columns > 0 ? columns : RUNNER_DEFAULT_COLUMNS,
+    };
+    return ioctl(terminal->master, TIOCSWINSZ, &size);
+}
+
+void runner_terminal_kill(RunTerminal *terminal) {
+    pthread_mutex_lock(&terminal->lock);
+    terminal->kill_requested = true;
+    // Not reaped before the zygote reports, so the group cannot be someone else's yet
+    if (terminal->pid > 0) {
+        kill(-terminal->pid, SIGKILL);
+    }
+    pthread_mutex_unlock(&terminal->lock);
+}
+
+void runner_terminal_destroy(RunTerminal *terminal) {
+    close_fd(&terminal->master);
+    close_fd(&terminal->slave);
+    close_fd(&terminal->wake_fd);
+    pthread_mutex_destroy(&terminal->lock);
+    free(terminal);
+}
+
+int runner_zygote_main(int fd) {
+    close_inherited_fds();
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    // The engine may go away mid-reply; that is an EPIPE, not a reason to die
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t children;
+    sigemptyset(&children);
+    sigaddset(&children, SIGCHLD);
+    sigprocmask(SIG_SETMASK, &children, NULL);
+    open_cgroup();
+
+    unsigned char message[sizeof(ZygoteRequest) + 2 * RUNNER_PATH_SIZE];
+    while (true) {
+        union {
+            char buffer[CMSG_SPACE(3 * sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = {.iov_base = message, .iov_len = sizeof(message)};
+        struct msghdr header = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buffer,
+            .msg_controllen = sizeof(control.buffer),
+        };
+        ssize_t length = recvmsg(fd, &header, MSG_CMSG_CLOEXEC);
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            // The engine closed its end or exited
+            close_cgroup();
+            return length == 0 ? 0 : 1;
+        }
+
+        int fds[3] = {-1, -1, -1};
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), (count < 3 ? count : 3) * sizeof(int));
+        }
+        serve_run(fd, message, (size_t)length, fds);
+        for (int i = 0; i < 3; ++i) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+    }
+}
+
+// Re-executes this binary as a zygote on a socket pair; runs with pool_mutex held
+static int start_zygote(Zygote *zygote) {
+    int ends[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, ends) != 0) {
+        return -1;
+    }
+    // dup2() onto its own number would leave close-on-exec set
+    int child_end = ends[1];
+    if (child_end == ZYGOTE_FD) {
+        child_end = fcntl(ends[1], F_DUPFD_CLOEXEC, ZYGOTE_FD + 1);
+        close(ends[1]);
+        if (child_end < 0) {
+            close(ends[0]);
+            return -1;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, child_end, ZYGOTE_FD);
+    // Worker threads block signals the zygote must not inherit blocked
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attributes, &none);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+
+    char fd_text[16];
+    snprintf(fd_text, sizeof(fd_text), "%d", ZYGOTE_FD);
+    char *argv[] = {SELF_PATH, "--zygote", fd_text, NULL};
+    pid_t pid;
+    int error = posix_spawn(&pid, SELF_PATH, &actions, &attributes, argv, environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(child_end);
+    if (error != 0) {
+        close(ends[0]);
+        errno = error;
+        return -1;
+    }
+    zygote->fd = ends[0];
+    zygote->pid = pid;
+    return 0;
+}
+
+// Closing the socket ends the zygote's loop
+static void stop_zygote(Zygote *zygote) {
+    if (zygote->fd >= 0) {
+        close(zygote->fd);
+        zygote->fd = -1;
+    }
+    if (zygote->pid > 0) {
+        while (waitpid(zygote->pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+        zygote->pid = -1;
+    }
+}
+
+// Waits for an idle zygote, restarting it first if it died. With `grow`
+// another one is started instead of waiting, while there is room.
+static Zygote *acquire_zygote(bool grow) {
+    pthread_mutex_lock(&pool_mutex);
+    Zygote *zygote = NULL;
+    while (zygote_count > 0 && zygote == NULL) {
+        for (int i = 0; i < zygote_count && zygote == NULL; ++i) {
+            zygote = zygotes[i].busy ? NULL : &zygotes[i];
+        }
+        if (zygote == NULL && grow && zygote_count < MAX_ZYGOTES) {
+            zygote = &zygotes[zygote_count++];
+            *zygote = (Zygote){.fd = -1, .pid = -1, .busy = false};
+        }
+        if (zygote == NULL) {
+            pthread_cond_wait(&pool_idle, &pool_mutex);
+        }
+    }
+    if (zygote != NULL && zygote->fd < 0 && start_zygote(zygote) != 0) {
+        zygote = NULL;
+    }
+    if (zygote != NULL) {
+        zygote->busy = true;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return zygote;
+}
+
+static void release_zygote(Zygote *zygote, bool healthy) {
+    pthread_mutex_lock(&pool_mutex);
+    if (!healthy) {
+        // Kill rather than wait: a zygote that stopped answering may never exit
+        kill(zygote->pid, SIGKILL);
+        stop_zygote(zygote);
+    }
+    zygote->busy = false;
+    pthread_cond_broadcast(&pool_idle);
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+static int send_request(int fd, const char *path, const char *cwd, const RunLimits *limits, bool terminal,
+                        const int fds[3]) {
+    ZygoteRequest request = {
+        .limits = *limits,
+        .terminal = terminal,
+        .path_length = (uint32_t)strlen(path),
+        .cwd_length = (uint32_t)strlen(cwd),
+    };
+    struct iovec iov[3] = {
+        {.iov_base = &request, .iov_len = sizeof(request)},
+        {.iov_base = (void *)path, .iov_len = request.path_length + 1},
+        {.iov_base = (void *)cwd, .iov_len = request.cwd_length + 1},
+    };
+    union {
+        char buffer[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr header = {
+        .msg_iov = iov,
+        .msg_iovlen = 3,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &header, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent < 0 ? -1 : 0;
+}
+
+// Reads both streams until the zygote has reported and the streams ended,
+// giving stragglers RUNNER_DRAIN_MS after the report
+static int collect(int zygote_fd, int out_fd, int err_fd, ZygoteReply *reply, Capture *out, Capture *err) {
+    struct pollfd fds[3] = {
+        {.fd = out_fd, .events = POLLIN},
+        {.fd = err_fd, .events = POLLIN},
+        {.fd = zygote_fd, .events = POLLIN},
+    };
+    Capture *captures[2] = {out, err};
+    uint64_t drain_deadline = 0;
+    while (fds[0].fd >= 0 || fds[1].fd >= 0 || fds[2].fd >= 0) {
+        int timeout = -1;
+        if (fds[2].fd < 0) {
+            uint64_t now = monotonic_us();
+            if (now >= drain_deadline) {
+                break;
+            }
+            timeout = (int)((drain_deadline - now + 999) / 1000);
+        }
+        int ready = poll(fds, 3, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            // Timed out draining, or poll failed after the report
+            return fds[2].fd < 0 ? 0 : -1;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].revents != 0 && !capture_read(fds[i].fd, captures[i])) {
+                fds[i].fd = -1;
+            }
+        }
+        if (fds[2].revents != 0) {
+            ssize_t length;
+            do {
+                length = recv(zygote_fd, reply, sizeof(*reply), 0);
+            } while (length < 0 && errno == EINTR);
+            if (length != (ssize_t)sizeof(*reply)) {
+                return -1;
+            }
+            fds[2].fd = -1;
+            drain_deadline = monotonic_us() + RUNNER_DRAIN_MS * 1000;
+        }
+    }
+    return 0;
+}
+
+// Returns false at end of stream. Past the limit, output is read and dropped
+static bool capture_read(int fd, Capture *capture) {
+    char chunk[RUNNER_READ_CHUNK];
+    ssize_t length;
+    do {
+        length = read(fd, chunk, sizeof(chunk));
+    } while (length < 0 && errno == EINTR);
+    if (length <= 0) {
+        return false;
+    }
+    size_t keep = RUNNER_OUTPUT_LIMIT - capture->length;
+    if ((size_t)length > keep) {
+        capture->truncated = true;
+    } else {
+        keep = (size_t)length;
+    }
+    if (keep > 0 && capture->length + keep > capture->capacity) {
+        size_t capacity = capture->capacity > 0 ? capture->capacity : RUNNER_INITIAL_CAPTURE;
+        while (capacity < capture->length + keep) {
+            capacity *= 2;
+        }
+        capacity = capacity < RUNNER_OUTPUT_LIMIT ? capacity : RUNNER_OUTPUT_LIMIT;
+        char *data = (char *)realloc(capture->data, capacity);
+        if (data == NULL) {
+            capture->truncated = true;
+            return true;
+        }
+        capture->data = data;
+        capture->capacity = capacity;
+    }
+    memcpy(capture->data + capture->length, chunk, keep);
+    capture->length += keep;
+    return true;
+}
+
+static void fill_result(const ZygoteReply *reply, RunResult *result) {
+    result->exit_code = WIFEXITED(reply->wait_status) ? WEXITSTATUS(reply->wait_status) : -1;
+    result->signal = WIFSIGNALED(reply->wait_status) ? WTERMSIG(reply->wait_status) : 0;
+    result->timed_out = reply->timed_out != 0;
+    result->wall_us = reply->wall_us;
+    result->user_us = reply->user_us;
+    result->system_us = reply->system_us;
+    result->max_rss_kb = reply->max_rss_kb;
+}
+
+// Passes the terminal's output on, a frame at a time, and its queued input
+// in, until the zygote has reported and the terminal closed, giving
+// stragglers RUNNER_DRAIN_MS after the report
+static int relay(RunTerminal *terminal, int zygote_fd, RunOutputFn output, void *context, ZygoteReply *reply) {
+    struct pollfd fds[3] = {
+        {.fd = terminal->master, .events = POLLIN},
+        {.fd = terminal->wake_fd, .events = POLLIN},
+        {.fd = zygote_fd, .events = POLLIN},
+    };
+    size_t frame_length = 0;
+    uint64_t flush_deadline = 0;
+    uint64_t drain_deadline = 0;
+    bool cancelled = false;
+    while (true) {
+        uint64_t now = monotonic_us();
+        bool reported = fds[2].fd < 0;
+        bool finished = reported && (fds[0].fd < 0 || now >= drain_deadline);
+        if (frame_length > 0 &&
+            (finished || frame_length == RUNNER_TERMINAL_FRAME_SIZE || now >= flush_deadline)) {
+            // Blocks while the reader is behind; the program then blocks on the full terminal
+            if (!cancelled && output(context, terminal->frame, frame_length) != 0) {
+                cancelled = true;
+                runner_terminal_kill(terminal);
+            }
+            frame_length = 0;
+            continue;
+        }
+        if (finished) {
+            return 0;
+        }
+
+        uint64_t wake_at = frame_length > 0 ? flush_deadline : 0;
+        if (reported && (wake_at == 0 || drain_deadline < wake_at)) {
+            wake_at = drain_deadline;
+        }
+        int timeout = wake_at > 0 ? (int)((wake_at - now + 999) / 1000) : -1;
+        pthread_mutex_lock(&terminal->lock);
+        fds[0].events = POLLIN | (terminal->input_length > 0 ? POLLOUT : 0);
+        pthread_mutex_unlock(&terminal->lock);
+        int ready = poll(fds, 3, timeout);
+        if (ready < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (fds[1].revents != 0) {
+            uint64_t wakeups;
+            ssize_t ignored = read(terminal->wake_fd, &wakeups, sizeof(wakeups));
+            (void)ignored;
+        }
+        if (fds[0].revents & POLLOUT) {
+            pthread_mutex_lock(&terminal->lock);
+            flush_input(terminal);
+            pthread_mutex_unlock(&terminal->lock);
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            bool was_empty = frame_length == 0;
+            if (!relay_read(terminal, &frame_length)) {
+                fds[0].fd = -1;
+            }
+            if (cancelled) {
+                frame_length = 0;
+            } else if (was_empty && frame_length > 0) {
+                flush_deadline = monotonic_us() + RUNNER_TERMINAL_FLUSH_MS * 1000;
+            }
+        }
+        if (fds[2].revents != 0) {
+            union {
+                ZygoteStarted started;
+                ZygoteReply reply;
+            } message;
+            ssize_t length;
+            do {
+                length = recv(zygote_fd, &message, sizeof(message), 0);
+            } while (length < 0 && errno == EINTR);
+            if (length == (ssize_t)sizeof(message.started)) {
+                pthread_mutex_lock(&terminal->lock);
+                terminal->pid = message.started.pid;
+                if (terminal->kill_requested) {
+                    kill(-terminal->pid, SIGKILL);
+                }
+                pthread_mutex_unlock(&terminal->lock);
+            } else if (length == (ssize_t)sizeof(message.reply)) {
+                *reply = message.reply;
+                // Reaped: the pid may be reused from here on
+                pthread_mutex_lock(&terminal->lock);
+                terminal->pid = 0;
+                terminal->exited = true;
+                pthread_mutex_unlock(&terminal->lock);
+                fds[2].fd = -1;
+                drain_deadline = monotonic_us() + RUNNER_DRAIN_MS * 1000;
+            } else {
+                return -1;
+            }
+        }
+    }
+}
+
+// Fills the frame from the terminal; returns false once the program's side
+// has closed (EIO) and nothing is left to read
+static bool relay_read(RunTerminal *terminal, size_t *frame_length) {
+    while (*frame_length < RUNNER_TERMINAL_FRAME_SIZE) {
+        ssize_t length = read(terminal->master, terminal->frame + *frame_length,
+                              RUNNER_TERMINAL_FRAME_SIZE - *frame_length);
+        if (length > 0) {
+            *frame_length += (size_t)length;
+            continue;
+        }
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        return length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
+
+// Moves queued input into the terminal as far as it takes it; runs with the lock held
+static void flush_input(RunTerminal *terminal) {
+    size_t written = 0;
+    while (written < terminal->input_length) {
+        ssize_t length = write(terminal->master, terminal->input + written, terminal->input_length - written);
+        if (length > 0) {
+            written += (size_t)length;
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    memmove(terminal->input, terminal->input + written, terminal->input_length - written);
+    terminal->input_length -= written;
+}
+
+static void close_fd(int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Everything but the standard streams and the socket: the daemon's
+// listener and client connections must not reach student programs
+static void close_inherited_fds(void) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, ZYGOTE_FD + 1, ~0U, 0) == 0) {
+        return;
+    }
+#endif
+    long max = sysconf(_SC_OPEN_MAX);
+    for (long fd = ZYGOTE_FD + 1; fd < max && fd < 65536; ++fd) {
+        close((int)fd);
+    }
+}
+
+/**
+ * RLIMIT_NPROC would count every process of the user the engine runs as,
+ * so processes are limited with a pids cgroup instead: one per zygote, below
+ * the cgroup the zygote was started in, from the v1 pids hierarchy or from
+ * v2 when pids is enabled for children. Without either programs have no
+ * process limit, only the group kill and the CPU and memory limits.
+ */
+static void open_cgroup(void) {
+    FILE *file = fopen("/proc/self/cgroup", "re");
+    if (file == NULL) {
+        return;
+    }
+    char line[RUNNER_PATH_SIZE];
+    char base[RUNNER_PATH_SIZE + 32] = "";
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // "id:controllers:path", with no controllers for v2
+        line[strcspn(line, "\n")] = '\0';
+        char *controllers = strchr(line, ':');
+        char *path = controllers != NULL ? strchr(controllers + 1, ':') : NULL;
+        if (path == NULL) {
+            continue;
+        }
+        *controllers++ = '\0';
+        *path++ = '\0';
+        bool pids = false;
+        char *saved = NULL;
+        for (char *name = strtok_r(controllers, ",", &saved); name != NULL; name = strtok_r(NULL, ",", &saved)) {
+            pids |= strcmp(name, "pids") == 0;
+        }
+        if (pids) {
+            snprintf(base, sizeof(base), CGROUP_ROOT "/pids%s", path);
+            break;
+        }
+        if (controllers[0] == '\0') {
+            snprintf(base, sizeof(base), CGROUP_ROOT "%s", path);
+        }
+    }
+    fclose(file);
+
+    int written = snprintf(cgroup_path, sizeof(cgroup_path), "%s/genix-zygote-%d", base, (int)getpid());
+    if (base[0] == '\0' || written < 0 || (size_t)written >= sizeof(cgroup_path) ||
+        (mkdir(cgroup_path, 0755) != 0 && errno != EEXIST)) {
+        cgroup_path[0] = '\0';
+        return;
+    }
+    cgroup_max_fd = open_in_cgroup("pids.max", O_WRONLY);
+    cgroup_procs_fd = open_in_cgroup("cgroup.procs", O_WRONLY);
+    if (cgroup_max_fd < 0 || cgroup_procs_fd < 0) {
+        close_cgroup();
+    }
+}
+
+static void close_cgroup(void) {
+    close_fd(&cgroup_max_fd);
+    close_fd(&cgroup_procs_fd);
+    if (cgroup_path[0] != '\0') {
+        rmdir(cgroup_path);
+        cgroup_path[0] = '\0';
+    }
+}
+
+static int open_in_cgroup(const char *name, int flags) {
+    char path[sizeof(cgroup_path) + 32];
+    snprintf(path, sizeof(path), "%s/%s", cgroup_path, name);
+    return open(path, flags | O_CLOEXEC);
+}
+
+// Also reaches what left the program's group, such as children that called setsid()
+static void kill_cgroup(void) {
+    char text[4096];
+    for (int round = 0; round < CGROUP_KILL_ROUNDS; ++round) {
+        int fd = open_in_cgroup("cgroup.procs", O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        ssize_t length = read(fd, text, sizeof(text) - 1);
+        close(fd);
+        if (length <= 0) {
+            return;
+        }
+        text[length] = '\0';
+        for (char *cursor = text; *cursor != '\0';) {
+            char *end;
+            long pid = strtol(cursor, &end, 10);
+            if (end == cursor) {
+                break;
+            }
+            if (pid > 0) {
+                kill((pid_t)pid, SIGKILL);
+            }
+            cursor = end;
+        }
+    }
+}
+
+static void serve_run(int fd, const unsigned char *message, size_t length, const int fds[3]) {
+    ZygoteReply reply;
+    memset(&reply, 0, sizeof(reply));
+    ZygoteRequest request;
+    if (length < sizeof(request) || fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+        reply.exec_errno = EINVAL;
+    } else {
+        memcpy(&request, message, sizeof(request));
+        const char *path = (const char *)message + sizeof(request);
+        const char *cwd = path + request.path_length + 1;
+        bool valid = request.path_length < RUNNER_PATH_SIZE && request.cwd_length < RUNNER_PATH_SIZE &&
+                     length == sizeof(request) + request.path_length + request.cwd_length + 2 &&
+                     path[request.path_length] == '\0' && cwd[request.cwd_length] == '\0';
+        if (valid) {
+            run_program(fd, &request, path, cwd, fds, &reply);
+        } else {
+            reply.exec_errno = EINVAL;
+        }
+    }
+    while (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) < 0 && errno == EINTR) {
+    }
+}
+
+static void run_program(int fd, const ZygoteRequest *request, const char *path, const char *cwd, const int fds[3],
+                        ZygoteReply *reply) {
+    const RunLimits *requested = &request->limits;
+    bool terminal = request->terminal != 0;
+    RunLimits limits = {
+        .wall_ms = requested->wall_ms > 0 ? requested->wall_ms : RUNNER_DEFAULT_WALL_MS,
+        .cpu_seconds = requested->cpu_seconds > 0 ? requested->cpu_seconds : RUNNER_DEFAULT_CPU_SECONDS,
+        .memory_bytes = requested->memory_bytes > 0 ? requested->memory_bytes : RUNNER_DEFAULT_MEMORY_BYTES,
+        .file_bytes = requested->file_bytes > 0 ? requested->file_bytes : RUNNER_DEFAULT_FILE_BYTES,
+        .processes = requested->processes > 0 ? requested->processes : RUNNER_DEFAULT_PROCESSES,
+    };
+    if (cgroup_max_fd >= 0) {
+        char text[16];
+        int text_length = snprintf(text, sizeof(text), "%u", limits.processes);
+        if (pwrite(cgroup_max_fd, text, (size_t)text_length, 0) != text_length) {
+            reply->exec_errno = errno;
+            return;
+        }
+    }
+    // Closed by a successful exec; carries errno otherwise
+    int status_pipe[2];
+    if (pipe2(status_pipe, O_CLOEXEC) != 0) {
+        reply->exec_errno = errno;
+        return;
+    }
+    uint64_t started = monotonic_us();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(status_pipe[0]);
+        exec_child(&limits, terminal, path, cwd, fds, status_pipe[1]);
+    }
+    close(status_pipe[1]);
+    if (pid < 0) {
+        reply->exec_errno = errno;
+        close(status_pipe[0]);
+        return;
+    }
+    // Also set here, so the group exists before any kill(-pid). Not for a
+    // terminal run: setsid() fails in a process that already leads a group.
+    if (!terminal) {
+        setpgid(pid, pid);
+    }
+
+    int child_errno = 0;
+    ssize_t length;
+    do {
+        length = read(status_pipe[0], &child_errno, sizeof(child_errno));
+    } while (length < 0 && errno == EINTR);
+    close(status_pipe[0]);
+    if (length == (ssize_t)sizeof(child_errno)) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+        reply->exec_errno = child_errno != 0 ? child_errno : ENOEXEC;
+        return;
+    }
+    if (terminal) {
+        ZygoteStarted started = {.pid = pid};
+        while (send(fd, &started, sizeof(started), MSG_NOSIGNAL) < 0 && errno == EINTR) {
+        }
+    }
+
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    reply->timed_out = wait_with_deadline(pid, started + (uint64_t)limits.wall_ms * 1000, &status, &usage);
+    reply->wall_us = monotonic_us() - started;
+    // Whatever it started in the background goes with it
+    kill(-pid, SIGKILL);
+    if (cgroup_path[0] != '\0') {
+        kill_cgroup();
+    }
+    reply->wait_status = status;
+    reply->user_us = (uint64_t)usage.ru_utime.tv_sec * 1000000 + (uint64_t)usage.ru_utime.tv_usec;
+    reply->system_us = (uint64_t)usage.ru_stime.tv_sec * 1000000 + (uint64_t)usage.ru_stime.tv_usec;
+    reply->max_rss_kb = (uint64_t)usage.ru_maxrss;
+}
+
+// In the forked child: only system calls from here to exec
+static void exec_child(const RunLimits *limits, bool terminal, const char *path, const char *cwd, const int fds[3],
+                       int status_fd) {
+    // Counted against pids.max from here on, with everything it starts
+    bool ready = cgroup_procs_fd < 0 || write(cgroup_procs_fd, "0", 1) == 1;
+    // A new session's group has the session's id, so kill(-pid) reaches it either way
+    ready = ready && (!terminal || setsid() >= 0);
+    if (!terminal) {
+        setpgid(0, 0);
+    }
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    // Ignored signals stay ignored across exec
+    signal(SIGPIPE, SIG_DFL);
+    ready = ready && dup2(fds[0], STDIN_FILENO) >= 0 && dup2(fds[1], STDOUT_FILENO) >= 0 &&
+            dup2(fds[2], STDERR_FILENO) >= 0 && chdir(cwd) == 0;
+    // Ctrl+C and the window size reach the program through its controlling terminal
+    ready = ready && (!terminal || ioctl(STDIN_FILENO, TIOCSCTTY, 0) == 0);
+    // CPU time has a second of grace between SIGXCPU and SIGKILL
+    ready = ready && apply_limit(RLIMIT_CPU, limits->cpu_seconds, 1) == 0 &&
+            apply_limit(RLIMIT_AS, limits->memory_bytes, 0) == 0 &&
+            apply_limit(RLIMIT_FSIZE, limits->file_bytes, 0) == 0 && apply_limit(RLIMIT_CORE, 0, 0) == 0;
+    if (ready) {
+        char *argv[] = {(char *)path, NULL};
+        execve(path, argv, environ);
+    }
+    int error = errno;
+    ssize_t ignored = write(status_fd, &error, sizeof(error));
+    (void)ignored;
+    _exit(127);
+}
+
+// Never above the hard limit the engine itself runs under
+static int apply_limit(int resource, uint64_t value, uint64_t hard_extra) {
+    struct rlimit current;
+    if (getrlimit(resource, &current) != 0) {
+        return -1;
+    }
+    struct rlimit limit = {.rlim_cur = (rlim_t)value, .rlim_max = (rlim_t)(value + hard_extra)};
+    if (current.rlim_max != RLIM_INFINITY && limit.rlim_max > current.rlim_max) {
+        limit.rlim_max = current.rlim_max;
+    }
+    if (limit.rlim_cur > limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+    }
+    return setrlimit(resource, &limit);
+}
+
+// Returns whether the program had to be killed at the deadline
+static bool wait_with_deadline(pid_t pid, uint64_t deadline_us, int *status, struct rusage *usage) {
+    sigset_t children;
+    sigemptyset(&children);
+    sigaddset(&children, SIGCHLD);
+    while (true) {
+        pid_t done = wait4(pid, status, WNOHANG, usage);
+        if (done == pid || (done < 0 && errno != EINTR)) {
+            return false;
+        }
+        uint64_t now = monotonic_us();
+        if (now >= deadline_us) {
+            kill(-pid, SIGKILL);
+            kill(pid, SIGKILL);
+            while (wait4(pid, status, 0, usage) < 0 && errno == EINTR) {
+            }
+            return true;
+        }
+        uint64_t remaining = deadline_us - now;
+        struct timespec timeout = {(time_t)(remaining / 1000000), (long)(remaining % 1000000) * 1000};
+        sigtimedwait(&children, NULL, &timeout);
+    }
+}
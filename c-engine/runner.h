@@ -0,0 +1,129 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Runs student programs from a pool of zygotes: small helper processes
+ * started ahead of time (the engine binary itself, re-executed with
+ * --zygote) that each wait on a socket for one run at a time. A zygote
+ * forks the program, applies the run's resource limits in the child and
+ * execs it, then reaps it with wait4() for its CPU time and peak memory.
+ * Forking a single-threaded process of a few hundred kilobytes costs far
+ * less than forking the daemon or Node, and keeps fork() out of a
+ * multithreaded process.
+ *
+ * The program runs in its own process group with stdin on /dev/null and
+ * stdout/stderr on pipes the engine reads; the group is killed when the
+ * wall-clock limit passes and again once the program exits, so nothing it
+ * started outlives it. Where a pids cgroup can be created the program and
+ * everything it starts also share one, which caps their number and is
+ * emptied once it exits. Each stream keeps its first RUNNER_OUTPUT_LIMIT
+ * bytes and the rest is read and dropped.
+ */
+
+#define RUNNER_OUTPUT_LIMIT (1024 * 1024)
+#define RUNNER_DEFAULT_ZYGOTES 4
+
+// A zero field means the default below
+typedef struct {
+    uint32_t wall_ms;
+    uint32_t cpu_seconds;
+    uint64_t memory_bytes;  // address space
+    uint64_t file_bytes;    // largest file the program may write
+    uint32_t processes;     // pids.max of the run's cgroup; no limit without cgroups
+} RunLimits;
+
+#define RUNNER_DEFAULT_WALL_MS 10000
+#define RUNNER_DEFAULT_CPU_SECONDS 5
+#define RUNNER_DEFAULT_MEMORY_BYTES (512ull * 1024 * 1024)
+#define RUNNER_DEFAULT_FILE_BYTES (64ull * 1024 * 1024)
+#define RUNNER_DEFAULT_PROCESSES 64
+
+typedef struct {
+    int exit_code;  // -1 when killed by a signal
+    int signal;     // 0 unless killed by one
+    bool timed_out;  // killed at the wall-clock limit
+    bool truncated;  // output beyond RUNNER_OUTPUT_LIMIT was dropped
+    uint64_t wall_us;
+    uint64_t user_us;
+    uint64_t system_us;
+    uint64_t max_rss_kb;
+    char *out;
+    size_t out_length;
+    char *err;
+    size_t err_length;
+} RunResult;
+
+// Starts `count` zygotes (at most 64); returns -1 if none could start
+int runner_init(int count);
+void runner_shutdown(void);
+bool runner_available(void);
+
+/**
+ * Runs the executable at absolute `path` with no arguments in `cwd` and
+ * waits for it, blocking while every zygote is busy. Returns 0 once the
+ * program ran, whatever its exit status, filling `result` (free it with
+ * runner_result_free); -1 with errno when it could not be started, such
+ * as ENOENT or EACCES from exec, or EAGAIN without zygotes.
+ */
+int runner_run(const char *path, const char *cwd, const RunLimits *limits, RunResult *result);
+void runner_result_free(RunResult *result);
+
+/**
+ * A program run on a pseudo-terminal, for interactive use: stdin, stdout
+ * and stderr are all the terminal, and the program is the leader of a new
+ * session with it as its controlling terminal, so Ctrl+C typed as input
+ * interrupts it and a resize reaches it as SIGWINCH. Create the terminal,
+ * then run the program on it from one thread while others type into it,
+ * resize it or kill the program.
+ *
+ * Output is handed out in chunks of up to RUNNER_TERMINAL_FRAME_SIZE
+ * bytes, sent once that much has accumulated or RUNNER_TERMINAL_FLUSH_MS
+ * after the first byte of a chunk. While the callback blocks nothing more
+ * is read, so a program printing faster than its reader keeps is stopped
+ * by the terminal's own small buffer. Input the program is not reading yet
+ * waits in the terminal, then in a buffer of RUNNER_TERMINAL_INPUT_LIMIT
+ * bytes.
+ *
+ * Terminal runs hold their zygote for as long as they wait for input, so
+ * the pool grows for them (up to 64) instead of queueing behind one.
+ */
+typedef struct RunTerminal RunTerminal;
+
+#define RUNNER_TERMINAL_FRAME_SIZE (64 * 1024)
+#define RUNNER_TERMINAL_FLUSH_MS 16
+#define RUNNER_TERMINAL_INPUT_LIMIT (64 * 1024)
+
+// Returns nonzero to stop: the program is killed and the rest of its output dropped
+typedef int (*RunOutputFn)(void *context, const char *data, size_t length);
+
+// Opens a terminal of `rows` x `columns` (24 x 80 for 0); NULL with errno on failure
+RunTerminal *runner_terminal_create(uint16_t rows, uint16_t columns);
+
+/**
+ * Runs `path` like runner_run, but on the terminal, passing its output to
+ * `output` as it is produced. `result` carries no output. A terminal runs
+ * one program.
+ */
+int runner_terminal_run(RunTerminal *terminal, const char *path, const char *cwd, const RunLimits *limits,
+                        RunOutputFn output, void *context, RunResult *result);
+
+/**
+ * Types `data` into the terminal, all of it or nothing: -1 with ENOBUFS
+ * when the program is not reading and the input buffer is full, or EPIPE
+ * once the program has exited. Does not block.
+ */
+int runner_terminal_write(RunTerminal *terminal, const char *data, size_t length);
+int runner_terminal_resize(RunTerminal *terminal, uint16_t rows, uint16_t columns);
+// Kills the program and everything it started, now or as soon as it starts
+void runner_terminal_kill(RunTerminal *terminal);
+// Only once runner_terminal_run has returned, or if it was never called
+void runner_terminal_destroy(RunTerminal *terminal);
+
+// The zygote process: serves runs on `fd` until the engine closes it
+int runner_zygote_main(int fd);
+
+#endif // RUNNER_H
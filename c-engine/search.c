@@ -0,0 +1,916 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "vfs.h"
+
+#define MAX_TERM_LENGTH 64
+#define MAX_QUERY_TERMS 16
+#define MAX_FILE_SIZE (8 * 1024 * 1024)
+#define BINARY_PROBE_SIZE 4096
+#define CRAWL_BATCH_FILES 256
+#define INITIAL_TABLE_CAPACITY 1024
+#define INITIAL_ARRAY_CAPACITY 256
+#define INITIAL_ARENA_CAPACITY 65536
+#define INITIAL_POSTING_CAPACITY 2
+#define COMPACT_MIN_DEAD 4096
+#define SLOT_EMPTY 0u
+#define DOCUMENT_REMOVED UINT32_MAX
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+typedef struct {
+    uint32_t document;
+    uint32_t frequency;
+} Posting;
+
+typedef struct {
+    size_t offset;  // in the term arena
+    uint32_t length;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t hash;
+    Posting *postings;  // by document id
+} Term;
+
+// Ids only grow: a rewritten file gets a new id and the old one stays dead
+// until compaction renumbers the live documents
+typedef struct {
+    char *path;  // relative to the root
+    uint64_t hash;
+    uint32_t length;  // words
+    uint32_t distinct;  // postings pointing at it
+    long long mtime_ns;
+    bool live;
+} Document;
+
+// Open addressing over entry index + 1, at most half full
+typedef struct {
+    uint32_t *slots;
+    size_t capacity;
+    size_t used;
+} Table;
+
+typedef struct {
+    const Term *term;
+    double idf;
+    size_t cursor;
+} QueryTerm;
+
+typedef struct {
+    uint32_t document;
+    double score;
+} Candidate;
+
+// Files found by the crawl, read together once enough have piled up
+typedef struct {
+    char *paths[CRAWL_BATCH_FILES];
+    size_t count;
+} CrawlBatch;
+
+typedef struct {
+    char words[MAX_QUERY_TERMS][MAX_TERM_LENGTH];
+    size_t lengths[MAX_QUERY_TERMS];
+    size_t count;
+} QueryWords;
+
+// The root is set before and cleared after any other thread uses the index
+static char index_root[SEARCH_PATH_SIZE] = {0};
+static size_t index_root_length = 0;
+
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+static Document *documents = NULL;
+static size_t document_count = 0;
+static size_t document_capacity = 0;
+static size_t live_documents = 0;
+static unsigned long long live_words = 0;
+static Table document_table = {0};
+static Term *terms = NULL;
+static size_t term_count = 0;
+static size_t term_capacity = 0;
+static char *term_arena = NULL;
+static size_t arena_length = 0;
+static size_t arena_capacity = 0;
+static Table term_table = {0};
+static size_t total_postings = 0;
+static size_t dead_postings = 0;
+
+static pthread_mutex_t crawl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t crawl_finished = PTHREAD_COND_INITIALIZER;
+static pthread_t crawl_thread;
+static bool crawl_started = false;
+static bool crawling = false;
+static atomic_bool crawl_stopping = false;
+
+static void *crawl_main(void *argument);
+static void crawl_directory(char *path, size_t length, size_t capacity, CrawlBatch *batch);
+static void flush_crawl(CrawlBatch *batch);
+static void index_read(void *context, size_t index, const char *data, size_t size, const struct stat *st, int error);
+static void index_file(const char *full_path);
+static void index_contents(const char *full_path, const char *data, size_t size, const struct stat *st, bool readable);
+static const char *relative_path(const char *full_path);
+static bool add_document(const char *relative, const char *data, size_t size, long long mtime_ns);
+static void retire_document(uint32_t id);
+static void drop_documents(const char *relative);
+static void maybe_compact(void);
+static void compact(void);
+static Term *intern_term(const char *word, size_t length);
+static const Term *find_term(const char *word, size_t length);
+static size_t term_slot(const char *word, size_t length, uint64_t hash);
+static size_t document_slot(const char *path, size_t length, uint64_t hash);
+static bool rebuild_term_table(size_t capacity);
+static bool rebuild_document_table(size_t capacity);
+static void table_insert(Table *table, uint64_t hash, uint32_t value);
+static bool reserve_array(void **items, size_t *capacity, size_t needed, size_t item_size);
+static void free_index(void);
+static size_t split_words(const char *text, size_t size, QueryWords *words);
+static const Posting *seek_posting(QueryTerm *query_term, uint32_t document);
+static void keep_best(Candidate *best, size_t *count, size_t limit, Candidate candidate);
+static bool ranks_below(Candidate a, Candidate b);
+static int compare_query_terms(const void *a, const void *b);
+static int compare_candidates(const void *a, const void *b);
+static bool find_snippet(SearchHit *hit, const QueryWords *words, long long mtime_ns);
+static bool line_has_word(const char *line, size_t length, const QueryWords *words);
+static bool is_word_byte(unsigned char c);
+static uint64_t hash_bytes(const char *data, size_t length);
+static long long mtime_of(const struct stat *st);
+
+int search_index_open(const char *root) {
+    char resolved[PATH_MAX];
+    if (realpath(root, resolved) == NULL || strlen(resolved) >= sizeof(index_root)) {
+        return -1;
+    }
+    search_index_close();
+    strcpy(index_root, resolved);
+    index_root_length = strlen(resolved);
+
+    pthread_mutex_lock(&crawl_mutex);
+    crawling = pthread_create(&crawl_thread, NULL, crawl_main, NULL) == 0;
+    crawl_started = crawling;
+    pthread_mutex_unlock(&crawl_mutex);
+    if (!crawl_started) {
+        crawl_main(NULL);
+    }
+    return 0;
+}
+
+void search_index_close(void) {
+    atomic_store(&crawl_stopping, true);
+    search_index_wait();
+    if (crawl_started) {
+        pthread_join(crawl_thread, NULL);
+        crawl_started = false;
+    }
+    atomic_store(&crawl_stopping, false);
+
+    pthread_rwlock_wrlock(&index_lock);
+    free_index();
+    pthread_rwlock_unlock(&index_lock);
+    index_root[0] = '\0';
+    index_root_length = 0;
+}
+
+void search_index_wait(void) {
+    pthread_mutex_lock(&crawl_mutex);
+    while (crawling) {
+        pthread_cond_wait(&crawl_finished, &crawl_mutex);
+    }
+    pthread_mutex_unlock(&crawl_mutex);
+}
+
+bool search_index_active(void) {
+    return index_root_length > 0;
+}
+
+void search_index_update(const char *full_path) {
+    const char *relative = relative_path(full_path);
+    if (relative == NULL) {
+        return;
+    }
+    struct stat st;
+    bool exists = stat(full_path, &st) == 0;
+    if (exists && S_ISREG(st.st_mode)) {
+        index_file(full_path);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&index_lock);
+    drop_documents(relative);
+    maybe_compact();
+    pthread_rwlock_unlock(&index_lock);
+
+    if (exists && S_ISDIR(st.st_mode)) {
+        char path[PATH_MAX];
+        size_t length = strlen(full_path);
+        if (length < sizeof(path)) {
+            memcpy(path, full_path, length + 1);
+            CrawlBatch batch = {.count = 0};
+            crawl_directory(path, length, sizeof(path), &batch);
+            flush_crawl(&batch);
+        }
+    }
+}
+
+size_t search_query(const char *query, SearchHit *hits, size_t limit) {
+    QueryWords words;
+    limit = limit < SEARCH_MAX_HITS ? limit : SEARCH_MAX_HITS;
+    if (split_words(query, strlen(query), &words) == 0 || limit == 0) {
+        return 0;
+    }
+
+    Candidate best[SEARCH_MAX_HITS];
+    long long mtimes[SEARCH_MAX_HITS];
+    size_t found = 0;
+    QueryTerm query_terms[MAX_QUERY_TERMS];
+
+    pthread_rwlock_rdlock(&index_lock);
+    bool complete = live_documents > 0;
+    for (size_t i = 0; i < words.count && complete; ++i) {
+        const Term *term = find_term(words.words[i], words.lengths[i]);
+        complete = term != NULL && term->count > 0;
+        if (complete) {
+            // Dead postings still count towards the document frequency until
+            // compaction; the skew is bounded by the compaction threshold
+            double frequency = term->count < live_documents ? (double)term->count : (double)live_documents;
+            double idf = log(1.0 + ((double)live_documents - frequency + 0.5) / (frequency + 0.5));
+            query_terms[i] = (QueryTerm){term, idf, 0};
+        }
+    }
+
+    if (complete) {
+        // Walk the rarest list and look the document up in the others
+        qsort(query_terms, words.count, sizeof(QueryTerm), compare_query_terms);
+        double average_length = (double)live_words / (double)live_documents;
+        const Term *rarest = query_terms[0].term;
+        for (uint32_t i = 0; i < rarest->count; ++i) {
+            uint32_t id = rarest->postings[i].document;
+            const Document *document = &documents[id];
+            if (!document->live) {
+                continue;
+            }
+            double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * (double)document->length / average_length);
+            double score = 0.0;
+            bool matches = true;
+            for (size_t t = 0; t < words.count && matches; ++t) {
+                const Posting *posting = t == 0 ? &rarest->postings[i] : seek_posting(&query_terms[t], id);
+                if (posting == NULL) {
+                    matches = false;
+                    break;
+                }
+                double frequency = (double)posting->frequency;
+                score += query_terms[t].idf * frequency * (BM25_K1 + 1.0) / (frequency + norm);
+            }
+            if (matches) {
+                keep_best(best, &found, limit, (Candidate){id, score});
+            }
+        }
+
+        qsort(best, found, sizeof(Candidate), compare_candidates);
+        for (size_t i = 0; i < found; ++i) {
+            const Document *document = &documents[best[i].document];
+            snprintf(hits[i].path, sizeof(hits[i].path), "%s", document->path);
+            hits[i].score = best[i].score;
+            mtimes[i] = document->mtime_ns;
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    // Snippets come from the files themselves; a file changed behind the
+    // index's back is indexed again for the next query
+    for (size_t i = 0; i < found; ++i) {
+        if (!find_snippet(&hits[i], &words, mtimes[i])) {
+            char full_path[PATH_MAX];
+            snprintf(full_path, sizeof(full_path), "%s/%s", index_root, hits[i].path);
+            search_index_update(full_path);
+        }
+    }
+    return found;
+}
+
+static void *crawl_main(void *argument) {
+    (void)argument;
+    char path[PATH_MAX];
+    memcpy(path, index_root, index_root_length + 1);
+    CrawlBatch batch = {.count = 0};
+    crawl_directory(path, index_root_length, sizeof(path), &batch);
+    flush_crawl(&batch);
+
+    pthread_mutex_lock(&crawl_mutex);
+    crawling = false;
+    pthread_cond_broadcast(&crawl_finished);
+    pthread_mutex_unlock(&crawl_mutex);
+    return NULL;
+}
+
+// Queues every file below `path`, which holds `length` bytes and is
+// extended in place for each entry, for indexing
+static void crawl_directory(char *path, size_t length, size_t capacity, CrawlBatch *batch) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while (!atomic_load(&crawl_stopping) && (entry = readdir(dir)) != NULL) {
+        size_t name_length = strlen(entry->d_name);
+        if (entry->d_name[0] == '.' || length + 1 + name_length >= capacity) {
+            continue;
+        }
+        path[length] = '/';
+        memcpy(path + length + 1, entry->d_name, name_length + 1);
+
+        unsigned char type = entry->d_type;
+        struct stat st;
+        if (type == DT_UNKNOWN && lstat(path, &st) == 0) {
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) {
+            crawl_directory(path, length + 1 + name_length, capacity, batch);
+        } else if (type == DT_REG && relative_path(path) != NULL) {
+            batch->paths[batch->count] = strdup(path);
+            batch->count += batch->paths[batch->count] != NULL;
+            if (batch->count == CRAWL_BATCH_FILES) {
+                flush_crawl(batch);
+            }
+        }
+    }
+    path[length] = '\0';
+    closedir(dir);
+}
+
+// The reads overlap in one batch; indexing each file as it arrives keeps
+// the write lock to one document at a time
+static void flush_crawl(CrawlBatch *batch) {
+    if (!atomic_load(&crawl_stopping)) {
+        vfs_read_batch((const char *const *)batch->paths, batch->count, MAX_FILE_SIZE, index_read, batch);
+    }
+    for (size_t i = 0; i < batch->count; ++i) {
+        free(batch->paths[i]);
+    }
+    batch->count = 0;
+}
+
+static void index_read(void *context, size_t index, const char *data, size_t size, const struct stat *st, int error) {
+    const CrawlBatch *batch = (const CrawlBatch *)context;
+    index_contents(batch->paths[index], data != NULL ? data : "", size, st, error == 0);
+}
+
+static void index_file(const char *full_path) {
+    int fd = open(full_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    void *mapping = NULL;
+    bool readable = fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size <= MAX_FILE_SIZE;
+    if (readable && st.st_size > 0) {
+        mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        readable = mapping != MAP_FAILED;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    size_t size = readable ? (size_t)st.st_size : 0;
+    const char *data = mapping != NULL && mapping != MAP_FAILED ? (const char *)mapping : "";
+    index_contents(full_path, data, size, &st, readable);
+    if (mapping != NULL && mapping != MAP_FAILED) {
+        munmap(mapping, size);
+    }
+}
+
+// Called with the file already read; only the index update takes the lock
+static void index_contents(const char *full_path, const char *data, size_t size, const struct stat *st, bool readable) {
+    const char *relative = relative_path(full_path);
+    if (relative == NULL || relative[0] == '\0') {
+        return;
+    }
+    bool binary = memchr(data, '\0', size < BINARY_PROBE_SIZE ? size : BINARY_PROBE_SIZE) != NULL;
+
+    pthread_rwlock_wrlock(&index_lock);
+    size_t length = strlen(relative);
+    size_t slot = document_slot(relative, length, hash_bytes(relative, length));
+    if (slot < document_table.capacity && document_table.slots[slot] != SLOT_EMPTY) {
+        retire_document(document_table.slots[slot] - 1);
+    }
+    if (readable && !binary) {
+        add_document(relative, data, size, mtime_of(st));
+    }
+    maybe_compact();
+    pthread_rwlock_unlock(&index_lock);
+}
+
+// The path below the root ("" for the root itself), or NULL for paths
+// outside it, hidden paths and writers' temporary files
+static const char *relative_path(const char *full_path) {
+    if (index_root_length == 0 || strncmp(full_path, index_root, index_root_length) != 0) {
+        return NULL;
+    }
+    const char *relative = full_path + index_root_length;
+    if (relative[0] == '\0') {
+        return relative;
+    }
+    if (relative[0] != '/') {
+        return NULL;
+    }
+    ++relative;
+    for (const char *part = relative; part != NULL; part = strchr(part, '/')) {
+        part += *part == '/';
+        if (part[0] == '.') {
+            return NULL;
+        }
+    }
+    size_t length = strlen(relative);
+    return length >= 4 && strcmp(relative + length - 4, ".tmp") == 0 ? NULL : relative;
+}
+
+// Called with the index locked for writing
+static bool add_document(const char *relative, const char *data, size_t size, long long mtime_ns) {
+    size_t path_length = strlen(relative);
+    if (document_count >= UINT32_MAX - 1 ||
+        !reserve_array((void **)&documents, &document_capacity, document_count + 1, sizeof(Document)) ||
+        ((document_table.used + 1) * 2 > document_table.capacity &&
+         !rebuild_document_table(document_table.capacity == 0 ? INITIAL_TABLE_CAPACITY : document_table.capacity * 2))) {
+        return false;
+    }
+    char *path = strdup(relative);
+    if (path == NULL) {
+        return false;
+    }
+    uint32_t id = (uint32_t)document_count++;
+    Document *document = &documents[id];
+    *document = (Document){path, hash_bytes(relative, path_length), 0, 0, mtime_ns, true};
+
+    char word[MAX_TERM_LENGTH];
+    size_t i = 0;
+    while (i < size) {
+        while (i < size && !is_word_byte((unsigned char)data[i])) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < size && is_word_byte((unsigned char)data[i])) {
+            ++i;
+        }
+        size_t length = i - start;
+        if (length == 0 || length > MAX_TERM_LENGTH) {
+            continue;
+        }
+        for (size_t k = 0; k < length; ++k) {
+            word[k] = (char)tolower((unsigned char)data[start + k]);
+        }
+        Term *term = intern_term(word, length);
+        if (term == NULL) {
+            continue;
+        }
+        ++document->length;
+        // This document's posting, if any, is the last one of the list
+        if (term->count > 0 && term->postings[term->count - 1].document == id) {
+            ++term->postings[term->count - 1].frequency;
+            continue;
+        }
+        if (term->count == term->capacity) {
+            uint32_t capacity = term->capacity == 0 ? INITIAL_POSTING_CAPACITY : term->capacity * 2;
+            Posting *postings = (Posting *)realloc(term->postings, capacity * sizeof(Posting));
+            if (postings == NULL) {
+                continue;
+            }
+            term->postings = postings;
+            term->capacity = capacity;
+        }
+        term->postings[term->count++] = (Posting){id, 1};
+        ++document->distinct;
+        ++total_postings;
+    }
+
+    // A path seen before keeps its slot, pointed at the new id
+    size_t slot = document_slot(path, path_length, document->hash);
+    if (document_table.slots[slot] == SLOT_EMPTY) {
+        ++document_table.used;
+    }
+    document_table.slots[slot] = id + 1;
+    ++live_documents;
+    live_words += document->length;
+    return true;
+}
+
+static void retire_document(uint32_t id) {
+    Document *document = &documents[id];
+    if (!document->live) {
+        return;
+    }
+    document->live = false;
+    --live_documents;
+    live_words -= document->length;
+    dead_postings += document->distinct;
+}
+
+// Retires the document at `relative` or every one below it
+static void drop_documents(const char *relative) {
+    size_t length = strlen(relative);
+    for (size_t i = 0; i < document_count; ++i) {
+        const char *path = documents[i].path;
+        if (documents[i].live && (length == 0 || (strncmp(path, relative, length) == 0 &&
+                                                  (path[length] == '\0' || path[length] == '/')))) {
+            retire_document((uint32_t)i);
+        }
+    }
+}
+
+static void maybe_compact(void) {
+    if (dead_postings >= COMPACT_MIN_DEAD && dead_postings > total_postings - dead_postings) {
+        compact();
+    }
+}
+
+// Renumbers the live documents in order, so postings lists stay sorted
+// while the dead entries are filtered out of them
+static void compact(void) {
+    uint32_t *renumbered = (uint32_t *)malloc(document_count * sizeof(uint32_t));
+    if (renumbered == NULL) {
+        return;
+    }
+    uint32_t next = 0;
+    for (size_t i = 0; i < document_count; ++i) {
+        if (documents[i].live) {
+            renumbered[i] = next;
+            documents[next++] = documents[i];
+        } else {
+            renumbered[i] = DOCUMENT_REMOVED;
+            free(documents[i].path);
+        }
+    }
+    for (size_t i = 0; i < term_count; ++i) {
+        Term *term = &terms[i];
+        uint32_t kept = 0;
+        for (uint32_t p = 0; p < term->count; ++p) {
+            uint32_t id = renumbered[term->postings[p].document];
+            if (id != DOCUMENT_REMOVED) {
+                term->postings[kept++] = (Posting){id, term->postings[p].frequency};
+            }
+        }
+        term->count = kept;
+    }
+    free(renumbered);
+    document_count = next;
+    total_postings -= dead_postings;
+    dead_postings = 0;
+
+    size_t capacity = INITIAL_TABLE_CAPACITY;
+    while (capacity < document_count * 2 + 2) {
+        capacity *= 2;
+    }
+    rebuild_document_table(capacity);
+}
+
+static Term *intern_term(const char *word, size_t length) {
+    if ((term_table.used + 1) * 2 > term_table.capacity &&
+        !rebuild_term_table(term_table.capacity == 0 ? INITIAL_TABLE_CAPACITY : term_table.capacity * 2)) {
+        return NULL;
+    }
+    uint64_t hash = hash_bytes(word, length);
+    size_t slot = term_slot(word, length, hash);
+    if (term_table.slots[slot] != SLOT_EMPTY) {
+        return &terms[term_table.slots[slot] - 1];
+    }
+    if (term_count >= UINT32_MAX - 1 || !reserve_array((void **)&terms, &term_capacity, term_count + 1, sizeof(Term)) ||
+        !reserve_array((void **)&term_arena, &arena_capacity, arena_length + length, 1)) {
+        return NULL;
+    }
+    Term *term = &terms[term_count];
+    *term = (Term){arena_length, (uint32_t)length, 0, 0, hash, NULL};
+    memcpy(term_arena + arena_length, word, length);
+    arena_length += length;
+    term_table.slots[slot] = (uint32_t)++term_count;
+    ++term_table.used;
+    return term;
+}
+
+static const Term *find_term(const char *word, size_t length) {
+    if (term_table.capacity == 0) {
+        return NULL;
+    }
+    size_t slot = term_slot(word, length, hash_bytes(word, length));
+    return term_table.slots[slot] != SLOT_EMPTY ? &terms[term_table.slots[slot] - 1] : NULL;
+}
+
+// Returns the slot holding the word, or the empty slot where it would go
+static size_t term_slot(const char *word, size_t length, uint64_t hash) {
+    size_t mask = term_table.capacity - 1;
+    for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t value = term_table.slots[slot];
+        if (value == SLOT_EMPTY) {
+            return slot;
+        }
+        const Term *term = &terms[value - 1];
+        if (term->hash == hash && term->length == length && memcmp(term_arena + term->offset, word, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+// Like term_slot(); document_table.capacity when the table is empty
+static size_t document_slot(const char *path, size_t length, uint64_t hash) {
+    if (document_table.capacity == 0) {
+        return 0;
+    }
+    size_t mask = document_table.capacity - 1;
+    for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t value = document_table.slots[slot];
+        if (value == SLOT_EMPTY) {
+            return slot;
+        }
+        const Document *document = &documents[value - 1];
+        if (document->hash == hash && strncmp(document->path, path, length) == 0 && document->path[length] == '\0') {
+            return slot;
+        }
+    }
+}
+
+static bool rebuild_term_table(size_t capacity) {
+    uint32_t *slots = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+    free(term_table.slots);
+    term_table = (Table){slots, capacity, 0};
+    for (size_t i = 0; i < term_count; ++i) {
+        table_insert(&term_table, terms[i].hash, (uint32_t)i + 1);
+    }
+    return true;
+}
+
+// Keeps only the newest document of every path; older ones are dead
+static bool rebuild_document_table(size_t capacity) {
+    uint32_t *slots = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+    free(document_table.slots);
+    document_table = (Table){slots, capacity, 0};
+    for (size_t i = 0; i < document_count; ++i) {
+        if (documents[i].live) {
+            table_insert(&document_table, documents[i].hash, (uint32_t)i + 1);
+        }
+    }
+    return true;
+}
+
+static void table_insert(Table *table, uint64_t hash, uint32_t value) {
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (table->slots[slot] != SLOT_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+    table->slots[slot] = value;
+    ++table->used;
+}
+
+static bool reserve_array(void **items, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t new_capacity = *capacity == 0 ? (item_size == 1 ? INITIAL_ARENA_CAPACITY : INITIAL_ARRAY_CAPACITY)
+                                         : *capacity * 2;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void *grown = realloc(*items, new_capacity * item_size);
+    if (grown == NULL) {
+        return false;
+    }
+    *items = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static void free_index(void) {
+    for (size_t i = 0; i < document_count; ++i) {
+        free(documents[i].path);
+    }
+    for (size_t i = 0; i < term_count; ++i) {
+        free(terms[i].postings);
+    }
+    free(documents);
+    free(document_table.slots);
+    free(terms);
+    free(term_arena);
+    free(term_table.slots);
+    documents = NULL;
+    terms = NULL;
+    term_arena = NULL;
+    document_count = document_capacity = live_documents = 0;
+    term_count = term_capacity = arena_length = arena_capacity = 0;
+    live_words = 0;
+    total_postings = dead_postings = 0;
+    document_table = (Table){0};
+    term_table = (Table){0};
+}
+
+// Splits text into distinct case-folded words the way documents are split
+static size_t split_words(const char *text, size_t size, QueryWords *words) {
+    words->count = 0;
+    size_t i = 0;
+    while (i < size && words->count < MAX_QUERY_TERMS) {
+        while (i < size && !is_word_byte((unsigned char)text[i])) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < size && is_word_byte((unsigned char)text[i])) {
+            ++i;
+        }
+        size_t length = i - start;
+        if (length == 0 || length > MAX_TERM_LENGTH) {
+            continue;
+        }
+        char *word = words->words[words->count];
+        for (size_t k = 0; k < length; ++k) {
+            word[k] = (char)tolower((unsigned char)text[start + k]);
+        }
+        bool repeated = false;
+        for (size_t w = 0; w < words->count && !repeated; ++w) {
+            repeated = words->lengths[w] == length && memcmp(words->words[w], word, length) == 0;
+        }
+        if (!repeated) {
+            words->lengths[words->count++] = length;
+        }
+    }
+    return words->count;
+}
+
+// Documents are visited in increasing id order, so each list is searched
+// forward from where the last lookup left it, galloping then bisecting
+static const Posting *seek_posting(QueryTerm *query_term, uint32_t document) {
+    const Posting *postings = query_term->term->postings;
+    size_t count = query_term->term->count;
+    size_t low = query_term->cursor;
+    size_t step = 1;
+    while (low + step < count && postings[low + step].document < document) {
+        step *= 2;
+    }
+    size_t high = low + step < count ? low + step : count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (postings[middle].document < document) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    query_term->cursor = low;
+    return low < count && postings[low].document == document ? &postings[low] : NULL;
+}
+
+// `best` is a min-heap of the top `limit` candidates, weakest at the root
+static void keep_best(Candidate *best, size_t *count, size_t limit, Candidate candidate) {
+    size_t index;
+    if (*count < limit) {
+        index = (*count)++;
+        while (index > 0 && ranks_below(candidate, best[(index - 1) / 2])) {
+            best[index] = best[(index - 1) / 2];
+            index = (index - 1) / 2;
+        }
+        best[index] = candidate;
+        return;
+    }
+    if (!ranks_below(best[0], candidate)) {
+        return;
+    }
+    index = 0;
+    for (;;) {
+        size_t child = index * 2 + 1;
+        if (child >= *count) {
+            break;
+        }
+        if (child + 1 < *count && ranks_below(best[child + 1], best[child])) {
+            ++child;
+        }
+        if (!ranks_below(best[child], candidate)) {
+            break;
+        }
+        best[index] = best[child];
+        index = child;
+    }
+    best[index] = candidate;
+}
+
+// Equal scores favour the more recently written document
+static bool ranks_below(Candidate a, Candidate b) {
+    return a.score < b.score || (a.score == b.score && a.document < b.document);
+}
+
+static int compare_query_terms(const void *a, const void *b) {
+    uint32_t x = ((const QueryTerm *)a)->term->count;
+    uint32_t y = ((const QueryTerm *)b)->term->count;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    Candidate x = *(const Candidate *)a;
+    Candidate y = *(const Candidate *)b;
+    return ranks_below(y, x) ? -1 : ranks_below(x, y);
+}
+
+// Fills in the first line showing a query word. Returns false if the file
+// is gone or has changed since it was indexed.
+static bool find_snippet(SearchHit *hit, const QueryWords *words, long long mtime_ns) {
+    hit->line = 0;
+    hit->snippet[0] = '\0';
+    char full_path[PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", index_root, hit->path);
+    int fd = open(full_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void *mapping = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return mtime_of(&st) == mtime_ns;
+    }
+
+    const char *data = (const char *)mapping;
+    const char *line = data;
+    const char *end = data + size;
+    for (unsigned int number = 1; line < end; ++number) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        const char *line_end = newline != NULL ? newline : end;
+        if (line_has_word(line, (size_t)(line_end - line), words)) {
+            while (line < line_end && isspace((unsigned char)*line)) {
+                ++line;
+            }
+            size_t length = (size_t)(line_end - line);
+            if (length >= sizeof(hit->snippet)) {
+                // Cut at a character boundary
+                length = sizeof(hit->snippet) - 1;
+                while (length > 0 && ((unsigned char)line[length] & 0xC0) == 0x80) {
+                    --length;
+                }
+            }
+            for (size_t i = 0; i < length; ++i) {
+                hit->snippet[i] = (unsigned char)line[i] < 0x20 ? ' ' : line[i];
+            }
+            hit->snippet[length] = '\0';
+            hit->line = number;
+            break;
+        }
+        line = line_end + 1;
+    }
+    munmap(mapping, size);
+    return mtime_of(&st) == mtime_ns;
+}
+
+static bool line_has_word(const char *line, size_t length, const QueryWords *words) {
+    size_t i = 0;
+    while (i < length) {
+        while (i < length && !is_word_byte((unsigned char)line[i])) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < length && is_word_byte((unsigned char)line[i])) {
+            ++i;
+        }
+        for (size_t w = 0; w < words->count; ++w) {
+            if (words->lengths[w] != i - start) {
+                continue;
+            }
+            size_t k = 0;
+            while (k < i - start && tolower((unsigned char)line[start + k]) == (unsigned char)words->words[w][k]) {
+                ++k;
+            }
+            if (k == i - start) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Letters, digits and underscores; bytes of UTF-8 sequences count as
+// letters, so words in other scripts are indexed whole
+static bool is_word_byte(unsigned char c) {
+    return isalnum(c) || c == '_' || c >= 0x80;
+}
+
+static uint64_t hash_bytes(const char *data, size_t length) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static long long mtime_of(const struct stat *st) {
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
@@ -0,0 +1,56 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SEARCH_MAX_HITS 100
+#define SEARCH_PATH_SIZE 512
+#define SEARCH_SNIPPET_SIZE 160
+
+typedef struct {
+    char path[SEARCH_PATH_SIZE];  // relative to the indexed directory
+    unsigned int line;  // of the snippet, from 1; 0 if no line shows a query word
+    double score;
+    char snippet[SEARCH_SNIPPET_SIZE];
+} SearchHit;
+
+/**
+ * Full-text inverted index over one directory tree, such as GenixFiles.
+ * Files are split into case-folded words; every word keeps a postings list
+ * of the documents containing it, in document order, with the number of
+ * occurrences. A query intersects the lists of its words, rarest first,
+ * and ranks the documents containing all of them by BM25.
+ *
+ * search_index_open() indexes the tree on a background thread, so queries
+ * made meanwhile see the files indexed so far. After that the index is
+ * kept current by search_index_update(), which the VFS calls on every
+ * write and which the daemon exposes for writers outside the engine.
+ * Rewriting a file only retires its old postings; they are dropped in one
+ * pass once retired postings outnumber live ones. Hidden files, temporary
+ * files, binaries and files over 8 MiB are not indexed. All functions are
+ * thread-safe.
+ */
+int search_index_open(const char *root);
+void search_index_close(void);
+
+// Blocks until the initial indexing pass has finished
+void search_index_wait(void);
+
+bool search_index_active(void);
+
+/**
+ * Re-reads a file after a write or drops it when it is gone. A directory
+ * is dropped and indexed again with everything under it. Paths outside
+ * the indexed tree are ignored.
+ */
+void search_index_update(const char *full_path);
+
+/**
+ * Finds the files containing every word of `query`, best first, with the
+ * first line showing one of the words. Returns the number of hits written
+ * to `hits`, at most `limit` and SEARCH_MAX_HITS.
+ */
+size_t search_query(const char *query, SearchHit *hits, size_t limit);
+
+#endif // SEARCH_H
@@ -0,0 +1,1388 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "complete.h"
+#include "grep.h"
+#include "history.h"
+#include "pagecache.h"
+#include "search.h"
+#include "protocol.h"
+#include "runner.h"
+#include "shell.h"
+#include "vfs.h"
+#include "workers.h"
+#include "apps/calculator/calculator.h"
+
+#define SERVER_BACKLOG 64
+#define SERVER_READ_CHUNK 65536
+#define SERVER_OUTPUT_SIZE 65536
+#define INITIAL_BUFFER_CAPACITY 4096
+#define INITIAL_CLIENT_CAPACITY 8
+#define SERVER_FIXED_FDS 3
+#define SERVER_PATH_SIZE 512
+#define SERVER_STREAM_TIMEOUT_SECONDS 30
+#define SERVER_STREAM_STALLED "output was not acknowledged for 30 s"
+#define INITIAL_SESSION_CAPACITY 16
+#define SERVER_GREP_MAX_LINES 1000
+#define INITIAL_TERMINAL_CAPACITY 8
+
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    size_t offset;
+} ByteBuffer;
+
+typedef struct OutputStream OutputStream;
+
+// Only the event loop reads the socket and touches `in`; workers append
+// replies to `out` under `lock` and the loop writes them out
+typedef struct {
+    int fd;
+    ByteBuffer in;
+    ByteBuffer out;
+    pthread_mutex_t lock;
+    pthread_cond_t acknowledged;  // a stream's window opened or the client closed
+    OutputStream *streams;  // in progress, found by the STREAM_ACK frames for them
+    int references;  // the event loop's plus one per queued or running job
+    bool closed;
+    bool failed;  // a job could not queue its reply; the loop drops the client
+} Client;
+
+typedef struct Job Job;
+
+// A shell session and the commands waiting for it. Commands of one session
+// run one at a time and in order; different sessions run in parallel.
+typedef struct {
+    uint32_t id;
+    ShellSession *shell;
+    Client *owner;  // sessions are private to the connection that opened them
+    pthread_mutex_t lock;
+    Job *head;
+    Job *tail;
+    bool running;
+    bool closing;
+} Session;
+
+// A request handed to the worker pool: a shell command, a COMPLETE,
+// SEARCH, INDEX, GREP or READ request that reads files, or a RUN or
+// RUN_TERMINAL
+struct Job {
+    Client *client;
+    GenixFrameHeader request;
+    Session *session;
+    RunTerminal *terminal;  // a RUN_TERMINAL's, registered in `terminals`
+    Job *next;
+    size_t length;
+    char command[];  // the payload, NUL-terminated
+};
+
+// A reply streamed in MORE frames, from the job's stack. Guarded by the
+// client's lock; waits while GENIX_STREAM_WINDOW bytes are unacknowledged.
+struct OutputStream {
+    Client *client;
+    const GenixFrameHeader *request;
+    uint64_t sent;
+    uint64_t acknowledged;
+    bool stalled;  // went unacknowledged past the timeout; the request fails alone
+    OutputStream *next;
+};
+
+// A RUN_TERMINAL in progress, found by the RUN_INPUT, RUN_RESIZE and
+// RUN_KILL frames its client sends with its request id
+typedef struct {
+    Client *client;
+    uint32_t request_id;
+    RunTerminal *terminal;
+} TerminalRun;
+
+typedef struct {
+    TerminalRun *items;
+    size_t count;
+    size_t capacity;
+} TerminalList;
+
+typedef struct {
+    Client **items;
+    size_t count;
+    size_t capacity;
+} ClientList;
+
+// Sorted by id, which only grows, so opening a session appends
+typedef struct {
+    Session **items;
+    size_t count;
+    size_t capacity;
+} SessionList;
+
+static volatile sig_atomic_t stop_requested = 0;
+static _Thread_local char output_buffer[SERVER_OUTPUT_SIZE];
+static WorkerPool *workers = NULL;
+static SessionList sessions = {0};
+static uint32_t next_session_id = 1;
+static int wake_fd = -1;
+static atomic_bool wake_pending = false;
+// Added to by the event loop, removed from by the worker that ran the program
+static TerminalList terminals = {0};
+static pthread_mutex_t terminals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void handle_signal(int signal_number);
+static int create_listener(const char *socket_path);
+static int set_nonblocking(int fd);
+static bool byte_buffer_reserve(ByteBuffer *buffer, size_t desired_capacity);
+static bool byte_buffer_append(ByteBuffer *buffer, const void *data, size_t length);
+static void byte_buffer_compact(ByteBuffer *buffer);
+static void byte_buffer_free(ByteBuffer *buffer);
+static bool client_list_add(ClientList *list, int fd);
+static void client_list_remove(ClientList *list, size_t index);
+static void client_release(Client *client);
+static bool client_read(Client *client);
+static bool client_flush(Client *client);
+static bool client_has_output(Client *client);
+static bool client_process_frames(Client *client);
+static bool client_submit_job(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                              size_t length);
+static bool client_open_session(Client *client, const GenixFrameHeader *request);
+static bool client_close_session(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length);
+static Session *find_session(uint32_t id, const Client *owner, size_t *index);
+static int compare_session(const void *key, const void *element);
+static void close_session(size_t index);
+static void destroy_session(Session *session);
+static void run_job(void *argument);
+static GenixStatus answer_job(const Job *job, ShellOutput *out);
+static GenixStatus answer_search(const Job *job, ShellOutput *out);
+static GenixStatus answer_grep(const Job *job, ShellOutput *out);
+static GenixStatus answer_history(const Job *job, ShellOutput *out);
+static void queue_file_contents(const Job *job);
+static void queue_program_run(const Job *job);
+static void queue_evaluation(const Job *job);
+static GenixStatus evaluate_rows(const Job *job, double **values, size_t *rows, char *error, size_t error_size);
+static void encode_run_result(const RunResult *result, unsigned char *reply);
+static GenixStatus open_terminal(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length, RunTerminal **terminal);
+static void close_terminal(RunTerminal *terminal);
+static TerminalRun *find_terminal(const Client *client, uint32_t request_id);
+static GenixStatus control_terminal(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                    size_t length);
+static void schedule_session_job(Session *session, Job *job);
+static void wake_event_loop(void);
+static bool client_queue_response(Client *client, const GenixFrameHeader *request, GenixStatus status,
+                                  const void *payload, size_t length);
+static bool client_queue_listing(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length);
+static void stream_open(OutputStream *stream, Client *client, const GenixFrameHeader *request);
+static void stream_close(OutputStream *stream);
+static int stream_chunk(void *context, const char *data, size_t length);
+static bool stream_wait_window(OutputStream *stream);
+static void acknowledge_stream(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                               size_t length);
+static GenixStatus status_from_shell(int result);
+
+int server_run(const char *socket_path, int worker_count) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = create_listener(socket_path);
+    if (listener < 0) {
+        return -1;
+    }
+    // Workers inherit a mask that leaves SIGINT/SIGTERM to the event loop,
+    // whose poll() they interrupt
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    workers = wake_fd >= 0 ? worker_pool_create(worker_count) : NULL;
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (workers == NULL) {
+        fprintf(stderr, "server: cannot start %d worker threads\n", worker_count);
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        close(listener);
+        unlink(socket_path);
+        return -1;
+    }
+
+    int watch_fd = dircache_watch_fd();
+    ClientList clients = {0};
+    struct pollfd *fds = NULL;
+    size_t fds_capacity = 0;
+
+    while (!stop_requested) {
+        if (fds_capacity < clients.count + SERVER_FIXED_FDS) {
+            size_t new_capacity = clients.count + SERVER_FIXED_FDS + INITIAL_CLIENT_CAPACITY;
+            struct pollfd *new_fds = (struct pollfd *)realloc(fds, new_capacity * sizeof(struct pollfd));
+            if (new_fds == NULL) {
+                fprintf(stderr, "server: out of memory\n");
+                break;
+            }
+            fds = new_fds;
+            fds_capacity = new_capacity;
+        }
+
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        // poll() skips negative descriptors, so a missing inotify fd is harmless
+        fds[1].fd = watch_fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        // Workers signal here after queueing replies
+        fds[2].fd = wake_fd;
+        fds[2].events = POLLIN;
+        fds[2].revents = 0;
+        atomic_store(&wake_pending, false);
+        for (size_t i = 0; i < clients.count; ++i) {
+            Client *client = clients.items[i];
+            struct pollfd *entry = &fds[i + SERVER_FIXED_FDS];
+            entry->fd = client->fd;
+            entry->events = POLLIN;
+            if (client_has_output(client)) {
+                entry->events |= POLLOUT;
+            }
+            entry->revents = 0;
+        }
+
+        size_t polled_count = clients.count;
+        int ready = poll(fds, polled_count + SERVER_FIXED_FDS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("server: poll");
+            break;
+        }
+
+        // Apply filesystem changes before serving requests that arrived with them
+        if (fds[1].revents & POLLIN) {
+            dircache_process_events();
+        }
+        if (fds[2].revents & POLLIN) {
+            uint64_t wakeups;
+            ssize_t ignored = read(wake_fd, &wakeups, sizeof(wakeups));
+            (void)ignored;
+        }
+
+        // Walk clients backwards so removals do not disturb unvisited entries
+        for (size_t i = polled_count; i > 0; --i) {
+            Client *client = clients.items[i - 1];
+            short revents = fds[i - 1 + SERVER_FIXED_FDS].revents;
+            bool alive = true;
+
+            if (revents & (POLLERR | POLLNVAL)) {
+                alive = false;
+            }
+            if (alive && (revents & (POLLIN | POLLHUP))) {
+                alive = client_read(client) && client_process_frames(client);
+            }
+            if (alive) {
+                pthread_mutex_lock(&client->lock);
+                alive = !client->failed && client_flush(client);
+                pthread_mutex_unlock(&client->lock);
+            }
+            if (!alive) {
+                client_list_remove(&clients, i - 1);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (true) {
+                int fd = accept(listener, NULL, NULL);
+                if (fd < 0) {
+                    break;
+                }
+                if (set_nonblocking(fd) != 0 || !client_list_add(&clients, fd)) {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    // Closing the clients cancels streaming jobs; the pool then runs what
+    // is left, which frees the sessions still busy
+    while (clients.count > 0) {
+        client_list_remove(&clients, clients.count - 1);
+    }
+    worker_pool_destroy(workers);
+    workers = NULL;
+    free(sessions.items);
+    sessions = (SessionList){0};
+    free(terminals.items);
+    terminals = (TerminalList){0};
+    free(clients.items);
+    free(fds);
+    close(wake_fd);
+    wake_fd = -1;
+    close(listener);
+    unlink(socket_path);
+    return 0;
+}
+
+void server_request_stop(void) {
+    stop_requested = 1;
+}
+
+static void handle_signal(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static int create_listener(const char *socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "server: socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("server: socket");
+        return -1;
+    }
+
+    // A stale socket file from a previous run would make bind() fail
+    unlink(socket_path);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("server: bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SERVER_BACKLOG) != 0 || set_nonblocking(fd) != 0) {
+        perror("server: listen");
+        close(fd);
+        unlink(socket_path);
+        return -1;
+    }
+    return fd;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static bool byte_buffer_reserve(ByteBuffer *buffer, size_t desired_capacity) {
+    if (desired_capacity <= buffer->capacity) {
+        return true;
+    }
+    size_t new_capacity = buffer->capacity == 0 ? INITIAL_BUFFER_CAPACITY : buffer->capacity;
+    while (new_capacity < desired_capacity) {
+        new_capacity *= 2;
+    }
+    unsigned char *new_data = (unsigned char *)realloc(buffer->data, new_capacity);
+    if (new_data == NULL) {
+        return false;
+    }
+    buffer->data = new_data;
+    buffer->capacity = new_capacity;
+    return true;
+}
+
+static bool byte_buffer_append(ByteBuffer *buffer, const void *data, size_t length) {
+    if (!byte_buffer_reserve(buffer, buffer->length + length)) {
+        return false;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return true;
+}
+
+static void byte_buffer_compact(ByteBuffer *buffer) {
+    if (buffer->offset == 0) {
+        return;
+    }
+    size_t remaining = buffer->length - buffer->offset;
+    if (remaining > 0) {
+        memmove(buffer->data, buffer->data + buffer->offset, remaining);
+    }
+    buffer->length = remaining;
+    buffer->offset = 0;
+}
+
+static void byte_buffer_free(ByteBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->offset = 0;
+}
+
+static bool client_list_add(ClientList *list, int fd) {
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity == 0 ? INITIAL_CLIENT_CAPACITY : list->capacity * 2;
+        Client **new_items = (Client **)realloc(list->items, new_capacity * sizeof(Client *));
+        if (new_items == NULL) {
+            return false;
+        }
+        list->items = new_items;
+        list->capacity = new_capacity;
+    }
+    Client *client = (Client *)calloc(1, sizeof(Client));
+    if (client == NULL) {
+        return false;
+    }
+    client->fd = fd;
+    client->references = 1;
+    pthread_mutex_init(&client->lock, NULL);
+    pthread_cond_init(&client->acknowledged, NULL);
+    list->items[list->count++] = client;
+    return true;
+}
+
+// Jobs still running for the client keep it alive but see it closed
+static void client_list_remove(ClientList *list, size_t index) {
+    Client *client = list->items[index];
+    for (size_t i = sessions.count; i > 0; --i) {
+        if (sessions.items[i - 1]->owner == client) {
+            close_session(i - 1);
+        }
+    }
+    // Programs waiting for input would otherwise wait out their wall-clock limit
+    pthread_mutex_lock(&terminals_lock);
+    for (size_t i = 0; i < terminals.count; ++i) {
+        if (terminals.items[i].client == client) {
+            runner_terminal_kill(terminals.items[i].terminal);
+        }
+    }
+    pthread_mutex_unlock(&terminals_lock);
+    pthread_mutex_lock(&client->lock);
+    client->closed = true;
+    pthread_cond_broadcast(&client->acknowledged);
+    pthread_mutex_unlock(&client->lock);
+    close(client->fd);
+    client->fd = -1;
+    byte_buffer_free(&client->in);
+    client_release(client);
+    list->items[index] = list->items[list->count - 1];
+    list->count--;
+}
+
+static void client_release(Client *client) {
+    pthread_mutex_lock(&client->lock);
+    bool last = --client->references == 0;
+    pthread_mutex_unlock(&client->lock);
+    if (last) {
+        byte_buffer_free(&client->out);
+        pthread_cond_destroy(&client->acknowledged);
+        pthread_mutex_destroy(&client->lock);
+        free(client);
+    }
+}
+
+static bool client_read(Client *client) {
+    while (true) {
+        if (!byte_buffer_reserve(&client->in, client->in.length + SERVER_READ_CHUNK)) {
+            return false;
+        }
+        ssize_t received = read(client->fd, client->in.data + client->in.length, SERVER_READ_CHUNK);
+        if (received > 0) {
+            client->in.length += (size_t)received;
+            continue;
+        }
+        if (received == 0) {
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+static bool client_flush(Client *client) {
+    while (client->out.offset < client->out.length) {
+        ssize_t sent = write(client->fd, client->out.data + client->out.offset,
+                             client->out.length - client->out.offset);
+        if (sent > 0) {
+            client->out.offset += (size_t)sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+    byte_buffer_compact(&client->out);
+    return true;
+}
+
+static bool client_has_output(Client *client) {
+    pthread_mutex_lock(&client->lock);
+    bool pending = client->out.length > client->out.offset;
+    pthread_mutex_unlock(&client->lock);
+    return pending;
+}
+
+static bool client_process_frames(Client *client) {
+    ByteBuffer *in = &client->in;
+
+    while (in->length - in->offset >= GENIX_FRAME_HEADER_SIZE) {
+        GenixFrameHeader header;
+        genix_frame_decode_header(in->data + in->offset, &header);
+        if (header.length > GENIX_FRAME_MAX_PAYLOAD) {
+            return false;
+        }
+        if (in->length - in->offset < GENIX_FRAME_HEADER_SIZE + (size_t)header.length) {
+            break;
+        }
+
+        const unsigned char *payload = in->data + in->offset + GENIX_FRAME_HEADER_SIZE;
+        bool queued = true;
+        GenixStatus status;
+
+        // Shell commands, evaluations and requests reading files go to the worker
+        // pool; the rest is quick and answered here, with the client locked against workers' replies
+        if (header.opcode == GENIX_OP_EXEC || header.opcode == GENIX_OP_EXEC_STREAM ||
+            header.opcode == GENIX_OP_SESSION_EXEC || header.opcode == GENIX_OP_COMPLETE ||
+            header.opcode == GENIX_OP_SEARCH || header.opcode == GENIX_OP_INDEX ||
+            header.opcode == GENIX_OP_GREP || header.opcode == GENIX_OP_READ || header.opcode == GENIX_OP_RUN ||
+            header.opcode == GENIX_OP_RUN_TERMINAL || header.opcode == GENIX_OP_EVAL ||
+            header.opcode == GENIX_OP_HISTORY) {
+            if (!client_submit_job(client, &header, payload, header.length)) {
+                return false;
+            }
+            in->offset += GENIX_FRAME_HEADER_SIZE + (size_t)header.length;
+            continue;
+        }
+
+        pthread_mutex_lock(&client->lock);
+        switch (header.opcode) {
+            case GENIX_OP_PING:
+                queued = client_queue_response(client, &header, GENIX_STATUS_OK, NULL, 0);
+                break;
+            case GENIX_OP_SESSION_OPEN:
+                queued = client_open_session(client, &header);
+                break;
+            case GENIX_OP_SESSION_CLOSE:
+                queued = client_close_session(client, &header, payload, header.length);
+                break;
+            case GENIX_OP_LIST:
+                queued = client_queue_listing(client, &header, payload, header.length);
+                break;
+            case GENIX_OP_RUN_INPUT:
+            case GENIX_OP_RUN_RESIZE:
+            case GENIX_OP_RUN_KILL:
+                status = control_terminal(client, &header, payload, header.length);
+                queued = client_queue_response(client, &header, status, NULL, 0);
+                break;
+            case GENIX_OP_STREAM_ACK:
+                acknowledge_stream(client, &header, payload, header.length);
+                break;
+            case GENIX_OP_STATS:
+                vfs_format_stats(output_buffer, sizeof(output_buffer));
+                queued = client_queue_response(client, &header, GENIX_STATUS_OK, output_buffer,
+                                               strlen(output_buffer));
+                break;
+            default:
+                queued = client_queue_response(client, &header, GENIX_STATUS_BAD_REQUEST, NULL, 0);
+                break;
+        }
+        pthread_mutex_unlock(&client->lock);
+
+        if (!queued) {
+            return false;
+        }
+        in->offset += GENIX_FRAME_HEADER_SIZE + (size_t)header.length;
+    }
+
+    byte_buffer_compact(in);
+    return true;
+}
+
+static bool client_submit_job(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                              size_t length) {
+    Session *session = NULL;
+    if (request->opcode == GENIX_OP_SESSION_EXEC || request->opcode == GENIX_OP_COMPLETE) {
+        // A completion without a session resolves paths from the project root
+        bool sessionless = request->opcode == GENIX_OP_COMPLETE && length >= 4 && genix_get_u32(payload) == 0;
+        session = length >= 4 && !sessionless ? find_session(genix_get_u32(payload), client, NULL) : NULL;
+        if (session == NULL && !sessionless) {
+            pthread_mutex_lock(&client->lock);
+            bool queued = client_queue_response(client, request,
+                                                length >= 4 ? GENIX_STATUS_NOT_FOUND : GENIX_STATUS_BAD_REQUEST, NULL, 0);
+            pthread_mutex_unlock(&client->lock);
+            return queued;
+        }
+        payload += 4;
+        length -= 4;
+    }
+    RunTerminal *terminal = NULL;
+    if (request->opcode == GENIX_OP_RUN_TERMINAL) {
+        GenixStatus status = open_terminal(client, request, payload, length, &terminal);
+        if (status != GENIX_STATUS_OK) {
+            pthread_mutex_lock(&client->lock);
+            bool queued = client_queue_response(client, request, status, NULL, 0);
+            pthread_mutex_unlock(&client->lock);
+            return queued;
+        }
+    }
+
+    Job *job = (Job *)malloc(sizeof(Job) + length + 1);
+    if (job == NULL) {
+        if (terminal != NULL) {
+            close_terminal(terminal);
+        }
+        return false;
+    }
+    job->client = client;
+    job->request = *request;
+    job->session = session;
+    job->terminal = terminal;
+    job->next = NULL;
+    job->length = length;
+    memcpy(job->command, payload, length);
+    job->command[length] = '\0';
+
+    pthread_mutex_lock(&client->lock);
+    ++client->references;
+    pthread_mutex_unlock(&client->lock);
+
+    if (session != NULL) {
+        schedule_session_job(session, job);
+        return true;
+    }
+    if (!worker_pool_submit(workers, run_job, job)) {
+        if (terminal != NULL) {
+            close_terminal(terminal);
+        }
+        client_release(client);
+        free(job);
+        return false;
+    }
+    return true;
+}
+
+static bool client_open_session(Client *client, const GenixFrameHeader *request) {
+    if (sessions.count == sessions.capacity) {
+        size_t capacity = sessions.capacity == 0 ? INITIAL_SESSION_CAPACITY : sessions.capacity * 2;
+        Session **items = (Session **)realloc(sessions.items, capacity * sizeof(Session *));
+        if (items == NULL) {
+            return client_queue_response(client, request, GENIX_STATUS_ERROR, NULL, 0);
+        }
+        sessions.items = items;
+        sessions.capacity = capacity;
+    }
+    Session *session = (Session *)calloc(1, sizeof(Session));
+    if (session == NULL || (session->shell = shell_session_create()) == NULL) {
+        free(session);
+        return client_queue_response(client, request, GENIX_STATUS_ERROR, NULL, 0);
+    }
+    session->id = next_session_id++;
+    session->owner = client;
+    pthread_mutex_init(&session->lock, NULL);
+    sessions.items[sessions.count++] = session;
+
+    unsigned char id[4];
+    genix_put_u32(id, session->id);
+    return client_queue_response(client, request, GENIX_STATUS_OK, id, sizeof(id));
+}
+
+static bool client_close_session(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length) {
+    size_t index;
+    if (length != 4) {
+        return client_queue_response(client, request, GENIX_STATUS_BAD_REQUEST, NULL, 0);
+    }
+    if (find_session(genix_get_u32(payload), client, &index) == NULL) {
+        return client_queue_response(client, request, GENIX_STATUS_NOT_FOUND, NULL, 0);
+    }
+    close_session(index);
+    return client_queue_response(client, request, GENIX_STATUS_OK, NULL, 0);
+}
+
+static Session *find_session(uint32_t id, const Client *owner, size_t *index) {
+    Session **found = bsearch(&id, sessions.items, sessions.count, sizeof(Session *), compare_session);
+    if (found == NULL || (*found)->owner != owner) {
+        return NULL;
+    }
+    if (index != NULL) {
+        *index = (size_t)(found - sessions.items);
+    }
+    return *found;
+}
+
+static int compare_session(const void *key, const void *element) {
+    uint32_t id = *(const uint32_t *)key;
+    uint32_t other = (*(Session *const *)element)->id;
+    return id < other ? -1 : id > other;
+}
+
+// Commands already queued for the session still run; the last one frees it
+static void close_session(size_t index) {
+    Session *session = sessions.items[index];
+    memmove(&sessions.items[index], &sessions.items[index + 1], (sessions.count - index - 1) * sizeof(Session *));
+    sessions.count--;
+
+    pthread_mutex_lock(&session->lock);
+    session->closing = true;
+    bool idle = !session->running;
+    pthread_mutex_unlock(&session->lock);
+    if (idle) {
+        destroy_session(session);
+    }
+}
+
+static void destroy_session(Session *session) {
+    shell_session_destroy(session->shell);
+    pthread_mutex_destroy(&session->lock);
+    free(session);
+}
+
+static void run_job(void *argument) {
+    Job *job = (Job *)argument;
+    Client *client = job->client;
+    Session *session = job->session;
+    int result;
+
+    if (job->request.opcode == GENIX_OP_EXEC) {
+        output_buffer[0] = '\0';
+        result = shell_execute_command(job->command, output_buffer, sizeof(output_buffer));
+        pthread_mutex_lock(&client->lock);
+        if (!client->closed) {
+            client->failed |= !client_queue_response(client, &job->request, status_from_shell(result), output_buffer,
+                                                     strlen(output_buffer));
+        }
+        pthread_mutex_unlock(&client->lock);
+    } else if (job->request.opcode == GENIX_OP_READ) {
+        queue_file_contents(job);
+    } else if (job->request.opcode == GENIX_OP_RUN || job->request.opcode == GENIX_OP_RUN_TERMINAL) {
+        queue_program_run(job);
+    } else if (job->request.opcode == GENIX_OP_EVAL) {
+        queue_evaluation(job);
+    } else if (job->request.opcode != GENIX_OP_EXEC_STREAM && job->request.opcode != GENIX_OP_SESSION_EXEC) {
+        ShellOutput out = {.data = output_buffer, .size = sizeof(output_buffer)};
+        output_buffer[0] = '\0';
+        GenixStatus status = answer_job(job, &out);
+        pthread_mutex_lock(&client->lock);
+        if (!client->closed) {
+            client->failed |= !client_queue_response(client, &job->request, status, out.data, out.length);
+        }
+        pthread_mutex_unlock(&client->lock);
+    } else {
+        OutputStream stream;
+        stream_open(&stream, client, &job->request);
+        result = shell_session_execute(session != NULL ? session->shell : NULL, job->command, stream_chunk, &stream);
+        stream_close(&stream);
+        pthread_mutex_lock(&client->lock);
+        if (!client->closed) {
+            client->failed |= !(stream.stalled ? client_queue_response(client, &job->request, GENIX_STATUS_ERROR,
+                                                                       SERVER_STREAM_STALLED,
+                                                                       strlen(SERVER_STREAM_STALLED))
+                                               : client_queue_response(client, &job->request,
+                                                                       status_from_shell(result), NULL, 0));
+        }
+        pthread_mutex_unlock(&client->lock);
+    }
+    wake_event_loop();
+    if (job->terminal != NULL) {
+        close_terminal(job->terminal);
+    }
+    free(job);
+
+    if (session != NULL) {
+        pthread_mutex_lock(&session->lock);
+        Job *next = session->head;
+        if (next != NULL) {
+            session->head = next->next;
+            session->tail = session->head != NULL ? session->tail : NULL;
+        }
+        session->running = next != NULL;
+        bool finished = next == NULL && session->closing;
+        pthread_mutex_unlock(&session->lock);
+        if (next != NULL && !worker_pool_submit(workers, run_job, next)) {
+            // Out of memory: run it here rather than strand the session
+            run_job(next);
+        }
+        if (finished) {
+            destroy_session(session);
+        }
+    }
+    client_release(client);
+}
+
+// Requests answered with a single frame
+static GenixStatus answer_job(const Job *job, ShellOutput *out) {
+    switch (job->request.opcode) {
+        case GENIX_OP_COMPLETE:
+            // Queued behind the session's commands, so a preceding cd has taken effect
+            complete_line(job->session != NULL ? job->session->shell : NULL, job->command, out);
+            return GENIX_STATUS_OK;
+        case GENIX_OP_SEARCH:
+            return answer_search(job, out);
+        case GENIX_OP_INDEX:
+            if (job->length == 0 || strlen(job->command) != job->length) {
+                return GENIX_STATUS_BAD_REQUEST;
+            }
+            search_index_update(job->command);
+            pagecache_invalidate(job->command);
+            return GENIX_STATUS_OK;
+        case GENIX_OP_GREP:
+            return answer_grep(job, out);
+        case GENIX_OP_HISTORY:
+            return answer_history(job, out);
+        default:
+            return GENIX_STATUS_BAD_REQUEST;
+    }
+}
+
+static GenixStatus answer_search(const Job *job, ShellOutput *out) {
+    if (job->length < 2) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    if (!search_index_active()) {
+        return GENIX_STATUS_NOT_FOUND;
+    }
+    size_t limit = genix_get_u16((const unsigned char *)job->command);
+    limit = limit < SEARCH_MAX_HITS ? limit : SEARCH_MAX_HITS;
+    SearchHit *hits = (SearchHit *)malloc((limit > 0 ? limit : 1) * sizeof(SearchHit));
+    if (hits == NULL) {
+        return GENIX_STATUS_ERROR;
+    }
+    size_t found = search_query(job->command + 2, hits, limit);
+    for (size_t i = 0; i < found; ++i) {
+        shell_output_printf(out, "%s\t%u\t%.4f\t%s\n", hits[i].path, hits[i].line, hits[i].score, hits[i].snippet);
+    }
+    free(hits);
+    return GENIX_STATUS_OK;
+}
+
+static GenixStatus answer_grep(const Job *job, ShellOutput *out) {
+    if (job->length < 4) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    const unsigned char *payload = (const unsigned char *)job->command;
+    const char *pattern_text = job->command + 4;
+    size_t pattern_length = strlen(pattern_text);
+    if (4 + pattern_length >= job->length) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    const char *directory = pattern_text + pattern_length + 1;
+    if (directory[0] != '/' || strlen(directory) != job->length - 5 - pattern_length) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+
+    size_t limit = genix_get_u16(payload + 2);
+    GrepOptions options = {
+        .ignore_case = (payload[0] & GENIX_GREP_IGNORE_CASE) != 0,
+        .fixed = (payload[0] & GENIX_GREP_FIXED) != 0,
+        .extended = (payload[0] & GENIX_GREP_EXTENDED) != 0,
+        .line_numbers = true,
+        .separator = '\t',
+        .limit = limit > 0 && limit < SERVER_GREP_MAX_LINES ? limit : SERVER_GREP_MAX_LINES,
+    };
+    GrepPattern pattern;
+    char error[256];
+    if (grep_compile(&pattern, pattern_text, &options, error, sizeof(error)) != 0) {
+        shell_output_printf(out, "%s", error);
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    long matches = grep_tree(&pattern, directory, NULL, out);
+    grep_free(&pattern);
+    return matches < 0 ? GENIX_STATUS_NOT_FOUND : GENIX_STATUS_OK;
+}
+
+// Scans the whole history file, so it runs off the event loop like completions
+static GenixStatus answer_history(const Job *job, ShellOutput *out) {
+    const unsigned char *payload = (const unsigned char *)job->command;
+    if (job->length < 4 || payload[0] > HISTORY_SUBSTRING) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    history_search(job->command + 4, (HistoryMatch)payload[0], genix_get_u16(payload + 2), out);
+    return GENIX_STATUS_OK;
+}
+
+// Copied straight from the page cache into the client's output buffer
+static void queue_file_contents(const Job *job) {
+    Client *client = job->client;
+    VfsView view = {"", 0, NULL, NULL};
+    GenixStatus status = GENIX_STATUS_OK;
+    if (job->length == 0 || job->command[0] != '/' || strlen(job->command) != job->length) {
+        status = GENIX_STATUS_BAD_REQUEST;
+    } else if (vfs_map_full(job->command, &view) != 0) {
+        status = GENIX_STATUS_NOT_FOUND;
+    } else if (view.size > GENIX_FRAME_MAX_PAYLOAD) {
+        status = GENIX_STATUS_ERROR;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (!client->closed) {
+        client->failed |= !client_queue_response(client, &job->request, status, view.data,
+                                                 status == GENIX_STATUS_OK ? view.size : 0);
+    }
+    pthread_mutex_unlock(&client->lock);
+    vfs_release(&view);
+}
+
+// Waits for the program, most of it asleep; a spare thread covers for the
+// worker. A terminal run streams its output meanwhile.
+static void queue_program_run(const Job *job) {
+    Client *client = job->client;
+    const unsigned char *payload = (const unsigned char *)job->command;
+    size_t header_size = job->terminal != NULL ? GENIX_RUN_TERMINAL_HEADER_SIZE : GENIX_RUN_REQUEST_HEADER_SIZE;
+    const char *path = job->command + header_size;
+    size_t path_length = job->length > header_size ? strlen(path) : 0;
+    const char *cwd = path + path_length + 1;
+    if (path_length == 0 || header_size + path_length + 1 >= job->length || path[0] != '/' || cwd[0] != '/' ||
+        strlen(cwd) != job->length - header_size - path_length - 1) {
+        pthread_mutex_lock(&client->lock);
+        if (!client->closed) {
+            client->failed |= !client_queue_response(client, &job->request, GENIX_STATUS_BAD_REQUEST, NULL, 0);
+        }
+        pthread_mutex_unlock(&client->lock);
+        return;
+    }
+    RunLimits limits = {
+        .wall_ms = genix_get_u32(payload),
+        .cpu_seconds = genix_get_u32(payload + 4),
+        .memory_bytes = (uint64_t)genix_get_u32(payload + 8) * 1024 * 1024,
+        .file_bytes = (uint64_t)genix_get_u32(payload + 12) * 1024 * 1024,
+        .processes = genix_get_u32(payload + 16),
+    };
+
+    RunResult result;
+    OutputStream stream;
+    stream_open(&stream, client, &job->request);
+    worker_pool_block_begin(workers);
+    int ran = job->terminal != NULL
+                  ? runner_terminal_run(job->terminal, path, cwd, &limits, stream_chunk, &stream, &result)
+                  : runner_run(path, cwd, &limits, &result);
+    // Ending the block takes the pool's lock, which may clobber errno
+    int error = errno;
+    worker_pool_block_end(workers);
+    stream_close(&stream);
+
+    GenixStatus status = GENIX_STATUS_OK;
+    unsigned char *reply = NULL;
+    size_t reply_length = 0;
+    const char *reason = NULL;
+    if (ran != 0) {
+        status = error == ENOENT ? GENIX_STATUS_NOT_FOUND : GENIX_STATUS_ERROR;
+        reason = error == EAGAIN ? "no zygotes are running" : strerror(error);
+    } else if (stream.stalled) {
+        // The program was killed when its output stopped being acknowledged
+        status = GENIX_STATUS_ERROR;
+        reason = SERVER_STREAM_STALLED;
+        runner_result_free(&result);
+    } else {
+        reply_length = GENIX_RUN_RESPONSE_HEADER_SIZE + result.out_length + result.err_length;
+        reply = (unsigned char *)malloc(reply_length);
+        if (reply == NULL) {
+            status = GENIX_STATUS_ERROR;
+            reason = "out of memory";
+            reply_length = 0;
+        } else {
+            encode_run_result(&result, reply);
+        }
+        runner_result_free(&result);
+    }
+
+    pthread_mutex_lock(&client->lock);
+    if (!client->closed) {
+        const void *data = reply != NULL ? (const void *)reply : (const void *)reason;
+        size_t length = reply != NULL ? reply_length : strlen(reason);
+        client->failed |= !client_queue_response(client, &job->request, status, data, length);
+    }
+    pthread_mutex_unlock(&client->lock);
+    free(reply);
+}
+
+// The results are encoded straight into the client's output buffer
+static void queue_evaluation(const Job *job) {
+    Client *client = job->client;
+    char error[CALC_ERROR_SIZE] = "";
+    double *results = NULL;
+    size_t rows = 0;
+    GenixStatus status = evaluate_rows(job, &results, &rows, error, sizeof(error));
+
+    pthread_mutex_lock(&client->lock);
+    if (!client->closed && status != GENIX_STATUS_OK) {
+        client->failed |= !client_queue_response(client, &job->request, status, error, strlen(error));
+    } else if (!client->closed) {
+        size_t payload_length = rows * sizeof(double);
+        size_t frame_start = client->out.length;
+        bool queued = client_queue_response(client, &job->request, GENIX_STATUS_OK, NULL, 0) &&
+                      byte_buffer_reserve(&client->out, client->out.length + payload_length);
+        if (queued) {
+            unsigned char *cursor = client->out.data + client->out.length;
+            for (size_t i = 0; i < rows; ++i) {
+                uint64_t bits;
+                memcpy(&bits, &results[i], sizeof(bits));
+                genix_put_u64(cursor + i * sizeof(double), bits);
+            }
+            client->out.length += payload_length;
+            genix_put_u32(client->out.data + frame_start, (uint32_t)payload_length);
+        }
+        client->failed |= !queued;
+    }
+    pthread_mutex_unlock(&client->lock);
+    free(results);
+}
+
+// Decodes the request and evaluates every row; on success *values holds the
+// result column followed by the variable columns
+static GenixStatus evaluate_rows(const Job *job, double **values, size_t *rows, char *error, size_t error_size) {
+    const unsigned char *payload = (const unsigned char *)job->command;
+    size_t length = job->length;
+    if (length < 8) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    size_t expression_length = genix_get_u16(payload);
+    size_t variable_count = genix_get_u16(payload + 2);
+    size_t row_count = genix_get_u32(payload + 4);
+    size_t offset = 8;
+
+    char expression[SERVER_PATH_SIZE];
+    char names[CALC_MAX_VARIABLES][16];
+    const char *variables[CALC_MAX_VARIABLES];
+    if (expression_length >= sizeof(expression) || variable_count > CALC_MAX_VARIABLES ||
+        length - offset < expression_length) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    memcpy(expression, payload + offset, expression_length);
+    expression[expression_length] = '\0';
+    offset += expression_length;
+
+    for (size_t i = 0; i < variable_count; ++i) {
+        if (offset >= length || payload[offset] >= sizeof(names[i]) || length - offset - 1 < payload[offset]) {
+            return GENIX_STATUS_BAD_REQUEST;
+        }
+        size_t name_length = payload[offset];
+        memcpy(names[i], payload + offset + 1, name_length);
+        names[i][name_length] = '\0';
+        variables[i] = names[i];
+        offset += 1 + name_length;
+    }
+    if (row_count > GENIX_FRAME_MAX_PAYLOAD / sizeof(double) ||
+        length - offset != row_count * variable_count * sizeof(double)) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+
+    CalcProgram program;
+    if (calc_compile_vars(expression, variables, variable_count, &program, error, error_size) != 0) {
+        return GENIX_STATUS_ERROR;
+    }
+
+    // Columns arrive unaligned inside the frame, so decode them into one
+    // block behind the result column.
+    double *block = (double *)malloc((variable_count + 1) * (row_count > 0 ? row_count : 1) * sizeof(double));
+    if (block == NULL) {
+        return GENIX_STATUS_ERROR;
+    }
+    const double *columns[CALC_MAX_VARIABLES];
+    for (size_t i = 0; i < variable_count * row_count; ++i) {
+        uint64_t bits = genix_get_u64(payload + offset + i * sizeof(double));
+        memcpy(&block[row_count + i], &bits, sizeof(bits));
+    }
+    for (size_t i = 0; i < variable_count; ++i) {
+        columns[i] = block + (i + 1) * row_count;
+    }
+
+    if (calc_execute_batch(&program, columns, row_count, block, error, error_size) != 0) {
+        free(block);
+        return GENIX_STATUS_ERROR;
+    }
+    *values = block;
+    *rows = row_count;
+    return GENIX_STATUS_OK;
+}
+
+static void encode_run_result(const RunResult *result, unsigned char *reply) {
+    genix_put_u32(reply, (uint32_t)result->exit_code);
+    reply[4] = (unsigned char)result->signal;
+    reply[5] = (unsigned char)((result->timed_out ? GENIX_RUN_TIMED_OUT : 0) |
+                               (result->truncated ? GENIX_RUN_TRUNCATED : 0));
+    genix_put_u16(reply + 6, 0);
+    genix_put_u64(reply + 8, result->wall_us);
+    genix_put_u64(reply + 16, result->user_us);
+    genix_put_u64(reply + 24, result->system_us);
+    genix_put_u64(reply + 32, result->max_rss_kb);
+    genix_put_u32(reply + 40, (uint32_t)result->out_length);
+    if (result->out_length > 0) {
+        memcpy(reply + GENIX_RUN_RESPONSE_HEADER_SIZE, result->out, result->out_length);
+    }
+    if (result->err_length > 0) {
+        memcpy(reply + GENIX_RUN_RESPONSE_HEADER_SIZE + result->out_length, result->err, result->err_length);
+    }
+}
+
+// Opens the terminal up front, so input can arrive before the job runs
+static GenixStatus open_terminal(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length, RunTerminal **terminal) {
+    if (length < GENIX_RUN_TERMINAL_HEADER_SIZE) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    pthread_mutex_lock(&terminals_lock);
+    GenixStatus status = GENIX_STATUS_OK;
+    if (find_terminal(client, request->request_id) != NULL) {
+        status = GENIX_STATUS_BAD_REQUEST;
+    } else if (terminals.count == terminals.capacity) {
+        size_t capacity = terminals.capacity == 0 ? INITIAL_TERMINAL_CAPACITY : terminals.capacity * 2;
+        TerminalRun *items = (TerminalRun *)realloc(terminals.items, capacity * sizeof(TerminalRun));
+        if (items == NULL) {
+            status = GENIX_STATUS_ERROR;
+        } else {
+            terminals.items = items;
+            terminals.capacity = capacity;
+        }
+    }
+    if (status == GENIX_STATUS_OK) {
+        *terminal = runner_terminal_create(genix_get_u16(payload + 20), genix_get_u16(payload + 22));
+        if (*terminal == NULL) {
+            status = GENIX_STATUS_ERROR;
+        } else {
+            terminals.items[terminals.count++] = (TerminalRun){client, request->request_id, *terminal};
+        }
+    }
+    pthread_mutex_unlock(&terminals_lock);
+    return status;
+}
+
+static void close_terminal(RunTerminal *terminal) {
+    pthread_mutex_lock(&terminals_lock);
+    for (size_t i = 0; i < terminals.count; ++i) {
+        if (terminals.items[i].terminal == terminal) {
+            terminals.items[i] = terminals.items[--terminals.count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&terminals_lock);
+    runner_terminal_destroy(terminal);
+}
+
+// Runs with terminals_lock held
+static TerminalRun *find_terminal(const Client *client, uint32_t request_id) {
+    for (size_t i = 0; i < terminals.count; ++i) {
+        if (terminals.items[i].client == client && terminals.items[i].request_id == request_id) {
+            return &terminals.items[i];
+        }
+    }
+    return NULL;
+}
+
+// RUN_INPUT, RUN_RESIZE and RUN_KILL, none of which blocks
+static GenixStatus control_terminal(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                    size_t length) {
+    if (length < 4 || (request->opcode == GENIX_OP_RUN_RESIZE && length != 8) ||
+        (request->opcode == GENIX_OP_RUN_KILL && length != 4)) {
+        return GENIX_STATUS_BAD_REQUEST;
+    }
+    pthread_mutex_lock(&terminals_lock);
+    TerminalRun *run = find_terminal(client, genix_get_u32(payload));
+    GenixStatus status = run != NULL ? GENIX_STATUS_OK : GENIX_STATUS_NOT_FOUND;
+    if (run != NULL && request->opcode == GENIX_OP_RUN_INPUT) {
+        if (runner_terminal_write(run->terminal, (const char *)payload + 4, length - 4) != 0) {
+            status = errno == EPIPE ? GENIX_STATUS_NOT_FOUND : GENIX_STATUS_ERROR;
+        }
+    } else if (run != NULL && request->opcode == GENIX_OP_RUN_RESIZE) {
+        if (runner_terminal_resize(run->terminal, genix_get_u16(payload + 4), genix_get_u16(payload + 6)) != 0) {
+            status = GENIX_STATUS_ERROR;
+        }
+    } else if (run != NULL) {
+        runner_terminal_kill(run->terminal);
+    }
+    pthread_mutex_unlock(&terminals_lock);
+    return status;
+}
+
+static void schedule_session_job(Session *session, Job *job) {
+    pthread_mutex_lock(&session->lock);
+    bool start = !session->running;
+    if (start) {
+        session->running = true;
+    } else if (session->tail != NULL) {
+        session->tail->next = job;
+        session->tail = job;
+    } else {
+        session->head = session->tail = job;
+    }
+    pthread_mutex_unlock(&session->lock);
+    if (start && !worker_pool_submit(workers, run_job, job)) {
+        run_job(job);
+    }
+}
+
+// Collapses bursts of replies into one wakeup of the event loop
+static void wake_event_loop(void) {
+    if (!atomic_exchange(&wake_pending, true)) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+static bool client_queue_response(Client *client, const GenixFrameHeader *request, GenixStatus status,
+                                  const void *payload, size_t length) {
+    GenixFrameHeader response = {
+        .length = (uint32_t)length,
+        .request_id = request->request_id,
+        .opcode = request->opcode,
+        .status = (uint16_t)status,
+    };
+    unsigned char header_bytes[GENIX_FRAME_HEADER_SIZE];
+    genix_frame_encode_header(&response, header_bytes);
+
+    if (!byte_buffer_append(&client->out, header_bytes, sizeof(header_bytes))) {
+        return false;
+    }
+    return length == 0 || byte_buffer_append(&client->out, payload, length);
+}
+
+static bool client_queue_listing(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                                 size_t length) {
+    char path[SERVER_PATH_SIZE];
+    if (length == 0 || length >= sizeof(path) || payload[0] != '/') {
+        return client_queue_response(client, request, GENIX_STATUS_BAD_REQUEST, NULL, 0);
+    }
+    memcpy(path, payload, length);
+    path[length] = '\0';
+
+    const DirListing *listing = dircache_acquire(path);
+    if (listing == NULL) {
+        return client_queue_response(client, request, GENIX_STATUS_NOT_FOUND, NULL, 0);
+    }
+
+    size_t payload_length = 0;
+    for (size_t i = 0; i < listing->count; ++i) {
+        payload_length += GENIX_DIR_RECORD_HEADER_SIZE + strlen(listing->entries[i].name);
+    }
+
+    // Encode the records straight into the output buffer behind the header
+    size_t frame_start = client->out.length;
+    bool queued = client_queue_response(client, request, GENIX_STATUS_OK, NULL, 0) &&
+                  byte_buffer_reserve(&client->out, client->out.length + payload_length);
+    if (queued) {
+        unsigned char *cursor = client->out.data + client->out.length;
+        for (size_t i = 0; i < listing->count; ++i) {
+            const DirCacheEntry *entry = &listing->entries[i];
+            size_t name_length = strlen(entry->name);
+            genix_put_u16(cursor, (uint16_t)name_length);
+            cursor[2] = (unsigned char)entry->type;
+            cursor[3] = 0;
+            genix_put_u64(cursor + 4, (uint64_t)entry->size);
+            genix_put_u64(cursor + 12, (uint64_t)entry->mtime_ms);
+            memcpy(cursor + GENIX_DIR_RECORD_HEADER_SIZE, entry->name, name_length);
+            cursor += GENIX_DIR_RECORD_HEADER_SIZE + name_length;
+        }
+        client->out.length += payload_length;
+        genix_put_u32(client->out.data + frame_start, (uint32_t)payload_length);
+    }
+
+    dircache_release(listing);
+    return queued;
+}
+
+// Registers a stream so the client's acknowledgements find it
+static void stream_open(OutputStream *stream, Client *client, const GenixFrameHeader *request) {
+    *stream = (OutputStream){.client = client, .request = request};
+    pthread_mutex_lock(&client->lock);
+    stream->next = client->streams;
+    client->streams = stream;
+    pthread_mutex_unlock(&client->lock);
+}
+
+static void stream_close(OutputStream *stream) {
+    Client *client = stream->client;
+    pthread_mutex_lock(&client->lock);
+    OutputStream **link = &client->streams;
+    while (*link != stream) {
+        link = &(*link)->next;
+    }
+    *link = stream->next;
+    pthread_mutex_unlock(&client->lock);
+}
+
+// Queues each chunk as soon as the shell or the program produces it; a
+// client that does not acknowledge it makes only this command wait, which
+// is what bounds the daemon's memory.
+static int stream_chunk(void *context, const char *data, size_t length) {
+    OutputStream *stream = (OutputStream *)context;
+    Client *client = stream->client;
+    pthread_mutex_lock(&client->lock);
+    bool queued = !client->closed && !stream->stalled &&
+                  client_queue_response(client, stream->request, GENIX_STATUS_MORE, data, length);
+    wake_event_loop();
+    if (queued) {
+        stream->sent += length;
+        queued = stream_wait_window(stream);
+    }
+    pthread_mutex_unlock(&client->lock);
+    return queued ? 0 : -1;
+}
+
+// Called with the client locked. Waits while more than a window of the
+// stream is unacknowledged; a spare worker covers for this one meanwhile.
+// A stream stalled past the timeout fails, leaving the connection and its
+// other requests alone.
+static bool stream_wait_window(OutputStream *stream) {
+    Client *client = stream->client;
+    if (client->closed || stream->sent - stream->acknowledged <= GENIX_STREAM_WINDOW) {
+        return !client->closed;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SERVER_STREAM_TIMEOUT_SECONDS;
+    worker_pool_block_begin(workers);
+    while (!client->closed && stream->sent - stream->acknowledged > GENIX_STREAM_WINDOW) {
+        if (pthread_cond_timedwait(&client->acknowledged, &client->lock, &deadline) != 0) {
+            stream->stalled = true;
+            break;
+        }
+    }
+    worker_pool_block_end(workers);
+    return !stream->stalled && !client->closed;
+}
+
+// Called with the client locked; an acknowledgement for a stream that has
+// already ended is dropped
+static void acknowledge_stream(Client *client, const GenixFrameHeader *request, const unsigned char *payload,
+                               size_t length) {
+    if (length != 4) {
+        return;
+    }
+    for (OutputStream *stream = client->streams; stream != NULL; stream = stream->next) {
+        if (stream->request->request_id == request->request_id) {
+            stream->acknowledged += genix_get_u32(payload);
+            pthread_cond_broadcast(&client->acknowledged);
+            return;
+        }
+    }
+}
+
+static GenixStatus status_from_shell(int result) {
+    if (result == SHELL_NOT_FOUND) {
+        return GENIX_STATUS_NOT_FOUND;
+    }
+    return result == 0 ? GENIX_STATUS_OK : GENIX_STATUS_ERROR;
+}
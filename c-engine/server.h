@@ -0,0 +1,19 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/**
+ * Runs the engine as a long-lived daemon listening on a Unix domain socket.
+ * Clients speak the framed protocol from protocol.h and may pipeline any
+ * number of requests over one connection.
+ *
+ * One thread owns the sockets; shell commands run on `worker_count` worker
+ * threads, so replies to different requests may arrive in any order and
+ * must be matched by request id. Commands of one session keep their order.
+ *
+ * Blocks until SIGINT/SIGTERM or server_request_stop(). Returns 0 on clean
+ * shutdown and -1 if the socket or the workers could not be set up.
+ */
+int server_run(const char *socket_path, int worker_count);
+void server_request_stop(void);
+
+#endif // SERVER_H
@@ -1,90 +1,1058 @@
 #include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/wait.h>
+#include <sys/stat.h>
 #include "shell.h"
+#include "builtins.h"
+#include "history.h"
+#include "search.h"
+#include "vfs.h"
 #include "apps/calculator/calculator.h"
 #include "apps/calendar/calendar.h"
 #include "apps/pkg_installer/pkg_installer.h"
 
+#define SHELL_COMMAND_SIZE 4096
+#define SHELL_PIPE_LIMIT (64 * 1024 * 1024)
+#define SHELL_MAX_VARIABLES 64
+#define SHELL_HISTORY_SIZE 100
+#define SEARCH_DEFAULT_HITS 10
+
+struct ShellSession {
+    char cwd[SHELL_PATH_SIZE];  // relative to the project root, "" at the root
+    char *variables[SHELL_MAX_VARIABLES];  // "NAME=value"
+    int variable_count;
+    char *history[SHELL_HISTORY_SIZE];  // ring buffer of the last command lines
+    unsigned long history_count;
+    int last_status;  // exit status of the last command line, for $?
+};
+
+typedef struct {
+    const char *name;
+    ShellCommandFn run;
+} ShellCommand;
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_WORD,
+    TOKEN_PIPE,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_SEQUENCE,
+    TOKEN_READ,
+    TOKEN_WRITE,
+    TOKEN_APPEND,
+    TOKEN_INVALID
+} ShellTokenType;
+
+typedef struct {
+    ShellTokenType type;
+    char *word;
+    const char *start;
+    const char *end;
+} ShellToken;
+
+typedef struct {
+    const char *cursor;
+    char *scratch;
+    char *scratch_end;
+    const ShellSession *session;
+    bool overflow;
+} ShellLexer;
+
+// One command of a pipeline; `connector` is the operator that follows it
+typedef struct {
+    ShellArgs args;
+    const char *input_path;
+    const char *output_path;
+    bool append;
+    ShellTokenType connector;
+} ShellStage;
+
+static int run_command_line(ShellSession *session, const char *command, ShellOutput *out);
+static int command_cachestat(const ShellArgs *args, ShellOutput *out);
+static int command_calc(const ShellArgs *args, ShellOutput *out);
+static int command_calendar(const ShellArgs *args, ShellOutput *out);
+static int command_cd(const ShellArgs *args, ShellOutput *out);
+static int command_env(const ShellArgs *args, ShellOutput *out);
+static int command_export(const ShellArgs *args, ShellOutput *out);
+static int command_history(const ShellArgs *args, ShellOutput *out);
+static int command_pkg(const ShellArgs *args, ShellOutput *out);
+static int command_pwd(const ShellArgs *args, ShellOutput *out);
+static int command_search(const ShellArgs *args, ShellOutput *out);
+static int command_unset(const ShellArgs *args, ShellOutput *out);
+static bool resolve_path(const ShellArgs *args, const char *path, bool clamp, char *resolved, size_t size);
+static const ShellCommand *find_command(const char *name);
+static int compare_command(const void *key, const void *element);
+static void record_history(ShellSession *session, const char *line);
+static int find_variable(const ShellSession *session, const char *name, size_t length);
+static const char *variable_value(const ShellSession *session, const char *name, size_t length);
+static int set_variable(ShellSession *session, const char *assignment);
+static bool is_variable_name(const char *name, size_t length);
+static int exit_code(int status);
+static void next_token(ShellLexer *lexer, ShellToken *token);
+static const char *expand_variable(ShellLexer *lexer, const char *read, char **write);
+static bool scratch_append(ShellLexer *lexer, char **write, const char *data, size_t length);
+static int parse_pipeline(ShellLexer *lexer, ShellStage *stages, int *stage_count, ShellOutput *out);
+static int run_pipeline(ShellStage *stages, int count, ShellOutput *out);
+static int run_stage(ShellStage *stage, ShellOutput *out);
+static bool is_plain_cat(const ShellStage *stage);
+static int map_path(const ShellStage *stage, const char *path, VfsView *view);
+static int write_redirect(const ShellStage *stage, const ShellOutput *buffer, ShellOutput *out);
+static void output_stream(ShellOutput *out, const char *data, size_t length);
+static void output_flush(ShellOutput *out);
+static void output_emit(ShellOutput *out, const char *data, size_t length);
+static bool output_reserve(ShellOutput *out, size_t length);
 static const char *skip_leading_whitespace(const char *input);
 static void trim_trailing_whitespace(char *text);
 
+// Sorted by name for bsearch; keep it that way when adding commands
+static const ShellCommand commands[] = {
+    {"cachestat", command_cachestat},
+    {"calc", command_calc},
+    {"calendar", command_calendar},
+    {"cat", builtin_cat},
+    {"cd", command_cd},
+    {"cp", builtin_cp},
+    {"du", builtin_du},
+    {"echo", builtin_echo},
+    {"env", command_env},
+    {"export", command_export},
+    {"find", builtin_find},
+    {"grep", builtin_grep},
+    {"head", builtin_head},
+    {"history", command_history},
+    {"ls", builtin_ls},
+    {"mkdir", builtin_mkdir},
+    {"mv", builtin_mv},
+    {"pkg", command_pkg},
+    {"pwd", command_pwd},
+    {"rm", builtin_rm},
+    {"search", command_search},
+    {"stat", builtin_stat},
+    {"tail", builtin_tail},
+    {"touch", builtin_touch},
+    {"tree", builtin_tree},
+    {"unset", command_unset},
+    {"wc", builtin_wc},
+};
+
+// The interactive apps own the terminal and keep global state; run one at a time
+static pthread_mutex_t apps_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool interactive_apps = false;
+
 void shell_init(void) {
     // Initialize shell environment
     // Set up signal handlers, etc.
 }
 
+void shell_set_interactive(bool interactive) {
+    interactive_apps = interactive;
+}
+
 int shell_execute_command(const char *command, char *output, size_t output_size) {
-    // Parse and execute shell commands
-    // This is a simplified version - full implementation would parse
-    // commands like ls, cd, mkdir, etc.
-    
     if (command == NULL || output == NULL || output_size == 0) {
         return -1;
     }
 
     output[0] = '\0';
+    ShellOutput out = {.data = output, .size = output_size};
+    return run_command_line(NULL, command, &out);
+}
+
+int shell_execute_stream(const char *command, ShellSinkFn sink, void *context) {
+    return shell_session_execute(NULL, command, sink, context);
+}
+
+ShellSession *shell_session_create(void) {
+    return calloc(1, sizeof(ShellSession));
+}
+
+void shell_session_destroy(ShellSession *session) {
+    if (session == NULL) {
+        return;
+    }
+    for (int i = 0; i < session->variable_count; ++i) {
+        free(session->variables[i]);
+    }
+    for (int i = 0; i < SHELL_HISTORY_SIZE; ++i) {
+        free(session->history[i]);
+    }
+    free(session);
+}
+
+const char *shell_session_cwd(const ShellSession *session) {
+    return session != NULL ? session->cwd : "";
+}
+
+int shell_session_execute(ShellSession *session, const char *command, ShellSinkFn sink, void *context) {
+    if (command == NULL || sink == NULL) {
+        return -1;
+    }
+
+    char chunk[SHELL_CHUNK_SIZE];
+    chunk[0] = '\0';
+    ShellOutput out = {.data = chunk, .size = sizeof(chunk), .sink = sink, .sink_context = context};
+    int status = run_command_line(session, command, &out);
+    output_flush(&out);
+    return status;
+}
+
+const char *shell_command_name(size_t index) {
+    return index < sizeof(commands) / sizeof(commands[0]) ? commands[index].name : NULL;
+}
 
+bool shell_resolve_path(const ShellArgs *args, const char *path, char *resolved, size_t size) {
+    return resolve_path(args, path, false, resolved, size);
+}
+
+void shell_output_write(ShellOutput *out, const void *data, size_t length) {
+    if (out->sink != NULL) {
+        output_stream(out, (const char *)data, length);
+        return;
+    }
+    if (!output_reserve(out, length)) {
+        length = out->size - out->length - 1;
+        out->truncated = true;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    out->data[out->length] = '\0';
+}
+
+void shell_output_printf(ShellOutput *out, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    if (out->sink != NULL) {
+        char line[1024];
+        int length = vsnprintf(line, sizeof(line), format, args);
+        if (length >= (int)sizeof(line)) {
+            char *long_line = malloc((size_t)length + 1);
+            if (long_line != NULL) {
+                vsnprintf(long_line, (size_t)length + 1, format, retry);
+                output_stream(out, long_line, (size_t)length);
+                free(long_line);
+            }
+        } else if (length > 0) {
+            output_stream(out, line, (size_t)length);
+        }
+        va_end(retry);
+        va_end(args);
+        return;
+    }
+    int written = -1;
+    if (output_reserve(out, 0)) {
+        written = vsnprintf(out->data + out->length, out->size - out->length, format, args);
+    }
+    if (written >= 0 && (size_t)written >= out->size - out->length) {
+        if (output_reserve(out, (size_t)written)) {
+            vsnprintf(out->data + out->length, out->size - out->length, format, retry);
+        } else {
+            written = (int)(out->size - out->length - 1);
+            out->truncated = true;
+        }
+    }
+    va_end(retry);
+    va_end(args);
+    if (written > 0) {
+        out->length += (size_t)written;
+    }
+}
+
+void shell_output_error(ShellOutput *out, const char *format, ...) {
+    ShellOutput *target = out->errors != NULL ? out->errors : out;
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (written > 0) {
+        shell_output_write(target, message, (size_t)written < sizeof(message) ? (size_t)written : sizeof(message) - 1);
+    }
+}
+
+static int run_command_line(ShellSession *session, const char *command, ShellOutput *out) {
     const char *trimmed_start = skip_leading_whitespace(command);
-    char command_buffer[256];
-    strncpy(command_buffer, trimmed_start, sizeof(command_buffer) - 1);
-    command_buffer[sizeof(command_buffer) - 1] = '\0';
+    char command_buffer[SHELL_COMMAND_SIZE];
+    if (strlen(trimmed_start) >= sizeof(command_buffer)) {
+        shell_output_error(out, "shell: command too long\n");
+        return SHELL_ERROR;
+    }
+    strcpy(command_buffer, trimmed_start);
     trim_trailing_whitespace(command_buffer);
 
     if (command_buffer[0] == '\0') {
-        return 0;
+        return SHELL_OK;
     }
+    record_history(session, command_buffer);
+
+    // Unquoted words and raw argument text of one pipeline land in scratch;
+    // without expansions each is at most the line length plus a terminator
+    char scratch[SHELL_COMMAND_SIZE * 3];
+    ShellStage stages[SHELL_MAX_STAGES];
+    int stage_count = 0;
+
+    // The whole line is checked before any of it runs, then parsed again a
+    // pipeline at a time so expansions see what earlier commands did
+    ShellLexer lexer = {command_buffer, scratch, scratch + sizeof(scratch), NULL, false};
+    do {
+        lexer.scratch = scratch;
+        if (parse_pipeline(&lexer, stages, &stage_count, out) != 0) {
+            if (session != NULL) {
+                session->last_status = exit_code(SHELL_ERROR);
+            }
+            return SHELL_ERROR;
+        }
+    } while (stages[stage_count - 1].connector != TOKEN_END);
+
+    lexer = (ShellLexer){command_buffer, scratch, scratch + sizeof(scratch), session, false};
+    int status = SHELL_OK;
+    bool skip = false;
+    ShellTokenType connector;
+    do {
+        lexer.scratch = scratch;
+        if (parse_pipeline(&lexer, stages, &stage_count, out) != 0) {
+            status = SHELL_ERROR;
+            break;
+        }
+        if (!skip) {
+            for (int i = 0; i < stage_count; ++i) {
+                stages[i].args.session = session;
+            }
+            status = run_pipeline(stages, stage_count, out);
+            if (session != NULL) {
+                session->last_status = exit_code(status);
+            }
+        }
+        // `a && b || c` is left-associative: skipped pipelines keep the last status
+        connector = stages[stage_count - 1].connector;
+        skip = connector == TOKEN_AND ? status != SHELL_OK : connector == TOKEN_OR ? status == SHELL_OK : false;
+    } while (connector != TOKEN_END);
+    if (session != NULL) {
+        session->last_status = exit_code(status);
+    }
+    return status;
+}
 
-    if (strcmp(command_buffer, "calc") == 0) {
+static int command_cachestat(const ShellArgs *args, ShellOutput *out) {
+    (void)args;
+    char stats[1024];
+    int status = vfs_format_stats(stats, sizeof(stats));
+    shell_output_write(out, stats, strlen(stats));
+    return status == 0 ? SHELL_OK : SHELL_ERROR;
+}
+
+static int command_calc(const ShellArgs *args, ShellOutput *out) {
+    if (args->arguments[0] == '\0' && !interactive_apps) {
+        shell_output_error(out, "calc: usage: calc <expr>\n");
+        return SHELL_ERROR;
+    }
+    if (args->arguments[0] == '\0') {
+        pthread_mutex_lock(&apps_mutex);
         calculator_run();
-        snprintf(output, output_size, "Calculator closed.\n");
-        return 0;
+        pthread_mutex_unlock(&apps_mutex);
+        shell_output_printf(out, "Calculator closed.\n");
+        return SHELL_OK;
+    }
+
+    // Inline "calc <expr>" evaluates without entering the interactive REPL
+    CalcError error;
+    double result = 0.0;
+    if (calc_eval(args->arguments, &result, &error) != 0) {
+        shell_output_error(out, "calc: %s\n", error.message);
+        return SHELL_ERROR;
     }
+    shell_output_printf(out, "%.10g\n", result);
+    return SHELL_OK;
+}
 
-    if (strcmp(command_buffer, "calendar") == 0) {
-        calendar_run();
-        snprintf(output, output_size, "Calendar closed.\n");
-        return 0;
+static int command_calendar(const ShellArgs *args, ShellOutput *out) {
+    (void)args;
+    if (!interactive_apps) {
+        shell_output_error(out, "calendar: needs an interactive terminal\n");
+        return SHELL_ERROR;
     }
+    pthread_mutex_lock(&apps_mutex);
+    calendar_run();
+    pthread_mutex_unlock(&apps_mutex);
+    shell_output_printf(out, "Calendar closed.\n");
+    return SHELL_OK;
+}
 
-    if (strncmp(command_buffer, "pkg", 3) == 0 && (command_buffer[3] == '\0' || isspace((unsigned char)command_buffer[3]))) {
-        const char *arguments = command_buffer + 3;
-        arguments = skip_leading_whitespace(arguments);
-        pkg_installer_run(arguments[0] != '\0' ? arguments : NULL);
-        snprintf(output, output_size, "Package installer finished.\n");
-        return 0;
+static int command_cd(const ShellArgs *args, ShellOutput *out) {
+    if (args->session == NULL) {
+        shell_output_error(out, "cd: no shell session\n");
+        return SHELL_ERROR;
+    }
+    if (args->argc > 2) {
+        shell_output_error(out, "cd: too many arguments\n");
+        return SHELL_ERROR;
+    }
+    const char *target = args->argc > 1 ? args->argv[1] : "/";
+    char relative[SHELL_PATH_SIZE];
+    char full_path[SHELL_PATH_SIZE];
+    struct stat st;
+    if (!resolve_path(args, target, true, relative, sizeof(relative)) ||
+        vfs_resolve(relative, full_path, sizeof(full_path)) != 0) {
+        shell_output_error(out, "cd: %s: Invalid path\n", target);
+        return SHELL_ERROR;
+    }
+    if (stat(full_path, &st) != 0) {
+        shell_output_error(out, "cd: %s: No such file or directory\n", target);
+        return SHELL_ERROR;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        shell_output_error(out, "cd: %s: Not a directory\n", target);
+        return SHELL_ERROR;
+    }
+    snprintf(args->session->cwd, sizeof(args->session->cwd), "%s", strcmp(relative, ".") == 0 ? "" : relative);
+    return SHELL_OK;
+}
+
+static int command_env(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc > 1) {
+        shell_output_error(out, "env: running commands is not supported\n");
+        return SHELL_ERROR;
+    }
+    if (args->session != NULL) {
+        for (int i = 0; i < args->session->variable_count; ++i) {
+            shell_output_printf(out, "%s\n", args->session->variables[i]);
+        }
     }
+    return SHELL_OK;
+}
 
-    if (strncmp(command, "ls", 2) == 0) {
-        // Execute ls command
-        FILE *fp = popen(command, "r");
-        if (fp == NULL) {
-            strncpy(output, "Error executing command", output_size);
-            return -1;
+static int command_export(const ShellArgs *args, ShellOutput *out) {
+    if (args->argc == 1) {
+        return command_env(args, out);
+    }
+    if (args->session == NULL) {
+        shell_output_error(out, "export: no shell session\n");
+        return SHELL_ERROR;
+    }
+    int result = SHELL_OK;
+    for (int i = 1; i < args->argc; ++i) {
+        const char *assignment = args->argv[i];
+        size_t name_length = strcspn(assignment, "=");
+        if (!is_variable_name(assignment, name_length)) {
+            shell_output_error(out, "export: '%s': not a valid identifier\n", assignment);
+            result = SHELL_ERROR;
+            continue;
         }
-        
-        size_t len = 0;
-        char line[256];
-        while (fgets(line, sizeof(line), fp) != NULL && len < output_size - 1) {
-            size_t line_len = strlen(line);
-            if (len + line_len < output_size) {
-                strncpy(output + len, line, output_size - len);
-                len += line_len;
+        // "export NAME" keeps an existing value and defines a missing one as empty
+        char definition[SHELL_PATH_SIZE];
+        if (assignment[name_length] == '\0') {
+            if (find_variable(args->session, assignment, name_length) >= 0) {
+                continue;
             }
+            snprintf(definition, sizeof(definition), "%s=", assignment);
+            assignment = definition;
+        }
+        if (set_variable(args->session, assignment) != 0) {
+            shell_output_error(out, "export: too many variables\n");
+            result = SHELL_ERROR;
+        }
+    }
+    return result;
+}
+
+static int command_history(const ShellArgs *args, ShellOutput *out) {
+    ShellSession *session = args->session;
+    if (session == NULL) {
+        return SHELL_OK;
+    }
+    unsigned long first = session->history_count > SHELL_HISTORY_SIZE ? session->history_count - SHELL_HISTORY_SIZE : 0;
+    for (unsigned long i = first; i < session->history_count; ++i) {
+        shell_output_printf(out, "%5lu  %s\n", i + 1, session->history[i % SHELL_HISTORY_SIZE]);
+    }
+    return SHELL_OK;
+}
+
+static int command_pkg(const ShellArgs *args, ShellOutput *out) {
+    if (args->arguments[0] == '\0' && !interactive_apps) {
+        shell_output_error(out, "pkg: usage: pkg <command>\n");
+        return SHELL_ERROR;
+    }
+    pthread_mutex_lock(&apps_mutex);
+    pkg_installer_run(args->arguments[0] != '\0' ? args->arguments : NULL);
+    pthread_mutex_unlock(&apps_mutex);
+    shell_output_printf(out, "Package installer finished.\n");
+    return SHELL_OK;
+}
+
+static int command_pwd(const ShellArgs *args, ShellOutput *out) {
+    shell_output_printf(out, "/%s\n", shell_session_cwd(args->session));
+    return SHELL_OK;
+}
+
+// search [-n COUNT] WORDS...: files containing every word, best first
+static int command_search(const ShellArgs *args, ShellOutput *out) {
+    if (!search_index_active()) {
+        shell_output_error(out, "search: no index (start the engine with --index DIR)\n");
+        return SHELL_ERROR;
+    }
+    long count = SEARCH_DEFAULT_HITS;
+    int first = 1;
+    if (first < args->argc && strcmp(args->argv[first], "-n") == 0) {
+        char *end = NULL;
+        count = first + 1 < args->argc ? strtol(args->argv[first + 1], &end, 10) : 0;
+        if (end == NULL || *end != '\0' || count < 1 || count > SEARCH_MAX_HITS) {
+            shell_output_error(out, "search: invalid number of results (1-%d)\n", SEARCH_MAX_HITS);
+            return SHELL_ERROR;
+        }
+        first += 2;
+    }
+
+    char query[SHELL_COMMAND_SIZE];
+    size_t length = 0;
+    for (int i = first; i < args->argc; ++i) {
+        int written = snprintf(query + length, sizeof(query) - length, "%s%s", length > 0 ? " " : "", args->argv[i]);
+        if (written < 0 || (size_t)written >= sizeof(query) - length) {
+            break;
+        }
+        length += (size_t)written;
+    }
+    if (length == 0) {
+        shell_output_error(out, "search: missing query\n");
+        return SHELL_ERROR;
+    }
+
+    SearchHit *hits = (SearchHit *)malloc((size_t)count * sizeof(SearchHit));
+    if (hits == NULL) {
+        shell_output_error(out, "search: out of memory\n");
+        return SHELL_ERROR;
+    }
+    size_t found = search_query(query, hits, (size_t)count);
+    for (size_t i = 0; i < found; ++i) {
+        if (hits[i].line > 0) {
+            shell_output_printf(out, "%s:%u: %s\n", hits[i].path, hits[i].line, hits[i].snippet);
+        } else {
+            shell_output_printf(out, "%s\n", hits[i].path);
+        }
+    }
+    free(hits);
+    // Like grep, finding nothing is a failure
+    return found > 0 ? SHELL_OK : SHELL_ERROR;
+}
+
+static int command_unset(const ShellArgs *args, ShellOutput *out) {
+    (void)out;
+    ShellSession *session = args->session;
+    for (int i = 1; session != NULL && i < args->argc; ++i) {
+        int index = find_variable(session, args->argv[i], strlen(args->argv[i]));
+        if (index >= 0) {
+            free(session->variables[index]);
+            session->variables[index] = session->variables[--session->variable_count];
+        }
+    }
+    return SHELL_OK;
+}
+
+// Resolves like shell_resolve_path(); with `clamp`, ".." at the root stays there as it does for cd
+static bool resolve_path(const ShellArgs *args, const char *path, bool clamp, char *resolved, size_t size) {
+    const char *parts[2] = {args->session != NULL && path[0] != '/' ? args->session->cwd : "", path};
+    size_t length = 0;
+    for (int i = 0; i < 2; ++i) {
+        const char *cursor = parts[i];
+        while (*cursor != '\0') {
+            while (*cursor == '/') {
+                ++cursor;
+            }
+            size_t component = strcspn(cursor, "/");
+            if (component == 0 || (component == 1 && cursor[0] == '.')) {
+                cursor += component;
+                continue;
+            }
+            if (component == 2 && cursor[0] == '.' && cursor[1] == '.') {
+                if (length == 0 && !clamp) {
+                    return false;
+                }
+                char *slash = memrchr(resolved, '/', length);
+                length = slash != NULL ? (size_t)(slash - resolved) : 0;
+                cursor += component;
+                continue;
+            }
+            size_t needed = length + (length > 0 ? 1 : 0) + component;
+            if (needed >= size) {
+                return false;
+            }
+            if (length > 0) {
+                resolved[length++] = '/';
+            }
+            memcpy(resolved + length, cursor, component);
+            length += component;
+            cursor += component;
+        }
+    }
+    if (length == 0) {
+        if (size < 2) {
+            return false;
+        }
+        resolved[length++] = '.';
+    }
+    resolved[length] = '\0';
+    return true;
+}
+
+static const ShellCommand *find_command(const char *name) {
+    return bsearch(name, commands, sizeof(commands) / sizeof(commands[0]), sizeof(commands[0]), compare_command);
+}
+
+static int compare_command(const void *key, const void *element) {
+    return strcmp((const char *)key, ((const ShellCommand *)element)->name);
+}
+
+static void record_history(ShellSession *session, const char *line) {
+    if (session == NULL) {
+        return;
+    }
+    history_append(line);
+    char **slot = &session->history[session->history_count % SHELL_HISTORY_SIZE];
+    char *copy = strdup(line);
+    if (copy == NULL) {
+        return;
+    }
+    free(*slot);
+    *slot = copy;
+    ++session->history_count;
+}
+
+static int find_variable(const ShellSession *session, const char *name, size_t length) {
+    for (int i = 0; i < session->variable_count; ++i) {
+        const char *entry = session->variables[i];
+        if (strncmp(entry, name, length) == 0 && entry[length] == '=') {
+            return i;
         }
-        
-        pclose(fp);
-        return 0;
     }
-    
-    // Default: command not found
-    snprintf(output, output_size, "%s: command not found\n", command);
     return -1;
 }
 
+// Unset variables expand to nothing, as in sh
+static const char *variable_value(const ShellSession *session, const char *name, size_t length) {
+    int index = session != NULL ? find_variable(session, name, length) : -1;
+    return index >= 0 ? session->variables[index] + length + 1 : "";
+}
+
+static int set_variable(ShellSession *session, const char *assignment) {
+    size_t name_length = strcspn(assignment, "=");
+    int index = find_variable(session, assignment, name_length);
+    if (index < 0 && session->variable_count == SHELL_MAX_VARIABLES) {
+        return -1;
+    }
+    char *copy = strdup(assignment);
+    if (copy == NULL) {
+        return -1;
+    }
+    if (index >= 0) {
+        free(session->variables[index]);
+        session->variables[index] = copy;
+    } else {
+        session->variables[session->variable_count++] = copy;
+    }
+    return 0;
+}
+
+static bool is_variable_name(const char *name, size_t length) {
+    if (length == 0 || isdigit((unsigned char)name[0])) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shell statuses as process exit codes, which is what $? reports
+static int exit_code(int status) {
+    return status == SHELL_OK ? 0 : status == SHELL_NOT_FOUND ? 127 : 1;
+}
+
+// Operators are recognised only outside quotes; words are unquoted into scratch
+static void next_token(ShellLexer *lexer, ShellToken *token) {
+    const char *read = skip_leading_whitespace(lexer->cursor);
+    token->start = read;
+    token->word = NULL;
+
+    static const struct {
+        const char *text;
+        ShellTokenType type;
+    } operators[] = {
+        {"||", TOKEN_OR}, {"&&", TOKEN_AND}, {">>", TOKEN_APPEND}, {"|", TOKEN_PIPE},
+        {";", TOKEN_SEQUENCE}, {">", TOKEN_WRITE}, {"<", TOKEN_READ}, {"&", TOKEN_INVALID},
+    };
+    if (*read == '\0') {
+        token->type = TOKEN_END;
+        token->end = read;
+        lexer->cursor = read;
+        return;
+    }
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i) {
+        size_t length = strlen(operators[i].text);
+        if (strncmp(read, operators[i].text, length) == 0) {
+            token->type = operators[i].type;
+            token->end = read + length;
+            lexer->cursor = token->end;
+            return;
+        }
+    }
+
+    char *write = lexer->scratch;
+    char quote = '\0';
+    while (*read != '\0' && (quote != '\0' || (!isspace((unsigned char)*read) && strchr("|&;<>", *read) == NULL))) {
+        if (quote == '\0' && (*read == '\'' || *read == '"')) {
+            quote = *read++;
+        } else if (quote != '\0' && *read == quote) {
+            quote = '\0';
+            ++read;
+        } else if (quote != '\'' && *read == '$') {
+            read = expand_variable(lexer, read, &write);
+        } else if (quote != '\'' && *read == '\\' && read[1] != '\0') {
+            ++read;
+            scratch_append(lexer, &write, read++, 1);
+        } else {
+            scratch_append(lexer, &write, read++, 1);
+        }
+    }
+    scratch_append(lexer, &write, "", 1);
+    token->type = quote != '\0' || lexer->overflow ? TOKEN_INVALID : TOKEN_WORD;
+    token->word = lexer->scratch;
+    token->end = read;
+    lexer->scratch = write;
+    lexer->cursor = read;
+}
+
+// Expands $NAME, ${NAME} or $? at `read`; a '$' starting none of those is literal
+static const char *expand_variable(ShellLexer *lexer, const char *read, char **write) {
+    const char *name = read + 1;
+    if (*name == '?') {
+        char status[16];
+        int length = snprintf(status, sizeof(status), "%d", lexer->session != NULL ? lexer->session->last_status : 0);
+        scratch_append(lexer, write, status, (size_t)length);
+        return name + 1;
+    }
+    bool braced = *name == '{';
+    name += braced ? 1 : 0;
+    size_t length = 0;
+    while (isalnum((unsigned char)name[length]) || name[length] == '_') {
+        ++length;
+    }
+    if (!is_variable_name(name, length) || (braced && name[length] != '}')) {
+        scratch_append(lexer, write, read, 1);
+        return read + 1;
+    }
+    const char *value = variable_value(lexer->session, name, length);
+    scratch_append(lexer, write, value, strlen(value));
+    return name + length + (braced ? 1 : 0);
+}
+
+// Expansions can outgrow the scratch estimate; running out fails the line
+static bool scratch_append(ShellLexer *lexer, char **write, const char *data, size_t length) {
+    if (lexer->overflow || length > (size_t)(lexer->scratch_end - *write)) {
+        lexer->overflow = true;
+        return false;
+    }
+    memcpy(*write, data, length);
+    *write += length;
+    return true;
+}
+
+// Parses up to the end of the next pipeline; its last stage's connector is
+// the list operator that follows it, or TOKEN_END
+static int parse_pipeline(ShellLexer *lexer, ShellStage *stages, int *stage_count, ShellOutput *out) {
+    int count = 0;
+    ShellStage *stage = NULL;
+    const char *arguments_start = NULL;
+    const char *arguments_end = NULL;
+    ShellToken token;
+
+    for (;;) {
+        next_token(lexer, &token);
+        if (stage == NULL && token.type != TOKEN_END) {
+            if (count == SHELL_MAX_STAGES) {
+                shell_output_error(out, "shell: too many commands\n");
+                return -1;
+            }
+            stage = &stages[count++];
+            memset(stage, 0, sizeof(*stage));
+            arguments_start = NULL;
+            arguments_end = NULL;
+        }
+
+        switch (token.type) {
+        case TOKEN_WORD:
+            if (stage->args.argc == SHELL_MAX_ARGS) {
+                shell_output_error(out, "shell: too many arguments\n");
+                return -1;
+            }
+            if (stage->args.argc > 0) {
+                arguments_start = arguments_start != NULL ? arguments_start : token.start;
+                arguments_end = token.end;
+            }
+            stage->args.argv[stage->args.argc++] = token.word;
+            continue;
+        case TOKEN_READ:
+        case TOKEN_WRITE:
+        case TOKEN_APPEND: {
+            ShellToken target;
+            next_token(lexer, &target);
+            if (target.type != TOKEN_WORD) {
+                token = target;
+                break;
+            }
+            if (token.type == TOKEN_READ) {
+                stage->input_path = target.word;
+            } else {
+                stage->output_path = target.word;
+                stage->append = token.type == TOKEN_APPEND;
+            }
+            continue;
+        }
+        case TOKEN_PIPE:
+        case TOKEN_AND:
+        case TOKEN_OR:
+        case TOKEN_SEQUENCE:
+        case TOKEN_END:
+            if (stage == NULL || stage->args.argc == 0) {
+                break;
+            }
+            // Free-text commands see the raw words after their name
+            size_t length = arguments_start != NULL ? (size_t)(arguments_end - arguments_start) : 0;
+            char *arguments = lexer->scratch;
+            if (!scratch_append(lexer, &lexer->scratch, arguments_start != NULL ? arguments_start : "", length) ||
+                !scratch_append(lexer, &lexer->scratch, "", 1)) {
+                shell_output_error(out, "shell: command too long\n");
+                return -1;
+            }
+            stage->args.arguments = arguments;
+            stage->connector = token.type;
+            stage = NULL;
+            if (token.type == TOKEN_PIPE) {
+                continue;
+            }
+            if (token.type == TOKEN_SEQUENCE) {
+                // A trailing ';' ends the line without starting a command
+                ShellLexer peek = *lexer;
+                ShellToken following;
+                next_token(&peek, &following);
+                if (following.type == TOKEN_END) {
+                    stages[count - 1].connector = TOKEN_END;
+                }
+            }
+            *stage_count = count;
+            return 0;
+        case TOKEN_INVALID:
+            break;
+        }
+
+        if (lexer->overflow) {
+            shell_output_error(out, "shell: command too long\n");
+        } else if (token.type == TOKEN_END) {
+            shell_output_error(out, "shell: syntax error near end of line\n");
+        } else {
+            shell_output_error(out, "shell: syntax error near '%.*s'\n", (int)(token.end - token.start), token.start);
+        }
+        return -1;
+    }
+}
+
+static int run_pipeline(ShellStage *stages, int count, ShellOutput *out) {
+    // Stages write into two pipe buffers alternately and read the other
+    // one in place, so data moves between builtins without copies
+    ShellOutput pipes[2];
+    for (int i = 0; i < 2; ++i) {
+        pipes[i] = (ShellOutput){.growable = true, .errors = out};
+    }
+    VfsView mapped = {"", 0, NULL, NULL};
+    const char *input = NULL;
+    size_t input_size = 0;
+    int status = SHELL_OK;
+
+    for (int i = 0; i < count; ++i) {
+        ShellStage *stage = &stages[i];
+        bool last = i == count - 1;
+        VfsView redirected = {"", 0, NULL, NULL};
+        if (stage->input_path != NULL) {
+            if (map_path(stage, stage->input_path, &redirected) != 0) {
+                shell_output_error(out, "shell: %s: No such file or directory\n", stage->input_path);
+                status = SHELL_ERROR;
+                input = "";
+                input_size = 0;
+                vfs_release(&mapped);
+                continue;
+            }
+            input = redirected.data;
+            input_size = redirected.size;
+        }
+
+        // "cat FILE | ..." just hands the next stage the file mapping
+        if (!last && is_plain_cat(stage)) {
+            VfsView view;
+            if (map_path(stage, stage->args.argv[1], &view) == 0) {
+                vfs_release(&redirected);
+                vfs_release(&mapped);
+                mapped = view;
+                input = mapped.data;
+                input_size = mapped.size;
+                status = SHELL_OK;
+                continue;
+            }
+        }
+
+        ShellOutput *target = out;
+        if (!last || stage->output_path != NULL) {
+            target = &pipes[i % 2];
+            target->length = 0;
+            target->truncated = false;
+            if (target->data != NULL) {
+                target->data[0] = '\0';
+            }
+        }
+        stage->args.input = input;
+        stage->args.input_size = input_size;
+        status = run_stage(stage, target);
+        vfs_release(&redirected);
+        vfs_release(&mapped);
+
+        if (stage->output_path != NULL) {
+            if (write_redirect(stage, target, out) != 0) {
+                status = SHELL_ERROR;
+            }
+            // Like a redirected shell stage, the next one reads nothing
+            input = "";
+            input_size = 0;
+        } else {
+            input = target->data != NULL ? target->data : "";
+            input_size = target->length;
+        }
+        if (target->truncated && target != out) {
+            shell_output_error(out, "shell: pipe buffer limit reached, output truncated\n");
+        }
+    }
+
+    vfs_release(&mapped);
+    free(pipes[0].data);
+    free(pipes[1].data);
+    return status;
+}
+
+static int run_stage(ShellStage *stage, ShellOutput *out) {
+    const ShellCommand *entry = find_command(stage->args.argv[0]);
+    if (entry == NULL) {
+        shell_output_error(out, "%s: command not found\n", stage->args.argv[0]);
+        return SHELL_NOT_FOUND;
+    }
+    return entry->run(&stage->args, out);
+}
+
+static bool is_plain_cat(const ShellStage *stage) {
+    return stage->args.argc == 2 && strcmp(stage->args.argv[0], "cat") == 0 && stage->output_path == NULL &&
+           stage->input_path == NULL;
+}
+
+static int map_path(const ShellStage *stage, const char *path, VfsView *view) {
+    char relative[SHELL_PATH_SIZE];
+    if (!shell_resolve_path(&stage->args, path, relative, sizeof(relative))) {
+        return -1;
+    }
+    return vfs_map(relative, view);
+}
+
+static int write_redirect(const ShellStage *stage, const ShellOutput *buffer, ShellOutput *out) {
+    const char *data = buffer->data != NULL ? buffer->data : "";
+    char relative[SHELL_PATH_SIZE];
+    char full_path[SHELL_PATH_SIZE];
+    struct stat st;
+    if (!shell_resolve_path(&stage->args, stage->output_path, relative, sizeof(relative)) ||
+        vfs_resolve(relative, full_path, sizeof(full_path)) != 0) {
+        shell_output_error(out, "shell: %s: Invalid path\n", stage->output_path);
+        return -1;
+    }
+    if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        shell_output_error(out, "shell: %s: Is a directory\n", stage->output_path);
+        return -1;
+    }
+
+    int status;
+    if (stage->append && access(full_path, F_OK) == 0) {
+        status = buffer->length > 0 ? vfs_append(relative, data, buffer->length) : 0;
+    } else {
+        VfsWriter writer;
+        status = vfs_writer_open(&writer, relative);
+        if (status == 0) {
+            vfs_writer_write(&writer, data, buffer->length);
+            status = vfs_writer_close(&writer);
+        }
+    }
+    if (status != 0) {
+        shell_output_error(out, "shell: %s: cannot write file\n", stage->output_path);
+    }
+    return status;
+}
+
+// Fills the chunk buffer and hands it to the sink each time it is full;
+// writes of a chunk or more go to the sink straight from the caller's memory
+static void output_stream(ShellOutput *out, const char *data, size_t length) {
+    size_t capacity = out->size - 1;
+    if (out->length + length > capacity) {
+        output_flush(out);
+        while (length >= capacity && !out->truncated) {
+            output_emit(out, data, capacity);
+            data += capacity;
+            length -= capacity;
+        }
+    }
+    if (out->truncated) {
+        return;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    out->data[out->length] = '\0';
+}
+
+static void output_flush(ShellOutput *out) {
+    if (out->length > 0) {
+        output_emit(out, out->data, out->length);
+        out->length = 0;
+        out->data[0] = '\0';
+    }
+}
+
+// A sink that refuses data cancels the rest of the output
+static void output_emit(ShellOutput *out, const char *data, size_t length) {
+    if (!out->truncated && out->sink(out->sink_context, data, length) != 0) {
+        out->truncated = true;
+    }
+}
+
+// Makes room for `length` more bytes plus the terminator; false if it cannot
+static bool output_reserve(ShellOutput *out, size_t length) {
+    if (out->length + length < out->size) {
+        return true;
+    }
+    if (!out->growable || out->length + length >= SHELL_PIPE_LIMIT) {
+        return false;
+    }
+    size_t size = out->size > 0 ? out->size : 4096;
+    while (size <= out->length + length) {
+        size *= 2;
+    }
+    size = size < SHELL_PIPE_LIMIT ? size : SHELL_PIPE_LIMIT;
+    char *data = realloc(out->data, size);
+    if (data == NULL) {
+        return false;
+    }
+    out->data = data;
+    out->size = size;
+    return true;
+}
+
 static const char *skip_leading_whitespace(const char *input) {
     while (*input != '\0' && isspace((unsigned char)*input)) {
         ++input;
@@ -98,4 +1066,3 @@ static void trim_trailing_whitespace(char *text) {
         text[--length] = '\0';
     }
 }
-
@@ -1,8 +1,115 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+// shell_execute_command return codes; any other negative value is a failure
+#define SHELL_OK 0
+#define SHELL_ERROR -1
+#define SHELL_NOT_FOUND -2
+
+#define SHELL_MAX_ARGS 64
+#define SHELL_MAX_STAGES 32
+#define SHELL_CHUNK_SIZE 16384
+#define SHELL_PATH_SIZE 512
+
+/**
+ * Per-user shell state: working directory (relative to the project root),
+ * environment variables and command history. Commands run without a
+ * session start at the root with an empty environment. A session must
+ * only be used by one thread at a time.
+ */
+typedef struct ShellSession ShellSession;
+
+/**
+ * Receives streamed output in chunks of at most SHELL_CHUNK_SIZE bytes
+ * while a command runs. `data` is only valid during the call. Returning
+ * non-zero cancels delivery: the rest of the command's output is dropped.
+ */
+typedef int (*ShellSinkFn)(void *context, const char *data, size_t length);
+
+/**
+ * Output buffer shared by every command. Always NUL-terminated. Fixed
+ * buffers drop writes past the end and set `truncated`; growable ones
+ * (pipe buffers between pipeline stages) are heap-allocated and grow as
+ * needed; streaming ones hand each full chunk to `sink` and reuse the
+ * buffer, so memory stays bounded however much a command prints.
+ * Diagnostics go to `errors` when set, so they reach the terminal instead
+ * of flowing down a pipe or into a redirected file.
+ */
+typedef struct ShellOutput {
+    char *data;
+    size_t size;
+    size_t length;
+    bool truncated;
+    bool growable;
+    struct ShellOutput *errors;
+    ShellSinkFn sink;
+    void *sink_context;
+} ShellOutput;
+
+/**
+ * A parsed command line. argv[0] is the command name; words are split on
+ * whitespace, with single and double quotes grouping. `arguments` is the
+ * raw, unsplit text after the command name for commands that take free
+ * text (calc expressions, pkg subcommands). `input` is standard input
+ * when the command reads a pipe or a `<` redirection, NULL otherwise; it
+ * borrows the previous stage's buffer or a file mapping, never a copy.
+ * `session` is the calling session, or NULL.
+ */
+typedef struct {
+    int argc;
+    char *argv[SHELL_MAX_ARGS];
+    const char *arguments;
+    const char *input;
+    size_t input_size;
+    ShellSession *session;
+} ShellArgs;
+
+typedef int (*ShellCommandFn)(const ShellArgs *args, ShellOutput *out);
+
 void shell_init(void);
+/**
+ * Allows calc, calendar and pkg without arguments to start their apps,
+ * which read the terminal. Off by default: a daemon's commands get a
+ * usage error instead.
+ */
+void shell_set_interactive(bool interactive);
+/**
+ * Runs a command line: pipelines of builtins joined by `|`, with `<`, `>`
+ * and `>>` redirection, sequenced by `;`, `&&` and `||`. Returns the
+ * status of the last pipeline that ran.
+ */
 int shell_execute_command(const char *command, char *output, size_t output_size);
 
-#endif // SHELL_H
+/**
+ * Like shell_execute_command(), but output is delivered to `sink` as it is
+ * produced instead of being collected, so nothing is truncated and first
+ * output arrives before the command finishes.
+ */
+int shell_execute_stream(const char *command, ShellSinkFn sink, void *context);
+
+ShellSession *shell_session_create(void);
+void shell_session_destroy(ShellSession *session);
+const char *shell_session_cwd(const ShellSession *session);
+
+// Streams like shell_execute_stream(), in the session's directory and environment
+int shell_session_execute(ShellSession *session, const char *command, ShellSinkFn sink, void *context);
+
+// Command names in sorted order; NULL past the last one
+const char *shell_command_name(size_t index);
 
+/**
+ * Resolves `path` against the command's working directory into a path
+ * relative to the project root ("." for the root itself), folding "." and
+ * ".." components; a leading "/" means the project root. Returns false if
+ * the path would leave the root or does not fit in `size`.
+ */
+bool shell_resolve_path(const ShellArgs *args, const char *path, char *resolved, size_t size);
+
+void shell_output_write(ShellOutput *out, const void *data, size_t length);
+void shell_output_printf(ShellOutput *out, const char *format, ...);
+void shell_output_error(ShellOutput *out, const char *format, ...);
+
+#endif // SHELL_H
@@ -0,0 +1,701 @@
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dircache.h"
+#include "trigram.h"
+
+#define MAX_INDEXED_SIZE (8 * 1024 * 1024)
+#define BINARY_PROBE_SIZE 4096
+#define INITIAL_TABLE_CAPACITY 4096
+#define INITIAL_ARRAY_CAPACITY 256
+#define INITIAL_POSTINGS_SIZE 8
+#define COMPACT_MIN_DEAD 65536
+#define SLOT_EMPTY 0u
+#define DOCUMENT_REMOVED UINT32_MAX
+#define TRIGRAM_KEY_MASK 0xFFFFFFu
+#define VARINT_MAX_BYTES 5
+
+typedef enum {
+    DOCUMENT_TEXT = 0,
+    DOCUMENT_BINARY = 1,
+    DOCUMENT_LARGE = 2  // too big to index; always read
+} DocumentKind;
+
+// Ids only grow: a rewritten file gets a new id and the old one stays dead
+// until compaction renumbers the live documents
+typedef struct {
+    char *path;  // full path
+    uint64_t hash;
+    long long size;
+    long long mtime_ms;
+    uint32_t distinct;  // trigrams, each holding one posting for it
+    unsigned long walk;  // last trigram_select() that listed it
+    DocumentKind kind;
+    bool live;
+} Document;
+
+typedef struct {
+    uint32_t key;
+    uint32_t count;
+    uint32_t last;  // document of the newest posting
+    uint32_t length;  // bytes of `postings` in use
+    uint32_t capacity;
+    unsigned char *postings;  // varint gaps between increasing document ids
+} Trigram;
+
+// Open addressing over entry index + 1, at most half full
+typedef struct {
+    uint32_t *slots;
+    size_t capacity;
+    size_t used;
+} Table;
+
+typedef struct {
+    TrigramFile *files;
+    size_t count;
+    size_t capacity;
+    bool failed;
+} FileList;
+
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Document *documents = NULL;
+static size_t document_count = 0;
+static size_t document_capacity = 0;
+static Table document_table = {0};
+static Trigram *trigrams = NULL;
+static size_t trigram_count = 0;
+static size_t trigram_capacity = 0;
+static Table trigram_table = {0};
+static size_t total_postings = 0;
+static size_t dead_postings = 0;
+static unsigned long walk_count = 0;
+
+static void collect_files(const DirListing *listing, char *path, size_t length, size_t capacity, FileList *list);
+static void append_file(FileList *list, const char *path, const DirCacheEntry *entry);
+static void sweep_documents(const char *directory, size_t length, unsigned long walk);
+static unsigned char *match_documents(const TrigramQuery *query);
+static size_t decode_postings(const Trigram *trigram, uint32_t *ids);
+static size_t intersect_postings(uint32_t *ids, size_t count, const Trigram *trigram);
+static size_t extract_trigrams(const char *data, size_t size, uint32_t **keys);
+static bool add_document(const TrigramFile *file, DocumentKind kind, const uint32_t *keys, size_t key_count);
+static bool append_posting(Trigram *trigram, uint32_t document);
+static uint32_t encode_gap(unsigned char *out, uint32_t gap);
+static void retire_document(uint32_t id);
+static void maybe_compact(void);
+static void compact(void);
+static int find_document(const char *path);
+static size_t document_slot(const char *path, size_t length, uint64_t hash);
+static Trigram *intern_trigram(uint32_t key);
+static const Trigram *find_trigram(uint32_t key);
+static size_t trigram_slot(uint32_t key);
+static bool rebuild_document_table(size_t capacity);
+static bool rebuild_trigram_table(size_t capacity);
+static void table_insert(Table *table, uint64_t hash, uint32_t value);
+static bool reserve_array(void **items, size_t *capacity, size_t needed, size_t item_size);
+static uint64_t hash_bytes(const char *data, size_t length);
+static uint64_t hash_key(uint32_t key);
+
+void trigram_query_init(TrigramQuery *query) {
+    query->branch_count = 1;
+    query->counts[0] = 0;
+    query->match_all = false;
+}
+
+void trigram_query_branch(TrigramQuery *query) {
+    if (query->branch_count == TRIGRAM_MAX_BRANCHES) {
+        query->match_all = true;
+        return;
+    }
+    query->counts[query->branch_count++] = 0;
+}
+
+void trigram_query_literal(TrigramQuery *query, const char *text, size_t length) {
+    size_t branch = query->branch_count - 1;
+    uint32_t *keys = query->trigrams[branch];
+    for (size_t i = 0; i + 3 <= length && query->counts[branch] < TRIGRAM_MAX_PER_BRANCH; ++i) {
+        uint32_t key = (uint32_t)tolower((unsigned char)text[i]) << 16 |
+                       (uint32_t)tolower((unsigned char)text[i + 1]) << 8 |
+                       (uint32_t)tolower((unsigned char)text[i + 2]);
+        bool known = false;
+        for (size_t k = 0; k < query->counts[branch] && !known; ++k) {
+            known = keys[k] == key;
+        }
+        if (!known) {
+            keys[query->counts[branch]++] = key;
+        }
+    }
+}
+
+int trigram_select(const char *directory, const TrigramQuery *query, TrigramFile **files, size_t *count) {
+    char path[PATH_MAX];
+    size_t length = strlen(directory);
+    while (length > 1 && directory[length - 1] == '/') {
+        --length;
+    }
+    if (length >= sizeof(path)) {
+        return -1;
+    }
+    memcpy(path, directory, length);
+    path[length] = '\0';
+    const DirListing *listing = dircache_acquire(path);
+    if (listing == NULL) {
+        return -1;
+    }
+    FileList list = {0};
+    collect_files(listing, path, length, sizeof(path), &list);
+    dircache_release(listing);
+    if (list.failed) {
+        trigram_files_free(list.files, list.count);
+        return -1;
+    }
+
+    // Bringing the tree up to date, sweeping out what is gone and matching
+    // happen in one critical section, so ids stay put and concurrent walks
+    // of overlapping trees cannot sweep each other's files
+    pthread_mutex_lock(&index_mutex);
+    unsigned long walk = ++walk_count;
+    int *ids = (int *)malloc((list.count > 0 ? list.count : 1) * sizeof(int));
+    for (size_t i = 0; i < list.count && ids != NULL; ++i) {
+        TrigramFile *file = &list.files[i];
+        int id = find_document(file->path);
+        if (id >= 0) {
+            Document *document = &documents[id];
+            document->walk = walk;
+            file->stale = document->size != file->size || document->mtime_ms != file->mtime_ms;
+        } else {
+            file->stale = true;
+        }
+        ids[i] = id;
+    }
+    sweep_documents(path, length, walk);
+    unsigned char *matches = ids != NULL ? match_documents(query) : NULL;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        TrigramFile *file = &list.files[i];
+        bool keep = true;
+        if (ids != NULL && !file->stale) {
+            const Document *document = &documents[ids[i]];
+            keep = document->kind == DOCUMENT_LARGE ||
+                   (document->kind == DOCUMENT_TEXT && (matches == NULL || matches[ids[i]]));
+        }
+        if (keep) {
+            list.files[kept++] = *file;
+        } else {
+            free(file->path);
+        }
+    }
+    maybe_compact();
+    pthread_mutex_unlock(&index_mutex);
+    free(matches);
+    free(ids);
+
+    *files = list.files;
+    *count = kept;
+    return 0;
+}
+
+void trigram_files_free(TrigramFile *files, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        free(files[i].path);
+    }
+    free(files);
+}
+
+// Trigrams are gathered outside the lock; only adding the postings holds it
+bool trigram_index_file(const TrigramFile *file, const char *data, size_t size) {
+    DocumentKind kind = DOCUMENT_TEXT;
+    if (size > MAX_INDEXED_SIZE) {
+        kind = DOCUMENT_LARGE;
+    } else if (memchr(data, '\0', size < BINARY_PROBE_SIZE ? size : BINARY_PROBE_SIZE) != NULL) {
+        kind = DOCUMENT_BINARY;
+    }
+    uint32_t *keys = NULL;
+    size_t key_count = 0;
+    if (kind == DOCUMENT_TEXT && size >= 3) {
+        key_count = extract_trigrams(data, size, &keys);
+        // Without its trigrams the file has to be read every time
+        kind = keys != NULL ? DOCUMENT_TEXT : DOCUMENT_LARGE;
+    }
+
+    pthread_mutex_lock(&index_mutex);
+    int id = find_document(file->path);
+    if (id >= 0) {
+        retire_document((uint32_t)id);
+    }
+    add_document(file, kind, keys, key_count);
+    maybe_compact();
+    pthread_mutex_unlock(&index_mutex);
+    free(keys);
+    return kind != DOCUMENT_BINARY;
+}
+
+// Appends the files below `path`, which holds `length` bytes and is
+// extended in place for each entry
+static void collect_files(const DirListing *listing, char *path, size_t length, size_t capacity, FileList *list) {
+    for (size_t i = 0; i < listing->count && !list->failed; ++i) {
+        const DirCacheEntry *entry = &listing->entries[i];
+        size_t name_length = strlen(entry->name);
+        if (entry->name[0] == '.' || length + 1 + name_length >= capacity) {
+            continue;
+        }
+        path[length] = '/';
+        memcpy(path + length + 1, entry->name, name_length + 1);
+        if (entry->type == DIRCACHE_ENTRY_DIRECTORY) {
+            const DirListing *child = dircache_acquire(path);
+            if (child != NULL) {
+                collect_files(child, path, length + 1 + name_length, capacity, list);
+                dircache_release(child);
+            }
+        } else if (entry->type == DIRCACHE_ENTRY_FILE) {
+            append_file(list, path, entry);
+        }
+    }
+    path[length] = '\0';
+}
+
+static void append_file(FileList *list, const char *path, const DirCacheEntry *entry) {
+    char *copy = strdup(path);
+    if (copy == NULL || !reserve_array((void **)&list->files, &list->capacity, list->count + 1, sizeof(TrigramFile))) {
+        free(copy);
+        list->failed = true;
+        return;
+    }
+    list->files[list->count++] = (TrigramFile){copy, entry->size, entry->mtime_ms, false};
+}
+
+// Retires the documents below `directory` that the walk did not list
+static void sweep_documents(const char *directory, size_t length, unsigned long walk) {
+    for (size_t i = 0; i < document_count; ++i) {
+        const Document *document = &documents[i];
+        if (document->live && document->walk != walk && strncmp(document->path, directory, length) == 0 &&
+            (length == 1 || document->path[length] == '/')) {
+            retire_document((uint32_t)i);
+        }
+    }
+}
+
+// Flags the documents holding every trigram of some branch, or returns
+// NULL when the query cannot rule any document out
+static unsigned char *match_documents(const TrigramQuery *query) {
+    if (query->match_all) {
+        return NULL;
+    }
+    for (size_t b = 0; b < query->branch_count; ++b) {
+        if (query->counts[b] == 0) {
+            return NULL;
+        }
+    }
+    unsigned char *matches = (unsigned char *)calloc(document_count > 0 ? document_count : 1, 1);
+    if (matches == NULL) {
+        return NULL;
+    }
+    for (size_t b = 0; b < query->branch_count; ++b) {
+        const Trigram *lists[TRIGRAM_MAX_PER_BRANCH];
+        size_t list_count = 0;
+        bool possible = true;
+        for (size_t k = 0; k < query->counts[b] && possible; ++k) {
+            const Trigram *trigram = find_trigram(query->trigrams[b][k]);
+            possible = trigram != NULL && trigram->count > 0;
+            if (possible) {
+                // Rarest first, so the running intersection starts small
+                size_t at = list_count++;
+                while (at > 0 && lists[at - 1]->count > trigram->count) {
+                    lists[at] = lists[at - 1];
+                    --at;
+                }
+                lists[at] = trigram;
+            }
+        }
+        if (!possible) {
+            continue;
+        }
+        uint32_t *ids = (uint32_t *)malloc(lists[0]->count * sizeof(uint32_t));
+        if (ids == NULL) {
+            free(matches);
+            return NULL;
+        }
+        size_t count = decode_postings(lists[0], ids);
+        for (size_t k = 1; k < list_count && count > 0; ++k) {
+            count = intersect_postings(ids, count, lists[k]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            matches[ids[i]] = 1;
+        }
+        free(ids);
+    }
+    return matches;
+}
+
+static size_t decode_postings(const Trigram *trigram, uint32_t *ids) {
+    const unsigned char *cursor = trigram->postings;
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < trigram->count; ++i) {
+        uint32_t gap = 0;
+        for (int shift = 0;; shift += 7) {
+            unsigned char byte = *cursor++;
+            gap |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        id += gap;
+        ids[i] = id;
+    }
+    return trigram->count;
+}
+
+// Keeps the ids that also appear in `trigram`, merging the two sorted lists
+static size_t intersect_postings(uint32_t *ids, size_t count, const Trigram *trigram) {
+    const unsigned char *cursor = trigram->postings;
+    uint32_t id = 0;
+    size_t read = 0;
+    size_t kept = 0;
+    for (uint32_t i = 0; i < trigram->count && read < count; ++i) {
+        uint32_t gap = 0;
+        for (int shift = 0;; shift += 7) {
+            unsigned char byte = *cursor++;
+            gap |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        id += gap;
+        while (read < count && ids[read] < id) {
+            ++read;
+        }
+        if (read < count && ids[read] == id) {
+            ids[kept++] = id;
+            ++read;
+        }
+    }
+    return kept;
+}
+
+// The distinct case-folded trigrams of `data`, sorted, leaving out those
+// spanning a line break: grep matches within lines, so no query has them
+static size_t extract_trigrams(const char *data, size_t size, uint32_t **keys) {
+    uint32_t *values = (uint32_t *)malloc(2 * (size - 2) * sizeof(uint32_t));
+    if (values == NULL) {
+        *keys = NULL;
+        return 0;
+    }
+    uint32_t *scratch = values + (size - 2);
+    size_t count = 0;
+    uint32_t key = 0;
+    size_t run = 0;  // bytes since the last line break
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\n') {
+            run = 0;
+            continue;
+        }
+        key = (key << 8 | (uint32_t)tolower(c)) & TRIGRAM_KEY_MASK;
+        if (++run >= 3) {
+            values[count++] = key;
+        }
+    }
+
+    // Radix sort a byte at a time, then drop repeats
+    for (int shift = 0; shift < 24; shift += 8) {
+        size_t offsets[257] = {0};
+        for (size_t i = 0; i < count; ++i) {
+            ++offsets[((values[i] >> shift) & 0xFF) + 1];
+        }
+        for (size_t b = 1; b < 257; ++b) {
+            offsets[b] += offsets[b - 1];
+        }
+        for (size_t i = 0; i < count; ++i) {
+            scratch[offsets[(values[i] >> shift) & 0xFF]++] = values[i];
+        }
+        uint32_t *swap = values;
+        values = scratch;
+        scratch = swap;
+    }
+    // Three passes leave the sorted keys in the upper half; the distinct
+    // ones go to the start of the block, which the caller frees
+    uint32_t *block = scratch;
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (distinct == 0 || values[i] != block[distinct - 1]) {
+            block[distinct++] = values[i];
+        }
+    }
+    *keys = block;
+    return distinct;
+}
+
+// Called with the index locked
+static bool add_document(const TrigramFile *file, DocumentKind kind, const uint32_t *keys, size_t key_count) {
+    size_t path_length = strlen(file->path);
+    if (document_count >= UINT32_MAX - 1 ||
+        !reserve_array((void **)&documents, &document_capacity, document_count + 1, sizeof(Document)) ||
+        ((document_table.used + 1) * 2 > document_table.capacity &&
+         !rebuild_document_table(document_table.capacity == 0 ? INITIAL_TABLE_CAPACITY : document_table.capacity * 2))) {
+        return false;
+    }
+    char *path = strdup(file->path);
+    if (path == NULL) {
+        return false;
+    }
+    uint32_t id = (uint32_t)document_count++;
+    Document *document = &documents[id];
+    *document = (Document){path, hash_bytes(path, path_length), file->size, file->mtime_ms, 0, walk_count, kind, true};
+    for (size_t i = 0; i < key_count; ++i) {
+        Trigram *trigram = intern_trigram(keys[i]);
+        if (trigram != NULL && append_posting(trigram, id)) {
+            ++document->distinct;
+            ++total_postings;
+        } else {
+            // A missing posting would hide the file from queries
+            document->kind = DOCUMENT_LARGE;
+        }
+    }
+
+    // A path seen before keeps its slot, pointed at the new id
+    size_t slot = document_slot(path, path_length, document->hash);
+    if (document_table.slots[slot] == SLOT_EMPTY) {
+        ++document_table.used;
+    }
+    document_table.slots[slot] = id + 1;
+    return true;
+}
+
+static bool append_posting(Trigram *trigram, uint32_t document) {
+    if (trigram->length + VARINT_MAX_BYTES > trigram->capacity) {
+        uint32_t capacity = trigram->capacity == 0 ? INITIAL_POSTINGS_SIZE : trigram->capacity * 2;
+        unsigned char *postings = (unsigned char *)realloc(trigram->postings, capacity);
+        if (postings == NULL) {
+            return false;
+        }
+        trigram->postings = postings;
+        trigram->capacity = capacity;
+    }
+    uint32_t gap = trigram->count == 0 ? document : document - trigram->last;
+    trigram->length += encode_gap(trigram->postings + trigram->length, gap);
+    trigram->last = document;
+    ++trigram->count;
+    return true;
+}
+
+// Seven bits a byte, low bits first; returns the bytes written
+static uint32_t encode_gap(unsigned char *out, uint32_t gap) {
+    uint32_t length = 0;
+    while (gap >= 0x80) {
+        out[length++] = (unsigned char)(gap | 0x80);
+        gap >>= 7;
+    }
+    out[length++] = (unsigned char)gap;
+    return length;
+}
+
+static void retire_document(uint32_t id) {
+    Document *document = &documents[id];
+    if (document->live) {
+        document->live = false;
+        dead_postings += document->distinct;
+    }
+}
+
+static void maybe_compact(void) {
+    if (dead_postings >= COMPACT_MIN_DEAD && dead_postings > total_postings - dead_postings) {
+        compact();
+    }
+}
+
+// Renumbers the live documents in order and re-encodes every list without
+// the dead ones. Gaps between survivors can only shrink, so each list is
+// rewritten in place behind its read cursor.
+static void compact(void) {
+    uint32_t *renumbered = (uint32_t *)malloc(document_count * sizeof(uint32_t));
+    if (renumbered == NULL) {
+        return;
+    }
+    uint32_t next = 0;
+    for (size_t i = 0; i < document_count; ++i) {
+        if (documents[i].live) {
+            renumbered[i] = next;
+            documents[next++] = documents[i];
+        } else {
+            renumbered[i] = DOCUMENT_REMOVED;
+            free(documents[i].path);
+        }
+    }
+    for (size_t t = 0; t < trigram_count; ++t) {
+        Trigram *trigram = &trigrams[t];
+        const unsigned char *read = trigram->postings;
+        uint32_t count = trigram->count;
+        uint32_t id = 0;
+        uint32_t last = 0;
+        trigram->count = 0;
+        trigram->length = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t gap = 0;
+            for (int shift = 0;; shift += 7) {
+                unsigned char byte = *read++;
+                gap |= (uint32_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+            id += gap;
+            if (renumbered[id] != DOCUMENT_REMOVED) {
+                uint32_t kept = renumbered[id];
+                trigram->length += encode_gap(trigram->postings + trigram->length, trigram->count == 0 ? kept : kept - last);
+                last = kept;
+                ++trigram->count;
+            }
+        }
+        trigram->last = last;
+    }
+    free(renumbered);
+    document_count = next;
+    total_postings -= dead_postings;
+    dead_postings = 0;
+
+    size_t capacity = INITIAL_TABLE_CAPACITY;
+    while (capacity < document_count * 2 + 2) {
+        capacity *= 2;
+    }
+    rebuild_document_table(capacity);
+}
+
+// The live document for `path`, or -1
+static int find_document(const char *path) {
+    size_t length = strlen(path);
+    size_t slot = document_slot(path, length, hash_bytes(path, length));
+    if (slot >= document_table.capacity || document_table.slots[slot] == SLOT_EMPTY) {
+        return -1;
+    }
+    uint32_t id = document_table.slots[slot] - 1;
+    return documents[id].live ? (int)id : -1;
+}
+
+// Returns the slot holding the path, or the empty slot where it would go;
+// document_table.capacity when the table is empty
+static size_t document_slot(const char *path, size_t length, uint64_t hash) {
+    if (document_table.capacity == 0) {
+        return 0;
+    }
+    size_t mask = document_table.capacity - 1;
+    for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t value = document_table.slots[slot];
+        if (value == SLOT_EMPTY) {
+            return slot;
+        }
+        const Document *document = &documents[value - 1];
+        if (document->hash == hash && strncmp(document->path, path, length) == 0 && document->path[length] == '\0') {
+            return slot;
+        }
+    }
+}
+
+static Trigram *intern_trigram(uint32_t key) {
+    if ((trigram_table.used + 1) * 2 > trigram_table.capacity &&
+        !rebuild_trigram_table(trigram_table.capacity == 0 ? INITIAL_TABLE_CAPACITY : trigram_table.capacity * 2)) {
+        return NULL;
+    }
+    size_t slot = trigram_slot(key);
+    if (trigram_table.slots[slot] != SLOT_EMPTY) {
+        return &trigrams[trigram_table.slots[slot] - 1];
+    }
+    if (!reserve_array((void **)&trigrams, &trigram_capacity, trigram_count + 1, sizeof(Trigram))) {
+        return NULL;
+    }
+    Trigram *trigram = &trigrams[trigram_count];
+    *trigram = (Trigram){key, 0, 0, 0, 0, NULL};
+    trigram_table.slots[slot] = (uint32_t)++trigram_count;
+    ++trigram_table.used;
+    return trigram;
+}
+
+static const Trigram *find_trigram(uint32_t key) {
+    if (trigram_table.capacity == 0) {
+        return NULL;
+    }
+    size_t slot = trigram_slot(key);
+    return trigram_table.slots[slot] != SLOT_EMPTY ? &trigrams[trigram_table.slots[slot] - 1] : NULL;
+}
+
+static size_t trigram_slot(uint32_t key) {
+    size_t mask = trigram_table.capacity - 1;
+    for (size_t slot = (size_t)hash_key(key) & mask;; slot = (slot + 1) & mask) {
+        uint32_t value = trigram_table.slots[slot];
+        if (value == SLOT_EMPTY || trigrams[value - 1].key == key) {
+            return slot;
+        }
+    }
+}
+
+// Keeps only the newest document of every path; older ones are dead
+static bool rebuild_document_table(size_t capacity) {
+    uint32_t *slots = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+    free(document_table.slots);
+    document_table = (Table){slots, capacity, 0};
+    for (size_t i = 0; i < document_count; ++i) {
+        if (documents[i].live) {
+            table_insert(&document_table, documents[i].hash, (uint32_t)i + 1);
+        }
+    }
+    return true;
+}
+
+static bool rebuild_trigram_table(size_t capacity) {
+    uint32_t *slots = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+    free(trigram_table.slots);
+    trigram_table = (Table){slots, capacity, 0};
+    for (size_t i = 0; i < trigram_count; ++i) {
+        table_insert(&trigram_table, hash_key(trigrams[i].key), (uint32_t)i + 1);
+    }
+    return true;
+}
+
+static void table_insert(Table *table, uint64_t hash, uint32_t value) {
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (table->slots[slot] != SLOT_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+    table->slots[slot] = value;
+    ++table->used;
+}
+
+static bool reserve_array(void **items, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t new_capacity = *capacity == 0 ? INITIAL_ARRAY_CAPACITY : *capacity * 2;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void *grown = realloc(*items, new_capacity * item_size);
+    if (grown == NULL) {
+        return false;
+    }
+    *items = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static uint64_t hash_bytes(const char *data, size_t length) {
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Fibonacci hashing spreads neighbouring trigrams over the table
+static uint64_t hash_key(uint32_t key) {
+    return ((uint64_t)key * 11400714819323198485ULL) >> 20;
+}
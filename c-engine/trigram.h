@@ -0,0 +1,61 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRIGRAM_MAX_BRANCHES 16
+#define TRIGRAM_MAX_PER_BRANCH 32
+
+/**
+ * What a file must contain to possibly match a pattern: every trigram of
+ * at least one branch. Trigrams are case-folded, so one query serves both
+ * case-sensitive and -i searches. A query with no branches, or with a
+ * branch that has no trigrams, lets every file through.
+ */
+typedef struct {
+    uint32_t trigrams[TRIGRAM_MAX_BRANCHES][TRIGRAM_MAX_PER_BRANCH];
+    size_t counts[TRIGRAM_MAX_BRANCHES];
+    size_t branch_count;
+    bool match_all;
+} TrigramQuery;
+
+typedef struct {
+    char *path;  // full path
+    long long size;  // as listed by the directory cache
+    long long mtime_ms;
+    bool stale;  // changed since it was indexed; pass it to trigram_index_file()
+} TrigramFile;
+
+void trigram_query_init(TrigramQuery *query);
+// Starts another alternative; literals added after it belong to it
+void trigram_query_branch(TrigramQuery *query);
+// Requires the current branch to contain `text`; strings shorter than a trigram add nothing
+void trigram_query_literal(TrigramQuery *query, const char *text, size_t length);
+
+/**
+ * Trigram index of every directory tree grep -r has searched: each
+ * distinct case-folded three-byte sequence keeps the list of files
+ * containing it, as varint-encoded gaps between file ids.
+ *
+ * trigram_select() walks `directory` through the directory cache, whose
+ * listings inotify keeps current, so there is no separate watcher: files
+ * whose size or mtime no longer match what was indexed come back marked
+ * stale, and files that are gone are dropped. It returns the regular
+ * files, in path order, that are stale or may match the query; hidden
+ * entries and binary files are left out. The caller reads every file it
+ * gets and hands stale ones to trigram_index_file(). Returns -1 if the
+ * directory cannot be listed. All functions are thread-safe.
+ */
+int trigram_select(const char *directory, const TrigramQuery *query, TrigramFile **files, size_t *count);
+void trigram_files_free(TrigramFile *files, size_t count);
+
+/**
+ * Indexes the contents of a stale file as read by the caller. Returns
+ * false for binary files, which stay out of later selections until they
+ * change. Files over 8 MiB are not indexed and always selected.
+ */
+bool trigram_index_file(const TrigramFile *file, const char *data, size_t size);
+
+#endif // TRIGRAM_H
@@ -0,0 +1,250 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "uring.h"
+
+#define PROBE_OPS 256
+
+struct Uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_local_tail;  // entries filled but not yet published to the kernel
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+static pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+static bool probed_available = false;
+
+static bool supports_required_ops(int fd);
+static void probe_availability(void);
+static struct io_uring_sqe *next_sqe(Uring *ring, uint8_t opcode, int fd, uint64_t user_data);
+
+Uring *uring_create(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+    Uring *ring = (Uring *)calloc(1, sizeof(Uring));
+    if (ring == NULL || !supports_required_ops(fd)) {
+        free(ring);
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Kernels since 5.4 map both rings with one mmap
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            uring_destroy(ring);
+            return NULL;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                             fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+
+    char *sq = (char *)ring->sq_ring;
+    char *cq = (char *)ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return ring;
+}
+
+void uring_destroy(Uring *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+bool uring_available(void) {
+    pthread_once(&probe_once, probe_availability);
+    return probed_available;
+}
+
+bool uring_openat(Uring *ring, int dir_fd, const char *path, int flags, mode_t mode, uint64_t user_data) {
+    struct io_uring_sqe *sqe = next_sqe(ring, IORING_OP_OPENAT, dir_fd, user_data);
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->len = mode;
+    sqe->open_flags = (uint32_t)flags;
+    return true;
+}
+
+bool uring_read(Uring *ring, int fd, void *buffer, unsigned length, uint64_t offset, uint64_t user_data) {
+    struct io_uring_sqe *sqe = next_sqe(ring, IORING_OP_READ, fd, user_data);
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    return true;
+}
+
+bool uring_write(Uring *ring, int fd, const void *buffer, unsigned length, uint64_t offset, uint64_t user_data) {
+    struct io_uring_sqe *sqe = next_sqe(ring, IORING_OP_WRITE, fd, user_data);
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    return true;
+}
+
+bool uring_fsync(Uring *ring, int fd, uint64_t user_data) {
+    return next_sqe(ring, IORING_OP_FSYNC, fd, user_data) != NULL;
+}
+
+bool uring_renameat(Uring *ring, int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path,
+                    uint64_t user_data) {
+    struct io_uring_sqe *sqe = next_sqe(ring, IORING_OP_RENAMEAT, old_dir_fd, user_data);
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->addr = (uint64_t)(uintptr_t)old_path;
+    sqe->len = (uint32_t)new_dir_fd;
+    sqe->addr2 = (uint64_t)(uintptr_t)new_path;
+    return true;
+}
+
+bool uring_close(Uring *ring, int fd, uint64_t user_data) {
+    return next_sqe(ring, IORING_OP_CLOSE, fd, user_data) != NULL;
+}
+
+int uring_wait(Uring *ring, UringDone done, void *context) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) || to_submit > 0) {
+        int entered;
+        do {
+            entered = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while (entered < 0 && errno == EINTR);
+        // Busy means the completion queue is full: reaping it is the cure
+        if (entered < 0 && errno != EBUSY && errno != EAGAIN) {
+            return -errno;
+        }
+    }
+
+    // Completions handed to `done` may queue more work; it goes out next time
+    int completed = 0;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int result = cqe->res;
+        ++head;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        done(context, user_data, result);
+        ++completed;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    return completed;
+}
+
+static bool supports_required_ops(int fd) {
+    static const uint8_t required[] = {
+        IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_RENAMEAT, IORING_OP_CLOSE,
+    };
+    size_t size = sizeof(struct io_uring_probe) + PROBE_OPS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, size);
+    if (probe == NULL) {
+        return false;
+    }
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) == 0;
+    for (size_t i = 0; supported && i < sizeof(required) / sizeof(required[0]); ++i) {
+        supported = required[i] <= probe->last_op && (probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+static void probe_availability(void) {
+    Uring *ring = uring_create(4);
+    probed_available = ring != NULL;
+    uring_destroy(ring);
+}
+
+static struct io_uring_sqe *next_sqe(Uring *ring, uint8_t opcode, int fd, uint64_t user_data) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+    unsigned index = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
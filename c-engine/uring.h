@@ -0,0 +1,45 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Minimal io_uring ring driven through the raw system calls: operations
+ * are queued with the uring_* helpers, which only fill submission queue
+ * entries, and go to the kernel together on the next uring_wait(). Each
+ * carries a caller-chosen `user_data` that comes back with its result
+ * (a non-negative value, or -errno).
+ *
+ * A ring is owned by one thread. uring_create() returns NULL when the
+ * kernel has no io_uring, it is disabled, or it lacks one of the
+ * operations below; callers then fall back to plain system calls.
+ */
+typedef struct Uring Uring;
+
+typedef void (*UringDone)(void *context, uint64_t user_data, int result);
+
+Uring *uring_create(unsigned entries);
+void uring_destroy(Uring *ring);
+// Whether uring_create() can succeed here; probed once
+bool uring_available(void);
+
+// Each returns false when the submission queue is full
+bool uring_openat(Uring *ring, int dir_fd, const char *path, int flags, mode_t mode, uint64_t user_data);
+bool uring_read(Uring *ring, int fd, void *buffer, unsigned length, uint64_t offset, uint64_t user_data);
+bool uring_write(Uring *ring, int fd, const void *buffer, unsigned length, uint64_t offset, uint64_t user_data);
+bool uring_fsync(Uring *ring, int fd, uint64_t user_data);
+bool uring_renameat(Uring *ring, int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path,
+                    uint64_t user_data);
+bool uring_close(Uring *ring, int fd, uint64_t user_data);
+
+/**
+ * Submits everything queued, waits for at least one completion and hands
+ * every available one to `done`, which may queue further operations.
+ * Returns the number of completions, which is 0 when the kernel was busy
+ * and nothing had completed yet, or -errno.
+ */
+int uring_wait(Uring *ring, UringDone done, void *context);
+
+#endif // URING_H
@@ -1,14 +1,116 @@
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "vfs.h"
+#include "dircache.h"
+#include "pagecache.h"
+#include "search.h"
+#include "uring.h"
+
+#define COPY_CHUNK_FILES 256
+#define COPY_MAX_FILE_SIZE (64u * 1024u * 1024u)
+// Largest single read or write handed to the ring
+#define BATCH_IO_CHUNK (1u << 30)
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_OPENING,
+    SLOT_READING,
+    SLOT_WRITING,
+    SLOT_SYNCING,
+    SLOT_RENAMING,
+    SLOT_CLOSING
+} SlotState;
+
+// One file moving through a batch; it has at most one operation in flight
+typedef struct {
+    SlotState state;
+    size_t index;
+    int fd;
+    size_t done;  // bytes read or written so far
+    struct stat st;
+    char *buffer;  // reads: reused from file to file
+    size_t capacity;
+    char path[512];  // writes: the target and its temporary
+    char temp_path[560];
+} BatchSlot;
+
+typedef struct {
+    Uring *ring;
+    const char *const *paths;
+    size_t count;
+    size_t next;
+    size_t max_size;
+    VfsReadDone done;
+    void *context;
+    size_t in_flight;
+    BatchSlot slots[VFS_BATCH_DEPTH];
+} ReadBatch;
+
+typedef struct {
+    Uring *ring;
+    VfsBatchWrite *writes;
+    size_t count;
+    size_t next;
+    size_t in_flight;
+    BatchSlot slots[VFS_BATCH_DEPTH];
+} WriteBatch;
+
+// Files found by vfs_copy_tree(), as full source paths
+typedef struct {
+    char **sources;
+    size_t count;
+    size_t capacity;
+} CopyList;
 
 static char project_root[256] = {0};
 static char sandbox_root[256] = {0};
 
+// Group commit state: one leader per epoch sleeps out the window, then
+// issues a single syncfs() covering every writer that joined the epoch.
+static pthread_mutex_t commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+static bool group_commit_enabled = false;
+static unsigned int group_commit_window_us = 0;
+static bool commit_leader_active = false;
+static unsigned long commit_open_epoch = 1;
+static unsigned long commit_done_epoch = 0;
+// Latest epoch whose syncfs() failed; only ever rises. A waiter also reports a
+// failure from a later epoch, since it cannot tell whether that one covered its data.
+static unsigned long commit_failed_epoch = 0;
+static unsigned long temp_sequence = 0;
+static VfsIoBackend io_backend = VFS_IO_AUTO;
+
+static int durable_sync(int fd);
+static int group_sync(int fd);
+static int sync_parent_directory(const char *path);
+static Uring *open_batch_ring(void);
+static void start_read(ReadBatch *batch, BatchSlot *slot);
+static void read_completed(void *context, uint64_t user_data, int result);
+static void finish_read(ReadBatch *batch, BatchSlot *slot, int error);
+static void read_batch_sync(ReadBatch *batch);
+static bool reserve_buffer(BatchSlot *slot, size_t size);
+static void start_write(WriteBatch *batch, BatchSlot *slot);
+static void write_completed(void *context, uint64_t user_data, int result);
+static void fail_write(WriteBatch *batch, BatchSlot *slot, int error);
+static void write_batch_sync(WriteBatch *batch);
+static void finish_writes(VfsBatchWrite *writes, size_t count);
+static void next_temp_path(const char *path, char *temp_path, size_t temp_path_size);
+static bool collect_tree(char *source, size_t source_length, char *target, size_t target_length, CopyList *list);
+static void keep_copy(void *context, size_t index, const char *data, size_t size, const struct stat *st, int error);
+static void free_copy_list(CopyList *list);
+
 int vfs_init(const char *project_root_path, const char *sandbox_root_path) {
     strncpy(project_root, project_root_path, sizeof(project_root) - 1);
     strncpy(sandbox_root, sandbox_root_path, sizeof(sandbox_root) - 1);
@@ -16,66 +118,859 @@ int vfs_init(const char *project_root_path, const char *sandbox_root_path) {
     // Create directories if they don't exist
     mkdir(project_root, 0755);
     mkdir(sandbox_root, 0755);
+
+    // Absolute roots give every path one cache key, whoever asks for it
+    char resolved[PATH_MAX];
+    if (realpath(project_root_path, resolved) != NULL && strlen(resolved) < sizeof(project_root)) {
+        strcpy(project_root, resolved);
+    }
     
     return 0;
 }
 
+int vfs_resolve(const char *path, char *full_path, size_t full_path_size) {
+    while (path[0] == '.' && path[1] == '/') {
+        path += 2;
+    }
+    // Paths come from remote clients; never let one climb out of the root
+    for (const char *part = path; part != NULL; part = strchr(part, '/')) {
+        part += *part == '/';
+        if (part[0] == '.' && part[1] == '.' && (part[2] == '/' || part[2] == '\0')) {
+            return -1;
+        }
+    }
+    int written;
+    if (path[0] == '\0' || strcmp(path, ".") == 0) {
+        written = snprintf(full_path, full_path_size, "%s", project_root);
+    } else {
+        written = snprintf(full_path, full_path_size, "%s/%s", project_root, path);
+    }
+    return written >= 0 && (size_t)written < full_path_size ? 0 : -1;
+}
+
 int vfs_list(const char *path, char *output, size_t output_size) {
-    char full_path[512];
-    snprintf(full_path, sizeof(full_path), "%s/%s", project_root, path);
-    
-    DIR *dir = opendir(full_path);
-    if (dir == NULL) {
+    const DirListing *listing = vfs_list_acquire(path);
+    if (listing == NULL) {
         snprintf(output, output_size, "Error: Cannot open directory\n");
         return -1;
     }
-    
-    struct dirent *entry;
-    size_t len = 0;
-    
-    while ((entry = readdir(dir)) != NULL && len < output_size - 1) {
-        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
-            size_t name_len = strlen(entry->d_name);
-            if (len + name_len + 1 < output_size) {
-                strncpy(output + len, entry->d_name, output_size - len);
-                len += name_len;
-                output[len++] = '\n';
-            }
+
+    size_t len = listing->text_length;
+    if (len > output_size - 1) {
+        // Truncate at a line boundary, as the directory walk used to
+        len = output_size - 1;
+        while (len > 0 && listing->text[len - 1] != '\n') {
+            --len;
         }
     }
-    
-    closedir(dir);
+    memcpy(output, listing->text, len);
     output[len] = '\0';
+
+    vfs_list_release(listing);
     return 0;
 }
 
-int vfs_read(const char *path, char *content, size_t content_size) {
+const DirListing *vfs_list_acquire(const char *path) {
     char full_path[512];
-    snprintf(full_path, sizeof(full_path), "%s/%s", project_root, path);
-    
-    FILE *fp = fopen(full_path, "r");
-    if (fp == NULL) {
+    if (vfs_resolve(path, full_path, sizeof(full_path)) != 0) {
+        return NULL;
+    }
+    return dircache_acquire(full_path);
+}
+
+void vfs_list_release(const DirListing *listing) {
+    dircache_release(listing);
+}
+
+int vfs_format_stats(char *output, size_t output_size) {
+    DirCacheStats dir_stats;
+    dircache_stats(&dir_stats);
+    PageCacheStats page_stats;
+    pagecache_stats(&page_stats);
+    int written = snprintf(output, output_size,
+                           "dircache.hits %lu\n"
+                           "dircache.misses %lu\n"
+                           "dircache.invalidations %lu\n"
+                           "dircache.directories %zu\n"
+                           "pagecache.hits %lu\n"
+                           "pagecache.misses %lu\n"
+                           "pagecache.revalidations %lu\n"
+                           "pagecache.evictions %lu\n"
+                           "pagecache.bytes_served %llu\n"
+                           "pagecache.bytes_cached %zu\n"
+                           "pagecache.files %zu\n"
+                           "pagecache.budget %zu\n",
+                           dir_stats.hits, dir_stats.misses, dir_stats.invalidations, dir_stats.directories,
+                           page_stats.hits, page_stats.misses, page_stats.revalidations, page_stats.evictions,
+                           page_stats.bytes_served, page_stats.bytes_cached, page_stats.files, page_stats.budget);
+    return written < 0 ? -1 : 0;
+}
+
+int vfs_read(const char *path, char *content, size_t content_size) {
+    VfsView view;
+    if (vfs_map(path, &view) != 0) {
         return -1;
     }
-    
-    size_t len = fread(content, 1, content_size - 1, fp);
+    size_t len = view.size < content_size - 1 ? view.size : content_size - 1;
+    memcpy(content, view.data, len);
     content[len] = '\0';
-    
-    fclose(fp);
+    vfs_release(&view);
     return 0;
 }
 
 int vfs_write(const char *path, const char *content) {
+    VfsWriter writer;
+    if (vfs_writer_open(&writer, path) != 0) {
+        return -1;
+    }
+    size_t length = strlen(content);
+    vfs_writer_write(&writer, content, length);
+    if (vfs_writer_close(&writer) != 0) {
+        return -1;
+    }
+    // Write-through: the next read is served without touching the file
+    pagecache_store(writer.path, content, length);
+    return 0;
+}
+
+int vfs_map(const char *path, VfsView *view) {
+    view->data = "";
+    view->size = 0;
+    view->mapping = NULL;
+    view->page = NULL;
+
     char full_path[512];
-    snprintf(full_path, sizeof(full_path), "%s/%s", project_root, path);
-    
-    FILE *fp = fopen(full_path, "w");
-    if (fp == NULL) {
+    if (vfs_resolve(path, full_path, sizeof(full_path)) != 0) {
+        return -1;
+    }
+    return vfs_map_full(full_path, view);
+}
+
+int vfs_map_full(const char *full_path, VfsView *view) {
+    view->data = "";
+    view->size = 0;
+    view->mapping = NULL;
+    view->page = NULL;
+
+    const PageCacheFile *page = pagecache_acquire(full_path);
+    if (page != NULL) {
+        view->data = page->data;
+        view->size = page->size;
+        view->page = page;
+        return 0;
+    }
+
+    int fd = open(full_path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    // mmap rejects zero-length mappings; an empty file is just an empty view
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+
+    madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+    view->data = (const char *)mapping;
+    view->size = (size_t)st.st_size;
+    view->mapping = mapping;
+    return 0;
+}
+
+void vfs_release(VfsView *view) {
+    if (view->mapping != NULL) {
+        munmap(view->mapping, view->size);
+    }
+    pagecache_release((const PageCacheFile *)view->page);
+    view->data = "";
+    view->size = 0;
+    view->mapping = NULL;
+    view->page = NULL;
+}
+
+int vfs_writer_open(VfsWriter *writer, const char *path) {
+    writer->fp = NULL;
+    if (vfs_resolve(path, writer->path, sizeof(writer->path)) != 0) {
+        return -1;
+    }
+
+    next_temp_path(writer->path, writer->temp_path, sizeof(writer->temp_path));
+
+    writer->error = 0;
+    writer->fp = NULL;
+    int fd = open(writer->temp_path, O_WRONLY | O_CREAT | O_EXCL | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    writer->fp = fdopen(fd, "wb");
+    if (writer->fp == NULL) {
+        close(fd);
+        unlink(writer->temp_path);
         return -1;
     }
-    
-    fputs(content, fp);
-    fclose(fp);
     return 0;
 }
 
+int vfs_writer_write(VfsWriter *writer, const void *data, size_t length) {
+    if (writer->fp == NULL || writer->error) {
+        return -1;
+    }
+    if (length > 0 && fwrite(data, 1, length, writer->fp) != length) {
+        writer->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int vfs_writer_printf(VfsWriter *writer, const char *format, ...) {
+    if (writer->fp == NULL || writer->error) {
+        return -1;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(writer->fp, format, args);
+    va_end(args);
+    if (written < 0) {
+        writer->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int vfs_writer_close(VfsWriter *writer) {
+    if (writer->fp == NULL) {
+        return -1;
+    }
+
+    int fd = fileno(writer->fp);
+    int result = writer->error ? -1 : 0;
+    if (result == 0 && fflush(writer->fp) != 0) {
+        result = -1;
+    }
+
+    // The data must be durable before the rename publishes it, and the
+    // rename itself must be durable before the commit is acknowledged.
+    if (result == 0 && durable_sync(fd) != 0) {
+        result = -1;
+    }
+    if (result == 0 && rename(writer->temp_path, writer->path) != 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        dircache_invalidate_parent(writer->path);
+        pagecache_invalidate(writer->path);
+        search_index_update(writer->path);
+        if (group_commit_enabled) {
+            result = group_sync(fd);
+        } else {
+            result = sync_parent_directory(writer->path);
+        }
+    } else {
+        unlink(writer->temp_path);
+    }
+
+    if (fclose(writer->fp) != 0) {
+        result = -1;
+    }
+    writer->fp = NULL;
+    return result;
+}
+
+int vfs_append(const char *path, const void *data, size_t length) {
+    char full_path[512];
+    if (vfs_resolve(path, full_path, sizeof(full_path)) != 0) {
+        return -1;
+    }
+
+    int fd = open(full_path, O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t written = write(fd, data, length);
+    int result = written == (ssize_t)length ? 0 : -1;
+    if (result == 0 && (group_commit_enabled ? group_sync(fd) : fdatasync(fd)) != 0) {
+        result = -1;
+    }
+    if (close(fd) != 0) {
+        result = -1;
+    }
+    dircache_invalidate_parent(full_path);
+    pagecache_invalidate(full_path);
+    search_index_update(full_path);
+    return result;
+}
+
+void vfs_set_group_commit(int enabled, unsigned int window_us) {
+    pthread_mutex_lock(&commit_mutex);
+    group_commit_enabled = enabled != 0;
+    group_commit_window_us = window_us;
+    pthread_mutex_unlock(&commit_mutex);
+}
+
+VfsIoBackend vfs_set_io_backend(VfsIoBackend backend) {
+    io_backend = backend == VFS_IO_SYNC || !uring_available() ? VFS_IO_SYNC : VFS_IO_URING;
+    return io_backend;
+}
+
+int vfs_read_batch(const char *const *full_paths, size_t count, size_t max_size, VfsReadDone done, void *context) {
+    ReadBatch batch = {
+        .paths = full_paths,
+        .count = count,
+        .max_size = max_size,
+        .done = done,
+        .context = context,
+    };
+    batch.ring = count > 1 ? open_batch_ring() : NULL;
+    int result = 0;
+    if (batch.ring == NULL) {
+        read_batch_sync(&batch);
+    }
+    while (batch.ring != NULL && result == 0) {
+        for (size_t i = 0; i < VFS_BATCH_DEPTH && batch.next < count; ++i) {
+            if (batch.slots[i].state == SLOT_FREE) {
+                start_read(&batch, &batch.slots[i]);
+            }
+        }
+        if (batch.in_flight == 0) {
+            break;
+        }
+        result = uring_wait(batch.ring, read_completed, &batch) < 0 ? -1 : 0;
+    }
+    for (size_t i = 0; i < VFS_BATCH_DEPTH; ++i) {
+        if (batch.slots[i].state != SLOT_FREE && batch.slots[i].fd >= 0) {
+            close(batch.slots[i].fd);
+        }
+        free(batch.slots[i].buffer);
+    }
+    uring_destroy(batch.ring);
+    return result;
+}
+
+size_t vfs_write_batch(VfsBatchWrite *writes, size_t count) {
+    WriteBatch batch = {.writes = writes, .count = count};
+    batch.ring = count > 1 ? open_batch_ring() : NULL;
+    if (batch.ring == NULL) {
+        write_batch_sync(&batch);
+    } else {
+        int result = 0;
+        while (result == 0) {
+            for (size_t i = 0; i < VFS_BATCH_DEPTH && batch.next < count; ++i) {
+                if (batch.slots[i].state == SLOT_FREE) {
+                    start_write(&batch, &batch.slots[i]);
+                }
+            }
+            if (batch.in_flight == 0) {
+                break;
+            }
+            result = uring_wait(batch.ring, write_completed, &batch) < 0 ? -1 : 0;
+        }
+        uring_destroy(batch.ring);
+        for (size_t i = 0; i < VFS_BATCH_DEPTH; ++i) {
+            if (batch.slots[i].state != SLOT_FREE && batch.slots[i].state != SLOT_CLOSING) {
+                fail_write(&batch, &batch.slots[i], EIO);
+            }
+        }
+        // Anything the ring never got to is reported as failed
+        for (size_t i = batch.next; i < count; ++i) {
+            writes[i].error = EIO;
+        }
+        finish_writes(writes, count);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        failed += writes[i].error != 0;
+    }
+    return failed;
+}
+
+long vfs_copy_tree(const char *source, const char *target, size_t *failed) {
+    char source_path[PATH_MAX];
+    char target_path[PATH_MAX];
+    if (vfs_resolve(source, source_path, sizeof(source_path)) != 0 ||
+        vfs_resolve(target, target_path, sizeof(target_path)) != 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    size_t source_length = strlen(source_path);
+    if (strncmp(target_path, source_path, source_length) == 0 &&
+        (target_path[source_length] == '/' || target_path[source_length] == '\0')) {
+        errno = EINVAL;  // would copy the tree into itself forever
+        return -1;
+    }
+
+    *failed = 0;
+    CopyList list = {0};
+    if (mkdir(target_path, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    dircache_invalidate_parent(target_path);
+    if (!collect_tree(source_path, source_length, target_path, strlen(target_path), &list)) {
+        free_copy_list(&list);
+        return -1;
+    }
+
+    // A chunk at a time: read the files into memory, then write them all
+    long copied = 0;
+    size_t target_length = strlen(target);
+    for (size_t start = 0; start < list.count; start += COPY_CHUNK_FILES) {
+        size_t chunk = list.count - start < COPY_CHUNK_FILES ? list.count - start : COPY_CHUNK_FILES;
+        VfsBatchWrite *writes = (VfsBatchWrite *)calloc(chunk, sizeof(VfsBatchWrite));
+        char **targets = (char **)calloc(chunk, sizeof(char *));
+        if (writes == NULL || targets == NULL) {
+            free(writes);
+            free(targets);
+            *failed += list.count - start;
+            break;
+        }
+        vfs_read_batch((const char *const *)list.sources + start, chunk, COPY_MAX_FILE_SIZE, keep_copy, writes);
+
+        size_t ready = 0;
+        for (size_t i = 0; i < chunk; ++i) {
+            const char *suffix = list.sources[start + i] + source_length;
+            targets[i] = (char *)malloc(target_length + strlen(suffix) + 1);
+            if (writes[i].error == 0 && writes[i].data != NULL && targets[i] != NULL) {
+                sprintf(targets[i], "%s%s", target, suffix);
+                writes[ready] = writes[i];
+                writes[ready].path = targets[i];
+                ++ready;
+            } else {
+                free((void *)writes[i].data);
+            }
+        }
+        size_t write_failures = vfs_write_batch(writes, ready);
+        copied += (long)(ready - write_failures);
+        *failed += chunk - ready + write_failures;
+        for (size_t i = 0; i < chunk; ++i) {
+            free(targets[i]);
+        }
+        for (size_t i = 0; i < ready; ++i) {
+            free((void *)writes[i].data);
+        }
+        free(writes);
+        free(targets);
+    }
+    free_copy_list(&list);
+    return copied;
+}
+
+static int durable_sync(int fd) {
+    if (group_commit_enabled) {
+        return group_sync(fd);
+    }
+    return fsync(fd);
+}
+
+static int group_sync(int fd) {
+    pthread_mutex_lock(&commit_mutex);
+    unsigned long epoch = commit_open_epoch;
+
+    while (commit_done_epoch < epoch) {
+        if (commit_leader_active) {
+            pthread_cond_wait(&commit_cond, &commit_mutex);
+            continue;
+        }
+
+        // Lead this epoch: give concurrent writers the window to join it
+        commit_leader_active = true;
+        unsigned int window_us = group_commit_window_us;
+        pthread_mutex_unlock(&commit_mutex);
+
+        if (window_us > 0) {
+            struct timespec delay = {.tv_sec = window_us / 1000000, .tv_nsec = (long)(window_us % 1000000) * 1000};
+            nanosleep(&delay, NULL);
+        }
+
+        pthread_mutex_lock(&commit_mutex);
+        unsigned long closing_epoch = commit_open_epoch++;
+        pthread_mutex_unlock(&commit_mutex);
+
+        int sync_result = syncfs(fd);
+
+        pthread_mutex_lock(&commit_mutex);
+        commit_done_epoch = closing_epoch;
+        if (sync_result != 0) {
+            commit_failed_epoch = closing_epoch;
+        }
+        commit_leader_active = false;
+        pthread_cond_broadcast(&commit_cond);
+    }
+
+    int result = commit_failed_epoch >= epoch ? -1 : 0;
+    pthread_mutex_unlock(&commit_mutex);
+    return result;
+}
+
+static int sync_parent_directory(const char *path) {
+    char directory[512];
+    snprintf(directory, sizeof(directory), "%s", path);
+    char *slash = strrchr(directory, '/');
+    if (slash == NULL) {
+        snprintf(directory, sizeof(directory), ".");
+    } else if (slash == directory) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    int fd = open(directory, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+static Uring *open_batch_ring(void) {
+    return io_backend == VFS_IO_SYNC ? NULL : uring_create(VFS_BATCH_DEPTH);
+}
+
+static void start_read(ReadBatch *batch, BatchSlot *slot) {
+    slot->index = batch->next++;
+    slot->fd = -1;
+    slot->done = 0;
+    uint64_t id = (uint64_t)(slot - batch->slots);
+    if (!uring_openat(batch->ring, AT_FDCWD, batch->paths[slot->index], O_RDONLY | O_CLOEXEC, 0, id)) {
+        batch->done(batch->context, slot->index, NULL, 0, NULL, EAGAIN);
+        return;
+    }
+    slot->state = SLOT_OPENING;
+    batch->in_flight++;
+}
+
+// open -> read until the size fstat reported -> close
+static void read_completed(void *context, uint64_t user_data, int result) {
+    ReadBatch *batch = (ReadBatch *)context;
+    BatchSlot *slot = &batch->slots[user_data];
+    if (slot->state == SLOT_CLOSING) {
+        slot->state = SLOT_FREE;
+        batch->in_flight--;
+        return;
+    }
+    if (result < 0) {
+        finish_read(batch, slot, -result);
+        return;
+    }
+    if (slot->state == SLOT_OPENING) {
+        slot->fd = result;
+        if (fstat(slot->fd, &slot->st) != 0) {
+            finish_read(batch, slot, errno);
+            return;
+        }
+        if (!S_ISREG(slot->st.st_mode) || (size_t)slot->st.st_size > batch->max_size) {
+            finish_read(batch, slot, S_ISDIR(slot->st.st_mode) ? EISDIR : S_ISREG(slot->st.st_mode) ? EFBIG : EINVAL);
+            return;
+        }
+        if (!reserve_buffer(slot, (size_t)slot->st.st_size)) {
+            finish_read(batch, slot, ENOMEM);
+            return;
+        }
+    } else {
+        slot->done += (size_t)result;
+    }
+
+    // A read returning nothing means the file shrank; report what is there
+    size_t size = (size_t)slot->st.st_size;
+    if (slot->done < size && (slot->state == SLOT_OPENING || result > 0)) {
+        size_t chunk = size - slot->done < BATCH_IO_CHUNK ? size - slot->done : BATCH_IO_CHUNK;
+        if (!uring_read(batch->ring, slot->fd, slot->buffer + slot->done, (unsigned)chunk, slot->done, user_data)) {
+            finish_read(batch, slot, EAGAIN);
+            return;
+        }
+        slot->state = SLOT_READING;
+        return;
+    }
+    finish_read(batch, slot, 0);
+}
+
+// Reports the file, then closes it; the slot frees up once the close completes
+static void finish_read(ReadBatch *batch, BatchSlot *slot, int error) {
+    if (error == 0) {
+        batch->done(batch->context, slot->index, slot->buffer != NULL ? slot->buffer : "", slot->done, &slot->st, 0);
+    } else {
+        batch->done(batch->context, slot->index, NULL, 0, NULL, error);
+    }
+    if (slot->fd >= 0 && uring_close(batch->ring, slot->fd, (uint64_t)(slot - batch->slots))) {
+        slot->fd = -1;
+        slot->state = SLOT_CLOSING;
+        return;
+    }
+    if (slot->fd >= 0) {
+        close(slot->fd);
+        slot->fd = -1;
+    }
+    slot->state = SLOT_FREE;
+    batch->in_flight--;
+}
+
+static void read_batch_sync(ReadBatch *batch) {
+    BatchSlot *slot = &batch->slots[0];
+    for (size_t i = 0; i < batch->count; ++i) {
+        int fd = open(batch->paths[i], O_RDONLY | O_CLOEXEC);
+        int error = 0;
+        size_t length = 0;
+        if (fd < 0 || fstat(fd, &slot->st) != 0) {
+            error = errno;
+        } else if (!S_ISREG(slot->st.st_mode)) {
+            error = S_ISDIR(slot->st.st_mode) ? EISDIR : EINVAL;
+        } else if ((size_t)slot->st.st_size > batch->max_size) {
+            error = EFBIG;
+        } else if (!reserve_buffer(slot, (size_t)slot->st.st_size)) {
+            error = ENOMEM;
+        }
+        while (error == 0 && length < (size_t)slot->st.st_size) {
+            ssize_t n = read(fd, slot->buffer + length, (size_t)slot->st.st_size - length);
+            if (n < 0 && errno != EINTR) {
+                error = errno;
+            } else if (n == 0) {
+                break;
+            } else if (n > 0) {
+                length += (size_t)n;
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (error == 0) {
+            batch->done(batch->context, i, slot->buffer != NULL ? slot->buffer : "", length, &slot->st, 0);
+        } else {
+            batch->done(batch->context, i, NULL, 0, NULL, error);
+        }
+    }
+}
+
+static bool reserve_buffer(BatchSlot *slot, size_t size) {
+    if (size < slot->capacity) {
+        return true;
+    }
+    size_t capacity = slot->capacity > 0 ? slot->capacity : 65536;
+    while (capacity <= size) {
+        capacity *= 2;
+    }
+    char *buffer = (char *)realloc(slot->buffer, capacity);
+    if (buffer == NULL) {
+        return false;
+    }
+    slot->buffer = buffer;
+    slot->capacity = capacity;
+    return true;
+}
+
+static void start_write(WriteBatch *batch, BatchSlot *slot) {
+    slot->index = batch->next++;
+    VfsBatchWrite *write = &batch->writes[slot->index];
+    write->error = 0;
+    slot->fd = -1;
+    slot->done = 0;
+    if (vfs_resolve(write->path, slot->path, sizeof(slot->path)) != 0) {
+        write->error = ENAMETOOLONG;
+        return;
+    }
+    next_temp_path(slot->path, slot->temp_path, sizeof(slot->temp_path));
+    if (!uring_openat(batch->ring, AT_FDCWD, slot->temp_path, O_WRONLY | O_CREAT | O_EXCL | O_TRUNC | O_CLOEXEC, 0644,
+                      (uint64_t)(slot - batch->slots))) {
+        write->error = EAGAIN;
+        return;
+    }
+    slot->state = SLOT_OPENING;
+    batch->in_flight++;
+}
+
+// open temporary -> write -> fsync -> rename over the target -> close
+static void write_completed(void *context, uint64_t user_data, int result) {
+    WriteBatch *batch = (WriteBatch *)context;
+    BatchSlot *slot = &batch->slots[user_data];
+    const VfsBatchWrite *write = &batch->writes[slot->index];
+    if (slot->state == SLOT_CLOSING) {
+        slot->state = SLOT_FREE;
+        batch->in_flight--;
+        return;
+    }
+    if (result < 0 || (slot->state == SLOT_WRITING && result == 0)) {
+        fail_write(batch, slot, result < 0 ? -result : EIO);
+        return;
+    }
+
+    bool queued;
+    if (slot->state == SLOT_OPENING || slot->state == SLOT_WRITING) {
+        if (slot->state == SLOT_OPENING) {
+            slot->fd = result;
+        } else {
+            slot->done += (size_t)result;
+        }
+        if (slot->done < write->size) {
+            size_t chunk = write->size - slot->done < BATCH_IO_CHUNK ? write->size - slot->done : BATCH_IO_CHUNK;
+            queued = uring_write(batch->ring, slot->fd, (const char *)write->data + slot->done, (unsigned)chunk,
+                                 slot->done, user_data);
+            slot->state = SLOT_WRITING;
+        } else {
+            queued = uring_fsync(batch->ring, slot->fd, user_data);
+            slot->state = SLOT_SYNCING;
+        }
+    } else if (slot->state == SLOT_SYNCING) {
+        // Durable before the rename publishes it
+        queued = uring_renameat(batch->ring, AT_FDCWD, slot->temp_path, AT_FDCWD, slot->path, user_data);
+        slot->state = SLOT_RENAMING;
+    } else {
+        slot->temp_path[0] = '\0';
+        if (!uring_close(batch->ring, slot->fd, user_data)) {
+            close(slot->fd);
+            slot->state = SLOT_FREE;
+            batch->in_flight--;
+        } else {
+            slot->state = SLOT_CLOSING;
+        }
+        slot->fd = -1;
+        return;
+    }
+    if (!queued) {
+        fail_write(batch, slot, EAGAIN);
+    }
+}
+
+static void fail_write(WriteBatch *batch, BatchSlot *slot, int error) {
+    batch->writes[slot->index].error = error;
+    if (slot->temp_path[0] != '\0') {
+        unlink(slot->temp_path);
+    }
+    if (slot->fd >= 0) {
+        close(slot->fd);
+        slot->fd = -1;
+    }
+    slot->state = SLOT_FREE;
+    batch->in_flight--;
+}
+
+static void write_batch_sync(WriteBatch *batch) {
+    for (size_t i = 0; i < batch->count; ++i) {
+        VfsBatchWrite *write = &batch->writes[i];
+        VfsWriter writer;
+        errno = 0;
+        int result = vfs_writer_open(&writer, write->path);
+        if (result == 0) {
+            vfs_writer_write(&writer, write->data, write->size);
+            result = vfs_writer_close(&writer);
+        }
+        write->error = result == 0 ? 0 : errno != 0 ? errno : EIO;
+        if (result == 0) {
+            pagecache_store(writer.path, write->data, write->size);
+        }
+    }
+}
+
+// After the renames: one directory sync per run of files in the same
+// directory, then the caches and the search index catch up
+static void finish_writes(VfsBatchWrite *writes, size_t count) {
+    char synced[512] = "";
+    for (size_t i = 0; i < count; ++i) {
+        char full_path[512];
+        if (writes[i].error != 0 || vfs_resolve(writes[i].path, full_path, sizeof(full_path)) != 0) {
+            continue;
+        }
+        const char *slash = strrchr(full_path, '/');
+        size_t parent_length = slash != NULL ? (size_t)(slash - full_path) : 0;
+        if (strlen(synced) != parent_length || strncmp(synced, full_path, parent_length) != 0) {
+            if (sync_parent_directory(full_path) != 0) {
+                writes[i].error = EIO;
+            }
+            snprintf(synced, sizeof(synced), "%.*s", (int)parent_length, full_path);
+        }
+        dircache_invalidate_parent(full_path);
+        pagecache_store(full_path, writes[i].data, writes[i].size);
+        search_index_update(full_path);
+    }
+}
+
+static void next_temp_path(const char *path, char *temp_path, size_t temp_path_size) {
+    pthread_mutex_lock(&commit_mutex);
+    unsigned long sequence = ++temp_sequence;
+    pthread_mutex_unlock(&commit_mutex);
+    snprintf(temp_path, temp_path_size, "%s.%ld.%lu.tmp", path, (long)getpid(), sequence);
+}
+
+// Lists the files below `source` and creates its directories below
+// `target`; both hold their lengths in bytes and are extended in place
+static bool collect_tree(char *source, size_t source_length, char *target, size_t target_length, CopyList *list) {
+    DIR *dir = opendir(source);
+    if (dir == NULL) {
+        return false;
+    }
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        size_t name_length = strlen(entry->d_name);
+        if (source_length + 1 + name_length >= PATH_MAX || target_length + 1 + name_length >= PATH_MAX) {
+            ok = false;
+            break;
+        }
+        source[source_length] = '/';
+        memcpy(source + source_length + 1, entry->d_name, name_length + 1);
+        target[target_length] = '/';
+        memcpy(target + target_length + 1, entry->d_name, name_length + 1);
+
+        unsigned char type = entry->d_type;
+        struct stat st;
+        if (type == DT_UNKNOWN && lstat(source, &st) == 0) {
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) {
+            ok = mkdir(target, 0755) == 0 || errno == EEXIST;
+            dircache_invalidate_parent(target);
+            ok = ok && collect_tree(source, source_length + 1 + name_length, target, target_length + 1 + name_length,
+                                    list);
+        } else if (type == DT_REG) {
+            if (list->count == list->capacity) {
+                size_t capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+                char **sources = (char **)realloc(list->sources, capacity * sizeof(char *));
+                ok = sources != NULL;
+                if (ok) {
+                    list->sources = sources;
+                    list->capacity = capacity;
+                }
+            }
+            ok = ok && (list->sources[list->count] = strdup(source)) != NULL;
+            list->count += ok;
+        }
+    }
+    source[source_length] = '\0';
+    target[target_length] = '\0';
+    closedir(dir);
+    return ok;
+}
+
+// Holds on to each file read for vfs_copy_tree() until its chunk is written
+static void keep_copy(void *context, size_t index, const char *data, size_t size, const struct stat *st, int error) {
+    (void)st;
+    VfsBatchWrite *write = &((VfsBatchWrite *)context)[index];
+    char *copy = error == 0 ? (char *)malloc(size > 0 ? size : 1) : NULL;
+    if (copy != NULL) {
+        memcpy(copy, data, size);
+    }
+    write->data = copy;
+    write->size = size;
+    write->error = error != 0 ? error : copy == NULL ? ENOMEM : 0;
+}
+
+static void free_copy_list(CopyList *list) {
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->sources[i]);
+    }
+    free(list->sources);
+}
@@ -1,10 +1,132 @@
 #ifndef VFS_H
 #define VFS_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include "dircache.h"
+
+#define VFS_BATCH_DEPTH 64
+
+/**
+ * Read-only view of a whole file. `data` is NOT NUL-terminated; use `size`.
+ * Views stay valid until vfs_release() and must always be released, even
+ * for empty files. Files that fit are served from the page cache, larger
+ * ones are mapped.
+ */
+typedef struct {
+    const char *data;
+    size_t size;
+    void *mapping;
+    const void *page;  // pinned page cache entry
+} VfsView;
+
+/**
+ * Streaming writer that accepts arbitrary bytes, including embedded NULs.
+ * Data goes to a temporary file next to the target; vfs_writer_close()
+ * makes it durable and atomically renames it into place, so readers and
+ * crashes only ever observe the old or the new contents. On any error the
+ * temporary is discarded and the original file is left untouched.
+ */
+typedef struct {
+    FILE *fp;
+    int error;
+    char path[512];
+    char temp_path[560];
+} VfsWriter;
+
+typedef enum {
+    VFS_IO_AUTO = 0,  // io_uring when the kernel allows it, else synchronous calls
+    VFS_IO_SYNC = 1,
+    VFS_IO_URING = 2
+} VfsIoBackend;
+
+/**
+ * Called once per file of a batch read, on the calling thread and in
+ * completion order. `index` is the file's position in the batch; `error`
+ * is 0 or an errno value, in which case `data` is NULL. `data` is only
+ * valid during the call.
+ */
+typedef void (*VfsReadDone)(void *context, size_t index, const char *data, size_t size, const struct stat *st,
+                            int error);
+
+// One file of vfs_write_batch(); `error` is set to 0 or an errno value
+typedef struct {
+    const char *path;
+    const void *data;
+    size_t size;
+    int error;
+} VfsBatchWrite;
+
 int vfs_init(const char *project_root, const char *sandbox_root);
 int vfs_list(const char *path, char *output, size_t output_size);
 int vfs_read(const char *path, char *content, size_t content_size);
 int vfs_write(const char *path, const char *content);
+int vfs_resolve(const char *path, char *full_path, size_t full_path_size);
 
-#endif // VFS_H
+/**
+ * Cached directory listing with per-entry type, size and mtime. Served from
+ * the directory cache while the directory is unchanged; release when done.
+ */
+const DirListing *vfs_list_acquire(const char *path);
+void vfs_list_release(const DirListing *listing);
+
+// Directory and page cache counters as "name value" lines, shared by the shell and the daemon
+int vfs_format_stats(char *output, size_t output_size);
 
+int vfs_map(const char *path, VfsView *view);
+// vfs_map() for a full path, as the daemon's READ requests carry
+int vfs_map_full(const char *full_path, VfsView *view);
+void vfs_release(VfsView *view);
+
+int vfs_writer_open(VfsWriter *writer, const char *path);
+int vfs_writer_write(VfsWriter *writer, const void *data, size_t length);
+int vfs_writer_printf(VfsWriter *writer, const char *format, ...);
+int vfs_writer_close(VfsWriter *writer);
+
+/**
+ * Appends `length` bytes to an existing file in a single write and makes
+ * them durable before returning. Meant for small journal records: readers
+ * see either none or all of the record, except a torn tail after a crash.
+ */
+int vfs_append(const char *path, const void *data, size_t length);
+
+/**
+ * Group commit: when enabled, writers closing within `window_us` of each
+ * other share one filesystem flush instead of an fsync each. Durability is
+ * unchanged; individual commits may wait up to the window for company.
+ */
+void vfs_set_group_commit(int enabled, unsigned int window_us);
+
+/**
+ * Backend for the batch operations below. With io_uring, up to
+ * VFS_BATCH_DEPTH files are in flight at once: their opens, reads,
+ * writes, fsyncs and renames are queued together and completed as they
+ * finish, so the disk queue stays full instead of waiting on each system
+ * call in turn. VFS_IO_URING falls back to synchronous calls too when the
+ * kernel refuses io_uring. Returns the backend batches will use.
+ */
+VfsIoBackend vfs_set_io_backend(VfsIoBackend backend);
+
+/**
+ * Reads whole regular files of at most `max_size` bytes, by full path.
+ * Returns 0, or -1 if the batch could not be started.
+ */
+int vfs_read_batch(const char *const *full_paths, size_t count, size_t max_size, VfsReadDone done, void *context);
+
+/**
+ * Writes each file atomically and durably like a VfsWriter: a temporary
+ * next to the target, fsync, rename, then one sync per directory written.
+ * Returns the number of files that failed.
+ */
+size_t vfs_write_batch(VfsBatchWrite *writes, size_t count);
+
+/**
+ * cp -r: recreates the tree at `source` under `target` (paths relative to
+ * the root), reading and writing its files in batches. Returns the number
+ * of files copied and counts the ones that were not in `failed`, or -1 if
+ * `source` cannot be listed or `target` created.
+ */
+long vfs_copy_tree(const char *source, const char *target, size_t *failed);
+
+#endif // VFS_H
@@ -0,0 +1,247 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "walk.h"
+#include "workers.h"
+
+#define MAX_WALK_THREADS 16
+// Subdirectories opened ahead of their job; past this, jobs open theirs by path
+#define MAX_HELD_DESCRIPTORS 256
+#define INITIAL_CHILD_CAPACITY 16
+
+typedef struct {
+    WorkerPool *pool;
+    const WalkOptions *options;
+    atomic_int held;
+} Walk;
+
+typedef struct {
+    Walk *walk;
+    WalkEntry *directory;
+    int fd;  // -1 when it has to be opened by path
+} WalkJob;
+
+static void walk_directory(void *argument);
+static void queue_directory(Walk *walk, WalkEntry *directory, int parent_fd);
+static int open_by_path(const WalkEntry *directory);
+static WalkEntry *new_entry(const char *name, const struct stat *st, WalkEntry *parent);
+static void free_entry(WalkEntry *entry);
+static bool add_child(WalkEntry *directory, WalkEntry *child, size_t *capacity);
+static void fold_totals(WalkEntry *entry);
+static int compare_entries(const void *a, const void *b);
+static int default_thread_count(void);
+
+WalkEntry *walk_tree(const char *full_path, const WalkOptions *options) {
+    struct stat st;
+    if (stat(full_path, &st) != 0) {
+        return NULL;
+    }
+    WalkEntry *root = new_entry(full_path, &st, NULL);
+    if (root == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    root->matched = options->keep == NULL || options->keep(root, options->context);
+
+    if (S_ISDIR(st.st_mode) && options->max_depth != 0) {
+        Walk walk = {.options = options};
+        atomic_init(&walk.held, 0);
+        walk.pool = worker_pool_create(options->threads > 0 ? options->threads : default_thread_count());
+        if (walk.pool == NULL) {
+            root->error = EAGAIN;
+        } else {
+            queue_directory(&walk, root, AT_FDCWD);
+            // Returns once every directory job, and the jobs they queued, ran
+            worker_pool_destroy(walk.pool);
+        }
+    }
+    fold_totals(root);
+    return root;
+}
+
+void walk_free(WalkEntry *root) {
+    if (root == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < root->child_count; ++i) {
+        walk_free(root->children[i]);
+    }
+    free(root->children);
+    free_entry(root);
+}
+
+// Lists one directory, then queues its subdirectories. The children are
+// sorted before any of their jobs can run, so no other job ever touches
+// this directory's entry.
+static void walk_directory(void *argument) {
+    WalkJob *job = (WalkJob *)argument;
+    Walk *walk = job->walk;
+    WalkEntry *directory = job->directory;
+    int fd = job->fd;
+    free(job);
+    if (fd >= 0) {
+        atomic_fetch_sub(&walk->held, 1);
+    } else {
+        fd = open_by_path(directory);
+    }
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (dir == NULL) {
+        directory->error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    const WalkOptions *options = walk->options;
+    size_t capacity = 0;
+    struct dirent *dirent;
+    while ((dirent = readdir(dir)) != NULL) {
+        const char *name = dirent->d_name;
+        if (name[0] == '.' && (!options->hidden || name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;  // gone since readdir
+        }
+        WalkEntry *child = new_entry(name, &st, directory);
+        if (child == NULL) {
+            directory->error = ENOMEM;
+            break;
+        }
+        child->matched = options->keep == NULL || options->keep(child, options->context);
+        if (!S_ISDIR(st.st_mode) && !child->matched) {
+            directory->total_size += (unsigned long long)st.st_size;
+            directory->total_blocks += (unsigned long long)st.st_blocks;
+            free_entry(child);
+        } else if (!add_child(directory, child, &capacity)) {
+            free_entry(child);
+            directory->error = ENOMEM;
+            break;
+        }
+    }
+
+    qsort(directory->children, directory->child_count, sizeof(WalkEntry *), compare_entries);
+    for (size_t i = 0; i < directory->child_count; ++i) {
+        WalkEntry *child = directory->children[i];
+        if (S_ISDIR(child->mode) && (options->max_depth < 0 || child->depth < options->max_depth)) {
+            queue_directory(walk, child, dirfd(dir));
+        }
+    }
+    closedir(dir);
+}
+
+// Opens the directory relative to its parent while the parent is still
+// open, unless too many descriptors are already waiting for their jobs
+static void queue_directory(Walk *walk, WalkEntry *directory, int parent_fd) {
+    int fd = -1;
+    if (atomic_fetch_add(&walk->held, 1) < MAX_HELD_DESCRIPTORS) {
+        int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (directory->parent != NULL ? O_NOFOLLOW : 0);
+        fd = openat(parent_fd, directory->name, flags);
+    }
+    if (fd < 0) {
+        atomic_fetch_sub(&walk->held, 1);
+    }
+    WalkJob *job = (WalkJob *)malloc(sizeof(WalkJob));
+    if (job != NULL) {
+        *job = (WalkJob){walk, directory, fd};
+        if (worker_pool_submit(walk->pool, walk_directory, job)) {
+            return;
+        }
+        free(job);
+    }
+    directory->error = ENOMEM;
+    if (fd >= 0) {
+        close(fd);
+        atomic_fetch_sub(&walk->held, 1);
+    }
+}
+
+static int open_by_path(const WalkEntry *directory) {
+    const WalkEntry *chain[PATH_MAX / 2];
+    size_t count = 0;
+    for (const WalkEntry *entry = directory; entry != NULL && count < PATH_MAX / 2; entry = entry->parent) {
+        chain[count++] = entry;
+    }
+    char path[PATH_MAX];
+    size_t length = 0;
+    while (count > 0) {
+        const char *name = chain[--count]->name;
+        int written = snprintf(path + length, sizeof(path) - length, "%s%s", length > 0 ? "/" : "", name);
+        if (written < 0 || (size_t)written >= sizeof(path) - length) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        length += (size_t)written;
+    }
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (directory->parent != NULL ? O_NOFOLLOW : 0);
+    return open(path, flags);
+}
+
+static WalkEntry *new_entry(const char *name, const struct stat *st, WalkEntry *parent) {
+    WalkEntry *entry = (WalkEntry *)calloc(1, sizeof(WalkEntry));
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->name = strdup(name);
+    if (entry->name == NULL) {
+        free(entry);
+        return NULL;
+    }
+    entry->mode = st->st_mode;
+    entry->size = st->st_size;
+    entry->blocks = st->st_blocks;
+    entry->mtime = st->st_mtime;
+    entry->depth = parent != NULL ? parent->depth + 1 : 0;
+    entry->parent = parent;
+    return entry;
+}
+
+static void free_entry(WalkEntry *entry) {
+    free(entry->name);
+    free(entry);
+}
+
+static bool add_child(WalkEntry *directory, WalkEntry *child, size_t *capacity) {
+    if (directory->child_count == *capacity) {
+        size_t new_capacity = *capacity == 0 ? INITIAL_CHILD_CAPACITY : *capacity * 2;
+        WalkEntry **children = (WalkEntry **)realloc(directory->children, new_capacity * sizeof(WalkEntry *));
+        if (children == NULL) {
+            return false;
+        }
+        directory->children = children;
+        *capacity = new_capacity;
+    }
+    directory->children[directory->child_count++] = child;
+    return true;
+}
+
+// Runs after the walk: adds each entry's own size to what its job already
+// counted of the entries it dropped, then its children's totals
+static void fold_totals(WalkEntry *entry) {
+    entry->total_size += (unsigned long long)entry->size;
+    entry->total_blocks += (unsigned long long)entry->blocks;
+    for (size_t i = 0; i < entry->child_count; ++i) {
+        fold_totals(entry->children[i]);
+        entry->total_size += entry->children[i]->total_size;
+        entry->total_blocks += entry->children[i]->total_blocks;
+    }
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp((*(const WalkEntry *const *)a)->name, (*(const WalkEntry *const *)b)->name);
+}
+
+static int default_thread_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long threads = cpus > 0 ? cpus * 2 : 2;
+    return threads < MAX_WALK_THREADS ? (int)threads : MAX_WALK_THREADS;
+}
@@ -0,0 +1,56 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * One entry of a walked tree. Directories always appear, with their
+ * children sorted by name; other entries only when the walk's `keep`
+ * accepted them. The totals of a directory cover everything below it,
+ * kept or not, and the directory itself.
+ */
+typedef struct WalkEntry {
+    char *name;  // the path as given for the root
+    mode_t mode;
+    off_t size;
+    blkcnt_t blocks;  // 512-byte units
+    time_t mtime;
+    int depth;  // 0 for the root
+    int error;  // errno from reading this directory, or 0
+    bool matched;  // passed `keep`; always true for files that appear
+    unsigned long long total_size;
+    unsigned long long total_blocks;
+    struct WalkEntry *parent;
+    struct WalkEntry **children;
+    size_t child_count;
+} WalkEntry;
+
+typedef struct {
+    int max_depth;  // entries deeper than this are not read; -1 for no limit
+    bool hidden;  // include names starting with '.'
+    int threads;  // 0 for two per CPU, since most of the wait is on stat
+    /**
+     * Decides, on a walker thread, whether an entry is kept (and for
+     * directories, `matched`). Entries it drops still count towards their
+     * parents' totals. NULL keeps everything.
+     */
+    bool (*keep)(const WalkEntry *entry, void *context);
+    void *context;
+} WalkOptions;
+
+/**
+ * Walks the tree at `full_path` on a work-stealing pool, one job per
+ * directory. Each job reads its directory through a descriptor and
+ * stats the entries relative to it with fstatat(), so the kernel never
+ * resolves a path from the root again, and opens subdirectories the same
+ * way before handing them on. Symbolic links are reported, not followed.
+ *
+ * Returns the root entry, or NULL with errno set if `full_path` cannot
+ * be stat'ed. Unreadable directories set their `error` and stay empty.
+ */
+WalkEntry *walk_tree(const char *full_path, const WalkOptions *options);
+void walk_free(WalkEntry *root);
+
+#endif // WALK_H
@@ -0,0 +1,276 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "workers.h"
+
+#define INITIAL_DEQUE_CAPACITY 16
+#define MAX_SPARE_THREADS 256
+#define SPARE_IDLE_CHECK_MS 100
+
+typedef struct {
+    WorkerJobFn run;
+    void *argument;
+} WorkerJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    WorkerJob *jobs;  // ring buffer
+    size_t head;
+    size_t count;
+    size_t capacity;
+    pthread_t thread;
+    WorkerPool *pool;
+    int index;
+} Worker;
+
+struct WorkerPool {
+    Worker *workers;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    pthread_cond_t spare_retired;
+    size_t queued;  // jobs in the deques not yet claimed by a worker
+    unsigned int next;
+    int threads;  // workers and spares alive
+    int blocked;  // threads inside worker_pool_block_begin/end
+    int spares;
+    bool stopping;
+};
+
+static _Thread_local Worker *current_worker = NULL;
+static _Thread_local int block_depth = 0;
+
+static void *worker_main(void *argument);
+static void *spare_main(void *argument);
+static void start_spare(WorkerPool *pool);
+static bool deque_push(Worker *worker, WorkerJob job);
+static bool deque_pop(Worker *worker, WorkerJob *job);
+static bool steal_job(WorkerPool *pool, int first, WorkerJob *job);
+
+WorkerPool *worker_pool_create(int thread_count) {
+    if (thread_count < 1) {
+        return NULL;
+    }
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = calloc((size_t)thread_count, sizeof(Worker));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    pthread_cond_init(&pool->spare_retired, NULL);
+
+    for (int i = 0; i < thread_count; ++i) {
+        Worker *worker = &pool->workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->pool = pool;
+        worker->index = i;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            pthread_mutex_destroy(&worker->lock);
+            break;
+        }
+        pool->count = i + 1;
+        pool->threads = i + 1;
+    }
+    if (pool->count == 0) {
+        worker_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+bool worker_pool_submit(WorkerPool *pool, WorkerJobFn run, void *argument) {
+    Worker *target = current_worker;
+    if (target == NULL || target->pool != pool) {
+        pthread_mutex_lock(&pool->lock);
+        target = &pool->workers[pool->next++ % (unsigned int)pool->count];
+        pthread_mutex_unlock(&pool->lock);
+    }
+    if (!deque_push(target, (WorkerJob){run, argument})) {
+        return false;
+    }
+
+    // The job is visible in a deque before it is counted, so a worker that
+    // claims a count always finds a job somewhere
+    pthread_mutex_lock(&pool->lock);
+    ++pool->queued;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+void worker_pool_block_begin(WorkerPool *pool) {
+    if (block_depth++ > 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    ++pool->blocked;
+    if (pool->threads - pool->blocked < pool->count && pool->spares < MAX_SPARE_THREADS && !pool->stopping) {
+        start_spare(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Spares left over once the wait ends retire when they next run dry
+void worker_pool_block_end(WorkerPool *pool) {
+    if (--block_depth > 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    --pool->blocked;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void worker_pool_destroy(WorkerPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    // Spares are detached; wait for the last one to let go of the pool
+    pthread_mutex_lock(&pool->lock);
+    while (pool->spares > 0) {
+        pthread_cond_wait(&pool->spare_retired, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; ++i) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].jobs);
+    }
+    pthread_cond_destroy(&pool->spare_retired);
+    pthread_cond_destroy(&pool->available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+static void *worker_main(void *argument) {
+    Worker *self = (Worker *)argument;
+    WorkerPool *pool = self->pool;
+    current_worker = self;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->available, &pool->lock);
+        }
+        if (pool->queued == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        --pool->queued;
+        pthread_mutex_unlock(&pool->lock);
+
+        // Another worker may take the job this claim was counted for, but
+        // then it holds a claim for one still queued; keep looking
+        WorkerJob job;
+        while (!deque_pop(self, &job) && !steal_job(pool, self->index + 1, &job)) {
+        }
+        job.run(job.argument);
+    }
+    return NULL;
+}
+
+// A spare has no deque of its own; it only steals, and retires once the
+// pool has enough unblocked threads without it
+static void *spare_main(void *argument) {
+    WorkerPool *pool = (WorkerPool *)argument;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        if (pool->queued > 0) {
+            --pool->queued;
+            pthread_mutex_unlock(&pool->lock);
+            WorkerJob job;
+            while (!steal_job(pool, 0, &job)) {
+            }
+            job.run(job.argument);
+            pthread_mutex_lock(&pool->lock);
+            continue;
+        }
+        if (pool->stopping || pool->threads - pool->blocked > pool->count) {
+            break;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SPARE_IDLE_CHECK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool->available, &pool->lock, &deadline);
+    }
+    --pool->threads;
+    --pool->spares;
+    pthread_cond_broadcast(&pool->spare_retired);
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Called with the pool locked
+static void start_spare(WorkerPool *pool) {
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attributes, spare_main, pool) == 0) {
+        ++pool->threads;
+        ++pool->spares;
+    }
+    pthread_attr_destroy(&attributes);
+}
+
+static bool deque_push(Worker *worker, WorkerJob job) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count == worker->capacity) {
+        size_t capacity = worker->capacity == 0 ? INITIAL_DEQUE_CAPACITY : worker->capacity * 2;
+        WorkerJob *jobs = malloc(capacity * sizeof(WorkerJob));
+        if (jobs == NULL) {
+            pthread_mutex_unlock(&worker->lock);
+            return false;
+        }
+        for (size_t i = 0; i < worker->count; ++i) {
+            jobs[i] = worker->jobs[(worker->head + i) % worker->capacity];
+        }
+        free(worker->jobs);
+        worker->jobs = jobs;
+        worker->head = 0;
+        worker->capacity = capacity;
+    }
+    worker->jobs[(worker->head + worker->count) % worker->capacity] = job;
+    ++worker->count;
+    pthread_mutex_unlock(&worker->lock);
+    return true;
+}
+
+// Jobs are independent requests, so owners and thieves alike take the
+// oldest one; that keeps waiting times fair instead of cache-friendly
+static bool deque_pop(Worker *worker, WorkerJob *job) {
+    pthread_mutex_lock(&worker->lock);
+    bool found = worker->count > 0;
+    if (found) {
+        *job = worker->jobs[worker->head];
+        worker->head = (worker->head + 1) % worker->capacity;
+        --worker->count;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+static bool steal_job(WorkerPool *pool, int first, WorkerJob *job) {
+    for (int offset = 0; offset < pool->count; ++offset) {
+        if (deque_pop(&pool->workers[(first + offset) % pool->count], job)) {
+            return true;
+        }
+    }
+    return false;
+}
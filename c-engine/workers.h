@@ -0,0 +1,33 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdbool.h>
+
+/**
+ * Fixed pool of worker threads running submitted jobs. Every worker owns a
+ * job deque: jobs submitted from a worker go to its own deque and other
+ * jobs are spread round-robin. A worker serves its own deque first and
+ * steals from the others when it runs dry, so jobs queued behind a slow
+ * one are picked up by whichever worker is idle.
+ */
+typedef struct WorkerPool WorkerPool;
+typedef void (*WorkerJobFn)(void *argument);
+
+WorkerPool *worker_pool_create(int thread_count);
+
+// Returns false only when out of memory; the job then never runs
+bool worker_pool_submit(WorkerPool *pool, WorkerJobFn run, void *argument);
+
+/**
+ * Brackets a wait inside a job that does not use the CPU, such as waiting
+ * for a stalled client to read. While it lasts the pool runs a spare
+ * thread in its place, so blocked jobs cannot starve the queued ones.
+ * Only call these from a job; a wait nested in another counts once.
+ */
+void worker_pool_block_begin(WorkerPool *pool);
+void worker_pool_block_end(WorkerPool *pool);
+
+// Runs every job still queued, including ones those jobs submit, then joins the threads
+void worker_pool_destroy(WorkerPool *pool);
+
+#endif // WORKERS_H
@@ -1,12 +1,23 @@
 import React, { useState, useEffect, useRef } from 'react';
 import { BACKEND_WS_URL } from '../../../config';
 
+// The output pane keeps the tail of what a program prints
+const OUTPUT_LIMIT = 256 * 1024;
+
+const appendBounded = (prev: string, text: string) => {
+  const next = prev + text;
+  return next.length > OUTPUT_LIMIT ? next.slice(next.length - OUTPUT_LIMIT) : next;
+};
+
 const GenixCode: React.FC = () => {
   const editorRef = useRef<HTMLTextAreaElement>(null);
   const [content, setContent] = useState('// Welcome to GenixCode\n// Start coding in C or C++\n\n#include <stdio.h>\n\nint main() {\n    printf("Hello, GENIX!\\n");\n    return 0;\n}');
   const [output, setOutput] = useState('');
+  // The program runs on a terminal and reads what is typed below the output
+  const [running, setRunning] = useState(false);
   const wsRef = useRef<WebSocket | null>(null);
   const pendingCompileRef = useRef<boolean>(false);
+  const stdinRef = useRef<HTMLInputElement>(null);
 
   useEffect(() => {
     // Initialize WebSocket connection
@@ -27,26 +38,33 @@ const GenixCode: React.FC = () => {
                     type: 'build',
                     action: 'run',
                     file: 'main.c',
+                    interactive: true,
                   })
                 );
+                setOutput((prev) => prev + '\n--- Program Output ---\n');
+                setRunning(true);
+                setTimeout(() => stdinRef.current?.focus(), 0);
               }
             }, 100);
           } else {
             setOutput((prev) => prev + 'Compilation failed:\n' + (data.output || data.error || 'Unknown error') + '\n');
           }
         } else if (data.action === 'run') {
-          if (data.success) {
-            setOutput((prev) => prev + '\n--- Program Output ---\n' + (data.output || '') + '\n');
+          // Interactive runs have streamed their output already
+          setRunning(false);
+          if (data.exitCode !== undefined) {
+            setOutput((prev) => appendBounded(prev, data.output || ''));
             if (data.error) {
-              setOutput((prev) => prev + '--- Errors ---\n' + data.error + '\n');
-            }
-            if (data.exitCode !== undefined) {
-              setOutput((prev) => prev + `Exit code: ${data.exitCode}\n`);
+              setOutput((prev) => prev + '\n--- Errors ---\n' + data.error + '\n');
             }
+            setOutput((prev) => prev + `\nExit code: ${data.exitCode}\n`);
           } else {
             setOutput((prev) => prev + '\n--- Run Failed ---\n' + (data.error || 'Unknown error') + '\n');
           }
         }
+      } else if (data.type === 'run-output') {
+        // The terminal ends lines with \r\n
+        setOutput((prev) => appendBounded(prev, data.output.replace(/\r\n/g, '\n')));
       } else if (data.type === 'file' && data.action === 'write') {
         // File saved successfully
         console.log('File saved successfully');
@@ -86,6 +104,28 @@ const GenixCode: React.FC = () => {
     }
   };
 
+  const sendToProgram = (message: object) => {
+    if (wsRef.current && wsRef.current.readyState === WebSocket.OPEN) {
+      wsRef.current.send(JSON.stringify({ type: 'build', ...message }));
+    }
+  };
+
+  // Enter sends the line (the terminal echoes it); Ctrl+C interrupts, Ctrl+D ends input
+  const handleStdinKeyDown = (e: React.KeyboardEvent<HTMLInputElement>) => {
+    const control = e.ctrlKey && (e.key === 'c' || e.key === 'd');
+    if (e.key !== 'Enter' && !control) {
+      return;
+    }
+    e.preventDefault();
+    const input = e.currentTarget;
+    if (control) {
+      sendToProgram({ action: 'run-input', input: input.value + (e.key === 'c' ? '\x03' : '\x04') });
+    } else {
+      sendToProgram({ action: 'run-input', input: input.value + '\n' });
+    }
+    input.value = '';
+  };
+
   const handleRun = () => {
     if (wsRef.current && wsRef.current.readyState === WebSocket.OPEN) {
       // Clear output and show we're starting
@@ -111,12 +151,21 @@ const GenixCode: React.FC = () => {
         <div className="flex items-center space-x-2">
           <span className="text-sm font-medium">main.c</span>
         </div>
-        <button
-          onClick={handleRun}
-          className="px-4 py-1 bg-genix-yellow text-genix-blue rounded hover:bg-yellow-400 transition-colors text-sm font-medium"
-        >
-          Run
-        </button>
+        {running ? (
+          <button
+            onClick={() => sendToProgram({ action: 'run-kill' })}
+            className="px-4 py-1 bg-red-500 text-white rounded hover:bg-red-400 transition-colors text-sm font-medium"
+          >
+            Stop
+          </button>
+        ) : (
+          <button
+            onClick={handleRun}
+            className="px-4 py-1 bg-genix-yellow text-genix-blue rounded hover:bg-yellow-400 transition-colors text-sm font-medium"
+          >
+            Run
+          </button>
+        )}
       </div>
       <div className="flex-1 flex">
         <div className="flex-1 flex flex-col">
@@ -135,6 +184,15 @@ const GenixCode: React.FC = () => {
           <div className="flex-1 p-4 bg-terminal-bg text-white font-mono text-sm overflow-y-auto">
             <pre className="whitespace-pre-wrap">{output || 'Output will appear here...'}</pre>
           </div>
+          {running && (
+            <input
+              ref={stdinRef}
+              onKeyDown={handleStdinKeyDown}
+              placeholder="Input for the program (Enter to send, Ctrl+C to interrupt)"
+              className="px-4 py-2 bg-gray-900 text-white font-mono text-sm border-t border-gray-700 outline-none"
+              spellCheck={false}
+            />
+          )}
         </div>
       </div>
     </div>
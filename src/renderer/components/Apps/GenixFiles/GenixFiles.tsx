@@ -6,6 +6,12 @@ interface FileItem {
   type: 'file' | 'directory';
 }
 
+interface SearchResult {
+  path: string;
+  line: number;
+  snippet: string;
+}
+
 // Shared connection guard to prevent React StrictMode from creating duplicate connections
 let globalWsConnection: WebSocket | null = null;
 
@@ -16,6 +22,9 @@ const GenixFiles: React.FC = () => {
   const [loading, setLoading] = useState(true); // Start with loading true
   const [error, setError] = useState<string>('');
   const [connected, setConnected] = useState(false);
+  const [searchQuery, setSearchQuery] = useState('');
+  // Ranked hits replace the listing until the search is cleared
+  const [searchResults, setSearchResults] = useState<SearchResult[] | null>(null);
   const wsRef = React.useRef<WebSocket | null>(null);
 
   const requestDirectory = (path: string) => {
@@ -138,6 +147,10 @@ const GenixFiles: React.FC = () => {
             setFiles(fileItems);
             setLoading(false);
             setError('');
+          } else if (data.type === 'file' && data.action === 'search') {
+            setSearchResults(data.results || []);
+            setLoading(false);
+            setError('');
           } else if (data.type === 'error') {
             // Clear any loading timeout
             if (wsRef.current && (wsRef.current as any)._loadingTimeout) {
@@ -357,6 +370,36 @@ const GenixFiles: React.FC = () => {
     }
   };
 
+  const handleSearch = () => {
+    const query = searchQuery.trim();
+    if (!query) {
+      setSearchResults(null);
+      return;
+    }
+    if (!wsRef.current || wsRef.current.readyState !== WebSocket.OPEN) {
+      setError('Connection not ready');
+      return;
+    }
+    setLoading(true);
+    wsRef.current.send(JSON.stringify({ type: 'file', action: 'search', query }));
+  };
+
+  const clearSearch = () => {
+    setSearchQuery('');
+    setSearchResults(null);
+  };
+
+  // Opens the folder holding the hit
+  const handleResultClick = (result: SearchResult) => {
+    const folder = result.path.includes('/') ? result.path.slice(0, result.path.lastIndexOf('/')) : '';
+    if (currentPath !== '' && currentPath !== '.') {
+      setPathHistory(prev => [...prev, currentPath]);
+    }
+    clearSearch();
+    setFiles([]);
+    setCurrentPath(folder);
+  };
+
   const basePathLabel = 'GenixFiles';
   const displayPath = currentPath === '.' || currentPath === '' ? basePathLabel : `${basePathLabel}/${currentPath}`;
 
@@ -471,6 +514,20 @@ const GenixFiles: React.FC = () => {
           </div>
         </div>
         <div className="flex items-center space-x-2">
+          <input
+            type="search"
+            value={searchQuery}
+            onChange={(e) => setSearchQuery(e.target.value)}
+            onKeyDown={(e) => {
+              if (e.key === 'Enter') {
+                handleSearch();
+              } else if (e.key === 'Escape') {
+                clearSearch();
+              }
+            }}
+            placeholder="Search files..."
+            className="px-2 py-1 border border-gray-300 rounded text-sm"
+          />
           {!connected && (
             <span className="text-xs text-red-600 bg-red-100 px-2 py-1 rounded">
               Not connected
@@ -494,6 +551,32 @@ const GenixFiles: React.FC = () => {
           </div>
         ) : loading ? (
           <div className="text-center text-gray-500">Loading...</div>
+        ) : searchResults ? (
+          searchResults.length === 0 ? (
+            <div className="text-center text-gray-500">No files contain all of those words</div>
+          ) : (
+            <div className="space-y-1">
+              {searchResults.map((result) => (
+                <div
+                  key={result.path}
+                  onClick={() => handleResultClick(result)}
+                  className="p-2 rounded cursor-pointer hover:bg-gray-100 active:bg-gray-200 transition-colors"
+                  title={`Open the folder containing ${result.path}`}
+                >
+                  <div className="flex items-center space-x-2">
+                    <span>📄</span>
+                    <span className="text-gray-900">{result.path}</span>
+                    {result.line > 0 && (
+                      <span className="text-xs text-gray-400">line {result.line}</span>
+                    )}
+                  </div>
+                  {result.snippet && (
+                    <div className="text-xs text-gray-500 font-mono truncate ml-6">{result.snippet}</div>
+                  )}
+                </div>
+              ))}
+            </div>
+          )
         ) : files.length === 0 ? (
           <div className="text-center text-gray-500">
             <div className="mb-2">No files found</div>
@@ -1,12 +1,46 @@
 import React, { useEffect, useRef, useState } from 'react';
 import { BACKEND_WS_URL } from '../../../config';
 
+const HISTORY_LIMIT = 50;
+// A streaming command keeps the tail of its output on screen
+const STREAM_LIMIT = 256 * 1024;
+
+interface HistoryBrowse {
+  // What was typed before browsing; matches are commands starting with it
+  draft: string;
+  matches: string[];
+  // -1 while the draft itself is shown
+  index: number;
+}
+
+interface HistorySearch {
+  query: string;
+  matches: string[];
+  index: number;
+}
+
+const commonPrefix = (words: string[]) =>
+  words.reduce((prefix, word) => {
+    let length = 0;
+    while (length < prefix.length && prefix[length] === word[length]) {
+      length++;
+    }
+    return prefix.slice(0, length);
+  });
+
 const GenixShell: React.FC = () => {
   const terminalRef = useRef<HTMLDivElement>(null);
   const inputRef = useRef<HTMLInputElement>(null);
   const [connected, setConnected] = useState(false);
   const wsRef = useRef<WebSocket | null>(null);
+  // Element receiving the output of the command currently streaming
+  const streamRef = useRef<HTMLDivElement | null>(null);
+  const streamLengthRef = useRef(0);
   const [status, setStatus] = useState<'connecting' | 'connected' | 'disconnected'>('connecting');
+  const browseRef = useRef<HistoryBrowse | null>(null);
+  // Ctrl+R reverse search; while active the input holds the query
+  const [search, setSearch] = useState<HistorySearch | null>(null);
+  const searchRef = useRef<HistorySearch | null>(null);
 
   useEffect(() => {
     // Initialize WebSocket connection
@@ -28,6 +62,28 @@ const GenixShell: React.FC = () => {
         output.className = 'text-white font-mono text-sm';
         terminalRef.current.appendChild(output);
         terminalRef.current.scrollTop = terminalRef.current.scrollHeight;
+      } else if (data.type === 'output-chunk' && terminalRef.current) {
+        if (!streamRef.current) {
+          streamRef.current = document.createElement('div');
+          streamRef.current.className = 'text-white font-mono text-sm whitespace-pre-wrap';
+          terminalRef.current.appendChild(streamRef.current);
+          streamLengthRef.current = 0;
+        }
+        // One text node per chunk: appending never copies what is already shown
+        const stream = streamRef.current;
+        stream.appendChild(document.createTextNode(data.output));
+        streamLengthRef.current += data.output.length;
+        while (streamLengthRef.current > STREAM_LIMIT && stream.firstChild !== stream.lastChild) {
+          streamLengthRef.current -= stream.firstChild!.textContent!.length;
+          stream.removeChild(stream.firstChild!);
+        }
+        terminalRef.current.scrollTop = terminalRef.current.scrollHeight;
+      } else if (data.type === 'output-end') {
+        streamRef.current = null;
+      } else if (data.type === 'completion') {
+        applyCompletion(data.line, data.start, data.candidates);
+      } else if (data.type === 'history') {
+        applyHistory(data.query, data.mode, data.matches);
       }
     };
 
@@ -60,6 +116,135 @@ const GenixShell: React.FC = () => {
     }
   };
 
+  const send = (message: object) => {
+    if (wsRef.current && wsRef.current.readyState === WebSocket.OPEN) {
+      wsRef.current.send(JSON.stringify(message));
+    }
+  };
+
+  const setInput = (value: string) => {
+    if (inputRef.current) {
+      inputRef.current.value = value;
+      inputRef.current.setSelectionRange(value.length, value.length);
+    }
+  };
+
+  // One candidate replaces the word; several extend it by what they share,
+  // or are listed when they share nothing more
+  const applyCompletion = (line: string, start: number, candidates: string[]) => {
+    if (!inputRef.current || inputRef.current.value !== line || candidates.length === 0) {
+      return;
+    }
+    const word = line.slice(start);
+    if (candidates.length === 1) {
+      const candidate = candidates[0];
+      setInput(line.slice(0, start) + candidate + (candidate.endsWith('/') ? '' : ' '));
+      return;
+    }
+    const shared = commonPrefix(candidates);
+    if (shared.length > word.length) {
+      setInput(line.slice(0, start) + shared);
+    } else {
+      appendOutput(candidates.join('  '), 'text-gray-400 font-mono text-sm');
+    }
+  };
+
+  const applyHistory = (query: string, mode: string, matches: string[]) => {
+    if (mode === 'substring') {
+      if (searchRef.current && searchRef.current.query === query) {
+        updateSearch({ query, matches, index: 0 });
+      }
+      return;
+    }
+    const browse = browseRef.current;
+    if (browse && browse.draft === query && browse.matches.length === 0 && matches.length > 0) {
+      browse.matches = matches;
+      browse.index = 0;
+      setInput(matches[0]);
+    }
+  };
+
+  const updateSearch = (next: HistorySearch | null) => {
+    searchRef.current = next;
+    setSearch(next);
+  };
+
+  const browseHistory = (step: number) => {
+    const browse = browseRef.current;
+    if (!browse) {
+      if (step > 0) {
+        const draft = inputRef.current?.value ?? '';
+        browseRef.current = { draft, matches: [], index: -1 };
+        send({
+          type: 'command',
+          action: 'history-search',
+          query: draft,
+          mode: 'prefix',
+          limit: HISTORY_LIMIT,
+        });
+      }
+      return;
+    }
+    const index = Math.max(-1, Math.min(browse.index + step, browse.matches.length - 1));
+    browse.index = index;
+    setInput(index < 0 ? browse.draft : browse.matches[index]);
+  };
+
+  const handleKeyDown = (e: React.KeyboardEvent<HTMLInputElement>) => {
+    const current = searchRef.current;
+    if (current) {
+      if (e.key === 'Enter' || e.key === 'Escape') {
+        e.preventDefault();
+        updateSearch(null);
+        setInput(e.key === 'Enter' ? (current.matches[current.index] ?? current.query) : '');
+      } else if (e.ctrlKey && e.key === 'r') {
+        e.preventDefault();
+        const index = Math.min(current.index + 1, current.matches.length - 1);
+        updateSearch({ ...current, index: Math.max(index, 0) });
+      }
+      return;
+    }
+
+    if (e.key === 'Enter') {
+      e.preventDefault();
+      const command = inputRef.current?.value;
+      if (inputRef.current) {
+        inputRef.current.value = '';
+      }
+      browseRef.current = null;
+      sendCommand(command);
+    } else if (e.key === 'Tab') {
+      e.preventDefault();
+      send({ type: 'command', action: 'complete', line: inputRef.current?.value ?? '' });
+    } else if (e.key === 'ArrowUp' || e.key === 'ArrowDown') {
+      e.preventDefault();
+      browseHistory(e.key === 'ArrowUp' ? 1 : -1);
+    } else if (e.ctrlKey && e.key === 'r') {
+      e.preventDefault();
+      browseRef.current = null;
+      updateSearch({ query: '', matches: [], index: 0 });
+      setInput('');
+    }
+  };
+
+  const handleChange = (value: string) => {
+    if (searchRef.current) {
+      updateSearch({ query: value, matches: [], index: 0 });
+      if (value) {
+        send({
+          type: 'command',
+          action: 'history-search',
+          query: value,
+          mode: 'substring',
+          limit: HISTORY_LIMIT,
+        });
+      }
+      return;
+    }
+    // Typing ends browsing; the next ArrowUp searches for the new text
+    browseRef.current = null;
+  };
+
   const sendCommand = (raw: string | undefined | null) => {
     const trimmed = (raw || '').trim();
     if (!trimmed) {
@@ -83,6 +268,7 @@ const GenixShell: React.FC = () => {
         type: 'command',
         action: action,
         path: path,
+        line: trimmed,
       })
     );
   };
@@ -108,22 +294,19 @@ const GenixShell: React.FC = () => {
         )}
       </div>
       <div className="border-t border-gray-700 p-2">
+        {search && (
+          <div className="text-gray-400 font-mono text-sm">
+            (reverse-i-search)`{search.query}&apos;: {search.matches[search.index] ?? ''}
+          </div>
+        )}
         <input
           ref={inputRef}
           type="text"
           autoFocus
           className="w-full bg-transparent text-white outline-none"
           placeholder="Enter command..."
-          onKeyDown={(e) => {
-            if (e.key === 'Enter') {
-              e.preventDefault();
-              const command = inputRef.current?.value;
-              if (inputRef.current) {
-                inputRef.current.value = '';
-              }
-              sendCommand(command);
-            }
-          }}
+          onKeyDown={handleKeyDown}
+          onChange={(e) => handleChange(e.target.value)}
         />
       </div>
     </div>